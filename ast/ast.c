@@ -6,14 +6,16 @@
 #include <ctype.h>
 #include <errno.h>
 
-static err_t ensure_cap_(void** buf, size_t* cap, size_t need, size_t elem_size)
+#include "../libs/memory/memory.h"
+
+static err_t ensure_cap_(mem_tag_t tag, void** buf, size_t* cap, size_t need, size_t elem_size)
 {
     if (*cap >= need) return OK;
 
     size_t new_cap = (*cap ? *cap * 2 : 8);
     if (new_cap < need) new_cap = need;
 
-    void* p = realloc(*buf, new_cap * elem_size);
+    void* p = mem_realloc(tag, *buf, new_cap * elem_size);
     if (!p) return ERR_ALLOC;
 
     *buf = p;
@@ -56,10 +58,10 @@ void ast_tree_dtor(ast_tree_t* ast_tree)
 {
     if (!ast_tree) return;
 
-    for (size_t i = 0; i < ast_tree->alloced_count; ++i)
-        free(ast_tree->alloced[i]);
+    for (size_t i = 0; i < ast_tree->chunk_count; ++i)
+        mem_free(ast_tree->chunks[i]);
 
-    free(ast_tree->alloced);
+    mem_free(ast_tree->chunks);
 
     symtable_dtor(&ast_tree->symtable);
     nametable_dtor(&ast_tree->nametable);
@@ -71,24 +73,105 @@ ast_node_t* ast_new(ast_tree_t* ast_tree, ast_kind_t kind, token_pos_t pos)
 {
     if (!ast_tree) return NULL;
 
-    ast_node_t* node = (ast_node_t*)calloc(1, sizeof(*node));
-    if (!node) return NULL;
+    if (ast_tree->chunk_count == 0 || ast_tree->chunk_used == AST_CHUNK_NODES)
+    {
+        err_t rc = ensure_cap_(MEM_TAG_AST, (void**)&ast_tree->chunks, &ast_tree->chunk_cap,
+                               ast_tree->chunk_count + 1, sizeof(ast_node_t*));
+        if (rc != OK) return NULL;
+
+        ast_node_t* chunk = (ast_node_t*)mem_calloc(MEM_TAG_AST, AST_CHUNK_NODES, sizeof(ast_node_t));
+        if (!chunk) return NULL;
+
+        ast_tree->chunks[ast_tree->chunk_count++] = chunk;
+        ast_tree->chunk_used = 0;
+    }
+
+    // chunks come zeroed and a node is never handed out twice
+    ast_node_t* node = &ast_tree->chunks[ast_tree->chunk_count - 1][ast_tree->chunk_used++];
 
     node->kind = kind;
     node->pos  = pos;
     node->type = AST_TYPE_UNKNOWN;
 
-    err_t rc = ensure_cap_((void**)&ast_tree->alloced, &ast_tree->alloced_cap, 
-                           ast_tree->alloced_count + 1, sizeof(ast_node_t*));
-    if (rc != OK)
+    ast_tree->alloced_count++;
+    ast_tree->nodes_amount++;
+    return node;
+}
+
+err_t ast_tree_view(ast_tree_t* view, const ast_tree_t* base)
+{
+    if (!view || !base || base->names_base) return ERR_BAD_ARG;
+
+    memset(view, 0, sizeof(*view));
+    view->names_base       = &base->nametable;
+    view->names_base_count = base->nametable.amount;
+    return nametable_ctor(&view->nametable);
+}
+
+static size_t* name_slot_(ast_node_t* n)
+{
+    switch (n->kind)
     {
-        free(node);
-        return NULL;
+        case ASTK_FUNC:     return &n->u.func.name_id;
+        case ASTK_PARAM:    return &n->u.param.name_id;
+        case ASTK_VAR_DECL: return &n->u.vdecl.name_id;
+        case ASTK_ASSIGN:   return &n->u.assign.name_id;
+        case ASTK_IDENT:    return &n->u.ident.name_id;
+        case ASTK_CALL:     return &n->u.call.name_id;
+        default:            return NULL;
     }
+}
 
-    ast_tree->alloced[ast_tree->alloced_count++] = node;
-    ast_tree->nodes_amount++;
-    return node;
+static void rename_(ast_node_t* n, size_t from, const size_t* map)
+{
+    for (; n; n = n->right)
+    {
+        size_t* id = name_slot_(n);
+        if (id && *id != SIZE_MAX && *id >= from) *id = map[*id - from];
+
+        rename_(n->left, from, map);
+    }
+}
+
+err_t ast_tree_merge(ast_tree_t* base, ast_tree_t* view, ast_node_t* sub)
+{
+    if (!base || !view || view->names_base != &base->nametable) return ERR_BAD_ARG;
+
+    err_t rc = ensure_cap_(MEM_TAG_AST, (void**)&base->chunks, &base->chunk_cap,
+                           base->chunk_count + view->chunk_count, sizeof(ast_node_t*));
+
+    const size_t added = view->nametable.amount;
+    size_t* map = (rc == OK && added) ? (size_t*)mem_calloc(MEM_TAG_AST, added, sizeof(size_t)) : NULL;
+    if (added && !map) rc = ERR_ALLOC;
+
+    for (size_t i = 0; i < added && rc == OK; ++i)
+    {
+        const nametable_entry_t* e = &view->nametable.data[i];
+        map[i] = nametable_insert(&base->nametable, e->name, e->length);
+        if (map[i] == SIZE_MAX) rc = ERR_ALLOC;
+    }
+
+    if (rc == OK)
+    {
+        if (added) rename_(sub, view->names_base_count, map);
+
+        // the last chunk of the view goes last, new nodes are taken from it
+        if (view->chunk_count)
+        {
+            memcpy(base->chunks + base->chunk_count, view->chunks, view->chunk_count * sizeof(ast_node_t*));
+            base->chunk_count += view->chunk_count;
+            base->chunk_used   = view->chunk_used;
+        }
+        base->alloced_count += view->alloced_count;
+        base->nodes_amount  += view->nodes_amount;
+    }
+
+    // on failure the nodes may still be in use under sub, they are left behind
+    mem_free(map);
+    mem_free(view->chunks);
+    nametable_dtor(&view->nametable);
+    memset(view, 0, sizeof(*view));
+    return rc;
 }
 
 void ast_add_child(ast_node_t* parent, ast_node_t* child)
@@ -109,6 +192,33 @@ void ast_add_child(ast_node_t* parent, ast_node_t* child)
     cur->right = child;
 }
 
+// put repl where old is: same parent, same place among siblings
+void ast_replace(ast_node_t* old, ast_node_t* repl)
+{
+    if (!old || !repl || old == repl) return;
+
+    ast_node_t* parent = old->parent;
+    repl->parent = parent;
+    repl->right  = old->right;
+
+    if (!parent) return;
+
+    if (parent->left == old)
+    {
+        parent->left = repl;
+        return;
+    }
+
+    for (ast_node_t* c = parent->left; c; c = c->right)
+    {
+        if (c->right == old)
+        {
+            c->right = repl;
+            return;
+        }
+    }
+}
+
 ast_node_t* ast_child(const ast_node_t* node, size_t idx)
 {
     if (!node) return NULL;
@@ -125,14 +235,76 @@ size_t ast_children_count(const ast_node_t* node)
     return cnt;
 }
 
+size_t ast_subtree_size(const ast_node_t* node)
+{
+    if (!node) return 0;
+    size_t cnt = 1;
+    for (const ast_node_t* c = node->left; c; c = c->right)
+        cnt += ast_subtree_size(c);
+    return cnt;
+}
+
+ast_node_t* ast_clone(ast_tree_t* ast_tree, const ast_node_t* node)
+{
+    if (!ast_tree || !node) return NULL;
+
+    ast_node_t* copy = ast_new(ast_tree, node->kind, node->pos);
+    if (!copy) return NULL;
+
+    copy->type  = node->type;
+    copy->flags = 0;
+    copy->u     = node->u;
+
+    ast_node_t** link = &copy->left;
+    for (const ast_node_t* c = node->left; c; c = c->right)
+    {
+        ast_node_t* cc = ast_clone(ast_tree, c);
+        if (!cc) return NULL;
+
+        cc->parent = copy;
+        *link = cc;
+        link  = &cc->right;
+    }
+
+    return copy;
+}
+
 const char* ast_name_cstr(const ast_tree_t* ast_tree, size_t name_id)
 {
     if (!ast_tree) return NULL;
     if (name_id == SIZE_MAX) return NULL;
+
+    if (ast_tree->names_base)
+    {
+        if (name_id < ast_tree->names_base_count) return ast_tree->names_base->data[name_id].name;
+        name_id -= ast_tree->names_base_count;
+    }
+
     if (name_id >= ast_tree->nametable.amount) return NULL;
     return ast_tree->nametable.data[name_id].name;
 }
 
+size_t ast_name_insert(ast_tree_t* ast_tree, const char* name, size_t length, int* out_added)
+{
+    if (!ast_tree || !name || !out_added) return SIZE_MAX;
+    *out_added = 0;
+
+    size_t offset = 0;
+    if (ast_tree->names_base)
+    {
+        const size_t id = nametable_find(ast_tree->names_base, name, length);
+        if (id != SIZE_MAX && id < ast_tree->names_base_count) return id;
+        offset = ast_tree->names_base_count;
+    }
+
+    const size_t before = ast_tree->nametable.amount;
+    const size_t id     = nametable_insert(&ast_tree->nametable, name, length);
+    if (id == SIZE_MAX) return SIZE_MAX;
+
+    *out_added = (id >= before);
+    return offset + id;
+}
+
 const char* ast_kind_to_cstr(ast_kind_t kind)
 {
     switch (kind)
@@ -167,8 +339,8 @@ err_t symtable_ctor(symtable_t* st)
 void symtable_dtor(symtable_t* st)
 {
     if (!st) return;
-    free(st->symbols);
-    free(st->scopes);
+    mem_free(st->symbols);
+    mem_free(st->scopes);
     memset(st, 0, sizeof(*st));
 }
 
@@ -176,7 +348,7 @@ err_t symtable_push_scope(symtable_t* st)
 {
     if (!st) return ERR_BAD_ARG;
 
-    err_t rc = ensure_cap_((void**)&st->scopes, &st->scopes_cap, st->scopes_amount + 1, sizeof(scope_t));
+    err_t rc = ensure_cap_(MEM_TAG_SYMTABLE, (void**)&st->scopes, &st->scopes_cap, st->scopes_amount + 1, sizeof(scope_t));
     if (rc != OK)
         return rc;
 
@@ -233,7 +405,7 @@ err_t symtable_declare(symtable_t* st, sym_kind_t kind, size_t name_id, ast_type
     if (symtable_lookup_current(st, name_id) >= 0)
         return ERR_SYNTAX;
 
-    err_t rc = ensure_cap_((void**)&st->symbols, &st->cap, st->amount + 1, sizeof(symbol_t));
+    err_t rc = ensure_cap_(MEM_TAG_SYMTABLE, (void**)&st->symbols, &st->cap, st->amount + 1, sizeof(symbol_t));
     if (rc != OK)
         return rc;
 
@@ -250,6 +422,9 @@ err_t symtable_declare(symtable_t* st, sym_kind_t kind, size_t name_id, ast_type
         fprintf(out, " name=%s ret=%s",           \
             ast_name_cstr(t, n->u.func.name_id),  \
             ast_type_to_cstr(n->u.func.ret_type));\
+        if (n->u.func.memo)                       \
+            fprintf(out, " memo=%zu",             \
+                n->u.func.memo);                  \
     })                                            \
     X(ASTK_PARAM, {                               \
         fprintf(out, " name=%s type=%s",          \
@@ -269,12 +444,17 @@ err_t symtable_declare(symtable_t* st, sym_kind_t kind, size_t name_id, ast_type
     })                                                                   \
     X(ASTK_CALL, {                                                       \
         fprintf(out, " name=%s", ast_name_cstr(t, n->u.call.name_id));   \
+        if (n->u.call.hits)                                              \
+            fprintf(out, " hits=%zu", n->u.call.hits);                   \
     })                                                                   \
+    X(ASTK_IF,     { dump_arm_(out, n); })                               \
+    X(ASTK_BRANCH, { dump_arm_(out, n); })                               \
+    X(ASTK_ELSE,   { dump_arm_(out, n); })                               \
     X(ASTK_NUM_LIT, {                                                    \
         if (n->u.num.lit_type == LIT_INT)                                \
             fprintf(out, " int=%lld", (long long)n->u.num.lit.i64);      \
         else if (n->u.num.lit_type == LIT_FLOAT)                         \
-            fprintf(out, " float=%g", n->u.num.lit.f64);                 \
+            fprintf(out, " float=%.17g", n->u.num.lit.f64);              \
     })                                                                   \
     X(ASTK_STR_LIT, {                                                    \
         fprintf(out, " str_len=%zu", n->u.str.len);                      \
@@ -289,6 +469,12 @@ err_t symtable_declare(symtable_t* st, sym_kind_t kind, size_t name_id, ast_type
         fprintf(out, " builtin=%d", (int)n->u.builtin_unary.id);         \
     })
 
+static void dump_arm_(FILE* out, const ast_node_t* n)
+{
+    if (n->u.arm.hits)  fprintf(out, " hits=%zu", n->u.arm.hits);
+    if (n->u.arm.total) fprintf(out, " total=%zu", n->u.arm.total);
+}
+
 static void dump_payload_(FILE* out, const ast_tree_t* t, const ast_node_t* n)
 {
     switch (n->kind)
@@ -307,6 +493,10 @@ void ast_dump_sexpr(FILE* out, const ast_tree_t* ast_tree, const ast_node_t* nod
 
     fprintf(out, "( %s", ast_kind_to_cstr(node->kind));
     dump_payload_(out, ast_tree, node);
+
+    // literals carry their type in the payload already
+    if (ast_is_expr_kind(node->kind) && node->kind != ASTK_NUM_LIT && node->type != AST_TYPE_UNKNOWN)
+        fprintf(out, " ty=%s", ast_type_to_cstr(node->type));
     fprintf(out, " ");
 
     // left = first child
@@ -330,6 +520,10 @@ typedef struct
     const char*         buffer;
     size_t              len;
     size_t              offset;
+
+    size_t              pos_offset; // line/col cache, reader only moves forward
+    size_t              pos_line;
+    size_t              pos_col;
 } sxr_t;
 
 static void sxr_linecol_(const char* buffer, size_t n, size_t offset, size_t* line, size_t* col)
@@ -347,6 +541,29 @@ static void sxr_linecol_(const char* buffer, size_t n, size_t offset, size_t* li
     *col  = C;
 }
 
+// incremental sxr_linecol_, rescans only from the previous node
+static void sxr_pos_(sxr_t* r, size_t* line, size_t* col)
+{
+    size_t offset = (r->offset > r->len) ? r->len : r->offset;
+
+    if (r->pos_line == 0 || offset < r->pos_offset)
+    {
+        r->pos_offset = 0;
+        r->pos_line   = 1;
+        r->pos_col    = 1;
+    }
+
+    for (size_t k = r->pos_offset; k < offset; ++k)
+    {
+        if (r->buffer[k] == '\n') { ++r->pos_line; r->pos_col = 1; }
+        else { ++r->pos_col; }
+    }
+
+    r->pos_offset = offset;
+    *line = r->pos_line;
+    *col  = r->pos_col;
+}
+
 static err_t sxr_fail_(sxr_t* r, const char* msg)
 {
     if (!r || !r->op) return ERR_SYNTAX;
@@ -507,6 +724,32 @@ static err_t sxr_apply_payload_(ast_tree_t* t, sxr_t* r, ast_node_t* n, const ch
         return OK;
     }
 
+    if (KEY("memo") && n->kind == ASTK_FUNC)
+    {
+        n->u.func.memo = (size_t)strtoull(val, NULL, 10);
+        return OK;
+    }
+
+    if (KEY("hits"))
+    {
+        const size_t v = (size_t)strtoull(val, NULL, 10);
+        if (n->kind == ASTK_CALL) n->u.call.hits = v;
+        if (n->kind == ASTK_IF || n->kind == ASTK_BRANCH || n->kind == ASTK_ELSE) n->u.arm.hits = v;
+        return OK;
+    }
+
+    if (KEY("total") && n->kind == ASTK_IF)
+    {
+        n->u.arm.total = (size_t)strtoull(val, NULL, 10);
+        return OK;
+    }
+
+    if (KEY("ty"))
+    {
+        n->type = ast_type_from_text_(val);
+        return OK;
+    }
+
     if (KEY("int") && n->kind == ASTK_NUM_LIT)
     {
         errno = 0;
@@ -600,7 +843,7 @@ static ast_node_t* sxr_parse_node_(ast_tree_t* t, sxr_t* r, ast_node_t* parent)
     }
 
     size_t line = 1, col = 1;
-    sxr_linecol_(r->buffer, r->len, r->offset, &line, &col);
+    sxr_pos_(r, &line, &col);
     token_pos_t pos = { .line = line, .column = col, .offset = r->offset };
 
     ast_node_t* n = ast_new(t, kind, pos);
@@ -644,12 +887,12 @@ static err_t sxr_read_all_into_op_buffer_(operational_data_t* op)
 {
     if (!op || !op->in_file) return ERR_BAD_ARG;
 
-    free(op->buffer);
+    mem_free(op->buffer);
     op->buffer = NULL;
     op->buffer_size = 0;
 
     size_t cap = 4096;
-    char* buf = (char*)malloc(cap + 1);
+    char* buf = (char*)mem_alloc(MEM_TAG_IO, cap + 1);
     if (!buf) return ERR_ALLOC;
 
     size_t n = 0;
@@ -658,10 +901,10 @@ static err_t sxr_read_all_into_op_buffer_(operational_data_t* op)
         if (n == cap)
         {
             size_t new_cap = cap * 2;
-            char* nb = (char*)realloc(buf, new_cap + 1);
+            char* nb = (char*)mem_realloc(MEM_TAG_IO, buf, new_cap + 1);
             if (!nb)
             {
-                free(buf);
+                mem_free(buf);
                 return ERR_ALLOC;
             }
             buf = nb;
@@ -677,7 +920,7 @@ static err_t sxr_read_all_into_op_buffer_(operational_data_t* op)
             if (feof(op->in_file)) break;
             if (ferror(op->in_file))
             {
-                free(buf);
+                mem_free(buf);
                 return ERR_CORRUPT;
             }
         }
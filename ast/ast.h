@@ -38,6 +38,11 @@ typedef enum
     AST_BUILTIN_FTOI,      // bozo
 } ast_builtin_unary_t;
 
+typedef enum
+{
+    AST_FLAG_QUEUED = 1u << 0,  // node is on optimizer worklist
+} ast_flag_t;
+
 typedef struct ast_node_s ast_node_t;
 
 struct ast_node_s
@@ -50,14 +55,17 @@ struct ast_node_s
     ast_node_t* left;
     ast_node_t* right;
 
+    unsigned    flags;  // AST_FLAG_*, transient marks of middle-end passes, not serialized
+
     union
     {
-        struct { size_t name_id; ast_type_t ret_type; } func;
+        struct { size_t name_id; ast_type_t ret_type; size_t memo; } func;  // memo: params in [0, memo) use a table
         struct { size_t name_id; ast_type_t type; } param;
         struct { size_t name_id; ast_type_t type; } vdecl;
         struct { size_t name_id; } assign;
         struct { size_t name_id; } ident;
-        struct { size_t name_id; } call;
+        struct { size_t name_id; size_t hits; } call;   // hits: profiled runs, 0 = none
+        struct { size_t hits; size_t total; } arm;      // IF/BRANCH/ELSE: runs of the arm; total: of the chain, IF only
 
         struct { literal_type_t lit_type; cell64_t lit; } num;
         struct { const char* ptr; size_t len; } str;
@@ -106,28 +114,87 @@ typedef struct
     size_t      nodes_amount;
     ast_node_t* root;
 
-    ast_node_t** alloced;
-    size_t       alloced_count;
-    size_t       alloced_cap;
+    // nodes come from chunks of AST_CHUNK_NODES, freed with the tree
+    ast_node_t** chunks;
+    size_t       chunk_count;
+    size_t       chunk_cap;
+    size_t       chunk_used;     // nodes taken from the last chunk
+    size_t       alloced_count;  // nodes handed out
 
     nametable_t  nametable;
     symtable_t   symtable;
+
+    // views only: names below names_base_count are read from names_base,
+    // nametable holds the ones added on top of it
+    const nametable_t* names_base;
+    size_t             names_base_count;
 } ast_tree_t;
 
+#define AST_CHUNK_NODES 256
+
 err_t ast_tree_ctor(ast_tree_t* ast_tree, nametable_t* nametable);
 void  ast_tree_dtor(ast_tree_t* ast_tree);
 
+/*
+    A view allocates nodes and adds names without writing base, so views
+    of the same tree can be used from several threads at once while base
+    is left alone. ast_tree_merge hands the nodes of a view to base and
+    gives the names it added ids in base, renumbering them under sub.
+    Views merged in the same order get the same ids
+*/
+err_t ast_tree_view (ast_tree_t* view, const ast_tree_t* base);
+err_t ast_tree_merge(ast_tree_t* base, ast_tree_t* view, ast_node_t* sub);
+
+
 ast_node_t* ast_new(ast_tree_t* ast_tree, ast_kind_t kind, token_pos_t pos);
 
 void        ast_add_child     (ast_node_t* parent, ast_node_t* child);
+void        ast_replace       (ast_node_t* old, ast_node_t* repl);
 ast_node_t* ast_child         (const ast_node_t* node, size_t idx);
 size_t      ast_children_count(const ast_node_t* node);
+size_t      ast_subtree_size  (const ast_node_t* node);
+
+// deep copy of node and its children (not its siblings), owned by ast_tree
+ast_node_t* ast_clone(ast_tree_t* ast_tree, const ast_node_t* node);
+
+// kinds that produce a value and get a type from ast_annotate_types
+int         ast_is_expr_kind(ast_kind_t kind);
+
+/*
+    Set the type of every expression node in one pass from literals,
+    declarations and return types. keep: leave types already set alone,
+    as when they came from .east
+*/
+err_t       ast_annotate_types(ast_tree_t* ast_tree, int keep);
+
+// printed by an instrumented program in front of its counters, "prof"
+#define AST_PROFILE_MAGIC 1886547814
+
+/*
+    Profile sites in preorder: an IF has two counters, chain runs and then
+    arm runs, BRANCH and ELSE one for their arm, CALL one for its runs.
+    The counters of a site follow those of the site before. The hash
+    covers kinds and callee names, a profile of another program fails it
+*/
+size_t      ast_profile_slots(ast_kind_t kind);
+err_t       ast_profile_sites(const ast_tree_t* ast_tree, const ast_node_t*** out_sites,
+                              size_t* out_count, size_t* out_counters, size_t* out_hash);
+
+/*
+    Read the output of an instrumented run from path, whatever the program
+    printed before the counters is skipped, and put the counts into hits
+    and total. ERR_CORRUPT: no counters for this tree in the file
+*/
+err_t       ast_profile_read(ast_tree_t* ast_tree, const char* path);
 
 const char* ast_kind_to_cstr(ast_kind_t kind);
 const char* ast_type_to_cstr(ast_type_t type);
 
 const char* ast_name_cstr(const ast_tree_t* type, size_t name_id);
 
+// id of name, added when missing; *out_added tells which. SIZE_MAX when out of memory
+size_t      ast_name_insert(ast_tree_t* ast_tree, const char* name, size_t length, int* out_added);
+
 void ast_dump_sexpr(FILE* out, const ast_tree_t* ast_tree, const ast_node_t* node);
 
 err_t  symtable_ctor(symtable_t* st);
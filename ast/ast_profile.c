@@ -0,0 +1,188 @@
+#include "ast.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Profiles. An instrumented program ends by printing AST_PROFILE_MAGIC,
+    the hash of the sites, the number of counters and the counters, in
+    the order ast_profile_sites gives. That output is the profile file;
+    reading it back walks the same sites of the same tree
+*/
+
+typedef struct
+{
+    const ast_node_t** sites;
+    size_t             count;
+    size_t             cap;
+    size_t             counters;
+    size_t             hash;
+} ap_walk_t;
+
+static size_t ap_mix_(size_t h, const char* s, size_t len)
+{
+    // FNV-1a, kept to 31 bits so it prints as a positive VM int
+    for (size_t i = 0; i < len; ++i)
+        h = ((h ^ (unsigned char)s[i]) * 16777619u) & 0x7FFFFFFFu;
+    return h;
+}
+
+static err_t ap_walk_(ap_walk_t* w, const ast_tree_t* t, const ast_node_t* n)
+{
+    for (; n; n = n->right)
+    {
+        const size_t slots = ast_profile_slots(n->kind);
+        if (slots)
+        {
+            if (w->count == w->cap)
+            {
+                const size_t cap = w->cap ? w->cap * 2 : 64;
+                const ast_node_t** p = (const ast_node_t**)mem_realloc(MEM_TAG_AST, w->sites, cap * sizeof(*p));
+                if (!p) return ERR_ALLOC;
+
+                w->sites = p;
+                w->cap   = cap;
+            }
+            w->sites[w->count++] = n;
+            w->counters += slots;
+
+            const char* kind = ast_kind_to_cstr(n->kind);
+            w->hash = ap_mix_(w->hash, kind, strlen(kind));
+
+            const char* name = (n->kind == ASTK_CALL) ? ast_name_cstr(t, n->u.call.name_id) : NULL;
+            if (name) w->hash = ap_mix_(w->hash, name, strlen(name));
+        }
+
+        err_t rc = ap_walk_(w, t, n->left);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+size_t ast_profile_slots(ast_kind_t kind)
+{
+    switch (kind)
+    {
+        case ASTK_IF:     return 2;
+        case ASTK_BRANCH:
+        case ASTK_ELSE:
+        case ASTK_CALL:   return 1;
+        default:          return 0;
+    }
+}
+
+err_t ast_profile_sites(const ast_tree_t* ast_tree, const ast_node_t*** out_sites,
+                        size_t* out_count, size_t* out_counters, size_t* out_hash)
+{
+    if (!ast_tree || !out_count || !out_counters || !out_hash) return ERR_BAD_ARG;
+
+    ap_walk_t w = { .hash = 2166136261u & 0x7FFFFFFFu };
+    err_t rc = ap_walk_(&w, ast_tree, ast_tree->root);
+    if (rc != OK || !out_sites) mem_free(w.sites);
+    if (rc != OK) return rc;
+
+    if (out_sites) *out_sites = w.sites;
+    *out_count    = w.count;
+    *out_counters = w.counters;
+    *out_hash     = w.hash;
+    return OK;
+}
+
+// next whitespace separated token as an integer; *ok = 0 when it is not one
+static const char* ap_token_(const char* p, const char* end, long long* out, int* ok)
+{
+    while (p < end && isspace((unsigned char)*p)) ++p;
+
+    const char* start = p;
+    while (p < end && !isspace((unsigned char)*p)) ++p;
+
+    char buf[32];
+    const size_t len = (size_t)(p - start);
+    *ok = 0;
+    if (len == 0 || len >= sizeof(buf)) return p;
+
+    memcpy(buf, start, len);
+    buf[len] = '\0';
+
+    char* tail = NULL;
+    errno = 0;
+    *out = strtoll(buf, &tail, 10);
+    *ok  = (errno == 0 && *tail == '\0');
+    return p;
+}
+
+static err_t ap_apply_(ast_tree_t* t, const char* text, size_t len)
+{
+    const char* end  = text + len;
+    const char* dump = NULL;
+
+    // the program's own output may come first, the last magic starts the counters
+    for (const char* p = text; p < end; )
+    {
+        long long v  = 0;
+        int       ok = 0;
+        const char* next = ap_token_(p, end, &v, &ok);
+        if (ok && v == AST_PROFILE_MAGIC) dump = next;
+        p = next;
+    }
+    if (!dump) return ERR_CORRUPT;
+
+    const ast_node_t** sites = NULL;
+    size_t count = 0, counters = 0, hash = 0;
+    err_t rc = ast_profile_sites(t, &sites, &count, &counters, &hash);
+    if (rc != OK) return rc;
+
+    long long head[2] = { 0 };
+    int       ok      = 1;
+    for (size_t i = 0; i < 2 && ok; ++i) dump = ap_token_(dump, end, &head[i], &ok);
+
+    if (!ok || (size_t)head[0] != hash || (size_t)head[1] != counters) rc = ERR_CORRUPT;
+
+    for (size_t i = 0; i < count && rc == OK; ++i)
+    {
+        ast_node_t* n = (ast_node_t*)sites[i];
+
+        long long v[2] = { 0 };
+        for (size_t k = 0; k < ast_profile_slots(n->kind) && ok; ++k)
+            dump = ap_token_(dump, end, &v[k], &ok);
+        if (!ok || v[0] < 0 || v[1] < 0) { rc = ERR_CORRUPT; break; }
+
+        if (n->kind == ASTK_CALL)    n->u.call.hits = (size_t)v[0];
+        else if (n->kind == ASTK_IF) { n->u.arm.total = (size_t)v[0]; n->u.arm.hits = (size_t)v[1]; }
+        else                         n->u.arm.hits = (size_t)v[0];
+    }
+
+    mem_free(sites);
+    return rc;
+}
+
+err_t ast_profile_read(ast_tree_t* ast_tree, const char* path)
+{
+    if (!ast_tree || !path) return ERR_BAD_ARG;
+
+    FILE* f = fopen(path, "rb");
+    if (!f) return ERR_BAD_ARG;
+
+    err_t rc  = OK;
+    char* buf = NULL;
+    long  len = -1;
+
+    if (fseek(f, 0, SEEK_END) == 0) len = ftell(f);
+    if (len < 0 || fseek(f, 0, SEEK_SET) != 0) rc = ERR_BAD_ARG;
+
+    if (rc == OK)
+    {
+        buf = (char*)mem_calloc(MEM_TAG_IO, (size_t)len + 1, 1);
+        if (!buf) rc = ERR_ALLOC;
+    }
+    if (rc == OK && fread(buf, 1, (size_t)len, f) != (size_t)len) rc = ERR_BAD_ARG;
+    fclose(f);
+
+    if (rc == OK) rc = ap_apply_(ast_tree, buf, (size_t)len);
+
+    mem_free(buf);
+    return rc;
+}
@@ -0,0 +1,231 @@
+#include "ast.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    One walk in program order with a stack of visible locals, the same
+    scoping the backend uses: a declaration is visible from its own
+    initializer on, a block drops what it declared
+*/
+
+typedef struct
+{
+    size_t     name_id;
+    ast_type_t type;
+} at_bind_t;
+
+typedef struct
+{
+    const ast_tree_t* tree;
+    int               keep;
+
+    // per name id: what a call of it returns, resolved on first use
+    ast_type_t*       calls;
+    unsigned char*    resolved;
+
+    at_bind_t*        binds;
+    size_t            bind_amount;
+    size_t            bind_cap;
+} at_ctx_t;
+
+static const struct { const char* name; ast_type_t ret; } at_builtins[] = {
+    { "in",        AST_TYPE_INT   }, { "cap",      AST_TYPE_INT   },
+    { "fin",       AST_TYPE_FLOAT }, { "nocap",    AST_TYPE_FLOAT },
+    { "cin",       AST_TYPE_INT   }, { "stinky",   AST_TYPE_INT   },
+    { "draw",      AST_TYPE_VOID  }, { "gyat",     AST_TYPE_VOID  },
+    { "clean_vm",  AST_TYPE_VOID  }, { "skibidi",  AST_TYPE_VOID  },
+    { "out",       AST_TYPE_INT   }, { "pookie",   AST_TYPE_INT   },
+    { "fout",      AST_TYPE_FLOAT }, { "rizz",     AST_TYPE_FLOAT },
+    { "cout",      AST_TYPE_INT   }, { "menace",   AST_TYPE_INT   },
+    { "set_pixel", AST_TYPE_VOID  },
+};
+
+static int at_builtin_(const char* name, ast_type_t* out)
+{
+    if (!name) return 0;
+
+    for (size_t i = 0; i < sizeof(at_builtins) / sizeof(at_builtins[0]); ++i)
+        if (strcmp(at_builtins[i].name, name) == 0)
+        {
+            *out = at_builtins[i].ret;
+            return 1;
+        }
+    return 0;
+}
+
+static ast_type_t at_call_type_(at_ctx_t* cx, size_t name_id)
+{
+    if (name_id >= cx->tree->nametable.amount) return AST_TYPE_UNKNOWN;
+
+    if (!cx->resolved[name_id])
+    {
+        ast_type_t t = AST_TYPE_UNKNOWN;
+        unused at_builtin_(ast_name_cstr(cx->tree, name_id), &t);
+
+        cx->calls[name_id]    = t;
+        cx->resolved[name_id] = 1;
+    }
+    return cx->calls[name_id];
+}
+
+static err_t at_bind_(at_ctx_t* cx, size_t name_id, ast_type_t type)
+{
+    if (cx->bind_amount == cx->bind_cap)
+    {
+        const size_t cap = cx->bind_cap ? cx->bind_cap * 2 : 32;
+        at_bind_t* p = (at_bind_t*)mem_realloc(MEM_TAG_AST, cx->binds, cap * sizeof(at_bind_t));
+        if (!p) return ERR_ALLOC;
+
+        cx->binds    = p;
+        cx->bind_cap = cap;
+    }
+
+    cx->binds[cx->bind_amount++] = (at_bind_t){ .name_id = name_id, .type = type };
+    return OK;
+}
+
+static ast_type_t at_lookup_(const at_ctx_t* cx, size_t name_id)
+{
+    for (size_t i = cx->bind_amount; i-- > 0; )
+        if (cx->binds[i].name_id == name_id) return cx->binds[i].type;
+    return AST_TYPE_UNKNOWN;
+}
+
+static ast_type_t at_binary_(const ast_node_t* e)
+{
+    const token_kind_t op = e->u.binary.op;
+
+    if (op == TOK_OP_EQ  || op == TOK_OP_NEQ || op == TOK_OP_LT  || op == TOK_OP_GT ||
+        op == TOK_OP_LTE || op == TOK_OP_GTE || op == TOK_OP_AND || op == TOK_OP_OR)
+        return AST_TYPE_INT;
+
+    const ast_type_t lt = e->left ? e->left->type : AST_TYPE_UNKNOWN;
+    const ast_type_t rt = (e->left && e->left->right) ? e->left->right->type : AST_TYPE_UNKNOWN;
+
+    if (op == TOK_OP_POW)
+        return (lt == AST_TYPE_INT && rt == AST_TYPE_INT) ? AST_TYPE_INT : AST_TYPE_FLOAT;
+
+    if (lt == AST_TYPE_FLOAT || rt == AST_TYPE_FLOAT) return AST_TYPE_FLOAT;
+    if (lt == AST_TYPE_UNKNOWN || rt == AST_TYPE_UNKNOWN) return AST_TYPE_UNKNOWN;
+    return AST_TYPE_INT;
+}
+
+// type of e from its payload and already annotated children
+static ast_type_t at_expr_type_(at_ctx_t* cx, const ast_node_t* e)
+{
+    switch (e->kind)
+    {
+        case ASTK_NUM_LIT:
+            return (e->u.num.lit_type == LIT_FLOAT) ? AST_TYPE_FLOAT : AST_TYPE_INT;
+
+        case ASTK_STR_LIT:
+            return AST_TYPE_PTR;
+
+        case ASTK_IDENT:
+            return at_lookup_(cx, e->u.ident.name_id);
+
+        case ASTK_CALL:
+            return at_call_type_(cx, e->u.call.name_id);
+
+        case ASTK_BUILTIN_UNARY:
+            return (e->u.builtin_unary.id == AST_BUILTIN_FTOI) ? AST_TYPE_INT : AST_TYPE_FLOAT;
+
+        case ASTK_UNARY:
+            if (e->u.unary.op == TOK_OP_NOT) return AST_TYPE_INT;
+            return e->left ? e->left->type : AST_TYPE_UNKNOWN;
+
+        case ASTK_BINARY:
+            return at_binary_(e);
+
+        default:
+            return e->type;
+    }
+}
+
+static err_t at_list_(at_ctx_t* cx, ast_node_t* first);
+
+static err_t at_node_(at_ctx_t* cx, ast_node_t* n)
+{
+    const size_t mark = cx->bind_amount;
+    err_t rc = OK;
+
+    switch (n->kind)
+    {
+        case ASTK_PARAM:
+            rc = at_bind_(cx, n->u.param.name_id, n->u.param.type);
+            break;
+
+        case ASTK_VAR_DECL:
+            rc = at_bind_(cx, n->u.vdecl.name_id, n->u.vdecl.type);
+            if (rc == OK) rc = at_list_(cx, n->left);
+            return rc;
+
+        default:
+            break;
+    }
+
+    if (rc == OK) rc = at_list_(cx, n->left);
+    if (rc != OK) return rc;
+
+    if (ast_is_expr_kind(n->kind) && !(cx->keep && n->type != AST_TYPE_UNKNOWN))
+        n->type = at_expr_type_(cx, n);
+
+    // params live until the end of their function, locals until the end of their block
+    if (n->kind == ASTK_FUNC || n->kind == ASTK_BLOCK) cx->bind_amount = mark;
+    return OK;
+}
+
+static err_t at_list_(at_ctx_t* cx, ast_node_t* first)
+{
+    for (ast_node_t* n = first; n; n = n->right)
+    {
+        err_t rc = at_node_(cx, n);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+int ast_is_expr_kind(ast_kind_t kind)
+{
+    return kind == ASTK_IDENT   || kind == ASTK_NUM_LIT || kind == ASTK_STR_LIT ||
+           kind == ASTK_CALL    || kind == ASTK_UNARY   || kind == ASTK_BINARY  ||
+           kind == ASTK_BUILTIN_UNARY;
+}
+
+err_t ast_annotate_types(ast_tree_t* ast_tree, int keep)
+{
+    if (!ast_tree) return ERR_BAD_ARG;
+
+    ast_node_t* program = ast_tree->root;
+    if (!program) return OK;
+
+    const size_t names = ast_tree->nametable.amount + 1;
+
+    at_ctx_t cx = { .tree = ast_tree, .keep = keep };
+    cx.calls    = (ast_type_t*)   mem_calloc(MEM_TAG_AST, names, sizeof(ast_type_t));
+    cx.resolved = (unsigned char*)mem_calloc(MEM_TAG_AST, names, 1);
+
+    err_t rc = (cx.calls && cx.resolved) ? OK : ERR_ALLOC;
+
+    // calls may come before the function, builtins win over a function of the same name
+    for (const ast_node_t* fn = program->left; fn && rc == OK; fn = fn->right)
+    {
+        const size_t id = fn->u.func.name_id;
+        if (fn->kind != ASTK_FUNC || id >= ast_tree->nametable.amount) continue;
+
+        ast_type_t t = fn->u.func.ret_type;
+        unused at_builtin_(ast_name_cstr(ast_tree, id), &t);
+
+        cx.calls[id]    = t;
+        cx.resolved[id] = 1;
+    }
+
+    if (rc == OK) rc = at_list_(&cx, program->left);
+
+    mem_free(cx.binds);
+    mem_free(cx.resolved);
+    mem_free(cx.calls);
+    return rc;
+}
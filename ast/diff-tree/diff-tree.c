@@ -3,6 +3,8 @@
 #include <ctype.h>
 #include <math.h>
 
+#include "../../libs/memory/memory.h"
+
 const double FLT_ERR = 1e-6;
 
 #define DECLARE_OP_DESC(name, text, id) { text, 0, name },
@@ -80,7 +82,7 @@ static err_t vars_ensure_capacity(tree_t *tree, size_t min_capacity)
     if (new_cap < min_capacity)
         new_cap = min_capacity;
 
-    var_t *new_arr = (var_t*)realloc(tree->variables, new_cap * sizeof(var_t));
+    var_t *new_arr = (var_t*)mem_realloc(MEM_TAG_DIFF_TREE, tree->variables, new_cap * sizeof(var_t));
     if (!new_arr)
         return ERR_ALLOC;
 
@@ -107,12 +109,12 @@ static void vars_free(tree_t *tree)
         {
             if (tree->variables[i].name)
             {
-                free(tree->variables[i].name);
+                mem_free(tree->variables[i].name);
                 tree->variables[i].name = NULL;
             }
         }
 
-        free(tree->variables);
+        mem_free(tree->variables);
         tree->variables = NULL;
     }
 
@@ -125,7 +127,7 @@ err_t node_ctor(node_t** node)
     if (!CHECK(ERROR, node != NULL, "node_ctor: node is NULL"))
         return ERR_BAD_ARG;
 
-    *node = (node_t*)calloc(1, sizeof(**node));
+    *node = (node_t*)mem_calloc(MEM_TAG_DIFF_TREE, 1, sizeof(**node));
     if (*node == NULL)
         return ERR_ALLOC;
 
@@ -145,11 +147,11 @@ err_t node_dtor(node_t* node)
 
     if (node->node_type == TYPE_VAR && node->value.var.name != NULL)
     {
-        free(node->value.var.name);
+        mem_free(node->value.var.name);
         node->value.var.name = NULL;
     }
 
-    free(node);
+    mem_free(node);
 
     return OK;
 }
@@ -293,7 +295,7 @@ var_t* get_or_create_var(tree_t* tree, const char* name)
         return NULL;
 
     var_t* v = &tree->variables[tree->var_amount++];
-    v->name  = strdup(name);
+    v->name  = mem_strdup(MEM_TAG_DIFF_TREE, name);
     v->hash  = h;
     v->value = NAN;
 
@@ -404,7 +406,7 @@ static node_t* new_var_node(tree_t* tree, const char* name, err_t* err)
     }
 
     n->node_type       = TYPE_VAR;
-    n->value.var.name  = strdup(v->name);
+    n->value.var.name  = mem_strdup(MEM_TAG_DIFF_TREE, v->name);
     n->value.var.hash  = v->hash;
     n->value.var.value = v->value;
     n->left            = NULL;
@@ -749,8 +751,8 @@ static void cfg_assign_field(derivative_config_t* config,
             v = strip_quotes(v);
             char** dst = (char**)(base + e->offset);
 
-            free(*dst);
-            *dst = strdup(v);
+            mem_free(*dst);
+            *dst = mem_strdup(MEM_TAG_DIFF_TREE, v);
             break;
         }
 
@@ -803,7 +805,7 @@ static err_t derivative_config_parse_kv(derivative_config_t* config,
 
 #define CLEANUP_AND_RETURN(code) \
     block_begin                  \
-        free(op_data.buffer);    \
+        mem_free(op_data.buffer);    \
         if (file) fclose(file);  \
         tree_dtor(tree);         \
         return (code);           \
@@ -943,7 +945,7 @@ err_t tree_read_file(tree_t* tree,
     size_t fsize = (size_t)rsize;
     operational_data_t op_data = {  };
     op_data.buffer_size = fsize;
-    op_data.buffer      = (char*)calloc(1, fsize);
+    op_data.buffer      = (char*)mem_calloc(MEM_TAG_DIFF_TREE, 1, fsize);
     if (!op_data.buffer)
         return ERR_ALLOC;
 
@@ -963,7 +965,7 @@ err_t tree_read_file(tree_t* tree,
     if (!has_equal)
     {
         err_t r = parse_equation_string(tree, buf, filename);
-        free(op_data.buffer);
+        mem_free(op_data.buffer);
         fclose(file);
         return r;
     }
@@ -972,7 +974,7 @@ err_t tree_read_file(tree_t* tree,
         derivative_config_init_defaults(config);
 
     err_t r = parse_config_and_equation(tree, config, buf, filename);
-    free(op_data.buffer);
+    mem_free(op_data.buffer);
     fclose(file);
 
     if (r != OK)
@@ -1015,10 +1017,10 @@ node_t* clone_subtree(const node_t* src,
     if (src->node_type == TYPE_VAR && src->value.var.name != NULL)
     {
         size_t len = strlen(src->value.var.name);
-        node->value.var.name = (char*)calloc(len + 1, sizeof(char));
+        node->value.var.name = (char*)mem_calloc(MEM_TAG_DIFF_TREE, len + 1, sizeof(char));
         if (!node->value.var.name)
         {
-            free(node);
+            mem_free(node);
             *err = ERR_ALLOC;
             return NULL;
         }
@@ -1,7 +1,17 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "dump.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "../../libs/memory/memory.h"
 
 static size_t s_ast_img_counter = 0;
 
@@ -121,29 +131,196 @@ static void node_payload_(char* out, size_t cap, const ast_tree_t* t, const ast_
     html_escape_(out, cap, tmp);
 }
 
+#define AST_GV_EDGE_COLOR "#98A2B3"
+
+static void dump_node_(FILE* dot, const ast_tree_t* tree, const ast_node_t* p, size_t id)
+{
+    const char* OUT_ROOT  = "#16A34A";
+    const char* OUT_NODE  = "#475467";
+    const char* FILL_NODE = "#F9FAFB";
+    const char* FILL_ROOT = "#E6F4EA";
+    const char* CELL_BG   = "#FFFFFF";
+    const char* TABLE_BRD = "#D0D5DD";
+    const char* TXT_COLOR = "#111827";
+
+    const int is_root = (p == tree->root);
+
+    const char* outline = is_root ? OUT_ROOT : OUT_NODE;
+    const char* fill    = is_root ? FILL_ROOT : FILL_NODE;
+
+    char payload[1024] = {0};
+    node_payload_(payload, sizeof(payload), tree, p);
+
+    fprintf(dot,
+        "n%zu [shape=plain, color=\"%s\", fillcolor=\"%s\", penwidth=2.0, label=<"
+        "<TABLE BORDER=\"0\" CELLBORDER=\"1\" CELLSPACING=\"0\" CELLPADDING=\"4\" COLOR=\"%s\">"
+        "<TR><TD COLSPAN=\"2\" BGCOLOR=\"%s\"><B><FONT COLOR=\"%s\">%s</FONT></B></TD></TR>"
+        "<TR><TD ALIGN=\"LEFT\">addr</TD><TD ALIGN=\"LEFT\">%p</TD></TR>"
+        "<TR><TD ALIGN=\"LEFT\">kind</TD><TD ALIGN=\"LEFT\">%s</TD></TR>"
+        "<TR><TD ALIGN=\"LEFT\">type</TD><TD ALIGN=\"LEFT\">%s</TD></TR>"
+        "<TR><TD ALIGN=\"LEFT\">pos</TD><TD ALIGN=\"LEFT\">%zu:%zu</TD></TR>"
+        "<TR><TD ALIGN=\"LEFT\">payload</TD><TD ALIGN=\"LEFT\">%s</TD></TR>"
+        "<TR><TD PORT=\"L\" ALIGN=\"LEFT\">child: %p</TD>"
+        "<TD PORT=\"R\" ALIGN=\"LEFT\">sib: %p</TD></TR>"
+        "</TABLE>"
+        ">];\n",
+        id,
+        outline, fill,
+        TABLE_BRD, CELL_BG, TXT_COLOR,
+        is_root ? "ROOT" : "NODE",
+        (void*)p,
+        ast_kind_to_cstr(p->kind),
+        ast_type_to_cstr(p->type),
+        p->pos.line, p->pos.column,
+        payload[0] ? payload : "&nbsp;",
+        (void*)p->left, (void*)p->right
+    );
+}
+
+static void dump_edge_(FILE* dot, size_t from, int sibling, const char* to)
+{
+    fprintf(dot, "n%zu:%c -> %s [color=\"%s\", penwidth=1.9%s];\n",
+            from, sibling ? 'R' : 'L', to, AST_GV_EDGE_COLOR, sibling ? ", style=dashed" : "");
+}
+
 typedef struct
 {
     const ast_node_t* node;
-    size_t           id;
-} NodeInfo;
+    size_t            parent_id;  // SIZE_MAX for the dump root
+    int               sibling;    // reached through parent->right
+} dump_item_t;
 
-static size_t find_index_by_ptr_(const NodeInfo* arr, size_t n, const ast_node_t* p)
+static const ast_node_t* find_function_(const ast_tree_t* tree, const char* name)
 {
-    for (size_t i = 0; i < n; ++i)
-        if (arr[i].node == p) return i;
-    return (size_t)-1;
+    if (!tree->root || !name) return NULL;
+
+    for (const ast_node_t* f = tree->root->left; f; f = f->right)
+        if (f->kind == ASTK_FUNC && strcmp(ast_name_cstr(tree, f->u.func.name_id), name) == 0)
+            return f;
+
+    return NULL;
+}
+
+// preorder walk with explicit stack; ids are assigned on visit, so edges need no lookup
+static size_t dump_walk_(FILE* dot, const ast_tree_t* tree, const ast_node_t* start,
+                         size_t max_nodes, int* truncated)
+{
+    size_t cap = 64, top = 0, n = 0;
+    dump_item_t* stack = (dump_item_t*)mem_calloc(MEM_TAG_DUMP, cap, sizeof(*stack));
+    if (!stack) return 0;
+
+    // the dumped subtree does not include siblings of its root
+    stack[top++] = (dump_item_t){ .node = start, .parent_id = SIZE_MAX, .sibling = 0 };
+
+    while (top > 0)
+    {
+        const dump_item_t it = stack[--top];
+
+        if (max_nodes && n >= max_nodes)
+        {
+            if (!*truncated)
+                fprintf(dot, "more [label=\"...truncated at %zu nodes\", color=\"#9CA3AF\", "
+                             "fontcolor=\"#9CA3AF\", fillcolor=\"#F3F4F6\"];\n", max_nodes);
+            *truncated = 1;
+            if (it.parent_id != SIZE_MAX) dump_edge_(dot, it.parent_id, it.sibling, "more");
+            continue;
+        }
+
+        const size_t id = n++;
+        dump_node_(dot, tree, it.node, id);
+
+        if (it.parent_id != SIZE_MAX)
+        {
+            char to[32] = {0};
+            snprintf(to, sizeof(to), "n%zu", id);
+            dump_edge_(dot, it.parent_id, it.sibling, to);
+        }
+
+        if (top + 2 > cap)
+        {
+            size_t nc = cap * 2;
+            dump_item_t* ns = (dump_item_t*)mem_realloc(MEM_TAG_DUMP, stack, nc * sizeof(*stack));
+            if (!ns) break;
+            stack = ns;
+            cap = nc;
+        }
+
+        if (it.node->right && it.node != start)
+            stack[top++] = (dump_item_t){ .node = it.node->right, .parent_id = id, .sibling = 1 };
+        if (it.node->left)
+            stack[top++] = (dump_item_t){ .node = it.node->left,  .parent_id = id, .sibling = 0 };
+    }
+
+    mem_free(stack);
+    return n;
+}
+
+// dot -T svg dot_path -o svg_path, stderr to svg_path.err; no shell is involved.
+// Without wait the dot runs in a grandchild, so nothing is left to reap
+static int dump_run_dot_(const char* dot_path, const char* svg_path, bool wait_dot)
+{
+    char err_path[600] = {0};
+    snprintf(err_path, sizeof(err_path), "%s.err", svg_path);
+
+    const pid_t pid = fork();
+    if (pid < 0) return -1;
+
+    if (pid == 0)
+    {
+        if (!wait_dot && fork() != 0) _exit(0);
+
+        const int fd = open(err_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd >= 0) { dup2(fd, STDERR_FILENO); close(fd); }
+
+        execlp("dot", "dot", "-T", "svg", dot_path, "-o", svg_path, (char*)NULL);
+        perror("dot");
+        _exit(127);
+    }
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0) return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+void ast_dump_options_default(ast_dump_options_t* opts)
+{
+    if (!opts) return;
+
+    opts->max_nodes = AST_DUMP_DEFAULT_MAX_NODES;
+    opts->function  = NULL;
+    opts->wait_dot  = false;
 }
 
 void ast_dump_graphviz_html(const ast_tree_t* tree, FILE* out_html)
+{
+    ast_dump_options_t opts = { 0 };
+    ast_dump_options_default(&opts);
+    ast_dump_graphviz_html_ex(tree, out_html, &opts);
+}
+
+void ast_dump_graphviz_html_ex(const ast_tree_t* tree, FILE* out_html, const ast_dump_options_t* opts)
 {
     if (!out_html) return;
 
-    system("mkdir -p temp");
+    ast_dump_options_t def = { 0 };
+    if (!opts)
+    {
+        ast_dump_options_default(&def);
+        opts = &def;
+    }
 
-    const char* dot_path = "temp/ast_graph.dot";
+    if (mkdir("temp", 0777) != 0 && errno != EEXIST)
+    {
+        fprintf(out_html, "<p><b>AST:</b> failed to create temp/</p>\n<hr/>\n");
+        return;
+    }
 
     char svg_name[64] = {0};
-    snprintf(svg_name, sizeof(svg_name), "ast%zu.svg", s_ast_img_counter++);
+    snprintf(svg_name, sizeof(svg_name), "ast%zu.svg", s_ast_img_counter);
+
+    // every dump gets its own .dot, so a background dot never reads a file being rewritten
+    char dot_path[128] = {0};
+    snprintf(dot_path, sizeof(dot_path), "temp/ast_graph%zu.dot", s_ast_img_counter++);
 
     char svg_path[512] = {0};
     snprintf(svg_path, sizeof(svg_path), "temp/t%s", svg_name);
@@ -155,16 +332,6 @@ void ast_dump_graphviz_html(const ast_tree_t* tree, FILE* out_html)
         return;
     }
 
-    const char* EDGE_CHILD   = "#98A2B3";
-    const char* EDGE_SIBLING = "#98A2B3";
-    const char* OUT_ROOT     = "#16A34A";
-    const char* OUT_NODE     = "#475467";
-    const char* FILL_NODE    = "#F9FAFB";
-    const char* FILL_ROOT    = "#E6F4EA";
-    const char* CELL_BG      = "#FFFFFF";
-    const char* TABLE_BRD    = "#D0D5DD";
-    const char* TXT_COLOR    = "#111827";
-
     fprintf(dot, "digraph AST {\n");
     fprintf(dot, "rankdir=TB;\n");
     fprintf(dot, "bgcolor=\"white\";\n");
@@ -174,188 +341,43 @@ void ast_dump_graphviz_html(const ast_tree_t* tree, FILE* out_html)
     fprintf(dot,
         "node [shape=box, style=\"rounded,filled\", color=\"%s\", fillcolor=\"%s\", "
         "fontname=\"monospace\", fontsize=10];\n",
-        OUT_NODE, FILL_NODE);
+        "#475467", "#F9FAFB");
 
     fprintf(dot,
-        "edge [color=\"#98A2B3\", penwidth=1.7, arrowsize=0.8, arrowhead=vee, "
-        "fontname=\"monospace\", fontsize=9];\n");
-
-    if (!tree || !tree->root)
-    {
-        fprintf(dot,
-            "empty [label=\"<empty AST>\", color=\"#9CA3AF\", "
-            "fontcolor=\"#9CA3AF\", fillcolor=\"#F3F4F6\"];\n");
-        fprintf(dot, "}\n");
-        fclose(dot);
-
-        char cmd_empty[4096];
-        snprintf(cmd_empty, sizeof(cmd_empty), "dot -T svg \"%s\" -o \"%s\"", dot_path, svg_path);
-        system(cmd_empty);
-
-        fprintf(out_html, "<h2>AST</h2>\n");
-        fprintf(out_html, "<h3>Nodes: 0</h3>\n");
-        fprintf(out_html, "<img src=\"temp/t%s\" />\n", svg_name);
-        fprintf(out_html, "<hr/>\n");
-        return;
-    }
-
-    size_t cap_nodes = 64;
-    size_t cap_q     = 64;
-    size_t n         = 0;
-    size_t head      = 0;
-    size_t tail      = 0;
-
-    NodeInfo* nodes = (NodeInfo*)calloc(cap_nodes, sizeof(NodeInfo));
-    const ast_node_t** q = (const ast_node_t**)calloc(cap_q, sizeof(const ast_node_t*));
-    if (!nodes || !q)
-    {
-        free(nodes);
-        free(q);
-        fclose(dot);
-        fprintf(out_html, "<p><b>AST:</b> alloc failed</p>\n<hr/>\n");
-        return;
-    }
-
-    q[tail++] = tree->root;
+        "edge [color=\"%s\", penwidth=1.7, arrowsize=0.8, arrowhead=vee, "
+        "fontname=\"monospace\", fontsize=9];\n", AST_GV_EDGE_COLOR);
 
-    while (head < tail)
-    {
-        const ast_node_t* cur = q[head++];
-
-        if (n == cap_nodes)
-        {
-            size_t nc = cap_nodes * 2;
-            NodeInfo* nn = (NodeInfo*)realloc(nodes, nc * sizeof(NodeInfo));
-            if (!nn)
-            {
-                free(nodes);
-                free(q);
-                fclose(dot);
-                fprintf(out_html, "<p><b>AST:</b> realloc failed</p>\n<hr/>\n");
-                return;
-            }
-            nodes = nn;
-            cap_nodes = nc;
-        }
-
-        nodes[n].node = cur;
-        nodes[n].id = n;
-        n++;
-
-        if (cur->left)
-        {
-            if (tail == cap_q)
-            {
-                size_t nq = cap_q * 2;
-                const ast_node_t** qq = (const ast_node_t**)realloc(q, nq * sizeof(*q));
-                if (!qq)
-                {
-                    free(nodes);
-                    free(q);
-                    fclose(dot);
-                    fprintf(out_html, "<p><b>AST:</b> realloc failed</p>\n<hr/>\n");
-                    return;
-                }
-                q = qq;
-                cap_q = nq;
-            }
-            q[tail++] = cur->left;
-        }
-
-        if (cur->right)
-        {
-            if (tail == cap_q)
-            {
-                size_t nq = cap_q * 2;
-                const ast_node_t** qq = (const ast_node_t**)realloc(q, nq * sizeof(*q));
-                if (!qq)
-                {
-                    free(nodes);
-                    free(q);
-                    fclose(dot);
-                    fprintf(out_html, "<p><b>AST:</b> realloc failed</p>\n<hr/>\n");
-                    return;
-                }
-                q = qq;
-                cap_q = nq;
-            }
-            q[tail++] = cur->right;
-        }
-    }
+    const ast_node_t* start = tree ? tree->root : NULL;
+    if (start && opts->function)
+        start = find_function_(tree, opts->function);
 
-    free(q);
+    size_t n = 0;
+    int truncated = 0;
 
-    for (size_t i = 0; i < n; ++i)
+    if (!start)
     {
-        const ast_node_t* p = nodes[i].node;
-        const int is_root = (p == tree->root);
-
-        const char* outline = is_root ? OUT_ROOT : OUT_NODE;
-        const char* fill    = is_root ? FILL_ROOT : FILL_NODE;
-
-        char payload[1024] = {0};
-        node_payload_(payload, sizeof(payload), tree, p);
-
         fprintf(dot,
-            "n%zu [shape=plain, color=\"%s\", fillcolor=\"%s\", penwidth=2.0, label=<"
-            "<TABLE BORDER=\"0\" CELLBORDER=\"1\" CELLSPACING=\"0\" CELLPADDING=\"4\" COLOR=\"%s\">"
-            "<TR><TD COLSPAN=\"2\" BGCOLOR=\"%s\"><B><FONT COLOR=\"%s\">%s</FONT></B></TD></TR>"
-            "<TR><TD ALIGN=\"LEFT\">addr</TD><TD ALIGN=\"LEFT\">%p</TD></TR>"
-            "<TR><TD ALIGN=\"LEFT\">kind</TD><TD ALIGN=\"LEFT\">%s</TD></TR>"
-            "<TR><TD ALIGN=\"LEFT\">type</TD><TD ALIGN=\"LEFT\">%s</TD></TR>"
-            "<TR><TD ALIGN=\"LEFT\">pos</TD><TD ALIGN=\"LEFT\">%zu:%zu</TD></TR>"
-            "<TR><TD ALIGN=\"LEFT\">payload</TD><TD ALIGN=\"LEFT\">%s</TD></TR>"
-            "<TR><TD PORT=\"L\" ALIGN=\"LEFT\">child: %p</TD>"
-            "<TD PORT=\"R\" ALIGN=\"LEFT\">sib: %p</TD></TR>"
-            "</TABLE>"
-            ">];\n",
-            nodes[i].id,
-            outline, fill,
-            TABLE_BRD, CELL_BG, TXT_COLOR,
-            is_root ? "ROOT" : "NODE",
-            (void*)p,
-            ast_kind_to_cstr(p->kind),
-            ast_type_to_cstr(p->type),
-            p->pos.line, p->pos.column,
-            payload[0] ? payload : "&nbsp;",
-            (void*)p->left, (void*)p->right
-        );
+            "empty [label=\"%s\", color=\"#9CA3AF\", "
+            "fontcolor=\"#9CA3AF\", fillcolor=\"#F3F4F6\"];\n",
+            (tree && tree->root) ? "<no such function>" : "<empty AST>");
     }
-
-    for (size_t i = 0; i < n; ++i)
+    else
     {
-        const ast_node_t* p = nodes[i].node;
-
-        if (p->left)
-        {
-            size_t j = find_index_by_ptr_(nodes, n, p->left);
-            if (j != (size_t)-1)
-                fprintf(dot, "n%zu:L -> n%zu [color=\"%s\", penwidth=1.9];\n",
-                        nodes[i].id, nodes[j].id, EDGE_CHILD);
-        }
-
-        if (p->right)
-        {
-            size_t j = find_index_by_ptr_(nodes, n, p->right);
-            if (j != (size_t)-1)
-                fprintf(dot, "n%zu:R -> n%zu [color=\"%s\", penwidth=1.9, style=dashed];\n",
-                        nodes[i].id, nodes[j].id, EDGE_SIBLING);
-        }
+        n = dump_walk_(dot, tree, start, opts->max_nodes, &truncated);
     }
 
     fprintf(dot, "}\n");
     fclose(dot);
 
-    char cmd[4096];
-    snprintf(cmd, sizeof(cmd), "dot -T svg \"%s\" -o \"%s\"", dot_path, svg_path);
-    const int rc = system(cmd);
+    // dot output goes to a side file: with a background dot nobody waits for its stderr
+    const int rc = dump_run_dot_(dot_path, svg_path, opts->wait_dot);
 
-    fprintf(out_html, "<h2>AST</h2>\n");
-    fprintf(out_html, "<h3>Nodes: %zu</h3>\n", n);
-    fprintf(out_html, "<h3>Root: 0x%p</h3>\n", (void*)tree->root);
-    fprintf(out_html, "<h3>dot rc: %d</h3>\n", rc);
+    char func_html[512] = {0};
+    html_escape_(func_html, sizeof(func_html), opts->function);
+    fprintf(out_html, "<h2>AST%s%s</h2>\n", opts->function ? ": " : "", func_html);
+    fprintf(out_html, "<h3>Nodes: %zu%s</h3>\n", n, truncated ? " (truncated)" : "");
+    if (tree) fprintf(out_html, "<h3>Root: 0x%p</h3>\n", (void*)tree->root);
+    fprintf(out_html, "<h3>dot rc: %d%s</h3>\n", rc, opts->wait_dot ? "" : " (background)");
     fprintf(out_html, "<img src=\"temp/t%s\" />\n", svg_name);
     fprintf(out_html, "<hr/>\n");
-
-    free(nodes);
 }
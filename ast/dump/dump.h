@@ -2,8 +2,24 @@
 #define AST_DUMP_H
 
 #include <stdio.h>
+#include <stdbool.h>
 #include "ast.h"
 
-void ast_dump_graphviz_html(const ast_tree_t* tree, FILE* out_html);
+#define AST_DUMP_DEFAULT_MAX_NODES 2000
+
+typedef struct
+{
+    size_t      max_nodes;  // 0 = unlimited, otherwise the rest is cut off
+    const char* function;   // dump only this function's subtree, NULL = whole AST
+    bool        wait_dot;   // block until dot renders svg instead of running it in background
+} ast_dump_options_t;
+
+void ast_dump_options_default(ast_dump_options_t* opts);
+
+/*
+    Write AST as .dot into temp/, start `dot` and reference the svg from out_html
+*/
+void ast_dump_graphviz_html   (const ast_tree_t* tree, FILE* out_html);
+void ast_dump_graphviz_html_ex(const ast_tree_t* tree, FILE* out_html, const ast_dump_options_t* opts);
 
 #endif
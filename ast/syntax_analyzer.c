@@ -6,6 +6,8 @@
 #include <math.h>
 #include <limits.h>
 
+#include "../libs/memory/memory.h"
+
 static const token_t* cur_(syntax_analyzer_t* sa)
 {
     if (!sa || sa->pos >= sa->amount) return NULL;
@@ -151,7 +153,7 @@ static err_t push_unresolved_(syntax_analyzer_t* sa, size_t name_id, token_pos_t
     if (sa->unresolved_amount == sa->unresolved_cap)
     {
         size_t new_cap = sa->unresolved_cap ? sa->unresolved_cap * 2 : 8;
-        void* p = realloc(sa->unresolved, new_cap * sizeof(*sa->unresolved));
+        void* p = mem_realloc(MEM_TAG_PARSER, sa->unresolved, new_cap * sizeof(*sa->unresolved));
         if (!p) return ERR_ALLOC;
         sa->unresolved = p;
         sa->unresolved_cap = new_cap;
@@ -213,7 +215,7 @@ err_t syntax_analyzer_ctor(syntax_analyzer_t*  sa,
 void syntax_analyzer_dtor(syntax_analyzer_t* sa)
 {
     if (!sa) return;
-    free(sa->unresolved);
+    mem_free(sa->unresolved);
     memset(sa, 0, sizeof(*sa));
 }
 
@@ -242,7 +244,7 @@ err_t syntax_analyze(syntax_analyzer_t* sa)
         }
     }
 
-    return OK;
+    return ast_annotate_types(sa->ast_tree, 0);
 }
 
 // Parsing helpers
@@ -491,6 +493,8 @@ static ast_node_t* parse_function_decl_(syntax_analyzer_t* sa)
 
     ast_add_child(fn, plist);
     ast_add_child(fn, body);
+
+    LOG_DEBUG("Parsed function '%s'", ast_name_cstr(sa->ast_tree, fname));
     return fn;
 }
 
@@ -999,17 +1003,17 @@ static ast_node_t* parse_if_(syntax_analyzer_t* sa)
 
         SA_EXPECT(TOK_LPAREN, "(");
         ast_node_t* cnd = parse_expr_(sa);
-        if (!cnd) { free(brs); return NULL; }
+        if (!cnd) { mem_free(brs); return NULL; }
         SA_EXPECT(TOK_RPAREN, ")");
 
         ast_node_t* st = parse_statement_(sa);
-        if (!st) { free(brs); return NULL; }
+        if (!st) { mem_free(brs); return NULL; }
 
         if (brn == brcap)
         {
             size_t nc = brcap ? brcap * 2 : 4;
-            void* p = realloc(brs, nc * sizeof(*brs));
-            if (!p) { free(brs); SA_FAIL(to, "Out of memory"); }
+            void* p = mem_realloc(MEM_TAG_PARSER, brs, nc * sizeof(*brs));
+            if (!p) { mem_free(brs); SA_FAIL(to, "Out of memory"); }
             brs = (br_t*)p;
             brcap = nc;
         }
@@ -1025,7 +1029,7 @@ static ast_node_t* parse_if_(syntax_analyzer_t* sa)
         sa->pos++;
 
         ast_node_t* else_body = parse_statement_(sa);
-        if (!else_body) { free(brs); return NULL; }
+        if (!else_body) { mem_free(brs); return NULL; }
 
         SA_NEW_NODE(els, ASTK_ELSE, ts);
         ast_add_child(els, else_body);
@@ -1040,7 +1044,7 @@ static ast_node_t* parse_if_(syntax_analyzer_t* sa)
         if (tail) ast_add_child(br, tail);
         tail = br;
     }
-    free(brs);
+    mem_free(brs);
 
     SA_NEW_NODE(ifn, ASTK_IF, t);
     ast_add_child(ifn, cond);
@@ -1206,6 +1210,38 @@ static ast_node_t* ast_from_math_node_(syntax_analyzer_t* sa,
     }
 }
 
+// d("expr", var, n): differentiate with diff-tree and convert back to AST; takes ownership of expr
+static ast_node_t* expand_derivative_(syntax_analyzer_t* sa, const token_t* td, char* expr,
+                                      const char* var_name, size_t order, token_pos_t pos)
+{
+    tree_t in_tree = {0}, out_tree = {0};
+    if (tree_ctor(&in_tree) != OK || tree_ctor(&out_tree) != OK) {
+        mem_free(expr);
+        SA_FAIL(td, "Out of memory");
+    }
+
+    err_t rc = tree_parse_expr(&in_tree, expr);
+    mem_free(expr);
+    if (rc != OK) {
+        tree_dtor(&in_tree); tree_dtor(&out_tree);
+        SA_FAIL(td, "Bad expression string in d(\"...\")");
+    }
+
+    rc = tree_derivative_n(&in_tree, &out_tree, var_name, order);
+    tree_dtor(&in_tree);
+    if (rc != OK) {
+        tree_dtor(&out_tree);
+        SA_FAIL(td, "Failed to differentiate d(\"...\", %s, %zu)", var_name, order);
+    }
+
+    tree_optimize(&out_tree);
+
+    ast_node_t* res = ast_from_math_node_(sa, out_tree.root, pos);
+    tree_dtor(&out_tree);
+
+    return res;
+}
+
 static ast_node_t* parse_derivative_call_(syntax_analyzer_t* sa)
 {
     const token_t* td = SA_CUR();
@@ -1217,7 +1253,7 @@ static ast_node_t* parse_derivative_call_(syntax_analyzer_t* sa)
     // 1) first arg: string literal
     const token_t* ts = SA_CUR();
     SA_EXPECT(TOK_STRING_LITERAL, "string literal as first arg to d()");
-    char* expr = strndup(ts->buffer, ts->length);
+    char* expr = mem_strndup(MEM_TAG_PARSER, ts->buffer, ts->length);
 
     SA_EXPECT(TOK_COMMA, ",");
 
@@ -1232,12 +1268,12 @@ static ast_node_t* parse_derivative_call_(syntax_analyzer_t* sa)
     const token_t* tn = SA_CUR();
     SA_EXPECT(TOK_NUMERIC_LITERAL, "integer order as third arg to d()");
     if (tn->lit_type != LIT_INT) {
-        free(expr);
+        mem_free(expr);
         SA_FAIL(tn, "d() order must be integer literal");
     }
     i64_t order_i = tn->lit.i64;
     if (order_i < 0) {
-        free(expr);
+        mem_free(expr);
         SA_FAIL(tn, "d() order must be >= 0");
     }
     size_t order = (size_t)order_i;
@@ -1246,32 +1282,10 @@ static ast_node_t* parse_derivative_call_(syntax_analyzer_t* sa)
 
     const char* var_name = ast_name_cstr(sa->ast_tree, var_id);
 
-    tree_t in_tree = {0}, out_tree = {0};
-    if (tree_ctor(&in_tree) != OK || tree_ctor(&out_tree) != OK) {
-        free(expr);
-        SA_FAIL(td, "Out of memory");
-    }
-
-    err_t rc = tree_parse_expr(&in_tree, expr);
-    free(expr);
-    if (rc != OK) {
-        tree_dtor(&in_tree); tree_dtor(&out_tree);
-        SA_FAIL(td, "Bad expression string in d(\"...\")");
-    }
-
-    rc = tree_derivative_n(&in_tree, &out_tree, var_name, order);
-    tree_dtor(&in_tree);
-    if (rc != OK) {
-        tree_dtor(&out_tree);
-        SA_FAIL(td, "Failed to differentiate d(\"...\", %s, %zu)", var_name, order);
-    }
-
-    tree_optimize(&out_tree);
-
-    ast_node_t* res = ast_from_math_node_(sa, out_tree.root, pos);
-    tree_dtor(&out_tree);
+    stats_phase_begin(STATS_PHASE_DERIV);
+    ast_node_t* res = expand_derivative_(sa, td, expr, var_name, order, pos);
+    stats_phase_end(STATS_PHASE_DERIV);
 
-    if (!res) return NULL;
     return res;
 }
 
@@ -8,6 +8,7 @@
 #include "ast_kinds.h"
 #include "../libs/logging/logging.h"
 #include "../libs/io/io.h"
+#include "../libs/stats/stats.h"
 #include "diff-tree/diff-tree.h"
 #include "diff-tree/differentiation.h"
 
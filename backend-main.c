@@ -4,10 +4,13 @@
 
 #include "libs/types.h"
 #include "libs/io/io.h"
+#include "libs/stats/stats.h"
+#include "libs/memory/memory.h"
 #include "libs/logging/logging.h"
 
 #include "ast/ast.h"
 #include "backend/backend.h"
+#include "ir/ir.h"
 
 static char* make_asm_filename_(const char* base)
 {
@@ -15,7 +18,7 @@ static char* make_asm_filename_(const char* base)
 
     const char* dot = strrchr(base, '.');
     if (dot && strcmp(dot, ".asm") == 0)
-        return strdup(base);
+        return mem_strdup(MEM_TAG_IO, base);
 
     size_t prefix_len = strlen(base);
     if (dot) prefix_len = (size_t)(dot - base);
@@ -23,7 +26,7 @@ static char* make_asm_filename_(const char* base)
     const char* ext = ".asm";
     const size_t ext_len = 4;
 
-    char* out = (char*)calloc(prefix_len + ext_len + 1, 1);
+    char* out = (char*)mem_calloc(MEM_TAG_IO, prefix_len + ext_len + 1, 1);
     if (!out) return NULL;
 
     memcpy(out, base, prefix_len);
@@ -61,9 +64,9 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
         if ((fp) && (fp) != stdout) { fclose((fp)); (fp) = NULL; } \
     block_end
 
-#define SAFE_FREE(p)                    \
-    block_begin                         \
-        if (p) { free(p); (p) = NULL; } \
+#define SAFE_FREE(p)                        \
+    block_begin                             \
+        if (p) { mem_free(p); (p) = NULL; } \
     block_end
 
 #define FAIL_MSG(msg)                                                            \
@@ -72,7 +75,7 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
             snprintf(op_data.error_msg, sizeof(op_data.error_msg), "%s", (msg)); \
         fprintf(stderr, "%s\n", op_data.error_msg);                              \
         print_error_context_(stderr, &op_data);                                  \
-        log_printf(ERROR, "%s", op_data.error_msg);                              \
+        LOG_ERROR("%s", op_data.error_msg);                                      \
         rc = ERR_SYNTAX;                                                         \
         goto cleanup;                                                            \
     block_end
@@ -82,7 +85,7 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
         snprintf(op_data.error_msg, sizeof(op_data.error_msg), (fmt), __VA_ARGS__); \
         fprintf(stderr, "%s\n", op_data.error_msg);                                 \
         print_error_context_(stderr, &op_data);                                     \
-        log_printf(ERROR, "%s", op_data.error_msg);                                 \
+        LOG_ERROR("%s", op_data.error_msg);                                         \
         rc = ERR_SYNTAX;                                                            \
         goto cleanup;                                                               \
     block_end
@@ -99,38 +102,85 @@ int main(int argc, char* const argv[])
     ast_tree_t ast_tree = (ast_tree_t){ 0 };
     int ast_inited = 0;
 
+    ir_module_t ir = (ir_module_t){ 0 };
+
+    backend_config_t be_cfg      = (backend_config_t){ 0 };
+    peep_report_t    peep_report = (peep_report_t){ 0 };
+
     char* asm_name = NULL;
+    FILE* ir_dump_file = NULL;
+
+    const char* stats_flag   = NULL;
+    const char* stats_json   = NULL;
+    const char* ir_flag      = NULL;
+    const char* ir_dump_path = NULL;
+    const char* instrument   = NULL;
+    const char* profile_path = NULL;
+    const char* no_peephole  = NULL;
+
+    const arg_option_t options[] = {
+        { "--stats",       ARG_FLAG,  &stats_flag   },
+        { "--stats-json",  ARG_VALUE, &stats_json   },
+        { "--ir",          ARG_FLAG,  &ir_flag      },
+        { "--dump-ir",     ARG_VALUE, &ir_dump_path },
+        { "--instrument",  ARG_FLAG,  &instrument   },
+        { "--profile",     ARG_VALUE, &profile_path },
+        { "--no-peephole", ARG_FLAG,  &no_peephole  },
+    };
 
     init_logging("backend.log", DEBUG);
-    log_printf(INFO, "Backend started");
+    LOG_INFO("Backend started");
 
-    size_t parsed = parse_arguments(argc, argv, &in_filename, &out_filename);
+    size_t parsed = parse_arguments_ex(argc, argv, &in_filename, &out_filename,
+                                       options, sizeof(options) / sizeof(options[0]));
     unused(parsed);
 
+    stats_init("backend", stats_flag || stats_json);
+
     if (!CHECK(ERROR, in_filename != NULL,
                "No input file specified. Use --infile <filename>"))
     {
         FAIL_MSG("Input file not specified.");
     }
 
+    if (instrument && ir_flag)
+        FAIL_MSG("--instrument emits from the AST, it does not go with --ir.");
+
     rc = ast_tree_ctor(&ast_tree, NULL);
     if (rc != OK)
         FAIL_MSG("Failed to initialize AST tree.");
     ast_inited = 1;
 
+    stats_phase_begin(STATS_PHASE_LOAD);
     op_data.in_file = load_file(in_filename, "rb");
     if (!op_data.in_file)
         FAILF("Failed to open input AST file '%s'", in_filename);
 
     rc = ast_read_sexpr_from_op(&ast_tree, &op_data);
     SAFE_FCLOSE(op_data.in_file);
+    stats_phase_end(STATS_PHASE_LOAD);
 
     if (rc != OK)
         FAIL_MSG("Failed to read/parse AST.");
 
+    // .east written before ty= existed has no expression types, fill just the gaps
+    rc = ast_annotate_types(&ast_tree, 1);
+    if (rc != OK)
+        FAIL_MSG("Failed to annotate AST types.");
+
+    // counts of an instrumented run of this same tree
+    if (profile_path)
+    {
+        rc = ast_profile_read(&ast_tree, profile_path);
+        if (rc == ERR_CORRUPT)
+            FAILF("Profile '%s' has no counters for this program", profile_path);
+        if (rc != OK)
+            FAILF("Failed to read profile '%s'", profile_path);
+    }
+
     if (out_filename)
     {
-        asm_name = strdup(out_filename);
+        asm_name = mem_strdup(MEM_TAG_IO, out_filename);
         if (!asm_name) FAIL_MSG("Out of memory while copying output filename.");
     }
     else
@@ -143,15 +193,74 @@ int main(int argc, char* const argv[])
     if (!op_data.out_file)
         FAILF("Failed to open output file '%s' for writing", asm_name);
 
-    rc = backend_emit_asm(&ast_tree, &op_data);
+    if (stats_enabled())
+    {
+        stats_set(STATS_INPUT_BYTES,    op_data.buffer_size);
+        stats_set(STATS_AST_NODES,      ast_subtree_size(ast_tree.root));
+        stats_set(STATS_AST_ALLOCS,     ast_tree.alloced_count);
+        stats_set(STATS_NAMETABLE_SIZE, ast_tree.nametable.amount);
+        stats_set(STATS_FUNCTIONS,      ast_children_count(ast_tree.root));
+    }
+
+    // --ir emits through the SSA IR, --dump-ir <file> writes it out
+    if (ir_flag || ir_dump_path)
+    {
+        stats_phase_begin(STATS_PHASE_IR);
+        rc = ir_build(&ir, &ast_tree, &op_data);
+        stats_phase_end(STATS_PHASE_IR);
+        if (rc != OK)
+            FAIL_MSG("IR construction failed.");
+
+        stats_set(STATS_IR_BLOCKS, ir_module_blocks(&ir));
+        stats_set(STATS_IR_VALUES, ir_module_values(&ir));
+
+        if (ir_dump_path)
+        {
+            stats_phase_begin(STATS_PHASE_DUMP);
+            ir_dump_file = load_file(ir_dump_path, "w");
+            if (!ir_dump_file)
+                FAILF("Failed to open IR dump file '%s' for writing", ir_dump_path);
+            ir_dump(ir_dump_file, &ir);
+            SAFE_FCLOSE(ir_dump_file);
+            stats_phase_end(STATS_PHASE_DUMP);
+        }
+    }
+
+    backend_config_default(&be_cfg);
+    be_cfg.peephole = !no_peephole;
+    be_cfg.report   = &peep_report;
+
+    stats_phase_begin(STATS_PHASE_EMIT);
+    if (ir_flag)
+    {
+        rc = ir_out_of_ssa(&ir);
+        if (rc == OK)
+            rc = backend_emit_asm_ir(&ir, &op_data, &be_cfg);
+    }
+    else if (instrument)
+        rc = backend_emit_asm_instrumented(&ast_tree, &op_data, &be_cfg);
+    else
+        rc = backend_emit_asm(&ast_tree, &op_data, &be_cfg);
+    stats_phase_end(STATS_PHASE_EMIT);
     if (rc != OK)
         FAIL_MSG("Backend codegen failed.");
 
-    log_printf(INFO, "Backend finished successfully. Wrote: %s", asm_name);
+    if (stats_flag && be_cfg.peephole)
+        peep_report_print(stderr, &peep_report);
+
+    stats_phase_begin(STATS_PHASE_WRITE);
+    stats_set(STATS_OUTPUT_BYTES, (size_t)ftell(op_data.out_file));
+    SAFE_FCLOSE(op_data.out_file);
+    stats_phase_end(STATS_PHASE_WRITE);
+
+    LOG_INFO("Backend finished successfully. Wrote: %s", asm_name);
 
 cleanup:
     SAFE_FCLOSE(op_data.in_file);
     SAFE_FCLOSE(op_data.out_file);
+    SAFE_FCLOSE(ir_dump_file);
+
+    ir_module_dtor(&ir);
 
     if (ast_inited)
         ast_tree_dtor(&ast_tree);
@@ -160,6 +269,11 @@ cleanup:
 
     SAFE_FREE(op_data.buffer);
 
+    mem_leak_report(stderr);
+
+    if (stats_finish(stats_flag != NULL, stats_json) != OK && rc == OK)
+        rc = ERR_BAD_ARG;
+
     close_log_file();
     return (rc == OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
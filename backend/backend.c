@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
+
+#include "../libs/memory/memory.h"
 
 static void be_set_error_(backend_t* be, token_pos_t pos, size_t fallback_offset,
                           const char* fmt, ...)
@@ -43,12 +46,52 @@ static void be_set_error_(backend_t* be, token_pos_t pos, size_t fallback_offset
 
 static int be_emitf_(backend_t* be, const char* fmt, ...)
 {
-    if (!be || !be->op->out_file) return 0;
-    va_list ap;
-    va_start(ap, fmt);
-    int r = vfprintf(be->op->out_file, fmt, ap);
-    va_end(ap);
-    return r;
+    if (!be || !be->op->out_file || be->out_rc != OK) return 0;
+
+    for (;;)
+    {
+        const size_t room = be->out_cap - be->out_len;
+
+        va_list ap;
+        va_start(ap, fmt);
+        int r = vsnprintf(be->out ? be->out + be->out_len : NULL, room, fmt, ap);
+        va_end(ap);
+
+        if (r < 0) return r;
+        if ((size_t)r < room)
+        {
+            be->out_len += (size_t)r;
+            return r;
+        }
+
+        size_t cap = be->out_cap ? be->out_cap * 2 : 4096;
+        while (cap < be->out_len + (size_t)r + 1) cap *= 2;
+
+        char* out = (char*)mem_realloc(MEM_TAG_BACKEND, be->out, cap);
+        if (!out)
+        {
+            be->out_rc = ERR_ALLOC;
+            return 0;
+        }
+        be->out     = out;
+        be->out_cap = cap;
+    }
+}
+
+// write out the unit emitted since the last flush
+static err_t be_flush_(backend_t* be)
+{
+    if (be->out_rc != OK) return be->out_rc;
+    if (be->out_len == 0) return OK;
+
+    err_t rc = OK;
+    if (be->peephole)
+        rc = peep_run(&be->peep, be->out, be->out_len, be->op->out_file, &be->peep_report);
+    else
+        fwrite(be->out, 1, be->out_len, be->op->out_file);
+
+    be->out_len = 0;
+    return rc;
 }
 
 static char* be_strdup_printf_(const char* fmt, ...)
@@ -60,7 +103,7 @@ static char* be_strdup_printf_(const char* fmt, ...)
 
     if (need < 0) return NULL;
 
-    char* s = (char*)calloc((size_t)need + 1, 1);
+    char* s = (char*)mem_calloc(MEM_TAG_BACKEND, (size_t)need + 1, 1);
     if (!s) return NULL;
 
     va_start(ap, fmt);
@@ -80,7 +123,7 @@ static char* be_new_label_(backend_t* be, const char* prefix)
         if ((want) > (cap)) {                                  \
             size_t new_cap = (cap) ? (cap) * 2 : 8;            \
             while (new_cap < (want)) new_cap *= 2;             \
-            void* np = realloc((ptr), new_cap * sizeof(type)); \
+            void* np = mem_realloc(MEM_TAG_BACKEND, (ptr), new_cap * sizeof(type)); \
             if (!np) return ERR_ALLOC;                         \
             (ptr) = (type*)np;                                 \
             (cap) = new_cap;                                   \
@@ -120,11 +163,11 @@ static ssize_t be_bind_lookup_(const backend_t* be, size_t name_id)
     return -1;
 }
 
-static err_t be_bind_push_(backend_t* be, size_t name_id, ast_type_t type, size_t offset, size_t depth)
+static err_t be_bind_push_(backend_t* be, size_t name_id, ast_type_t type, size_t offset, size_t depth, unsigned reg)
 {
     VEC_GROW(be->binds, be->bind_cap, be->bind_amount + 1, binding_t);
     be->binds[be->bind_amount++] = (binding_t){
-        .name_id = name_id, .type = type, .offset = offset, .depth = depth
+        .name_id = name_id, .type = type, .offset = offset, .depth = depth, .reg = reg
     };
     return OK;
 }
@@ -136,6 +179,13 @@ static void be_bind_pop_depth_(backend_t* be, size_t depth)
         be->bind_amount--;
 }
 
+// %.17e round-trips a finite double and always keeps the '.' of a float;
+// the middle end never folds to inf or nan
+static void be_emit_push_float_(backend_t* be, double v)
+{
+    be_emitf_(be, "PUSH %.17e\n", v);
+}
+
 static void be_emit_addr_bp_off_(backend_t* be, size_t offset)
 {
     // x13 = x15
@@ -161,6 +211,37 @@ static void be_emit_store_bp_off_(backend_t* be, size_t offset)
     be_emitf_(be, "POPM x%u\n", (unsigned)REG_TMPA);
 }
 
+// a variable from its register, or from its frame slot when it has none
+static void be_emit_load_home_(backend_t* be, unsigned reg, size_t offset)
+{
+    if (!reg)                    be_emit_load_bp_off_(be, offset);
+    else if (reg & BE_REG_FLOAT) be_emitf_(be, "FPUSHR fx%u\n", reg & ~BE_REG_FLOAT);
+    else                         be_emitf_(be, "PUSHR x%u\n", reg);
+}
+
+static void be_emit_store_home_(backend_t* be, unsigned reg, size_t offset)
+{
+    if (!reg)                    be_emit_store_bp_off_(be, offset);
+    else if (reg & BE_REG_FLOAT) be_emitf_(be, "FPOPR fx%u\n", reg & ~BE_REG_FLOAT);
+    else                         be_emitf_(be, "POPR x%u\n", reg);
+}
+
+// register of the param or IR slot at a BP offset, 0 = it stays in the frame
+static unsigned be_home_at_(const backend_t* be, size_t offset)
+{
+    if (offset < be->ir_reg_count) return be->ir_regs[offset];
+    for (size_t i = 0; i < be->home_count; ++i)
+        if (be->homes[i].offset == offset) return be->homes[i].reg;
+    return 0;
+}
+
+static unsigned be_home_of_decl_(const backend_t* be, const ast_node_t* decl)
+{
+    for (size_t i = 0; i < be->home_count; ++i)
+        if (be->homes[i].decl == decl) return be->homes[i].reg;
+    return 0;
+}
+
 // Compute addr = SP + imm into x13
 static void be_emit_addr_sp_plus_(backend_t* be, size_t imm)
 {
@@ -176,15 +257,23 @@ static void be_emit_addr_sp_plus_(backend_t* be, size_t imm)
     }
 }
 
-static void be_count_locals_rec_(const ast_node_t* n, size_t* out)
+// Slots of a BLOCK are reused once it ends, so the frame needs the most
+// locals alive at once. Returns how many are still held after n
+static size_t be_count_locals_rec_(const ast_node_t* n, size_t held, size_t* peak)
 {
-    if (!n || !out) return;
+    if (!n || !peak) return held;
 
+    size_t inner = held;
     if (n->kind == ASTK_VAR_DECL)
-        (*out)++;
+    {
+        inner++;
+        if (inner > *peak) *peak = inner;
+    }
 
     for (const ast_node_t* c = n->left; c; c = c->right)
-        be_count_locals_rec_(c, out);
+        inner = be_count_locals_rec_(c, inner, peak);
+
+    return (n->kind == ASTK_BLOCK) ? held : inner;
 }
 
 static const func_meta_t* be_find_func_(const backend_t* be, size_t name_id)
@@ -217,7 +306,7 @@ static err_t be_collect_funcs_(backend_t* be, const ast_node_t* program)
         ast_type_t* ptypes = NULL;
         if (pcount)
         {
-            ptypes = (ast_type_t*)calloc(pcount, sizeof(ast_type_t));
+            ptypes = (ast_type_t*)mem_calloc(MEM_TAG_BACKEND, pcount, sizeof(ast_type_t));
             if (!ptypes) return ERR_ALLOC;
 
             size_t i = 0;
@@ -231,10 +320,21 @@ static err_t be_collect_funcs_(backend_t* be, const ast_node_t* program)
         size_t locals = 0;
         const ast_node_t* body = plist->right;
         if (!body) body = fn->left ? fn->left->right : NULL;
-        if (body) be_count_locals_rec_(body, &locals);
+        if (body) be_count_locals_rec_(body, 0, &locals);
+
+        // the middle-end picks memoized functions, the signature is checked again
+        size_t memo_bound = 0, memo_base = 0;
+        if (fn->u.func.memo && fn->u.func.ret_type == AST_TYPE_INT && (pcount == 1 || pcount == 2) &&
+            ptypes[0] == AST_TYPE_INT && ptypes[pcount - 1] == AST_TYPE_INT)
+        {
+            memo_bound = fn->u.func.memo;
+            if (be->memo_end == 0) be->memo_end = 1;    // address 0 means no entry
+            memo_base = be->memo_end;
+            be->memo_end += 2 * ((pcount == 1) ? memo_bound : memo_bound * memo_bound);
+        }
 
         char* label = be_strdup_printf_(":fn_%s", ast_name_cstr(be->tree, name_id));
-        if (!label) { free(ptypes); return ERR_ALLOC; }
+        if (!label) { mem_free(ptypes); return ERR_ALLOC; }
 
         VEC_GROW(be->funcs, be->func_cap, be->func_amount + 1, func_meta_t);
         be->funcs[be->func_amount++] = (func_meta_t){
@@ -243,68 +343,212 @@ static err_t be_collect_funcs_(backend_t* be, const ast_node_t* program)
             .ret_type = fn->u.func.ret_type,
             .param_count = pcount,
             .param_types = ptypes,
-            .local_count = locals
+            .local_count = locals,
+            .memo_bound = memo_bound,
+            .memo_base = memo_base
         };
     }
 
     return OK;
 }
 
-err_t backend_emit_asm(const ast_tree_t* tree, operational_data_t* op_data)
+static int be_prof_cmp_(const void* a, const void* b)
 {
-    if (!tree || !tree->root || !op_data) return ERR_BAD_ARG;
+    const uintptr_t x = (uintptr_t)((const prof_site_t*)a)->node;
+    const uintptr_t y = (uintptr_t)((const prof_site_t*)b)->node;
+    return (x > y) - (x < y);
+}
 
-    backend_t be = { 0 };
-    be.tree = tree;
-    be.op   = op_data;
+// counters go right above the memo tables
+static err_t be_prof_setup_(backend_t* be)
+{
+    const ast_node_t** sites = NULL;
+    err_t rc = ast_profile_sites(be->tree, &sites, &be->prof_site_count, &be->prof_counters, &be->prof_hash);
+    if (rc != OK) return rc;
+
+    be->prof_sites = (prof_site_t*)mem_calloc(MEM_TAG_BACKEND, be->prof_site_count + 1, sizeof(prof_site_t));
+    if (!be->prof_sites) { mem_free(sites); return ERR_ALLOC; }
+
+    size_t counter = 0;
+    for (size_t i = 0; i < be->prof_site_count; ++i)
+    {
+        be->prof_sites[i] = (prof_site_t){ .node = sites[i], .counter = counter };
+        counter += ast_profile_slots(sites[i]->kind);
+    }
+    mem_free(sites);
+
+    qsort(be->prof_sites, be->prof_site_count, sizeof(prof_site_t), be_prof_cmp_);
+    be->prof_base = be->memo_end ? be->memo_end : 1;
+    return OK;
+}
+
+// counter k of site n += 1, nothing when not instrumenting
+static void be_emit_prof_inc_(backend_t* be, const ast_node_t* n, size_t k)
+{
+    if (!be->prof_sites) return;
+
+    const prof_site_t key  = { .node = n };
+    const prof_site_t* site = (const prof_site_t*)bsearch(&key, be->prof_sites, be->prof_site_count,
+                                                          sizeof(prof_site_t), be_prof_cmp_);
+    if (!site) return;
+
+    be_emitf_(be, "PUSH %zu\nPOPR x%u\n", be->prof_base + site->counter + k, (unsigned)REG_TMPA);
+    be_emitf_(be, "PUSHM x%u\nPUSH 1\nADD\nPOPM x%u\n", (unsigned)REG_TMPA, (unsigned)REG_TMPA);
+}
+
+// collect function metadata and make sure there is a main()
+void backend_config_default(backend_config_t* cfg)
+{
+    if (!cfg) return;
+    *cfg = (backend_config_t){ .peephole = 1 };
+}
+
+static err_t be_setup_(backend_t* be, const ast_tree_t* tree, operational_data_t* op_data,
+                       const backend_config_t* cfg)
+{
+    backend_config_t def;
+    if (!cfg)
+    {
+        backend_config_default(&def);
+        cfg = &def;
+    }
+
+    be->tree     = tree;
+    be->op       = op_data;
+    be->peephole = cfg->peephole;
 
     const ast_node_t* program = tree->root;
     if (program->kind != ASTK_PROGRAM)
-        be_set_error_(&be, program->pos, program->pos.offset, "Root is not PROGRAM");
+        be_set_error_(be, program->pos, program->pos.offset, "Root is not PROGRAM");
 
-    err_t rc = be_collect_funcs_(&be, program);
-    if (rc != OK) goto cleanup;
+    err_t rc = be_collect_funcs_(be, program);
+    if (rc != OK) return rc;
 
-    {
-        size_t main_id = SIZE_MAX;
-        for (size_t i = 0; i < tree->nametable.amount; ++i)
-            if (tree->nametable.data[i].name && strcmp(tree->nametable.data[i].name, "main") == 0)
-                { main_id = i; break; }
+    size_t main_id = SIZE_MAX;
+    for (size_t i = 0; i < tree->nametable.amount; ++i)
+        if (tree->nametable.data[i].name && strcmp(tree->nametable.data[i].name, "main") == 0)
+            { main_id = i; break; }
 
-        if (main_id == SIZE_MAX || !be_find_func_(&be, main_id))
-        {
-            be_set_error_(&be, (token_pos_t){1,1,0}, 0, "No function 'main' found");
-            rc = ERR_SYNTAX;
-            goto cleanup;
-        }
+    if (main_id == SIZE_MAX || !be_find_func_(be, main_id))
+    {
+        be_set_error_(be, (token_pos_t){1,1,0}, 0, "No function 'main' found");
+        return ERR_SYNTAX;
     }
 
-    rc = be_emit_program_(&be, program);
+    return OK;
+}
+
+static void be_cleanup_(backend_t* be, const backend_config_t* cfg)
+{
+    if (be->peephole)
+        LOG_DEBUG("Peephole: %zu -> %zu instructions", be->peep_report.insns_in, be->peep_report.insns_out);
+    if (cfg && cfg->report)
+        *cfg->report = be->peep_report;
+
+    mem_free(be->out);
+    peep_dtor(&be->peep);
 
-cleanup:
-    for (size_t i = 0; i < be.func_amount; ++i)
+    for (size_t i = 0; i < be->func_amount; ++i)
     {
-        free(be.funcs[i].label);
-        free(be.funcs[i].param_types);
+        mem_free(be->funcs[i].label);
+        mem_free(be->funcs[i].param_types);
     }
-    free(be.funcs);
-    free(be.binds);
+    mem_free(be->funcs);
+    mem_free(be->binds);
+
+    for (size_t i = 0; i < be->loop_amount; ++i)
+        mem_free(be->loops[i].end_label);
+    mem_free(be->loops);
+
+    mem_free(be->fn_end_label);
+    mem_free(be->memo_done_label);
+    mem_free(be->prof_sites);
+    mem_free(be->ir_slots);
+    mem_free(be->ir_inline);
+    mem_free(be->ir_regs);
+}
+
+err_t backend_emit_asm(const ast_tree_t* tree, operational_data_t* op_data, const backend_config_t* cfg)
+{
+    if (!tree || !tree->root || !op_data) return ERR_BAD_ARG;
 
-    for (size_t i = 0; i < be.loop_amount; ++i)
-        free(be.loops[i].end_label);
-    free(be.loops);
+    backend_t be = { 0 };
 
-    free(be.fn_end_label);
+    err_t rc = be_setup_(&be, tree, op_data, cfg);
+    if (rc == OK)
+        rc = be_emit_program_(&be, tree->root);
 
+    be_cleanup_(&be, cfg);
     return rc;
 }
 
-static err_t be_emit_program_(backend_t* be, const ast_node_t* program)
+err_t backend_emit_asm_instrumented(const ast_tree_t* tree, operational_data_t* op_data, const backend_config_t* cfg)
+{
+    if (!tree || !tree->root || !op_data) return ERR_BAD_ARG;
+
+    backend_t be = { 0 };
+
+    err_t rc = be_setup_(&be, tree, op_data, cfg);
+    if (rc == OK)
+        rc = be_prof_setup_(&be);
+    if (rc == OK)
+        rc = be_emit_program_(&be, tree->root);
+
+    be_cleanup_(&be, cfg);
+    return rc;
+}
+
+// for x13 = from; x13 < to; x13 += step: RAM[x13] = 0
+static err_t be_emit_clear_(backend_t* be, size_t from, size_t to, size_t step)
 {
-    // init SP/BP = 0; CALL main; HLT
+    char* again = be_new_label_(be, "clear");
+    if (!again) return ERR_ALLOC;
+
+    be_emitf_(be, "PUSH %zu\nPOPR x%u\n", from, (unsigned)REG_TMPA);
+    be_emitf_(be, "%s\n", again);
+    be_emitf_(be, "PUSH 0\nPOPM x%u\n", (unsigned)REG_TMPA);
+    be_emitf_(be, "PUSHR x%u\nPUSH %zu\nADD\nPOPR x%u\n", (unsigned)REG_TMPA, step, (unsigned)REG_TMPA);
+    be_emitf_(be, "PUSHR x%u\nPUSH %zu\nJB %s\n", (unsigned)REG_TMPA, to, again);
+    mem_free(again);
+    return OK;
+}
+
+// magic, hash, count and the counters, see ast_profile_read
+static err_t be_emit_prof_dump_(backend_t* be)
+{
+    be_emitf_(be, "; profile\n");
+    be_emitf_(be, "PUSH %d\nOUT\n", AST_PROFILE_MAGIC);
+    be_emitf_(be, "PUSH %zu\nOUT\nPUSH %zu\nOUT\n", be->prof_hash, be->prof_counters);
+    if (be->prof_counters == 0) return OK;
+
+    char* again = be_new_label_(be, "prof_dump");
+    if (!again) return ERR_ALLOC;
+
+    be_emitf_(be, "PUSH %zu\nPOPR x%u\n", be->prof_base, (unsigned)REG_TMPA);
+    be_emitf_(be, "%s\n", again);
+    be_emitf_(be, "PUSHM x%u\nOUT\n", (unsigned)REG_TMPA);
+    be_emitf_(be, "PUSHR x%u\nPUSH 1\nADD\nPOPR x%u\n", (unsigned)REG_TMPA, (unsigned)REG_TMPA);
+    be_emitf_(be, "PUSHR x%u\nPUSH %zu\nJB %s\n", (unsigned)REG_TMPA, be->prof_base + be->prof_counters, again);
+    mem_free(again);
+    return OK;
+}
+
+static err_t be_emit_entry_(backend_t* be, const ast_node_t* program)
+{
+    // init SP/BP = 0 (above memo tables and counters); CALL main; HLT
+    const size_t stack = be->prof_sites ? be->prof_base + be->prof_counters : be->memo_end;
+
     be_emitf_(be, "; --- program entry ---\n");
-    be_emitf_(be, "PUSH 0\nPOPR x%u\n", (unsigned)REG_SP);
-    be_emitf_(be, "PUSH 0\nPOPR x%u\n", (unsigned)REG_BP);
+    be_emitf_(be, "PUSH %zu\nPOPR x%u\n", stack, (unsigned)REG_SP);
+    be_emitf_(be, "PUSH %zu\nPOPR x%u\n", stack, (unsigned)REG_BP);
+
+    // memo done cells, counters
+    err_t rc = OK;
+    if (be->memo_end)
+        rc = be_emit_clear_(be, 1, be->memo_end, 2);
+    if (rc == OK && be->prof_counters)
+        rc = be_emit_clear_(be, be->prof_base, be->prof_base + be->prof_counters, 1);
+    if (rc != OK) return rc;
 
     // CALL :fn_main
     {
@@ -318,55 +562,239 @@ static err_t be_emit_program_(backend_t* be, const ast_node_t* program)
         be_emitf_(be, "CALL %s\n", fm->label);
     }
 
+    if (be->prof_sites)
+    {
+        rc = be_emit_prof_dump_(be);
+        if (rc != OK) return rc;
+    }
+
     be_emitf_(be, "HLT\n\n");
+    return OK;
+}
+
+static err_t be_emit_program_(backend_t* be, const ast_node_t* program)
+{
+    err_t rc = be_emit_entry_(be, program);
+    if (rc == OK)
+        rc = be_flush_(be);
+    if (rc != OK) return rc;
 
     // emit all functions
     for (const ast_node_t* fn = program->left; fn; fn = fn->right)
     {
-        err_t rc = be_emit_func_(be, fn);
+        rc = be_emit_func_(be, fn);
         if (rc != OK) return rc;
         be_emitf_(be, "\n");
+
+        rc = be_flush_(be);
+        if (rc != OK) return rc;
     }
 
     return OK;
 }
 
-static err_t be_emit_func_(backend_t* be, const ast_node_t* fn)
+// ============================ register allocation ===========================
+
+typedef struct
 {
-    BE_CHECK(be, fn && fn->kind == ASTK_FUNC, fn, "Internal: expected FUNC");
-    const func_meta_t* meta = be_find_func_(be, fn->u.func.name_id);
-    BE_CHECK(be, meta != NULL, fn, "Internal: no metadata for function '%s'",
-             ast_name_cstr(be->tree, fn->u.func.name_id));
+    be_home_t  home;
+    ast_type_t type;
+    size_t     weight;     // accesses, each counted 8^loop depth times
+    size_t     order;      // ties keep the order of appearance
+} be_ra_cand_t;
 
-    be->cur_fn = meta;
+typedef struct
+{
+    size_t name_id;
+    size_t cand;
+} be_ra_name_t;
 
-    free(be->fn_end_label);
-    be->fn_end_label = be_new_label_(be, "fn_end");
-    if (!be->fn_end_label) return ERR_ALLOC;
+typedef struct
+{
+    be_ra_cand_t* cands;
+    size_t        count;
+    size_t        cap;
 
-    // reset bindings
-    be->bind_amount  = 0;
-    be->scope_depth  = 1;
-    be->next_local_offset = 1 + meta->param_count;
+    be_ra_name_t* names;   // visible declarations, innermost last
+    size_t        name_count;
+    size_t        name_cap;
+} be_ra_t;
+
+static size_t be_ra_weight_(size_t loop)
+{
+    return (size_t)1 << (3 * (loop < 6 ? loop : 6));
+}
 
+static int be_ra_cmp_(const void* a, const void* b)
+{
+    const be_ra_cand_t* x = (const be_ra_cand_t*)a;
+    const be_ra_cand_t* y = (const be_ra_cand_t*)b;
+    if (x->weight != y->weight) return (x->weight < y->weight) ? 1 : -1;
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+// An access through a register takes 1 instruction instead of 7. Saving
+// and restoring costs 2 per call, loading a param on entry 8 more
+static void be_ra_pick_(backend_t* be, be_ra_cand_t* cands, size_t count, size_t param_count)
+{
+    if (count > 1) qsort(cands, count, sizeof(be_ra_cand_t), be_ra_cmp_);
+
+    unsigned next_i = REG_VAR_I_FIRST;
+    unsigned next_f = REG_VAR_F_FIRST;
+    be->home_count = 0;
+
+    for (size_t i = 0; i < count; ++i)
     {
-        const ast_node_t* plist = fn->left;
-        size_t i = 0;
-        for (const ast_node_t* p = plist ? plist->left : NULL; p; p = p->right)
+        be_ra_cand_t* c = &cands[i];
+        const int is_param = (c->home.offset && c->home.offset <= param_count);
+        if (c->weight * 6 <= (is_param ? 10u : 2u)) continue;
+
+        if (c->type == AST_TYPE_FLOAT)
         {
-            // param node has name_id + type
-            err_t rc = be_bind_push_(be, p->u.param.name_id, p->u.param.type, 1 + i, be->scope_depth);
-            if (rc != OK) return rc;
-            i++;
+            if (next_f > REG_VAR_F_LAST) continue;
+            c->home.reg = BE_REG_FLOAT | next_f++;
+        }
+        else if (c->type == AST_TYPE_INT || c->type == AST_TYPE_PTR)
+        {
+            if (next_i > REG_VAR_I_LAST) continue;
+            c->home.reg = next_i++;
+        }
+        else continue;
+
+        be->homes[be->home_count++] = c->home;
+    }
+}
+
+static err_t be_ra_add_(be_ra_t* ra, size_t name_id, be_ra_cand_t cand)
+{
+    VEC_GROW(ra->cands, ra->cap, ra->count + 1, be_ra_cand_t);
+    VEC_GROW(ra->names, ra->name_cap, ra->name_count + 1, be_ra_name_t);
+
+    cand.order = ra->count;
+    ra->names[ra->name_count++] = (be_ra_name_t){ .name_id = name_id, .cand = ra->count };
+    ra->cands[ra->count++] = cand;
+    return OK;
+}
+
+static void be_ra_touch_(be_ra_t* ra, size_t name_id, size_t weight)
+{
+    for (size_t i = ra->name_count; i > 0; --i)
+        if (ra->names[i - 1].name_id == name_id)
+        {
+            ra->cands[ra->names[i - 1].cand].weight += weight;
+            return;
+        }
+}
+
+// n and its right siblings, scoped like the emitter does
+static err_t be_ra_walk_(be_ra_t* ra, const ast_node_t* n, size_t loop)
+{
+    for (; n; n = n->right)
+    {
+        err_t rc = OK;
+        switch (n->kind)
+        {
+            case ASTK_BLOCK:
+            {
+                const size_t mark = ra->name_count;
+                rc = be_ra_walk_(ra, n->left, loop);
+                ra->name_count = mark;
+                break;
+            }
+
+            case ASTK_VAR_DECL:
+                rc = be_ra_add_(ra, n->u.vdecl.name_id, (be_ra_cand_t){
+                    .home = { .decl = n }, .type = n->u.vdecl.type, .weight = be_ra_weight_(loop) });
+                if (rc == OK) rc = be_ra_walk_(ra, n->left, loop);
+                break;
+
+            case ASTK_ASSIGN:
+                be_ra_touch_(ra, n->u.assign.name_id, be_ra_weight_(loop));
+                rc = be_ra_walk_(ra, n->left, loop);
+                break;
+
+            case ASTK_IDENT:
+                be_ra_touch_(ra, n->u.ident.name_id, be_ra_weight_(loop));
+                break;
+
+            case ASTK_WHILE:
+                rc = be_ra_walk_(ra, n->left, loop + 1);
+                break;
+
+            default:
+                rc = be_ra_walk_(ra, n->left, loop);
+                break;
         }
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+// homes for the params and locals of fn that are used the most
+static err_t be_ra_ast_(backend_t* be, const ast_node_t* fn, const func_meta_t* meta)
+{
+    be_ra_t ra = { 0 };
+    err_t rc = OK;
+
+    const ast_node_t* plist = fn->left;
+    size_t i = 0;
+    for (const ast_node_t* p = plist ? plist->left : NULL; p && rc == OK; p = p->right, ++i)
+        rc = be_ra_add_(&ra, p->u.param.name_id, (be_ra_cand_t){
+            .home = { .offset = 1 + i }, .type = p->u.param.type });
+
+    if (rc == OK && plist) rc = be_ra_walk_(&ra, plist->right, 0);
+    if (rc == OK) be_ra_pick_(be, ra.cands, ra.count, meta->param_count);
+
+    mem_free(ra.cands);
+    mem_free(ra.names);
+    return rc;
+}
+
+// the entry of this call's arguments into the slot, 0 when they are out of the table
+static void be_emit_memo_index_(backend_t* be, const func_meta_t* meta, const char* miss)
+{
+    be_emitf_(be, "PUSH 0\n");
+    be_emit_store_bp_off_(be, be->memo_slot);
+
+    for (size_t i = 0; i < meta->param_count; ++i)
+    {
+        be_emit_load_bp_off_(be, 1 + i);
+        be_emitf_(be, "PUSH 0\nJB %s\n", miss);
+        be_emit_load_bp_off_(be, 1 + i);
+        be_emitf_(be, "PUSH %zu\nJAE %s\n", meta->memo_bound, miss);
     }
 
+    // base + 2 * (p0 * bound + p1)
+    be_emit_load_bp_off_(be, 1);
+    if (meta->param_count == 2)
+    {
+        be_emitf_(be, "PUSH %zu\nMUL\n", meta->memo_bound);
+        be_emit_load_bp_off_(be, 2);
+        be_emitf_(be, "ADD\n");
+    }
+    be_emitf_(be, "PUSH 2\nMUL\nPUSH %zu\nADD\n", meta->memo_base);
+    be_emit_store_bp_off_(be, be->memo_slot);
+}
+
+static err_t be_emit_prologue_(backend_t* be, const func_meta_t* meta, size_t frame)
+{
     be_emitf_(be, "; --- function %s ---\n", ast_name_cstr(be->tree, meta->name_id));
     be_emitf_(be, "%s\n", meta->label);
 
+    // one more slot past the frame for the table entry
+    be->memo_slot = meta->memo_bound ? frame++ : 0;
+
+    // the caller's values in the registers this function takes
+    for (size_t i = 0; i < be->home_count; ++i)
+    {
+        const unsigned reg = be->homes[i].reg;
+        if (reg & BE_REG_FLOAT) be_emitf_(be, "FPUSHR fx%u\n", reg & ~BE_REG_FLOAT);
+        else                    be_emitf_(be, "PUSHR x%u\n", reg);
+    }
+
     //   RAM[SP] = oldBP
     //   BP = SP
-    //   SP = SP + (1 + param_count + local_count)
+    //   SP = SP + frame (1 + param_count + local_count)
     //
     // Using: x13 as addr temp, x14=SP, x15=BP
     be_emitf_(be, "PUSHR x%u\n", (unsigned)REG_BP);        // push old BP
@@ -376,27 +804,59 @@ static err_t be_emit_func_(backend_t* be, const ast_node_t* fn)
 
     be_emitf_(be, "PUSHR x%u\nPOPR x%u\n", (unsigned)REG_SP, (unsigned)REG_BP); // BP = SP
 
-    const size_t frame = 1 + meta->param_count + meta->local_count;
     be_emitf_(be, "PUSHR x%u\nPUSH %zu\nADD\nPOPR x%u\n",
               (unsigned)REG_SP, frame, (unsigned)REG_SP);
 
-    const ast_node_t* plist = fn->left;
-    const ast_node_t* body  = plist ? plist->right : NULL;
-    if (!body) body = fn->left ? fn->left->right : NULL;
-
-    BE_CHECK(be, body != NULL, fn, "Function has no body");
-    err_t rc = be_emit_stmt_(be, body);
-    if (rc != OK) return rc;
-
-    if (meta->ret_type != AST_TYPE_VOID)
+    // params the caller stored in the frame move to their registers
+    for (size_t off = 1; off <= meta->param_count; ++off)
     {
-        be_emitf_(be, "; implicit return 0 (defensive)\n");
-        be_emitf_(be, "PUSH 0\n");
-        be_emitf_(be, "POPR x%u\n", (unsigned)REG_RET_I);
+        const unsigned reg = be_home_at_(be, off);
+        if (!reg) continue;
+
+        be_emit_load_bp_off_(be, off);
+        be_emit_store_home_(be, reg, off);
     }
 
+    if (!be->memo_slot) return OK;
+
+    mem_free(be->memo_done_label);
+    be->memo_done_label = be_new_label_(be, "memo_done");
+    char* miss = be_new_label_(be, "memo_miss");
+    if (!be->memo_done_label || !miss) { mem_free(miss); return ERR_ALLOC; }
+
+    // a done entry is the result, the epilogue fills the entry on a miss
+    be_emitf_(be, "; memo lookup\n");
+    be_emit_memo_index_(be, meta, miss);
+
+    be_emit_load_bp_off_(be, be->memo_slot);
+    be_emitf_(be, "POPR  x%u\n", (unsigned)REG_TMPA);
+    be_emitf_(be, "PUSHM x%u\nPUSH 0\nJE %s\n", (unsigned)REG_TMPA, miss);
+
+    be_emitf_(be, "PUSHR x%u\nPUSH 1\nADD\nPOPR x%u\n", (unsigned)REG_TMPA, (unsigned)REG_TMPA);
+    be_emitf_(be, "PUSHM x%u\nPOPR x%u\n", (unsigned)REG_TMPA, (unsigned)REG_RET_I);
+    be_emitf_(be, "JMP %s\n", be->memo_done_label);
+
+    be_emitf_(be, "%s\n", miss);
+    mem_free(miss);
+    return OK;
+}
+
+static void be_emit_epilogue_(backend_t* be)
+{
     be_emitf_(be, "%s\n", be->fn_end_label);
 
+    if (be->memo_slot)
+    {
+        // RAM[entry] = 1, RAM[entry + 1] = x0 unless the arguments were out of the table
+        be_emit_load_bp_off_(be, be->memo_slot);
+        be_emitf_(be, "POPR  x%u\n", (unsigned)REG_TMPA);
+        be_emitf_(be, "PUSHR x%u\nPUSH 0\nJE %s\n", (unsigned)REG_TMPA, be->memo_done_label);
+        be_emitf_(be, "PUSH 1\nPOPM x%u\n", (unsigned)REG_TMPA);
+        be_emitf_(be, "PUSHR x%u\nPUSH 1\nADD\nPOPR x%u\n", (unsigned)REG_TMPA, (unsigned)REG_TMPA);
+        be_emitf_(be, "PUSHR x%u\nPOPM x%u\n", (unsigned)REG_RET_I, (unsigned)REG_TMPA);
+        be_emitf_(be, "%s\n", be->memo_done_label);
+    }
+
     // SP = BP
     be_emitf_(be, "PUSHR x%u\nPOPR x%u\n", (unsigned)REG_BP, (unsigned)REG_SP);
 
@@ -405,34 +865,98 @@ static err_t be_emit_func_(backend_t* be, const ast_node_t* fn)
     be_emitf_(be, "PUSHM x%u\n", (unsigned)REG_TMPA);
     be_emitf_(be, "POPR  x%u\n", (unsigned)REG_BP);
 
-    be_emitf_(be, "RET\n");
+    for (size_t i = be->home_count; i > 0; --i)
+    {
+        const unsigned reg = be->homes[i - 1].reg;
+        if (reg & BE_REG_FLOAT) be_emitf_(be, "FPOPR fx%u\n", reg & ~BE_REG_FLOAT);
+        else                    be_emitf_(be, "POPR x%u\n", reg);
+    }
 
-    return OK;
+    be_emitf_(be, "RET\n");
 }
 
-#define BE_BUILTIN0_RET(BNAME, INSTR, RETTYPE)                      \
-    block_begin                                                     \
-        if (streq_(name, BNAME)) {                                  \
-            BE_CHECK(be, argc == 0, call, BNAME "() takes 0 args"); \
-            be_emitf_(be, INSTR "\n");                              \
-            if (out_type) *out_type = (RETTYPE);                    \
-            return OK;                                              \
-        }                                                           \
-    block_end
-
-#define BE_BUILTIN0_VOID(BNAME, INSTR)                              \
-    block_begin                                                     \
-        if (streq_(name, BNAME)) {                                  \
-            BE_CHECK(be, argc == 0, call, BNAME "() takes 0 args"); \
-            be_emitf_(be, INSTR "\n");                              \
-            if (out_type) *out_type = AST_TYPE_VOID;                \
-            return OK;                                              \
-        }                                                           \
-    block_end
-
-static size_t arg_count_(const ast_node_t* args)
+static err_t be_emit_func_(backend_t* be, const ast_node_t* fn)
 {
-    if (!args) return 0;
+    BE_CHECK(be, fn && fn->kind == ASTK_FUNC, fn, "Internal: expected FUNC");
+    const func_meta_t* meta = be_find_func_(be, fn->u.func.name_id);
+    BE_CHECK(be, meta != NULL, fn, "Internal: no metadata for function '%s'",
+             ast_name_cstr(be->tree, fn->u.func.name_id));
+
+    be->cur_fn = meta;
+
+    mem_free(be->fn_end_label);
+    be->fn_end_label = be_new_label_(be, "fn_end");
+    if (!be->fn_end_label) return ERR_ALLOC;
+
+    // reset bindings
+    be->bind_amount  = 0;
+    be->scope_depth  = 1;
+    be->next_local_offset = 1 + meta->param_count;
+
+    err_t rc = be_ra_ast_(be, fn, meta);
+    if (rc != OK) return rc;
+
+    {
+        const ast_node_t* plist = fn->left;
+        size_t i = 0;
+        for (const ast_node_t* p = plist ? plist->left : NULL; p; p = p->right)
+        {
+            // param node has name_id + type
+            rc = be_bind_push_(be, p->u.param.name_id, p->u.param.type, 1 + i, be->scope_depth,
+                               be_home_at_(be, 1 + i));
+            if (rc != OK) return rc;
+            i++;
+        }
+    }
+
+    LOG_DEBUG("Emitting function '%s': %zu params, %zu locals, %zu in registers",
+              ast_name_cstr(be->tree, meta->name_id), meta->param_count, meta->local_count, be->home_count);
+
+    rc = be_emit_prologue_(be, meta, 1 + meta->param_count + meta->local_count);
+    if (rc != OK) return rc;
+
+    const ast_node_t* plist = fn->left;
+    const ast_node_t* body  = plist ? plist->right : NULL;
+    if (!body) body = fn->left ? fn->left->right : NULL;
+
+    BE_CHECK(be, body != NULL, fn, "Function has no body");
+    rc = be_emit_stmt_(be, body);
+    if (rc != OK) return rc;
+
+    if (meta->ret_type != AST_TYPE_VOID)
+    {
+        be_emitf_(be, "; implicit return 0 (defensive)\n");
+        be_emitf_(be, "PUSH 0\n");
+        be_emitf_(be, "POPR x%u\n", (unsigned)REG_RET_I);
+    }
+
+    be_emit_epilogue_(be);
+    return OK;
+}
+
+#define BE_BUILTIN0_RET(BNAME, INSTR, RETTYPE)                      \
+    block_begin                                                     \
+        if (streq_(name, BNAME)) {                                  \
+            BE_CHECK(be, argc == 0, call, BNAME "() takes 0 args"); \
+            be_emitf_(be, INSTR "\n");                              \
+            if (out_type) *out_type = (RETTYPE);                    \
+            return OK;                                              \
+        }                                                           \
+    block_end
+
+#define BE_BUILTIN0_VOID(BNAME, INSTR)                              \
+    block_begin                                                     \
+        if (streq_(name, BNAME)) {                                  \
+            BE_CHECK(be, argc == 0, call, BNAME "() takes 0 args"); \
+            be_emitf_(be, INSTR "\n");                              \
+            if (out_type) *out_type = AST_TYPE_VOID;                \
+            return OK;                                              \
+        }                                                           \
+    block_end
+
+static size_t arg_count_(const ast_node_t* args)
+{
+    if (!args) return 0;
     size_t n = 0;
     for (const ast_node_t* a = args->left; a; a = a->right) n++;
     return n;
@@ -557,6 +1081,7 @@ static err_t be_emit_block_(backend_t* be, const ast_node_t* block)
 
     be->scope_depth++;
     size_t depth = be->scope_depth;
+    const size_t locals = be->next_local_offset;
 
     for (const ast_node_t* c = block->left; c; c = c->right)
     {
@@ -564,7 +1089,9 @@ static err_t be_emit_block_(backend_t* be, const ast_node_t* block)
         if (rc != OK) return rc;
     }
 
+    // slots of this block's locals are free for the next one
     be_bind_pop_depth_(be, depth);
+    be->next_local_offset = locals;
     be->scope_depth--;
     return OK;
 }
@@ -593,10 +1120,18 @@ static void be_promote_pair_to_float_(backend_t* be, ast_type_t* at, ast_type_t*
     }
 }
 
-static err_t be_emit_cond_jfalse_(backend_t* be, const ast_node_t* cond, const char* L_false)
+// jumps to label when cond is on_true, falls through otherwise
+static err_t be_emit_cond_jump_(backend_t* be, const ast_node_t* cond, int on_true, const char* label)
 {
     if (!cond) return OK;
 
+    // lowkey (1) and friends: no test at all
+    if (cond->kind == ASTK_NUM_LIT && cond->u.num.lit_type == LIT_INT)
+    {
+        if ((cond->u.num.lit.i64 != 0) == on_true) be_emitf_(be, "JMP %s\n", label);
+        return OK;
+    }
+
     if (cond->kind == ASTK_BINARY && is_bool_op_(cond->u.binary.op))
     {
         const token_kind_t opk = cond->u.binary.op;
@@ -612,32 +1147,36 @@ static err_t be_emit_cond_jfalse_(backend_t* be, const ast_node_t* cond, const c
             be_promote_pair_to_float_(be, &at, &bt);
             be_emitf_(be, "FCMP\n");
 
+            // FCMP gives -1/0/1, cond holds when it is (or is not) k
+            int k = 0, eq = 1;
             switch (opk)
             {
-                case TOK_OP_EQ:  be_emitf_(be, "PUSH 0\nJNE %s\n", L_false); break;
-                case TOK_OP_NEQ: be_emitf_(be, "PUSH 0\nJE  %s\n", L_false); break;
-                case TOK_OP_LT:  be_emitf_(be, "PUSH -1\nJNE %s\n", L_false); break;
-                case TOK_OP_LTE: be_emitf_(be, "PUSH 1\nJE  %s\n", L_false); break;
-                case TOK_OP_GT:  be_emitf_(be, "PUSH 1\nJNE %s\n", L_false); break;
-                case TOK_OP_GTE: be_emitf_(be, "PUSH -1\nJE  %s\n", L_false); break;
+                case TOK_OP_EQ:  k =  0; eq = 1; break;
+                case TOK_OP_NEQ: k =  0; eq = 0; break;
+                case TOK_OP_LT:  k = -1; eq = 1; break;
+                case TOK_OP_LTE: k =  1; eq = 0; break;
+                case TOK_OP_GT:  k =  1; eq = 1; break;
+                case TOK_OP_GTE: k = -1; eq = 0; break;
                 default: BE_FAIL_NODE(be, cond, "Unsupported float compare op");
             }
+            be_emitf_(be, "PUSH %d\n%s %s\n", k, (eq == on_true) ? "JE " : "JNE", label);
             return OK;
         }
 
+        const char* jtrue  = NULL;
         const char* jfalse = NULL;
         switch (opk)
         {
-            case TOK_OP_EQ:  jfalse = "JNE"; break;
-            case TOK_OP_NEQ: jfalse = "JE";  break;
-            case TOK_OP_LT:  jfalse = "JAE"; break;
-            case TOK_OP_LTE: jfalse = "JA";  break;
-            case TOK_OP_GT:  jfalse = "JBE"; break;
-            case TOK_OP_GTE: jfalse = "JB";  break;
+            case TOK_OP_EQ:  jtrue = "JE";  jfalse = "JNE"; break;
+            case TOK_OP_NEQ: jtrue = "JNE"; jfalse = "JE";  break;
+            case TOK_OP_LT:  jtrue = "JB";  jfalse = "JAE"; break;
+            case TOK_OP_LTE: jtrue = "JBE"; jfalse = "JA";  break;
+            case TOK_OP_GT:  jtrue = "JA";  jfalse = "JBE"; break;
+            case TOK_OP_GTE: jtrue = "JAE"; jfalse = "JB";  break;
             default: BE_FAIL_NODE(be, cond, "Unsupported int compare op");
         }
 
-        be_emitf_(be, "%s %s\n", jfalse, L_false);
+        be_emitf_(be, "%s %s\n", on_true ? jtrue : jfalse, label);
         return OK;
     }
 
@@ -647,16 +1186,11 @@ static err_t be_emit_cond_jfalse_(backend_t* be, const ast_node_t* cond, const c
 
     if (ct == AST_TYPE_FLOAT)
     {
-        be_emitf_(be, "PUSH 0\nITOF\n"); // 0.0
+        be_emit_push_float_(be, 0.0);
         be_emitf_(be, "FCMP\n");         // compare cond vs 0.0 -> int
-        be_emitf_(be, "PUSH 0\n");       // res == 0 ?
-        be_emitf_(be, "JE %s\n", L_false);
-    }
-    else
-    {
-        be_emitf_(be, "PUSH 0\n");
-        be_emitf_(be, "JE %s\n", L_false);
     }
+    be_emitf_(be, "PUSH 0\n");
+    be_emitf_(be, "%s %s\n", on_true ? "JNE" : "JE", label);
 
     return OK;
 }
@@ -670,33 +1204,42 @@ static err_t be_emit_while_(backend_t* be, const ast_node_t* w)
 
     char* L_begin = be_new_label_(be, "while_begin");
     char* L_end   = be_new_label_(be, "while_end");
-    if (!L_begin || !L_end) { free(L_begin); free(L_end); return ERR_ALLOC; }
+    if (!L_begin || !L_end) { mem_free(L_begin); mem_free(L_end); return ERR_ALLOC; }
 
     // push loop ctx
     VEC_GROW(be->loops, be->loop_cap, be->loop_amount + 1, loop_ctx_t);
-    be->loops[be->loop_amount++] = (loop_ctx_t){ .end_label = strdup(L_end) };
+    be->loops[be->loop_amount++] = (loop_ctx_t){ .end_label = mem_strdup(MEM_TAG_BACKEND, L_end) };
+
+    // rotated: the test on entry guards the loop, the one at the bottom
+    // jumps back, so an iteration costs no extra JMP
+    err_t rc = be_emit_cond_jump_(be, cond, 0, L_end);
+    if (rc != OK) goto done;
 
     be_emitf_(be, "%s\n", L_begin);
 
-    err_t rc = be_emit_cond_jfalse_(be, cond, L_end);
+    const size_t binds = be->bind_amount;
+    rc = be_emit_stmt_(be, body);
     if (rc != OK) goto done;
 
-    rc = be_emit_stmt_(be, body);
+    // a bare declaration as the body must not leak into the condition
+    const size_t body_binds = be->bind_amount;
+    be->bind_amount = binds;
+    rc = be_emit_cond_jump_(be, cond, 1, L_begin);
+    be->bind_amount = body_binds;
     if (rc != OK) goto done;
 
-    be_emitf_(be, "JMP %s\n", L_begin);
     be_emitf_(be, "%s\n", L_end);
 
 done:
     // pop loop ctx
     if (be->loop_amount > 0)
     {
-        free(be->loops[be->loop_amount - 1].end_label);
+        mem_free(be->loops[be->loop_amount - 1].end_label);
         be->loop_amount--;
     }
 
-    free(L_begin);
-    free(L_end);
+    mem_free(L_begin);
+    mem_free(L_end);
     return rc;
 }
 
@@ -709,6 +1252,13 @@ static err_t be_emit_break_(backend_t* be, const ast_node_t* brk)
     return OK;
 }
 
+typedef struct
+{
+    char*             label;
+    const ast_node_t* arm;    // IF or BRANCH, its counter
+    const ast_node_t* then;
+} be_cold_arm_t;
+
 static err_t be_emit_if_chain_(backend_t* be, const ast_node_t* ifn)
 {
     // IF children: cond, then, [tail]
@@ -718,28 +1268,71 @@ static err_t be_emit_if_chain_(backend_t* be, const ast_node_t* ifn)
 
     BE_CHECK(be, cond && then_st, ifn, "Internal: IF missing children");
 
+    size_t arms = 1;
+    const ast_node_t* t = tail;
+    for (; t && t->kind != ASTK_ELSE; t = t->left->right->right, ++arms)
+    {
+        BE_CHECK(be, t->kind == ASTK_BRANCH, t, "Internal: IF tail is not BRANCH/ELSE");
+        BE_CHECK(be, t->left && t->left->right, t, "Internal: BRANCH missing (cond, stmt)");
+    }
+    BE_CHECK(be, !t || t->left, t, "Internal: ELSE missing body");
+
     char* L_end = be_new_label_(be, "if_end");
-    if (!L_end) return ERR_ALLOC;
+    be_cold_arm_t* cold = (be_cold_arm_t*)mem_calloc(MEM_TAG_BACKEND, arms, sizeof(be_cold_arm_t));
+    if (!L_end || !cold) { mem_free(L_end); mem_free(cold); return ERR_ALLOC; }
+
+    size_t cold_count = 0;
+    const size_t binds = be->bind_amount;
+
+    be_emit_prof_inc_(be, ifn, 0);
+
+    // With a profile, a then arm taken less often than its test fails goes
+    // behind the chain, so the more frequent path falls through. The last
+    // arm of a chain without sigma gains nothing, its miss already jumps
+    size_t tested = ifn->u.arm.total;
 
+    const ast_node_t* cur_arm     = ifn;
     const ast_node_t* cur_if_cond = cond;
     const ast_node_t* cur_then    = then_st;
     const ast_node_t* cur_tail    = tail;
 
-    while (1)
+    err_t rc = OK;
+    while (rc == OK)
     {
-        char* L_next = be_new_label_(be, "if_next");
-        if (!L_next) { free(L_end); return ERR_ALLOC; }
+        const size_t hits = cur_arm->u.arm.hits;
+        const size_t k    = (cur_arm == ifn) ? 1 : 0;
+
+        if (cur_tail && tested > hits && hits < tested - hits)
+        {
+            char* L_arm = be_new_label_(be, "if_cold");
+            if (!L_arm) { rc = ERR_ALLOC; break; }
+            cold[cold_count++] = (be_cold_arm_t){ .label = L_arm, .arm = cur_arm, .then = cur_then };
+
+            rc = be_emit_cond_jump_(be, cur_if_cond, 1, L_arm);
+        }
+        else
+        {
+            char* L_next = be_new_label_(be, "if_next");
+            if (!L_next) { rc = ERR_ALLOC; break; }
 
-        err_t rc = be_emit_cond_jfalse_(be, cur_if_cond, L_next);
-        if (rc != OK) { free(L_next); free(L_end); return rc; }
+            rc = be_emit_cond_jump_(be, cur_if_cond, 0, L_next);
 
-        // then
-        rc = be_emit_stmt_(be, cur_then);
-        if (rc != OK) { free(L_next); free(L_end); return rc; }
+            // then
+            if (rc == OK)
+            {
+                be_emit_prof_inc_(be, cur_arm, k);
+                rc = be_emit_stmt_(be, cur_then);
+            }
+            if (rc == OK)
+            {
+                be_emitf_(be, "JMP %s\n", L_end);
+                be_emitf_(be, "%s\n", L_next);
+            }
+            mem_free(L_next);
+        }
+        if (rc != OK) break;
 
-        be_emitf_(be, "JMP %s\n", L_end);
-        be_emitf_(be, "%s\n", L_next);
-        free(L_next);
+        tested = (tested > hits) ? tested - hits : 0;
 
         if (!cur_tail)
             break;
@@ -747,30 +1340,36 @@ static err_t be_emit_if_chain_(backend_t* be, const ast_node_t* ifn)
         if (cur_tail->kind == ASTK_ELSE)
         {
             // ELSE child: body at else->left
-            const ast_node_t* else_body = cur_tail->left;
-            BE_CHECK(be, else_body != NULL, cur_tail, "Internal: ELSE missing body");
-            rc = be_emit_stmt_(be, else_body);
-            if (rc != OK) { free(L_end); return rc; }
+            be_emit_prof_inc_(be, cur_tail, 0);
+            rc = be_emit_stmt_(be, cur_tail->left);
             break;
         }
 
-        BE_CHECK(be, cur_tail->kind == ASTK_BRANCH, cur_tail, "Internal: IF tail is not BRANCH/ELSE");
-
         // BRANCH children: cond, stmt, [tail]
-        const ast_node_t* bc = cur_tail->left;
-        const ast_node_t* bs = bc ? bc->right : NULL;
-        const ast_node_t* bt = bs ? bs->right : NULL;
+        cur_arm     = cur_tail;
+        cur_if_cond = cur_tail->left;
+        cur_then    = cur_if_cond->right;
+        cur_tail    = cur_then->right;
+    }
 
-        BE_CHECK(be, bc && bs, cur_tail, "Internal: BRANCH missing (cond, stmt)");
+    // cold arms, each scoped as if it were in place
+    for (size_t i = 0; i < cold_count && rc == OK; ++i)
+    {
+        if (i == 0) be_emitf_(be, "JMP %s\n", L_end);
 
-        cur_if_cond = bc;
-        cur_then    = bs;
-        cur_tail    = bt;
+        be->bind_amount = binds;
+        be_emitf_(be, "%s\n", cold[i].label);
+        be_emit_prof_inc_(be, cold[i].arm, (cold[i].arm == ifn) ? 1 : 0);
+        rc = be_emit_stmt_(be, cold[i].then);
+        if (rc == OK && i + 1 < cold_count) be_emitf_(be, "JMP %s\n", L_end);
     }
 
-    be_emitf_(be, "%s\n", L_end);
-    free(L_end);
-    return OK;
+    if (rc == OK) be_emitf_(be, "%s\n", L_end);
+
+    for (size_t i = 0; i < cold_count; ++i) mem_free(cold[i].label);
+    mem_free(cold);
+    mem_free(L_end);
+    return rc;
 }
 
 static err_t be_emit_return_(backend_t* be, const ast_node_t* r)
@@ -790,10 +1389,17 @@ static err_t be_emit_return_(backend_t* be, const ast_node_t* r)
         err_t rc = be_emit_expr_(be, expr, &et);
         if (rc != OK) return rc;
 
+        // same conversion as a store into a variable of the return type
         if (be->cur_fn && be->cur_fn->ret_type == AST_TYPE_FLOAT)
+        {
+            if (et != AST_TYPE_FLOAT) be_emitf_(be, "ITOF\n");
             be_emitf_(be, "FPOPR fx%u\n", (unsigned)REG_RET_F);
+        }
         else
+        {
+            if (et == AST_TYPE_FLOAT) be_emitf_(be, "FTOI\n");
             be_emitf_(be, "POPR x%u\n", (unsigned)REG_RET_I);
+        }
     }
     else
     {
@@ -812,8 +1418,9 @@ static err_t be_emit_vdecl_(backend_t* be, const ast_node_t* vd)
     const size_t name_id = vd->u.vdecl.name_id;
     const ast_type_t t   = vd->u.vdecl.type;
 
-    const size_t off = be->next_local_offset++;
-    err_t rc = be_bind_push_(be, name_id, t, off, be->scope_depth);
+    const size_t   off = be->next_local_offset++;
+    const unsigned reg = be_home_of_decl_(be, vd);
+    err_t rc = be_bind_push_(be, name_id, t, off, be->scope_depth, reg);
     if (rc != OK) return rc;
 
     const ast_node_t* init = vd->left;
@@ -831,13 +1438,14 @@ static err_t be_emit_vdecl_(backend_t* be, const ast_node_t* vd)
         if (t != AST_TYPE_FLOAT && it == AST_TYPE_FLOAT)
             be_emitf_(be, "FTOI\n");
 
-        be_emit_store_bp_off_(be, off);
+        be_emit_store_home_(be, reg, off);
     }
     else
     {
-        // default-init 0
-        be_emitf_(be, "PUSH 0\n");
-        be_emit_store_bp_off_(be, off);
+        // default-init 0, a float home takes a float zero
+        if (t == AST_TYPE_FLOAT) be_emit_push_float_(be, 0.0);
+        else                     be_emitf_(be, "PUSH 0\n");
+        be_emit_store_home_(be, reg, off);
     }
 
     return OK;
@@ -865,7 +1473,7 @@ static err_t be_emit_assign_(backend_t* be, const ast_node_t* asn)
     if (b->type != AST_TYPE_FLOAT && rt == AST_TYPE_FLOAT)
         be_emitf_(be, "FTOI\n");
 
-    be_emit_store_bp_off_(be, b->offset);
+    be_emit_store_home_(be, b->reg, b->offset);
     return OK;
 }
 
@@ -921,7 +1529,7 @@ static err_t be_emit_cmp_to_bool_(backend_t* be, const ast_node_t* op_node, toke
 {
     char* L_true = be_new_label_(be, "cmp_true");
     char* L_end  = be_new_label_(be, "cmp_end");
-    if (!L_true || !L_end) { free(L_true); free(L_end); return ERR_ALLOC; }
+    if (!L_true || !L_end) { mem_free(L_true); mem_free(L_end); return ERR_ALLOC; }
 
     const char* jmp = NULL;
     switch (opk)
@@ -933,7 +1541,7 @@ static err_t be_emit_cmp_to_bool_(backend_t* be, const ast_node_t* op_node, toke
         case TOK_OP_GT:  jmp = "JA";  break;
         case TOK_OP_GTE: jmp = "JAE"; break;
         default:
-            free(L_true); free(L_end);
+            mem_free(L_true); mem_free(L_end);
             BE_FAIL_NODE(be, op_node, "Unsupported compare operator");
     }
 
@@ -942,84 +1550,17 @@ static err_t be_emit_cmp_to_bool_(backend_t* be, const ast_node_t* op_node, toke
     be_emitf_(be, "%s\nPUSH 1\n", L_true);
     be_emitf_(be, "%s\n", L_end);
 
-    free(L_true);
-    free(L_end);
+    mem_free(L_true);
+    mem_free(L_end);
     return OK;
 }
 
 
-static ast_type_t be_infer_expr_type_(const backend_t* be, const ast_node_t* e)
-{
-    if (!e) return AST_TYPE_UNKNOWN;
-
-    if (e->type != AST_TYPE_UNKNOWN) return e->type;
-
-    switch (e->kind)
-    {
-        case ASTK_NUM_LIT:
-            return (e->u.num.lit_type == LIT_FLOAT) ? AST_TYPE_FLOAT : AST_TYPE_INT;
-
-        case ASTK_IDENT:
-        {
-            ssize_t idx = be_bind_lookup_(be, e->u.ident.name_id);
-            return (idx >= 0) ? be->binds[(size_t)idx].type : AST_TYPE_UNKNOWN;
-        }
-
-        case ASTK_CALL:
-        {
-            const char* name = ast_name_cstr(be->tree, e->u.call.name_id);
-            if (!name) return AST_TYPE_UNKNOWN;
-
-            if (streq_(name, "in")     || streq_(name, "cap") ||
-                streq_(name, "cin")    || streq_(name, "stinky"))
-                return AST_TYPE_INT;
-
-            if (streq_(name, "fin")    || streq_(name, "nocap"))
-                return AST_TYPE_FLOAT;
-
-            const func_meta_t* fm = be_find_func_(be, e->u.call.name_id);
-            return fm ? fm->ret_type : AST_TYPE_UNKNOWN;
-        }
-
-        case ASTK_BUILTIN_UNARY:
-            return AST_TYPE_FLOAT;
-
-        case ASTK_UNARY:
-        {
-            const token_kind_t op = e->u.unary.op;
-            if (op == TOK_OP_NOT) return AST_TYPE_INT;
-                return be_infer_expr_type_(be, e->left);
-        }
-
-        case ASTK_BINARY:
-        {
-            const token_kind_t op = e->u.binary.op;
-
-            if (is_bool_op_(op) || op == TOK_OP_AND || op == TOK_OP_OR)
-                return AST_TYPE_INT;
-
-            const ast_type_t lt = be_infer_expr_type_(be, e->left);
-            const ast_type_t rt = be_infer_expr_type_(be, e->right);
-
-            if (op == TOK_OP_POW)
-                return (lt == AST_TYPE_INT && rt == AST_TYPE_INT) ? AST_TYPE_INT : AST_TYPE_FLOAT;
-
-            if (lt == AST_TYPE_FLOAT || rt == AST_TYPE_FLOAT) return AST_TYPE_FLOAT;
-            if (lt == AST_TYPE_UNKNOWN || rt == AST_TYPE_UNKNOWN) return AST_TYPE_UNKNOWN;
-
-            return AST_TYPE_INT;
-        }
-
-        default:
-            return AST_TYPE_UNKNOWN;
-    }
-}
-
 static err_t be_emit_fcmp_res_to_bool_(backend_t* be, const ast_node_t* op_node, token_kind_t opk)
 {
     char* L_true = be_new_label_(be, "fcmp_true");
     char* L_end  = be_new_label_(be, "fcmp_end");
-    if (!L_true || !L_end) { free(L_true); free(L_end); return ERR_ALLOC; }
+    if (!L_true || !L_end) { mem_free(L_true); mem_free(L_end); return ERR_ALLOC; }
 
     const char* jmp = NULL;
     long long   k   = 0;
@@ -1032,7 +1573,7 @@ static err_t be_emit_fcmp_res_to_bool_(backend_t* be, const ast_node_t* op_node,
         case TOK_OP_GT:  jmp = "JE";  k = 1;  break;
         case TOK_OP_GTE: jmp = "JNE"; k = -1; break;
         default:
-            free(L_true); free(L_end);
+            mem_free(L_true); mem_free(L_end);
             BE_FAIL_NODE(be, op_node, "Unsupported float-compare operator");
     }
 
@@ -1043,11 +1584,70 @@ static err_t be_emit_fcmp_res_to_bool_(backend_t* be, const ast_node_t* op_node,
     be_emitf_(be, "%s\nPUSH 1\n", L_true);
     be_emitf_(be, "%s\n", L_end);
 
-    free(L_true);
-    free(L_end);
+    mem_free(L_true);
+    mem_free(L_end);
     return OK;
 }
 
+// longest power turned into multiplies, past it one POW is shorter than the chain
+#define BE_POW_CHAIN_MAX 16
+
+// n when base ^ exp can be multiplies instead: int ^ small int, or float ^ 2, the only exact one
+static unsigned be_pow_chain_n_(int base_float, int exp_float, long long ei, double ef)
+{
+    if (!base_float)
+        return (!exp_float && ei >= 2 && ei <= BE_POW_CHAIN_MAX) ? (unsigned)ei : 0;
+
+    return ((exp_float ? ef : (double)ei) == 2.0) ? 2 : 0;
+}
+
+// k when n is 2^k for k > 0, 0 otherwise
+static unsigned be_log2_exact_(long long n)
+{
+    if (n < 2 || (n & (n - 1)) != 0) return 0;
+
+    unsigned k = 0;
+    while (n > 1) { n >>= 1; ++k; }
+    return k;
+}
+
+static unsigned be_lit_log2_(const ast_node_t* n)
+{
+    if (!n || n->kind != ASTK_NUM_LIT || n->u.num.lit_type != LIT_INT) return 0;
+    return be_log2_exact_((long long)n->u.num.lit.i64);
+}
+
+/*
+    x ^ n for x on the stack by squaring. A copy of x is left under the
+    running power for every set bit below the top one, there is no DUP, so
+    squaring copies the top through the scratch register
+*/
+static void be_emit_pow_chain_(backend_t* be, unsigned n, int is_float)
+{
+    const unsigned reg = is_float ? (unsigned)REG_TMP_F : (unsigned)REG_TMPA;
+
+    unsigned top = 0, bits = 0;
+    for (unsigned m = n; m; m >>= 1) { ++top; bits += m & 1u; }
+
+    be_emitf_(be, is_float ? "FPOPR fx%u\n" : "POPR  x%u\n", reg);
+    for (unsigned i = 0; i < bits; ++i)
+        be_emitf_(be, is_float ? "FPUSHR fx%u\n" : "PUSHR x%u\n", reg);
+
+    int in_reg = 1;  // the running power is also in reg
+    for (unsigned bit = top - 1; bit-- > 0; )
+    {
+        if (!in_reg)
+        {
+            be_emitf_(be, is_float ? "FPOPR fx%u\n" : "POPR  x%u\n", reg);
+            be_emitf_(be, is_float ? "FPUSHR fx%u\n" : "PUSHR x%u\n", reg);
+        }
+        be_emitf_(be, is_float ? "FPUSHR fx%u\nFMUL\n" : "PUSHR x%u\nMUL\n", reg);
+        in_reg = 0;
+
+        if ((n >> bit) & 1u) be_emitf_(be, is_float ? "FMUL\n" : "MUL\n");
+    }
+}
+
 static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_type)
 {
     if (!e) return ERR_BAD_ARG;
@@ -1056,7 +1656,7 @@ static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_t
     {
         case ASTK_NUM_LIT:
             if (e->u.num.lit_type == LIT_FLOAT)
-                be_emitf_(be, "PUSH %lf\n", e->u.num.lit.f64);
+                be_emit_push_float_(be, e->u.num.lit.f64);
             else
                 be_emitf_(be, "PUSH %lld\n", (long long)e->u.num.lit.i64);
             if (out_type) *out_type = e->type;
@@ -1067,7 +1667,7 @@ static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_t
             ssize_t bi = be_bind_lookup_(be, e->u.ident.name_id);
             BE_CHECK(be, bi >= 0, e, "Unknown identifier '%s'", ast_name_cstr(be->tree, e->u.ident.name_id));
             const binding_t* b = &be->binds[(size_t)bi];
-            be_emit_load_bp_off_(be, b->offset);
+            be_emit_load_home_(be, b->reg, b->offset);
             if (out_type) *out_type = b->type;
             return OK;
         }
@@ -1085,7 +1685,10 @@ static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_t
             const ast_node_t* args = e->left;
             BE_CHECK(be, args && args->kind == ASTK_ARG_LIST, e, "Internal: CALL missing ARG_LIST");
 
-            // store args into RAM[SP + i]
+            be_emit_prof_inc_(be, e, 0);
+
+            // all args go to the stack first: a call in a later arg would
+            // store its own args over RAM[SP + i]
             size_t i = 1;
             for (const ast_node_t* a = args->left; a; a = a->right, ++i)
             {
@@ -1099,7 +1702,10 @@ static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_t
                     if (pt == AST_TYPE_FLOAT && at != AST_TYPE_FLOAT) be_emitf_(be, "ITOF\n");
                     if (pt != AST_TYPE_FLOAT && at == AST_TYPE_FLOAT) be_emitf_(be, "FTOI\n");
                 }
+            }
 
+            for (--i; i > 0; --i)
+            {
                 be_emit_addr_sp_plus_(be, i);
                 be_emitf_(be, "POPM x%u\n", (unsigned)REG_TMPA); // pop arg into RAM[SP+i]
             }
@@ -1135,8 +1741,8 @@ static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_t
             {
                 // -x  => 0 x SUB
                 be_emitf_(be, "POPR  x%u\n", (unsigned)REG_TMPA);
-                be_emitf_(be, "PUSH 0\n");
-                if (st == AST_TYPE_FLOAT) be_emitf_(be, "ITOF\n");
+                if (st == AST_TYPE_FLOAT) be_emit_push_float_(be, 0.0);
+                else                      be_emitf_(be, "PUSH 0\n");
                 be_emitf_(be, "PUSHR x%u\n", (unsigned)REG_TMPA);
                 be_emitf_(be, (st == AST_TYPE_FLOAT) ? "FSUB\n" : "SUB\n");
                 if (out_type) *out_type = st;
@@ -1151,15 +1757,15 @@ static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_t
                 // stack [x,0]
                 char* L_true = be_new_label_(be, "not_true");
                 char* L_end  = be_new_label_(be, "not_end");
-                if (!L_true || !L_end) { free(L_true); free(L_end); return ERR_ALLOC; }
+                if (!L_true || !L_end) { mem_free(L_true); mem_free(L_end); return ERR_ALLOC; }
 
                 be_emitf_(be, "JE %s\n", L_true);
                 be_emitf_(be, "PUSH 0\nJMP %s\n", L_end);
                 be_emitf_(be, "%s\nPUSH 1\n", L_true);
                 be_emitf_(be, "%s\n", L_end);
 
-                free(L_true);
-                free(L_end);
+                mem_free(L_true);
+                mem_free(L_end);
 
                 if (out_type) *out_type = AST_TYPE_INT;
                 return OK;
@@ -1273,6 +1879,17 @@ static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_t
                 ast_type_t at = AST_TYPE_UNKNOWN, bt = AST_TYPE_UNKNOWN;
                 err_t rc = be_emit_expr_(be, a, &at);
                 if (rc != OK) return rc;
+
+                const unsigned n = (b->kind != ASTK_NUM_LIT) ? 0 :
+                    be_pow_chain_n_(at == AST_TYPE_FLOAT, b->u.num.lit_type == LIT_FLOAT,
+                                    (long long)b->u.num.lit.i64, b->u.num.lit.f64);
+                if (n && (at == AST_TYPE_INT || at == AST_TYPE_FLOAT))
+                {
+                    be_emit_pow_chain_(be, n, at == AST_TYPE_FLOAT);
+                    if (out_type) *out_type = at;
+                    return OK;
+                }
+
                 rc = be_emit_expr_(be, b, &bt);
                 if (rc != OK) return rc;
 
@@ -1287,9 +1904,22 @@ static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_t
             }
 
             ast_type_t at = AST_TYPE_UNKNOWN, bt = AST_TYPE_UNKNOWN;
-            const ast_type_t ta = be_infer_expr_type_(be, a);
-            const ast_type_t tb = be_infer_expr_type_(be, b);
-            const int want_float = (ta == AST_TYPE_FLOAT || tb == AST_TYPE_FLOAT);
+            // annotated once by ast_annotate_types, no walk of the operands here
+            const int want_float = (a->type == AST_TYPE_FLOAT || b->type == AST_TYPE_FLOAT);
+
+            // x * 2^k => x << k, the literal may stand on either side
+            const unsigned shl_b = (opk == TOK_OP_MUL && !want_float) ? be_lit_log2_(b) : 0;
+            const unsigned shl_a = (opk == TOK_OP_MUL && !want_float && !shl_b) ? be_lit_log2_(a) : 0;
+            if (shl_a || shl_b)
+            {
+                err_t rc = be_emit_expr_(be, shl_b ? a : b, &at);
+                if (rc != OK) return rc;
+                if (at == AST_TYPE_FLOAT) be_emitf_(be, "FTOI\n");
+
+                be_emitf_(be, "PUSH %u\nSHL\n", shl_b ? shl_b : shl_a);
+                if (out_type) *out_type = AST_TYPE_INT;
+                return OK;
+            }
 
             err_t rc = be_emit_expr_(be, a, &at);
             if (rc != OK) return rc;
@@ -1335,3 +1965,1283 @@ static err_t be_emit_expr_(backend_t* be, const ast_node_t* e, ast_type_t* out_t
     }
 }
 
+
+// ================================= IR path ==================================
+
+static err_t be_ir_push_(backend_t* be, ir_id_t id);
+
+static int be_ir_is_cmp_(ir_op_t op)
+{
+    return op == IR_OP_EQ || op == IR_OP_NE || op == IR_OP_LT ||
+           op == IR_OP_LE || op == IR_OP_GT || op == IR_OP_GE;
+}
+
+static token_kind_t be_ir_cmp_tok_(ir_op_t op)
+{
+    switch (op)
+    {
+        case IR_OP_EQ: return TOK_OP_EQ;
+        case IR_OP_NE: return TOK_OP_NEQ;
+        case IR_OP_LT: return TOK_OP_LT;
+        case IR_OP_LE: return TOK_OP_LTE;
+        case IR_OP_GT: return TOK_OP_GT;
+        default:       return TOK_OP_GTE;
+    }
+}
+
+static ast_type_t be_ir_type_(const backend_t* be, ir_id_t id)
+{
+    return be->ir_fn->values[id].type;
+}
+
+static err_t be_ir_call_(backend_t* be, const ir_value_t* v)
+{
+    const func_meta_t* fm = be_find_func_(be, v->name_id);
+    BE_CHECK(be, fm != NULL, NULL, "Call to unknown function '%s'", ast_name_cstr(be->tree, v->name_id));
+
+    // push all args before storing any into RAM[SP + i], a call pushed
+    // inline for a later arg stores its own args there
+    for (size_t i = 0; i < v->arg_count; ++i)
+    {
+        err_t rc = be_ir_push_(be, v->args[i]);
+        if (rc != OK) return rc;
+    }
+
+    for (size_t i = v->arg_count; i > 0; --i)
+    {
+        be_emit_addr_sp_plus_(be, i);
+        be_emitf_(be, "POPM x%u\n", (unsigned)REG_TMPA);
+    }
+
+    be_emitf_(be, "CALL %s\n", fm->label);
+
+    if (fm->ret_type == AST_TYPE_FLOAT)
+        be_emitf_(be, "FPUSHR fx%u\n", (unsigned)REG_RET_F);
+    else if (fm->ret_type != AST_TYPE_VOID)
+        be_emitf_(be, "PUSHR x%u\n", (unsigned)REG_RET_I);
+
+    return OK;
+}
+
+static err_t be_ir_set_pixel_(backend_t* be, const ir_value_t* v)
+{
+    // ch first: loading it may clobber x13 which holds the address
+    err_t rc = be_ir_push_(be, v->args[2]);
+    if (rc == OK) rc = be_ir_push_(be, v->args[1]);
+    if (rc != OK) return rc;
+
+    be_emitf_(be, "PUSH %d\nMUL\n", (int)BE_SCREEN_WIDTH);
+
+    rc = be_ir_push_(be, v->args[0]);
+    if (rc != OK) return rc;
+
+    be_emitf_(be, "ADD\nPOPR x%u\n", (unsigned)REG_TMPA);
+    be_emitf_(be, "POPVM x%u\n", (unsigned)REG_TMPA);
+    return OK;
+}
+
+// leaves the value on the stack, nothing for VOID
+// POW and MUL by a constant as multiplies and shifts, *done unless left as they are
+static err_t be_ir_reduce_(backend_t* be, const ir_value_t* v, int* done)
+{
+    const ir_value_t* vals = be->ir_fn->values;
+    const ir_value_t* k0   = &vals[v->args[0]];
+    const ir_value_t* k1   = &vals[v->args[1]];
+
+    if (v->op == IR_OP_POW && k1->op == IR_OP_CONST)
+    {
+        const ast_type_t bt = be_ir_type_(be, v->args[0]);
+        const unsigned n = be_pow_chain_n_(bt == AST_TYPE_FLOAT, k1->type == AST_TYPE_FLOAT,
+                                           (long long)k1->imm.i, k1->imm.f);
+        if (!n || (bt != AST_TYPE_INT && bt != AST_TYPE_FLOAT)) return OK;
+
+        err_t rc = be_ir_push_(be, v->args[0]);
+        if (rc != OK) return rc;
+
+        be_emit_pow_chain_(be, n, bt == AST_TYPE_FLOAT);
+        *done = 1;
+        return OK;
+    }
+
+    if (v->op == IR_OP_MUL && v->type == AST_TYPE_INT)
+    {
+        const unsigned shl1 = (k1->op == IR_OP_CONST && k1->type == AST_TYPE_INT) ? be_log2_exact_((long long)k1->imm.i) : 0;
+        const unsigned shl0 = (k0->op == IR_OP_CONST && k0->type == AST_TYPE_INT) ? be_log2_exact_((long long)k0->imm.i) : 0;
+        if (!shl0 && !shl1) return OK;
+
+        err_t rc = be_ir_push_(be, shl1 ? v->args[0] : v->args[1]);
+        if (rc != OK) return rc;
+
+        be_emitf_(be, "PUSH %u\nSHL\n", shl1 ? shl1 : shl0);
+        *done = 1;
+    }
+    return OK;
+}
+
+static err_t be_ir_compute_(backend_t* be, ir_id_t id)
+{
+    const ir_value_t* v = &be->ir_fn->values[id];
+    const int is_float  = (v->type == AST_TYPE_FLOAT);
+
+    switch (v->op)
+    {
+        case IR_OP_CONST:
+            if (is_float) be_emit_push_float_(be, v->imm.f);
+            else          be_emitf_(be, "PUSH %lld\n", (long long)v->imm.i);
+            return OK;
+
+        case IR_OP_PARAM:
+            be_emit_load_home_(be, be_home_at_(be, 1 + (size_t)v->imm.i), 1 + (size_t)v->imm.i);
+            return OK;
+
+        case IR_OP_PHI:
+            BE_FAIL_NODE(be, NULL, "Internal: phi v%zu has no slot", id);
+
+        case IR_OP_CALL:      return be_ir_call_(be, v);
+        case IR_OP_SET_PIXEL: return be_ir_set_pixel_(be, v);
+
+        case IR_OP_POW:
+        case IR_OP_MUL:
+        {
+            int done = 0;
+            err_t rc = be_ir_reduce_(be, v, &done);
+            if (rc != OK || done) return rc;
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    for (size_t i = 0; i < v->arg_count; ++i)
+    {
+        err_t rc = be_ir_push_(be, v->args[i]);
+        if (rc != OK) return rc;
+    }
+
+    switch (v->op)
+    {
+        case IR_OP_ADD: be_emitf_(be, is_float ? "FADD\n" : "ADD\n"); return OK;
+        case IR_OP_SUB: be_emitf_(be, is_float ? "FSUB\n" : "SUB\n"); return OK;
+        case IR_OP_MUL: be_emitf_(be, is_float ? "FMUL\n" : "MUL\n"); return OK;
+        case IR_OP_DIV: be_emitf_(be, is_float ? "FDIV\n" : "DIV\n"); return OK;
+
+        case IR_OP_POW:
+        {
+            const int fa = (be_ir_type_(be, v->args[0]) == AST_TYPE_FLOAT);
+            const int fb = (be_ir_type_(be, v->args[1]) == AST_TYPE_FLOAT);
+            be_emitf_(be, fa ? (fb ? "FPOWF\n" : "FPOW\n") : (fb ? "POWF\n" : "POW\n"));
+            return OK;
+        }
+
+        case IR_OP_NEG:
+            // -x  => 0 x SUB
+            be_emitf_(be, "POPR  x%u\n", (unsigned)REG_TMPA);
+            if (is_float) be_emit_push_float_(be, 0.0);
+            else          be_emitf_(be, "PUSH 0\n");
+            be_emitf_(be, "PUSHR x%u\n", (unsigned)REG_TMPA);
+            be_emitf_(be, is_float ? "FSUB\n" : "SUB\n");
+            return OK;
+
+        case IR_OP_NOT:
+        {
+            const size_t l = be->label_counter++;
+            be_emitf_(be, "PUSH 0\nJE :L_not_true_%zu\n", l);
+            be_emitf_(be, "PUSH 0\nJMP :L_not_end_%zu\n", l);
+            be_emitf_(be, ":L_not_true_%zu\nPUSH 1\n", l);
+            be_emitf_(be, ":L_not_end_%zu\n", l);
+            return OK;
+        }
+
+        case IR_OP_AND: be_emitf_(be, "AND\n"); return OK;
+        case IR_OP_OR:  be_emitf_(be, "OR\n");  return OK;
+
+        case IR_OP_EQ: case IR_OP_NE:
+        case IR_OP_LT: case IR_OP_LE:
+        case IR_OP_GT: case IR_OP_GE:
+            if (be_ir_type_(be, v->args[0]) == AST_TYPE_FLOAT)
+            {
+                be_emitf_(be, "FCMP\n");
+                return be_emit_fcmp_res_to_bool_(be, NULL, be_ir_cmp_tok_(v->op));
+            }
+            return be_emit_cmp_to_bool_(be, NULL, be_ir_cmp_tok_(v->op));
+
+        case IR_OP_ITOF:    be_emitf_(be, "ITOF\n");    return OK;
+        case IR_OP_FTOI:    be_emitf_(be, "FTOI\n");    return OK;
+        case IR_OP_FLOOR:   be_emitf_(be, "FLOOR\n");   return OK;
+        case IR_OP_CEIL:    be_emitf_(be, "CEIL\n");    return OK;
+        case IR_OP_ROUND:   be_emitf_(be, "ROUND\n");   return OK;
+
+        case IR_OP_IN:      be_emitf_(be, "IN\n");      return OK;
+        case IR_OP_FIN:     be_emitf_(be, "FIN\n");     return OK;
+        case IR_OP_CIN:     be_emitf_(be, "CIN\n");     return OK;
+        case IR_OP_DRAW:    be_emitf_(be, "DRAW\n");    return OK;
+        case IR_OP_CLEANVM: be_emitf_(be, "CLEANVM\n"); return OK;
+
+        case IR_OP_OUT:     be_emitf_(be, "TOPOUT\n");  return OK;
+        case IR_OP_FOUT:    be_emitf_(be, "FTOPOUT\n"); return OK;
+        case IR_OP_COUT:    be_emitf_(be, "CTOPOUT\n"); return OK;
+
+        default:
+            BE_FAIL_NODE(be, NULL, "Backend: unsupported IR op %s", ir_op_name(v->op));
+    }
+}
+
+static err_t be_ir_push_(backend_t* be, ir_id_t id)
+{
+    const size_t slot = be->ir_slots[id];
+    if (slot)
+    {
+        be_emit_load_home_(be, be_home_at_(be, slot), slot);
+        return OK;
+    }
+
+    return be_ir_compute_(be, id);
+}
+
+static err_t be_ir_branch_(backend_t* be, const ir_block_t* b, size_t next)
+{
+    const ir_value_t* c = &be->ir_fn->values[b->cond];
+    const size_t t = be->ir_label_base + b->succ[0];
+    const size_t f = be->ir_label_base + b->succ[1];
+    const int t_next = (b->succ[0] == next);
+    const int f_next = (b->succ[1] == next);
+
+    if (c->op == IR_OP_CONST)
+    {
+        const int taken = (c->type == AST_TYPE_FLOAT) ? (c->imm.f != 0.0) : (c->imm.i != 0);
+        if (!(taken ? t_next : f_next))
+            be_emitf_(be, "JMP :L_bb_%zu\n", taken ? t : f);
+        return OK;
+    }
+
+    const char* jt = "JNE";
+    const char* jf = "JE";
+    err_t rc = OK;
+
+    if (be_ir_is_cmp_(c->op) && be->ir_inline[b->cond])
+    {
+        rc = be_ir_push_(be, c->args[0]);
+        if (rc == OK) rc = be_ir_push_(be, c->args[1]);
+        if (rc != OK) return rc;
+
+        if (be_ir_type_(be, c->args[0]) == AST_TYPE_FLOAT)
+        {
+            // FCMP gives -1/0/1
+            long long k = 0;
+            int       eq = 1;
+            switch (c->op)
+            {
+                case IR_OP_EQ: k =  0; eq = 1; break;
+                case IR_OP_NE: k =  0; eq = 0; break;
+                case IR_OP_LT: k = -1; eq = 1; break;
+                case IR_OP_LE: k =  1; eq = 0; break;
+                case IR_OP_GT: k =  1; eq = 1; break;
+                default:       k = -1; eq = 0; break;
+            }
+            be_emitf_(be, "FCMP\nPUSH %lld\n", k);
+            jt = eq ? "JE"  : "JNE";
+            jf = eq ? "JNE" : "JE";
+        }
+        else
+        {
+            switch (c->op)
+            {
+                case IR_OP_EQ: jt = "JE";  jf = "JNE"; break;
+                case IR_OP_NE: jt = "JNE"; jf = "JE";  break;
+                case IR_OP_LT: jt = "JB";  jf = "JAE"; break;
+                case IR_OP_LE: jt = "JBE"; jf = "JA";  break;
+                case IR_OP_GT: jt = "JA";  jf = "JBE"; break;
+                default:       jt = "JAE"; jf = "JB";  break;
+            }
+        }
+    }
+    else
+    {
+        rc = be_ir_push_(be, b->cond);
+        if (rc != OK) return rc;
+
+        if (c->type == AST_TYPE_FLOAT)
+        {
+            be_emit_push_float_(be, 0.0);
+            be_emitf_(be, "FCMP\n");         // compare cond vs 0.0 -> int
+        }
+        be_emitf_(be, "PUSH 0\n");
+    }
+
+    if (t_next)
+        be_emitf_(be, "%s :L_bb_%zu\n", jf, f);
+    else
+    {
+        be_emitf_(be, "%s :L_bb_%zu\n", jt, t);
+        if (!f_next) be_emitf_(be, "JMP :L_bb_%zu\n", f);
+    }
+
+    return OK;
+}
+
+// a phi sharing the slot of its destination, or a value already in the
+// register of its destination
+static int be_ir_copy_is_nop_(const backend_t* be, const ir_copy_t* c)
+{
+    const ir_value_t* src = &be->ir_fn->values[c->src];
+    if (src->op == IR_OP_PHI && be->ir_slots[c->src] == be->ir_slots[c->dst]) return 1;
+
+    const size_t   from = (src->op == IR_OP_PARAM) ? 1 + (size_t)src->imm.i : be->ir_slots[c->src];
+    const unsigned reg  = from ? be_home_at_(be, from) : 0;
+    return reg && reg == be_home_at_(be, be->ir_slots[c->dst]);
+}
+
+// a block that only branches on values computed at the branch itself
+static int be_ir_is_test_only_(const backend_t* be, const ir_block_t* b)
+{
+    if (b->term != IR_TERM_BR || b->copy_count > 0) return 0;
+
+    for (size_t i = 0; i < b->inst_count; ++i)
+    {
+        const ir_id_t     id = b->insts[i];
+        const ir_value_t* v  = &be->ir_fn->values[id];
+        if (v->op == IR_OP_CONST || v->op == IR_OP_PARAM || v->op == IR_OP_PHI) continue;
+        if (!be->ir_inline[id] && (be->ir_slots[id] || ir_op_has_effect(v->op))) return 0;
+    }
+    return 1;
+}
+
+static err_t be_ir_block_(backend_t* be, const ir_block_t* b, size_t next)
+{
+    const ir_func_t* fn = be->ir_fn;
+
+    for (size_t i = 0; i < b->inst_count; ++i)
+    {
+        const ir_id_t     id = b->insts[i];
+        const ir_value_t* v  = &fn->values[id];
+
+        if (v->op == IR_OP_CONST || v->op == IR_OP_PARAM || v->op == IR_OP_PHI) continue;
+
+        const size_t slot = be->ir_slots[id];
+        if (be->ir_inline[id]) continue;                  // computed at its use
+        if (!slot && !ir_op_has_effect(v->op)) continue;  // unused
+
+        err_t rc = be_ir_compute_(be, id);
+        if (rc != OK) return rc;
+
+        if (slot)                             be_emit_store_home_(be, be_home_at_(be, slot), slot);
+        else if (v->type != AST_TYPE_VOID)    be_emitf_(be, "POP\n");
+    }
+
+    // parallel copies: read every source before writing any phi slot,
+    // a phi sharing the slot of its destination is there already
+    for (size_t i = 0; i < b->copy_count; ++i)
+    {
+        if (be_ir_copy_is_nop_(be, &b->copies[i])) continue;
+
+        err_t rc = be_ir_push_(be, b->copies[i].src);
+        if (rc != OK) return rc;
+    }
+    for (size_t i = b->copy_count; i > 0; --i)
+        if (!be_ir_copy_is_nop_(be, &b->copies[i - 1]))
+        {
+            const size_t slot = be->ir_slots[b->copies[i - 1].dst];
+            be_emit_store_home_(be, be_home_at_(be, slot), slot);
+        }
+
+    switch (b->term)
+    {
+        case IR_TERM_JMP:
+            if (b->succ[0] == next) return OK;
+
+            // a jump to a bare test, a loop entered from above, runs the test here
+            if (be_ir_is_test_only_(be, &fn->blocks[b->succ[0]]))
+                return be_ir_branch_(be, &fn->blocks[b->succ[0]], next);
+
+            be_emitf_(be, "JMP :L_bb_%zu\n", be->ir_label_base + b->succ[0]);
+            return OK;
+
+        case IR_TERM_BR:
+            return be_ir_branch_(be, b, next);
+
+        case IR_TERM_RET:
+            if (b->cond != IR_NONE)
+            {
+                err_t rc = be_ir_push_(be, b->cond);
+                if (rc != OK) return rc;
+
+                if (be->cur_fn->ret_type == AST_TYPE_FLOAT)
+                    be_emitf_(be, "FPOPR fx%u\n", (unsigned)REG_RET_F);
+                else
+                    be_emitf_(be, "POPR x%u\n", (unsigned)REG_RET_I);
+            }
+            if (next != IR_NONE)
+                be_emitf_(be, "JMP %s\n", be->fn_end_label);
+            return OK;
+
+        default:
+            BE_FAIL_NODE(be, NULL, "Internal: IR block without terminator");
+    }
+}
+
+// use_block ends up IR_NONE for values used in more than one block
+static void be_ir_use_(size_t* uses, size_t* use_block, ir_id_t value, size_t block)
+{
+    use_block[value] = (uses[value] == 0 || use_block[value] == block) ? block : IR_NONE;
+    uses[value]++;
+}
+
+typedef struct
+{
+    const ir_func_t* fn;
+    const ir_block_t* b;
+    size_t  block;
+    const size_t* uses;
+    const size_t* use_block;
+    const size_t* pos;       // index of a value inside its block
+    const size_t* prev_eff;  // position -> previous instruction with effects
+    char*   inl;
+    size_t  expect;          // the only effect that may be evaluated next, going backwards
+    int     ok;
+} be_ir_stackify_t;
+
+static size_t be_ir_prev_effect_(const be_ir_stackify_t* st, size_t p)
+{
+    p = (p == 0) ? IR_NONE : st->prev_eff[p - 1];
+    while (p != IR_NONE && st->inl[st->b->insts[p]])
+        p = (p == 0) ? IR_NONE : st->prev_eff[p - 1];
+    return p;
+}
+
+static void be_ir_claim_(be_ir_stackify_t* st, ir_id_t a);
+
+// operands in reverse evaluation order
+static void be_ir_claim_args_(be_ir_stackify_t* st, const ir_value_t* v)
+{
+    if (v->op == IR_OP_SET_PIXEL)
+    {
+        // evaluated as ch, y, x
+        for (size_t k = 0; k < v->arg_count; ++k)
+            be_ir_claim_(st, v->args[k]);
+        return;
+    }
+
+    for (size_t k = v->arg_count; k > 0; --k)
+        be_ir_claim_(st, v->args[k - 1]);
+}
+
+static void be_ir_claim_(be_ir_stackify_t* st, ir_id_t a)
+{
+    const ir_value_t* v = &st->fn->values[a];
+    if (v->block != st->block) return;
+    if (v->op == IR_OP_CONST || v->op == IR_OP_PARAM || v->op == IR_OP_PHI) return;
+
+    if (!ir_op_has_effect(v->op))
+    {
+        if (st->inl[a]) be_ir_claim_args_(st, v);
+        return;
+    }
+
+    // an effect may stay on the stack only if no other effect runs between
+    // its definition and its use
+    if (st->ok && st->uses[a] == 1 && st->use_block[a] == st->block &&
+        v->type != AST_TYPE_VOID && st->pos[a] == st->expect)
+    {
+        st->inl[a] = 1;
+        st->expect = be_ir_prev_effect_(st, st->pos[a]);
+        be_ir_claim_args_(st, v);
+        return;
+    }
+
+    st->ok = 0;
+}
+
+static void be_ir_stackify_block_(be_ir_stackify_t* st)
+{
+    const ir_block_t* b  = st->b;
+    const ir_func_t*  fn = st->fn;
+
+    // block end: copies, then the terminator operand
+    st->ok     = 1;
+    st->expect = be_ir_prev_effect_(st, b->inst_count);
+    if ((b->term == IR_TERM_BR || b->term == IR_TERM_RET) && b->cond != IR_NONE)
+    {
+        const ir_value_t* c = &fn->values[b->cond];
+        if (c->block == st->block && st->inl[b->cond] && b->term == IR_TERM_BR)
+            be_ir_claim_args_(st, c);
+        else
+            be_ir_claim_(st, b->cond);
+    }
+    for (size_t i = b->copy_count; i > 0; --i)
+        be_ir_claim_(st, b->copies[i - 1].src);
+
+    for (size_t i = b->inst_count; i > 0; --i)
+    {
+        const ir_id_t     id = b->insts[i - 1];
+        const ir_value_t* v  = &fn->values[id];
+
+        if (st->inl[id] || v->op == IR_OP_CONST || v->op == IR_OP_PARAM || v->op == IR_OP_PHI) continue;
+        if (!ir_op_has_effect(v->op) && st->uses[id] == 0) continue;
+
+        st->ok     = 1;
+        st->expect = be_ir_prev_effect_(st, i - 1);
+        be_ir_claim_args_(st, v);
+    }
+}
+
+// a block that does nothing but hand its phis on, each to a phi elsewhere
+static int be_ir_passes_phis_(const ir_func_t* fn, const size_t* uses, size_t bi)
+{
+    const ir_block_t* b = &fn->blocks[bi];
+    if (!b->reachable || b->term != IR_TERM_JMP || b->copy_count == 0) return 0;
+
+    for (size_t i = 0; i < b->inst_count; ++i)
+        if (fn->values[b->insts[i]].op != IR_OP_PHI) return 0;
+
+    for (size_t i = 0; i < b->copy_count; ++i)
+    {
+        const ir_value_t* src = &fn->values[b->copies[i].src];
+        if (src->op != IR_OP_PHI || src->block != bi || uses[b->copies[i].src] != 1 ||
+            fn->values[b->copies[i].dst].block == bi)
+            return 0;
+    }
+    return 1;
+}
+
+// Such a phi (the join of several gg in front of a loop head) can live in
+// the slot of the phi it is copied to: nothing reads that one on the way
+static ir_id_t be_ir_phi_alias_(const ir_func_t* fn, const size_t* uses, ir_id_t phi)
+{
+    const size_t bi = fn->values[phi].block;
+    if (!be_ir_passes_phis_(fn, uses, bi)) return IR_NONE;
+
+    const ir_block_t* b = &fn->blocks[bi];
+    for (size_t i = 0; i < b->copy_count; ++i)
+    {
+        if (b->copies[i].src != phi) continue;
+
+        const ir_id_t dst = b->copies[i].dst;
+        return be_ir_passes_phis_(fn, uses, fn->values[dst].block) ? IR_NONE : dst;
+    }
+    return IR_NONE;
+}
+
+// Values are computed on the stack right at their single use in the same
+// block; effects only when nothing with effects runs in between. Phis and
+// everything else that is used get a frame slot after the params, consts
+// and params are rematerialized
+static size_t be_ir_assign_slots_(backend_t* be, const ir_func_t* fn, size_t* uses, size_t* use_block, size_t* pos, size_t* prev_eff)
+{
+    for (size_t bi = 0; bi < fn->block_count; ++bi)
+    {
+        const ir_block_t* b = &fn->blocks[bi];
+        if (!b->reachable) continue;
+
+        for (size_t i = 0; i < b->inst_count; ++i)
+        {
+            const ir_value_t* v = &fn->values[b->insts[i]];
+            for (size_t k = 0; k < v->arg_count; ++k)
+                be_ir_use_(uses, use_block, v->args[k], bi);
+        }
+
+        for (size_t i = 0; i < b->copy_count; ++i)
+            be_ir_use_(uses, use_block, b->copies[i].src, bi);
+
+        if ((b->term == IR_TERM_BR || b->term == IR_TERM_RET) && b->cond != IR_NONE)
+            be_ir_use_(uses, use_block, b->cond, bi);
+    }
+
+    be_ir_stackify_t st = {
+        .fn = fn, .uses = uses, .use_block = use_block,
+        .pos = pos, .prev_eff = prev_eff, .inl = be->ir_inline,
+    };
+
+    for (size_t bi = 0; bi < fn->block_count; ++bi)
+    {
+        const ir_block_t* b = &fn->blocks[bi];
+        if (!b->reachable) continue;
+
+        size_t last_eff = IR_NONE;
+        for (size_t i = 0; i < b->inst_count; ++i)
+        {
+            const ir_id_t     id = b->insts[i];
+            const ir_value_t* v  = &fn->values[id];
+
+            pos[id] = i;
+            if (ir_op_has_effect(v->op)) last_eff = i;
+            prev_eff[i] = last_eff;
+
+            if (v->op != IR_OP_CONST && v->op != IR_OP_PARAM && v->op != IR_OP_PHI &&
+                !ir_op_has_effect(v->op) && uses[id] == 1 && use_block[id] == bi)
+                be->ir_inline[id] = 1;
+        }
+
+        st.b     = b;
+        st.block = bi;
+        be_ir_stackify_block_(&st);
+    }
+
+    size_t next = 1 + fn->param_count;
+
+    for (size_t bi = 0; bi < fn->block_count; ++bi)
+    {
+        const ir_block_t* b = &fn->blocks[bi];
+        if (!b->reachable) continue;
+
+        for (size_t i = 0; i < b->inst_count; ++i)
+        {
+            const ir_id_t     id = b->insts[i];
+            const ir_value_t* v  = &fn->values[id];
+
+            int needs_slot = 0;
+            if (v->op == IR_OP_PHI)
+                needs_slot = (be_ir_phi_alias_(fn, uses, id) == IR_NONE);
+            else if (v->op == IR_OP_CONST || v->op == IR_OP_PARAM || uses[id] == 0 || be->ir_inline[id])
+                needs_slot = 0;
+            else
+                needs_slot = (v->type != AST_TYPE_VOID);
+
+            if (needs_slot) be->ir_slots[id] = next++;
+        }
+    }
+
+    for (size_t bi = 0; bi < fn->block_count; ++bi)
+        for (size_t i = 0; fn->blocks[bi].reachable && i < fn->blocks[bi].inst_count; ++i)
+        {
+            const ir_id_t id    = fn->blocks[bi].insts[i];
+            const ir_id_t alias = (fn->values[id].op == IR_OP_PHI) ? be_ir_phi_alias_(fn, uses, id) : IR_NONE;
+            if (alias != IR_NONE) be->ir_slots[id] = be->ir_slots[alias];
+        }
+
+    return next;
+}
+
+// Rough loop nesting of each block for register weights: an edge back to a
+// block no later in reverse postorder puts the blocks in between one deeper
+static err_t be_ir_loop_depth_(const ir_func_t* fn, size_t* depth)
+{
+    const size_t n = fn->block_count;
+    size_t* order = (size_t*)mem_calloc(MEM_TAG_BACKEND, n + 1, sizeof(size_t));
+    size_t* index = (size_t*)mem_calloc(MEM_TAG_BACKEND, n + 1, sizeof(size_t));
+    size_t* stack = (size_t*)mem_calloc(MEM_TAG_BACKEND, n + 1, sizeof(size_t));
+    size_t* edge  = (size_t*)mem_calloc(MEM_TAG_BACKEND, n + 1, sizeof(size_t));
+    char*   seen  = (char*)  mem_calloc(MEM_TAG_BACKEND, n + 1, 1);
+
+    err_t rc = (order && index && stack && edge && seen) ? OK : ERR_ALLOC;
+
+    size_t post = n;
+    size_t top  = 0;
+    if (rc == OK && n > 0) { stack[top++] = 0; seen[0] = 1; }
+
+    while (top > 0)
+    {
+        const size_t bi = stack[top - 1];
+        const ir_block_t* b = &fn->blocks[bi];
+        const size_t succ_count = (b->term == IR_TERM_BR) ? 2 : (b->term == IR_TERM_JMP) ? 1 : 0;
+
+        if (edge[bi] < succ_count)
+        {
+            const size_t s = b->succ[edge[bi]++];
+            if (!seen[s]) { seen[s] = 1; stack[top++] = s; }
+            continue;
+        }
+
+        order[--post] = bi;
+        index[bi]     = post;
+        top--;
+    }
+
+    for (size_t k = post; k < n; ++k)
+    {
+        const ir_block_t* b = &fn->blocks[order[k]];
+        const size_t succ_count = (b->term == IR_TERM_BR) ? 2 : (b->term == IR_TERM_JMP) ? 1 : 0;
+
+        for (size_t e = 0; e < succ_count; ++e)
+            if (index[b->succ[e]] <= k)
+                for (size_t j = index[b->succ[e]]; j <= k; ++j) depth[order[j]]++;
+    }
+
+    mem_free(order);
+    mem_free(index);
+    mem_free(stack);
+    mem_free(edge);
+    mem_free(seen);
+    return rc;
+}
+
+// BP offset a value is read from, 0 = none
+static size_t be_ra_ir_slot_(const backend_t* be, ir_id_t a)
+{
+    const ir_value_t* v = &be->ir_fn->values[a];
+    return (v->op == IR_OP_PARAM) ? 1 + (size_t)v->imm.i : be->ir_slots[a];
+}
+
+static void be_ra_ir_use_(const backend_t* be, be_ra_cand_t* cands, ir_id_t a, size_t weight)
+{
+    const size_t slot = be_ra_ir_slot_(be, a);
+    if (slot) cands[slot].weight += weight;
+}
+
+/*
+    Slots that are never live at the same time share a register. Liveness is
+    solved per block over slot bitsets, then each block is walked backwards
+    to fill a slot x slot conflict matrix: a slot written while another is
+    live conflicts with it, unless that one is what it is copied from. A
+    value computed at its use reads its args there. Functions too big for
+    the matrix give every slot a register of its own
+*/
+#define BE_RA_IR_MATRIX_MAX_BITS ((size_t)1 << 24)
+
+typedef uint64_t be_bits_t;
+
+#define BE_BITS_WORDS(n)     (((n) + 63) / 64)
+#define BE_BITS_SET(set, i)  ((set)[(i) / 64] |= (be_bits_t)1 << ((i) % 64))
+#define BE_BITS_CLR(set, i)  ((set)[(i) / 64] &= ~((be_bits_t)1 << ((i) % 64)))
+#define BE_BITS_HAS(set, i)  (((set)[(i) / 64] >> ((i) % 64)) & 1)
+
+typedef struct
+{
+    const backend_t* be;
+    size_t           sw;        // words of a slot set
+    be_bits_t*       ue;        // per block: read before any write in it
+    be_bits_t*       def;
+    be_bits_t*       in;
+    be_bits_t*       out;
+    be_bits_t*       live;      // scratch set for the backward walk
+    be_bits_t*       conflict;  // row per slot
+} be_ra_live_t;
+
+typedef void (*be_ra_read_fn_t)(be_ra_live_t* lv, size_t bi, size_t slot);
+
+// the slots reading a reads where it is used
+static void be_ra_ir_reads_(be_ra_live_t* lv, size_t bi, ir_id_t a, be_ra_read_fn_t fn)
+{
+    const backend_t* be = lv->be;
+    if (be->ir_inline[a])
+    {
+        const ir_value_t* v = &be->ir_fn->values[a];
+        for (size_t k = 0; k < v->arg_count; ++k) be_ra_ir_reads_(lv, bi, v->args[k], fn);
+        return;
+    }
+
+    const size_t slot = be_ra_ir_slot_(be, a);
+    if (slot) fn(lv, bi, slot);
+}
+
+static int be_ra_ir_writes_(const backend_t* be, const ir_value_t* v, ir_id_t id)
+{
+    return v->op != IR_OP_CONST && v->op != IR_OP_PARAM && v->op != IR_OP_PHI && !be->ir_inline[id];
+}
+
+static void be_ra_ue_read_(be_ra_live_t* lv, size_t bi, size_t slot)
+{
+    if (!BE_BITS_HAS(lv->def + bi * lv->sw, slot)) BE_BITS_SET(lv->ue + bi * lv->sw, slot);
+}
+
+static void be_ra_ue_write_(be_ra_live_t* lv, size_t bi, size_t slot)
+{
+    if (slot) BE_BITS_SET(lv->def + bi * lv->sw, slot);
+}
+
+static void be_ra_ue_block_(be_ra_live_t* lv, size_t bi)
+{
+    const backend_t*  be = lv->be;
+    const ir_func_t*  fn = be->ir_fn;
+    const ir_block_t* b  = &fn->blocks[bi];
+
+    if (bi == 0)
+        for (size_t off = 1; off <= fn->param_count; ++off) be_ra_ue_write_(lv, bi, off);
+
+    for (size_t i = 0; i < b->inst_count; ++i)
+    {
+        const ir_id_t     id = b->insts[i];
+        const ir_value_t* v  = &fn->values[id];
+        if (!be_ra_ir_writes_(be, v, id)) continue;
+
+        for (size_t k = 0; k < v->arg_count; ++k) be_ra_ir_reads_(lv, bi, v->args[k], be_ra_ue_read_);
+        be_ra_ue_write_(lv, bi, be->ir_slots[id]);
+    }
+
+    for (size_t i = 0; i < b->copy_count; ++i)
+        if (!be_ir_copy_is_nop_(be, &b->copies[i]))
+            be_ra_ir_reads_(lv, bi, b->copies[i].src, be_ra_ue_read_);
+    for (size_t i = 0; i < b->copy_count; ++i)
+        if (!be_ir_copy_is_nop_(be, &b->copies[i]))
+            be_ra_ue_write_(lv, bi, be->ir_slots[b->copies[i].dst]);
+
+    if ((b->term == IR_TERM_BR || b->term == IR_TERM_RET) && b->cond != IR_NONE)
+        be_ra_ir_reads_(lv, bi, b->cond, be_ra_ue_read_);
+}
+
+static void be_ra_live_solve_(be_ra_live_t* lv)
+{
+    const ir_func_t* fn = lv->be->ir_fn;
+
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (size_t bi = fn->block_count; bi > 0; --bi)
+        {
+            const ir_block_t* b = &fn->blocks[bi - 1];
+            if (!b->reachable) continue;
+
+            const size_t     succ_count = (b->term == IR_TERM_BR) ? 2 : (b->term == IR_TERM_JMP) ? 1 : 0;
+            be_bits_t*       out = lv->out + (bi - 1) * lv->sw;
+            be_bits_t*       in  = lv->in  + (bi - 1) * lv->sw;
+            const be_bits_t* ue  = lv->ue  + (bi - 1) * lv->sw;
+            const be_bits_t* def = lv->def + (bi - 1) * lv->sw;
+
+            for (size_t w = 0; w < lv->sw; ++w)
+            {
+                be_bits_t o = out[w];
+                for (size_t e = 0; e < succ_count; ++e) o |= lv->in[b->succ[e] * lv->sw + w];
+
+                const be_bits_t n = ue[w] | (o & ~def[w]);
+                if (o != out[w] || n != in[w]) changed = 1;
+                out[w] = o;
+                in[w]  = n;
+            }
+        }
+    }
+}
+
+static void be_ra_conflict_(be_ra_live_t* lv, size_t a, size_t b)
+{
+    if (a == b) return;
+    BE_BITS_SET(lv->conflict + a * lv->sw, b);
+    BE_BITS_SET(lv->conflict + b * lv->sw, a);
+}
+
+// slot is written here: it conflicts with everything live but itself and from
+static void be_ra_live_write_(be_ra_live_t* lv, size_t slot, size_t from)
+{
+    if (!slot) return;
+
+    const int keep = from && BE_BITS_HAS(lv->live, from);
+    if (keep) BE_BITS_CLR(lv->live, from);
+
+    for (size_t w = 0; w < lv->sw; ++w)
+        for (be_bits_t m = lv->live[w]; m; m &= m - 1)
+            be_ra_conflict_(lv, slot, w * 64 + (size_t)__builtin_ctzll(m));
+
+    if (keep) BE_BITS_SET(lv->live, from);
+}
+
+static void be_ra_live_read_(be_ra_live_t* lv, size_t bi, size_t slot)
+{
+    (void)bi;
+    BE_BITS_SET(lv->live, slot);
+}
+
+static void be_ra_conflict_block_(be_ra_live_t* lv, size_t bi)
+{
+    const backend_t*  be = lv->be;
+    const ir_func_t*  fn = be->ir_fn;
+    const ir_block_t* b  = &fn->blocks[bi];
+
+    memcpy(lv->live, lv->out + bi * lv->sw, lv->sw * sizeof(be_bits_t));
+
+    if ((b->term == IR_TERM_BR || b->term == IR_TERM_RET) && b->cond != IR_NONE)
+        be_ra_ir_reads_(lv, bi, b->cond, be_ra_live_read_);
+
+    // the copies write all at once: their targets conflict with each other too
+    for (size_t i = 0; i < b->copy_count; ++i)
+    {
+        const ir_copy_t* c = &b->copies[i];
+        if (be_ir_copy_is_nop_(be, c)) continue;
+
+        const size_t dst = be->ir_slots[c->dst];
+        be_ra_live_write_(lv, dst, be_ra_ir_slot_(be, c->src));
+        for (size_t j = 0; j < b->copy_count; ++j)
+            if (j != i && !be_ir_copy_is_nop_(be, &b->copies[j]))
+                be_ra_conflict_(lv, dst, be->ir_slots[b->copies[j].dst]);
+    }
+    for (size_t i = 0; i < b->copy_count; ++i)
+        if (!be_ir_copy_is_nop_(be, &b->copies[i]))
+            BE_BITS_CLR(lv->live, be->ir_slots[b->copies[i].dst]);
+    for (size_t i = 0; i < b->copy_count; ++i)
+        if (!be_ir_copy_is_nop_(be, &b->copies[i]))
+            be_ra_ir_reads_(lv, bi, b->copies[i].src, be_ra_live_read_);
+
+    for (size_t i = b->inst_count; i > 0; --i)
+    {
+        const ir_id_t     id = b->insts[i - 1];
+        const ir_value_t* v  = &fn->values[id];
+        if (!be_ra_ir_writes_(be, v, id)) continue;
+
+        const size_t slot = be->ir_slots[id];
+        if (slot)
+        {
+            be_ra_live_write_(lv, slot, 0);
+            BE_BITS_CLR(lv->live, slot);
+        }
+        for (size_t k = 0; k < v->arg_count; ++k) be_ra_ir_reads_(lv, bi, v->args[k], be_ra_live_read_);
+    }
+
+    // the prologue loads every param at once
+    if (bi == 0)
+        for (size_t off = 1; off <= fn->param_count; ++off)
+        {
+            be_ra_live_write_(lv, off, 0);
+            for (size_t other = 1; other <= fn->param_count; ++other) be_ra_conflict_(lv, off, other);
+        }
+}
+
+// conflict matrix over the slots below frame, NULL when out of memory
+static be_bits_t* be_ra_ir_conflicts_(const backend_t* be, size_t frame)
+{
+    const ir_func_t* fn = be->ir_fn;
+    const size_t     nb = fn->block_count;
+
+    be_ra_live_t lv = { .be = be, .sw = BE_BITS_WORDS(frame) };
+    lv.ue       = (be_bits_t*)mem_calloc(MEM_TAG_BACKEND, nb * lv.sw + 1, sizeof(be_bits_t));
+    lv.def      = (be_bits_t*)mem_calloc(MEM_TAG_BACKEND, nb * lv.sw + 1, sizeof(be_bits_t));
+    lv.in       = (be_bits_t*)mem_calloc(MEM_TAG_BACKEND, nb * lv.sw + 1, sizeof(be_bits_t));
+    lv.out      = (be_bits_t*)mem_calloc(MEM_TAG_BACKEND, nb * lv.sw + 1, sizeof(be_bits_t));
+    lv.live     = (be_bits_t*)mem_calloc(MEM_TAG_BACKEND, lv.sw + 1, sizeof(be_bits_t));
+    lv.conflict = (be_bits_t*)mem_calloc(MEM_TAG_BACKEND, frame * lv.sw + 1, sizeof(be_bits_t));
+
+    if (lv.ue && lv.def && lv.in && lv.out && lv.live && lv.conflict)
+    {
+        for (size_t bi = 0; bi < nb; ++bi)
+            if (fn->blocks[bi].reachable) be_ra_ue_block_(&lv, bi);
+
+        be_ra_live_solve_(&lv);
+
+        for (size_t bi = 0; bi < nb; ++bi)
+            if (fn->blocks[bi].reachable) be_ra_conflict_block_(&lv, bi);
+    }
+    else
+    {
+        mem_free(lv.conflict);
+        lv.conflict = NULL;
+    }
+
+    mem_free(lv.ue);
+    mem_free(lv.def);
+    mem_free(lv.in);
+    mem_free(lv.out);
+    mem_free(lv.live);
+    return lv.conflict;
+}
+
+// index of a home register among all of them, floats after the ints
+static size_t be_ra_reg_index_(unsigned reg)
+{
+    return (reg & BE_REG_FLOAT) ? REG_VAR_I_LAST + 1 + (reg & ~BE_REG_FLOAT) : reg;
+}
+
+// Like be_ra_pick_, but a slot takes a register already in use when none of
+// the slots there conflict with it, first one holding a slot it is copied
+// to or from, so that the copy goes away
+static void be_ra_ir_pick_(backend_t* be, be_ra_cand_t* cands, size_t count,
+                           const be_bits_t* conflict, size_t frame)
+{
+    const ir_func_t* fn    = be->ir_fn;
+    const size_t     sw    = BE_BITS_WORDS(frame);
+    char             ban[REG_VAR_I_LAST + 1 + REG_VAR_F_LAST + 1];
+
+    if (count > 1) qsort(cands, count, sizeof(be_ra_cand_t), be_ra_cmp_);
+    be->home_count = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const be_ra_cand_t* c   = &cands[i];
+        const size_t        off = c->home.offset;
+        const int is_param = (off <= fn->param_count);
+        if (c->weight * 6 <= (is_param ? 10u : 2u)) continue;
+
+        unsigned first = 0, last = 0, flag = 0;
+        if (c->type == AST_TYPE_FLOAT)
+        {
+            first = REG_VAR_F_FIRST; last = REG_VAR_F_LAST; flag = BE_REG_FLOAT;
+        }
+        else if (c->type == AST_TYPE_INT || c->type == AST_TYPE_PTR)
+        {
+            first = REG_VAR_I_FIRST; last = REG_VAR_I_LAST;
+        }
+        else continue;
+
+        memset(ban, 0, sizeof(ban));
+        const be_bits_t* row = conflict + off * sw;
+        for (size_t w = 0; w < sw; ++w)
+            for (be_bits_t m = row[w]; m; m &= m - 1)
+            {
+                const unsigned reg = be->ir_regs[w * 64 + (size_t)__builtin_ctzll(m)];
+                if (reg) ban[be_ra_reg_index_(reg)] = 1;
+            }
+
+        unsigned pick = 0;
+        for (size_t bi = 0; bi < fn->block_count && !pick; ++bi)
+            for (size_t k = 0; fn->blocks[bi].reachable && k < fn->blocks[bi].copy_count && !pick; ++k)
+            {
+                const ir_copy_t* cp  = &fn->blocks[bi].copies[k];
+                const size_t     src = be_ra_ir_slot_(be, cp->src);
+                const size_t     dst = be->ir_slots[cp->dst];
+                const size_t     mate = (src == off) ? dst : (dst == off) ? src : 0;
+                const unsigned   reg  = mate ? be->ir_regs[mate] : 0;
+
+                if (reg && (reg & BE_REG_FLOAT) == flag && !ban[be_ra_reg_index_(reg)]) pick = reg;
+            }
+
+        unsigned used = 0;
+        for (size_t h = 0; h < be->home_count && !pick; ++h)
+        {
+            const unsigned reg = be->homes[h].reg;
+            if ((reg & BE_REG_FLOAT) != flag) continue;
+            used++;
+            if (!ban[be_ra_reg_index_(reg)]) pick = reg;
+        }
+
+        if (!pick)
+        {
+            if (first + used > last) continue;
+            pick = flag | (first + used);
+            be->homes[be->home_count++] = (be_home_t){ .reg = pick, .offset = off };
+        }
+
+        be->ir_regs[off] = pick;
+    }
+}
+
+// homes for the params and slots (frame offsets below frame) used the most
+static err_t be_ra_ir_(backend_t* be, const ir_func_t* fn, size_t frame)
+{
+    size_t*       depth = (size_t*)mem_calloc(MEM_TAG_BACKEND, fn->block_count + 1, sizeof(size_t));
+    be_ra_cand_t* cands = (be_ra_cand_t*)mem_calloc(MEM_TAG_BACKEND, frame + 1, sizeof(be_ra_cand_t));
+
+    err_t rc = (depth && cands) ? be_ir_loop_depth_(fn, depth) : ERR_ALLOC;
+    if (rc != OK) { mem_free(depth); mem_free(cands); return rc; }
+
+    for (size_t off = 1; off < frame; ++off)
+    {
+        cands[off].home.offset = off;
+        cands[off].order       = off;
+        if (off <= fn->param_count) cands[off].type = fn->param_types[off - 1];
+    }
+
+    for (size_t bi = 0; bi < fn->block_count; ++bi)
+    {
+        const ir_block_t* b = &fn->blocks[bi];
+        if (!b->reachable) continue;
+
+        const size_t w = be_ra_weight_(depth[bi]);
+
+        for (size_t i = 0; i < b->inst_count; ++i)
+        {
+            const ir_id_t     id   = b->insts[i];
+            const ir_value_t* v    = &fn->values[id];
+            const size_t      slot = be->ir_slots[id];
+
+            if (slot) cands[slot].type = v->type;
+            if (v->op == IR_OP_CONST || v->op == IR_OP_PARAM || v->op == IR_OP_PHI) continue;
+            if (!slot && !be->ir_inline[id] && !ir_op_has_effect(v->op)) continue;
+
+            if (slot) cands[slot].weight += w;
+            for (size_t k = 0; k < v->arg_count; ++k) be_ra_ir_use_(be, cands, v->args[k], w);
+        }
+
+        for (size_t i = 0; i < b->copy_count; ++i)
+        {
+            if (be_ir_copy_is_nop_(be, &b->copies[i])) continue;
+
+            be_ra_ir_use_(be, cands, b->copies[i].src, w);
+            cands[be->ir_slots[b->copies[i].dst]].weight += w;
+        }
+
+        if ((b->term == IR_TERM_BR || b->term == IR_TERM_RET) && b->cond != IR_NONE)
+            be_ra_ir_use_(be, cands, b->cond, w);
+    }
+
+    be->ir_regs      = (unsigned*)mem_calloc(MEM_TAG_BACKEND, frame + 1, sizeof(unsigned));
+    be->ir_reg_count = be->ir_regs ? frame : 0;
+
+    be_bits_t* conflict = NULL;
+    if (be->ir_regs && frame * frame <= BE_RA_IR_MATRIX_MAX_BITS)
+        conflict = be_ra_ir_conflicts_(be, frame);
+
+    if (conflict)
+        be_ra_ir_pick_(be, cands + 1, (frame > 1) ? frame - 1 : 0, conflict, frame);
+    else
+    {
+        be_ra_pick_(be, cands + 1, (frame > 1) ? frame - 1 : 0, fn->param_count);
+        for (size_t i = 0; i < be->home_count && be->ir_regs; ++i)
+            be->ir_regs[be->homes[i].offset] = be->homes[i].reg;
+    }
+
+    mem_free(conflict);
+    mem_free(depth);
+    mem_free(cands);
+    return be->ir_regs ? OK : ERR_ALLOC;
+}
+
+// Reverse postorder, taken branch (then, loop body) visited last so that it
+// directly follows the branch and falls through, unless a profile says a
+// then skipped more often than run should move out of the way; loop tests
+// go to the bottom
+static size_t* be_ir_layout_(const ir_func_t* fn, size_t* out_count)
+{
+    size_t* order = (size_t*)mem_calloc(MEM_TAG_BACKEND, fn->block_count + 1, sizeof(size_t));
+    size_t* stack = (size_t*)mem_calloc(MEM_TAG_BACKEND, fn->block_count + 1, sizeof(size_t));
+    size_t* edge  = (size_t*)mem_calloc(MEM_TAG_BACKEND, fn->block_count + 1, sizeof(size_t));
+    char*   seen  = (char*)  mem_calloc(MEM_TAG_BACKEND, fn->block_count + 1, 1);
+
+    if (!order || !stack || !edge || !seen)
+    {
+        mem_free(order); mem_free(stack); mem_free(edge); mem_free(seen);
+        return NULL;
+    }
+
+    size_t post = fn->block_count;
+    size_t top  = 0;
+    stack[top++] = 0;
+    seen[0] = 1;
+
+    while (top > 0)
+    {
+        const size_t bi = stack[top - 1];
+        const ir_block_t* b = &fn->blocks[bi];
+        const size_t succ_count = (b->term == IR_TERM_BR) ? 2 : (b->term == IR_TERM_JMP) ? 1 : 0;
+
+        if (edge[bi] < succ_count)
+        {
+            // the edge the profile says is taken more often goes last instead
+            // when the other one is a single block jumping to it; a longer
+            // arm or a return would move its JMP onto the hot path
+            const ir_block_t* cold = (succ_count == 2) ? &fn->blocks[b->succ[0]] : NULL;
+            const int    flip = cold && b->weight[1] > b->weight[0] &&
+                                cold->term == IR_TERM_JMP && cold->succ[0] == b->succ[1];
+            const size_t e    = edge[bi]++;
+            const size_t s    = b->succ[flip ? e : succ_count - 1 - e];
+            if (!seen[s]) { seen[s] = 1; stack[top++] = s; }
+            continue;
+        }
+
+        order[--post] = bi;
+        top--;
+    }
+
+    // compact to the front
+    const size_t count = fn->block_count - post;
+    memmove(order, order + post, count * sizeof(size_t));
+
+    // Rotate loops: a header that ends in a branch goes behind the last
+    // block jumping back to it. The back edge falls through into the test,
+    // only entering the loop costs a JMP
+    size_t i = 0;
+    while (i < count)
+    {
+        const size_t h = order[i];
+        size_t latch_at = IR_NONE;
+
+        if (fn->blocks[h].term == IR_TERM_BR)
+            for (size_t j = i + 1; j < count; ++j)
+                if (fn->blocks[order[j]].term == IR_TERM_JMP && fn->blocks[order[j]].succ[0] == h)
+                    latch_at = j;
+
+        if (latch_at == IR_NONE)
+        {
+            ++i;
+            continue;
+        }
+
+        memmove(order + i, order + i + 1, (latch_at - i) * sizeof(size_t));
+        order[latch_at] = h;
+    }
+
+    mem_free(stack);
+    mem_free(edge);
+    mem_free(seen);
+
+    *out_count = count;
+    return order;
+}
+
+static err_t be_ir_func_(backend_t* be, const ir_func_t* fn)
+{
+    const func_meta_t* meta = be_find_func_(be, fn->name_id);
+    BE_CHECK(be, meta != NULL, NULL, "Internal: no metadata for function '%s'",
+             ast_name_cstr(be->tree, fn->name_id));
+    BE_CHECK(be, !fn->in_ssa, NULL, "Internal: IR of '%s' is still in SSA form",
+             ast_name_cstr(be->tree, fn->name_id));
+
+    be->cur_fn = meta;
+    be->ir_fn  = fn;
+
+    mem_free(be->fn_end_label);
+    be->fn_end_label = be_new_label_(be, "fn_end");
+
+    const size_t n = fn->value_count + 1;
+
+    mem_free(be->ir_slots);
+    mem_free(be->ir_inline);
+    mem_free(be->ir_regs);
+    be->ir_regs      = NULL;
+    be->ir_reg_count = 0;
+    be->ir_slots  = (size_t*)mem_calloc(MEM_TAG_BACKEND, n, sizeof(size_t));
+    be->ir_inline = (char*)  mem_calloc(MEM_TAG_BACKEND, n, 1);
+
+    size_t* scratch = (size_t*)mem_calloc(MEM_TAG_BACKEND, 4 * n, sizeof(size_t));
+
+    if (!be->fn_end_label || !be->ir_slots || !be->ir_inline || !scratch)
+    {
+        mem_free(scratch);
+        return ERR_ALLOC;
+    }
+
+    // uses, use_block, pos, prev_eff
+    const size_t frame = be_ir_assign_slots_(be, fn, scratch, scratch + n, scratch + 2 * n, scratch + 3 * n);
+    mem_free(scratch);
+
+    err_t rc = be_ra_ir_(be, fn, frame);
+    if (rc != OK) return rc;
+
+    LOG_DEBUG("Emitting function '%s' from IR: %zu params, %zu slots, %zu in registers",
+              ast_name_cstr(be->tree, meta->name_id), meta->param_count, frame - 1 - meta->param_count,
+              be->home_count);
+
+    rc = be_emit_prologue_(be, meta, frame);
+    if (rc != OK) return rc;
+
+    be->ir_label_base  = be->label_counter;
+    be->label_counter += fn->block_count;
+
+    size_t order_count = 0;
+    size_t* order = be_ir_layout_(fn, &order_count);
+    if (!order) return ERR_ALLOC;
+
+    for (size_t i = 0; i < order_count && rc == OK; ++i)
+    {
+        const size_t next = (i + 1 < order_count) ? order[i + 1] : IR_NONE;
+
+        be_emitf_(be, ":L_bb_%zu\n", be->ir_label_base + order[i]);
+        rc = be_ir_block_(be, &fn->blocks[order[i]], next);
+    }
+
+    mem_free(order);
+    if (rc != OK) return rc;
+
+    be_emit_epilogue_(be);
+    return OK;
+}
+
+err_t backend_emit_asm_ir(const ir_module_t* module, operational_data_t* op_data, const backend_config_t* cfg)
+{
+    if (!module || !module->tree || !module->tree->root || !op_data) return ERR_BAD_ARG;
+
+    backend_t be = { 0 };
+
+    err_t rc = be_setup_(&be, module->tree, op_data, cfg);
+    if (rc == OK)
+        rc = be_emit_entry_(&be, module->tree->root);
+    if (rc == OK)
+        rc = be_flush_(&be);
+
+    for (size_t i = 0; i < module->func_count && rc == OK; ++i)
+    {
+        rc = be_ir_func_(&be, &module->funcs[i]);
+        be_emitf_(&be, "\n");
+        if (rc == OK)
+            rc = be_flush_(&be);
+    }
+
+    be_cleanup_(&be, cfg);
+    return rc;
+}
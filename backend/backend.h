@@ -3,6 +3,8 @@
 
 #include "../ast/ast.h"
 #include "../libs/io/io.h"
+#include "../ir/ir.h"
+#include "peephole.h"
 
 typedef enum
 {
@@ -12,8 +14,28 @@ typedef enum
     REG_TMPA  = 13,  // x13 - temp address register for PUSHM/POPM
     REG_RET_F = 0,   // fx0 - float return
     REG_TMP_F = 1,   // fx1 scratch temp
+
+    REG_VAR_I_FIRST = 1,   // x1..x12 hold the locals and params the allocator picks
+    REG_VAR_I_LAST  = 12,
+    REG_VAR_F_FIRST = 2,   // fx2..fx7 the same for floats
+    REG_VAR_F_LAST  = 7,
 } reserved_regs_t;
 
+#define BE_REG_FLOAT 0x100u  // marks an fx register in a home
+#define BE_HOME_MAX  ((REG_VAR_I_LAST - REG_VAR_I_FIRST + 1) + (REG_VAR_F_LAST - REG_VAR_F_FIRST + 1))
+
+/*
+    A variable kept in a register instead of its frame slot. Registers are
+    callee-saved: a function pushes the ones it takes on the operand stack
+    on entry and pops them before RET
+*/
+typedef struct
+{
+    unsigned          reg;     // x register, fx with BE_REG_FLOAT
+    size_t            offset;  // BP offset of a param or IR slot it stands for, 0 = none
+    const ast_node_t* decl;    // VAR_DECL it holds on the AST path
+} be_home_t;
+
 typedef struct 
 {
     size_t     name_id;
@@ -23,6 +45,9 @@ typedef struct
     size_t      param_count;
     ast_type_t* param_types; // param_count items
     size_t      local_count; // number of VAR_DECL inside body
+
+    size_t      memo_bound;  // params in [0, bound) go through a table, 0 = none
+    size_t      memo_base;   // RAM address of the table, (done, value) per entry
 } func_meta_t;
 
 typedef struct binding_t
@@ -31,6 +56,7 @@ typedef struct binding_t
     ast_type_t type;
     size_t     offset;   // offset relative to BP (0 = saved BP, 1..params..locals)
     size_t     depth;    // scope depth where introduced
+    unsigned   reg;      // register holding it instead, 0 = none
 } binding_t;
 
 typedef struct 
@@ -38,6 +64,12 @@ typedef struct
     char* end_label;
 } loop_ctx_t;
 
+typedef struct
+{
+    const ast_node_t* node;
+    size_t            counter;   // first counter of the site
+} prof_site_t;
+
 typedef struct
 {
     const ast_tree_t*   tree;
@@ -61,10 +93,65 @@ typedef struct
     const func_meta_t* cur_fn;
     size_t             next_local_offset; 
     char*              fn_end_label;
+
+    size_t             memo_end;         // RAM below it holds the memo tables, then counters and the stack
+    size_t             memo_slot;        // BP offset of the entry address, 0 = not memoized
+
+    be_home_t          homes[BE_HOME_MAX];   // registers the current function takes
+    size_t             home_count;
+    char*              memo_done_label;
+
+    prof_site_t* prof_sites;         // sorted by node, NULL when not instrumenting
+    size_t       prof_site_count;
+    size_t       prof_counters;
+    size_t       prof_hash;
+    size_t       prof_base;          // RAM address of counter 0
+
+    const ir_func_t* ir_fn;
+    size_t*          ir_slots;       // value -> BP offset, 0 = no slot
+    char*            ir_inline;      // value is computed on the stack at its single use
+    unsigned*        ir_regs;        // BP offset -> register, 0 = stays in the frame
+    size_t           ir_reg_count;   // offsets ir_regs covers, 0 on the AST path
+    size_t           ir_label_base;  // block b is :L_bb_<base + b>
+
+    char*            out;            // text of the unit being emitted, written out by be_flush_
+    size_t           out_len;
+    size_t           out_cap;
+    err_t            out_rc;         // the buffer could not grow
+
+    int              peephole;
+    peep_t           peep;
+    peep_report_t    peep_report;
 } backend_t;
 
+typedef struct
+{
+    int            peephole;   // run peep_run over the entry and every function before writing them
+    peep_report_t* report;     // filled with the peephole counts, may be NULL
+} backend_config_t;
+
 #define BE_SCREEN_WIDTH 128
 
-err_t backend_emit_asm(const ast_tree_t* tree, operational_data_t* op_data);
+void  backend_config_default(backend_config_t* cfg);
+
+/*
+    Emit straight from the AST. Expression types are read from
+    ast_node_t.type, run ast_annotate_types first. cfg NULL means defaults
+*/
+err_t backend_emit_asm(const ast_tree_t* tree, operational_data_t* op_data, const backend_config_t* cfg);
+
+/*
+    backend_emit_asm with a counter in RAM for every profile site (see
+    ast_profile_sites), printed when main returns. The output of a run is
+    a profile for the middle-end and backend
+*/
+err_t backend_emit_asm_instrumented(const ast_tree_t* tree, operational_data_t* op_data, const backend_config_t* cfg);
+
+/*
+    Emit from IR out of SSA form (ir_out_of_ssa). Phis and values used more
+    than once or in another block get a frame slot, the rest is evaluated
+    on the stack at its single use
+*/
+err_t backend_emit_asm_ir(const ir_module_t* module, operational_data_t* op_data, const backend_config_t* cfg);
 
 #endif
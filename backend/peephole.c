@@ -0,0 +1,691 @@
+#include "peephole.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../libs/hash/hash.h"
+#include "../libs/memory/memory.h"
+
+#define PEEP_MAX_ROUNDS 8
+#define PEEP_THREAD_MAX 16   // JMPs followed from one jump
+#define PEEP_SCAN_MAX   64   // instructions looked at to prove a register dead
+#define PEEP_OPS_CAP    256
+
+enum
+{
+    PEEP_INSN,
+    PEEP_LABEL,
+    PEEP_NOTE,               // comment or blank line
+};
+
+typedef int (*peep_rule_fn_t)(peep_t* pp, const size_t* w, size_t wn);
+
+// ================================ mnemonics =================================
+
+typedef struct
+{
+    const char*     name;
+    size_t          len;
+    instruction_set op;
+} peep_op_t;
+
+// mnemonic hash over the instruction table, built on first use. The hash
+// is folded in while a line is read, see peep_split_
+static peep_op_t peep_ops_[PEEP_OPS_CAP];
+static int       peep_ops_built_ = 0;
+
+#define PEEP_OP_HASH(h, c) ((h) * 33u + (unsigned char)(c))
+
+static void peep_ops_build_(void)
+{
+    if (peep_ops_built_) return;
+
+    const instruction_t* table = instruction_table();
+    for (size_t i = 0; i < instruction_table_size(); ++i)
+    {
+        if (!table[i].name) continue;
+
+        const size_t len = strlen(table[i].name);
+        size_t h = 0;
+        for (size_t k = 0; k < len; ++k) h = PEEP_OP_HASH(h, table[i].name[k]);
+
+        h &= PEEP_OPS_CAP - 1;
+        while (peep_ops_[h].name) h = (h + 1) & (PEEP_OPS_CAP - 1);
+
+        peep_ops_[h] = (peep_op_t){ table[i].name, len, table[i].id };
+    }
+    peep_ops_built_ = 1;
+}
+
+static instruction_set peep_op_(const char* s, size_t len, size_t h)
+{
+    for (h &= PEEP_OPS_CAP - 1; peep_ops_[h].name; h = (h + 1) & (PEEP_OPS_CAP - 1))
+        if (peep_ops_[h].len == len && memcmp(peep_ops_[h].name, s, len) == 0)
+            return peep_ops_[h].op;
+    return UNDEF;
+}
+
+static int peep_is_jump_(instruction_set op)
+{
+    switch (op)
+    {
+        case JMP: case JB: case JBE: case JA: case JAE: case JE: case JNE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static unsigned peep_at_(instruction_set op)
+{
+    switch (op)
+    {
+        case JMP:                    return PEEP_AT_JUMP | PEEP_AT_END;
+        case RET: case HLT:          return PEEP_AT_END;
+        case PUSH: case PUSHR:
+        case FPUSHR: case PUSHM:     return PEEP_AT_PUSH;
+        case POPR: case FPOPR:       return PEEP_AT_POPR;
+        case TOPOUT: case FTOPOUT:   return PEEP_AT_OUT;
+        default:                     return peep_is_jump_(op) ? PEEP_AT_JUMP : 0;
+    }
+}
+
+static instruction_set peep_invert_(instruction_set op)
+{
+    switch (op)
+    {
+        case JB:  return JAE;
+        case JAE: return JB;
+        case JBE: return JA;
+        case JA:  return JBE;
+        case JE:  return JNE;
+        case JNE: return JE;
+        default:  return UNDEF;
+    }
+}
+
+// ================================== lines ===================================
+
+// one line from p on: kind, mnemonic and operand. Returns the end of the line
+static char* peep_parse_(peep_t* pp, peep_line_t* ln, char* p)
+{
+    char* e = p;
+
+    if (*p == ':')
+    {
+        ln->kind = PEEP_LABEL;
+        ln->at   = PEEP_AT_LABEL;
+        pp->label_count++;
+    }
+    else if (*p != '\n' && *p != '\0' && *p != ';')
+    {
+        ln->kind = PEEP_INSN;
+        pp->live++;
+
+        size_t h = 0;
+        while (*e && *e != '\n' && *e != ' ' && *e != '\t') { h = PEEP_OP_HASH(h, *e); ++e; }
+        ln->op = peep_op_(p, (size_t)(e - p), h);
+        ln->at = (unsigned char)peep_at_(ln->op);
+
+        while (*e == ' ' || *e == '\t') ++e;
+        if (*e && *e != '\n') ln->arg = e;
+    }
+
+    while (*e && *e != '\n') ++e;
+    if (ln->arg) ln->arg_len = (size_t)(e - ln->arg);
+    return e;
+}
+
+static err_t peep_split_(peep_t* pp, char* text, size_t len)
+{
+    pp->line_count  = 0;
+    pp->label_count = 0;
+    pp->live        = 0;
+
+    char* const end = text + len;
+    *end = '\0';
+
+    for (char* p = text; p < end; )
+    {
+        if (pp->line_count == pp->line_cap)
+        {
+            const size_t cap = pp->line_cap ? pp->line_cap * 2 : 256;
+            peep_line_t* lines = (peep_line_t*)mem_realloc(MEM_TAG_BACKEND, pp->lines, cap * sizeof(peep_line_t));
+            if (!lines) return ERR_ALLOC;
+            pp->lines    = lines;
+            pp->line_cap = cap;
+        }
+
+        peep_line_t* ln = &pp->lines[pp->line_count++];
+        *ln = (peep_line_t){ .text = p, .slot = SIZE_MAX, .op = UNDEF, .kind = PEEP_NOTE };
+
+        char* e = peep_parse_(pp, ln, p);
+        ln->len = (size_t)(e - p);
+        *e = '\0';
+        p = e + 1;
+    }
+    return OK;
+}
+
+// ================================== labels ==================================
+
+static size_t peep_find_(const peep_t* pp, const char* name, size_t len)
+{
+    const size_t mask = pp->index_cap - 1;
+    for (size_t h = sdbm_n(name, len) & mask; pp->index[h]; h = (h + 1) & mask)
+    {
+        const peep_label_t* lb = &pp->labels[pp->index[h] - 1];
+        if (pp->lines[lb->at].len == len && memcmp(lb->name, name, len) == 0)
+            return pp->index[h] - 1;
+    }
+    return SIZE_MAX;
+}
+
+static err_t peep_labels_(peep_t* pp)
+{
+    if (pp->label_count > pp->label_cap)
+    {
+        peep_label_t* labels = (peep_label_t*)mem_realloc(MEM_TAG_BACKEND, pp->labels, pp->label_count * sizeof(peep_label_t));
+        if (!labels) return ERR_ALLOC;
+        pp->labels    = labels;
+        pp->label_cap = pp->label_count;
+    }
+
+    size_t cap = 16;
+    while (cap < 2 * pp->label_count) cap *= 2;
+    if (cap > pp->index_cap)
+    {
+        size_t* index = (size_t*)mem_realloc(MEM_TAG_BACKEND, pp->index, cap * sizeof(size_t));
+        if (!index) return ERR_ALLOC;
+        pp->index     = index;
+        pp->index_cap = cap;
+    }
+    memset(pp->index, 0, pp->index_cap * sizeof(size_t));
+
+    size_t count = 0;
+    for (size_t i = 0; i < pp->line_count; ++i)
+    {
+        peep_line_t* ln = &pp->lines[i];
+        if (ln->kind != PEEP_LABEL) continue;
+
+        // a name defined twice keeps the first, its jumps are left alone
+        if (peep_find_(pp, ln->text, ln->len) != SIZE_MAX) continue;
+
+        pp->labels[count] = (peep_label_t){ ln->text, i, 0 };
+        ln->slot = count++;
+
+        size_t h = sdbm_n(ln->text, ln->len) & (pp->index_cap - 1);
+        while (pp->index[h]) h = (h + 1) & (pp->index_cap - 1);
+        pp->index[h] = count;
+    }
+    pp->label_count = count;
+
+    for (size_t i = 0; i < pp->line_count; ++i)
+    {
+        peep_line_t* ln = &pp->lines[i];
+        if (ln->kind != PEEP_INSN || !ln->arg || (!peep_is_jump_(ln->op) && ln->op != CALL)) continue;
+
+        ln->slot = peep_find_(pp, ln->arg, ln->arg_len);
+        if (ln->slot != SIZE_MAX) pp->labels[ln->slot].refs++;
+    }
+    return OK;
+}
+
+// ================================= helpers ==================================
+
+// first line from i on that is still there and not a comment, SIZE_MAX at the end
+static size_t peep_next_(const peep_t* pp, size_t i)
+{
+    for (; i < pp->line_count; ++i)
+        if (!pp->lines[i].dead && pp->lines[i].kind != PEEP_NOTE) return i;
+    return SIZE_MAX;
+}
+
+// the instruction control reaches from line i on, past labels
+static size_t peep_next_insn_(const peep_t* pp, size_t i)
+{
+    for (i = peep_next_(pp, i); i != SIZE_MAX; i = peep_next_(pp, i + 1))
+        if (pp->lines[i].kind == PEEP_INSN) return i;
+    return SIZE_MAX;
+}
+
+static size_t peep_window_(const peep_t* pp, size_t i, size_t* w)
+{
+    size_t n = 0;
+    for (; i != SIZE_MAX && n < PEEP_WINDOW_MAX; i = peep_next_(pp, i + 1)) w[n++] = i;
+    return n;
+}
+
+static int peep_is_(const peep_t* pp, size_t i, instruction_set op)
+{
+    return pp->lines[i].kind == PEEP_INSN && pp->lines[i].op == op;
+}
+
+static int peep_arg_is_(const peep_line_t* ln, const char* s)
+{
+    return ln->arg && ln->arg_len == strlen(s) && memcmp(ln->arg, s, ln->arg_len) == 0;
+}
+
+static int peep_same_arg_(const peep_line_t* a, const peep_line_t* b)
+{
+    return a->arg && b->arg && a->arg_len == b->arg_len && memcmp(a->arg, b->arg, a->arg_len) == 0;
+}
+
+// last line before i that is still there and not a comment, SIZE_MAX at the start
+static size_t peep_prev_(const peep_t* pp, size_t i)
+{
+    while (i-- > 0)
+        if (!pp->lines[i].dead && pp->lines[i].kind != PEEP_NOTE) return i;
+    return SIZE_MAX;
+}
+
+// a label behind the scan nothing jumps to any more takes another round to drop
+static void peep_unref_(peep_t* pp, size_t slot)
+{
+    if (--pp->labels[slot].refs == 0 && pp->labels[slot].at < pp->pos) pp->again = 1;
+}
+
+static void peep_kill_(peep_t* pp, size_t i)
+{
+    peep_line_t* ln = &pp->lines[i];
+    if (ln->dead) return;
+
+    ln->dead = 1;
+    if (ln->kind != PEEP_INSN) return;
+
+    pp->live--;
+    if (ln->slot != SIZE_MAX) peep_unref_(pp, ln->slot);
+
+    // L: now starts with a JMP, jumps to L already passed can skip it
+    const size_t next = peep_next_insn_(pp, i + 1);
+    if (next != SIZE_MAX && pp->lines[next].op == JMP)
+    {
+        const size_t prev = peep_prev_(pp, i);
+        if (prev != SIZE_MAX && pp->lines[prev].kind == PEEP_LABEL) pp->again = 1;
+    }
+}
+
+static void peep_retarget_(peep_t* pp, size_t i, size_t slot)
+{
+    peep_line_t* ln = &pp->lines[i];
+    pp->labels[slot].refs++;
+    if (ln->slot != SIZE_MAX) peep_unref_(pp, ln->slot);
+
+    ln->slot    = slot;
+    ln->arg     = pp->labels[slot].name;
+    ln->arg_len = pp->lines[pp->labels[slot].at].len;
+    ln->changed = 1;
+}
+
+// reg is written before anything reads it, without leaving the block
+static int peep_reg_dead_(const peep_t* pp, size_t i, const peep_line_t* reg)
+{
+    size_t n = 0;
+    for (i = peep_next_(pp, i + 1); i != SIZE_MAX && n < PEEP_SCAN_MAX; i = peep_next_(pp, i + 1), ++n)
+    {
+        const peep_line_t* ln = &pp->lines[i];
+        if (ln->kind == PEEP_LABEL) return 0;
+
+        switch (ln->op)
+        {
+            case CALL: case RET: case HLT: case UNDEF:
+                return 0;
+            default:
+                if (peep_is_jump_(ln->op)) return 0;
+                break;
+        }
+
+        if (peep_same_arg_(ln, reg)) return ln->op == POPR || ln->op == FPOPR;
+    }
+    return 0;
+}
+
+// ================================== rules ===================================
+
+// nothing after JMP, RET or HLT runs before the next label
+static int rule_unreachable_(peep_t* pp, const size_t* w, size_t wn)
+{
+    unused(wn);
+    if (!peep_is_(pp, w[0], JMP) && !peep_is_(pp, w[0], RET) && !peep_is_(pp, w[0], HLT)) return 0;
+
+    int fired = 0;
+    for (size_t i = peep_next_(pp, w[0] + 1); i != SIZE_MAX && pp->lines[i].kind != PEEP_LABEL; i = peep_next_(pp, i + 1))
+    {
+        peep_kill_(pp, i);
+        fired = 1;
+    }
+    return fired;
+}
+
+// JMP L right before L
+static int rule_jump_next_(peep_t* pp, const size_t* w, size_t wn)
+{
+    if (!peep_is_(pp, w[0], JMP) || pp->lines[w[0]].slot == SIZE_MAX) return 0;
+
+    for (size_t k = 1; k < wn && pp->lines[w[k]].kind == PEEP_LABEL; ++k)
+        if (pp->lines[w[k]].slot == pp->lines[w[0]].slot)
+        {
+            peep_kill_(pp, w[0]);
+            return 1;
+        }
+    return 0;
+}
+
+// Jcc A / JMP B / A:  ->  J!cc B / A:
+static int rule_branch_over_(peep_t* pp, const size_t* w, size_t wn)
+{
+    const peep_line_t* jcc = &pp->lines[w[0]];
+    const peep_line_t* jmp = &pp->lines[w[1]];
+    if (jcc->kind != PEEP_INSN || peep_invert_(jcc->op) == UNDEF || jcc->slot == SIZE_MAX) return 0;
+    if (!peep_is_(pp, w[1], JMP) || jmp->slot == SIZE_MAX) return 0;
+
+    for (size_t k = 2; k < wn && pp->lines[w[k]].kind == PEEP_LABEL; ++k)
+        if (pp->lines[w[k]].slot == jcc->slot)
+        {
+            pp->lines[w[0]].op = peep_invert_(jcc->op);
+            peep_retarget_(pp, w[0], jmp->slot);
+            peep_kill_(pp, w[1]);
+            return 1;
+        }
+    return 0;
+}
+
+// a jump to L: JMP M goes to where the chain of JMPs ends. A chain that
+// runs in a circle ends after PEEP_THREAD_MAX hops, the same place each time
+static int rule_jump_thread_(peep_t* pp, const size_t* w, size_t wn)
+{
+    unused(wn);
+    const peep_line_t* ln = &pp->lines[w[0]];
+    if (ln->kind != PEEP_INSN || !peep_is_jump_(ln->op) || ln->slot == SIZE_MAX) return 0;
+
+    size_t to = ln->slot;
+    for (size_t hop = 0; hop < PEEP_THREAD_MAX; ++hop)
+    {
+        const size_t t = peep_next_insn_(pp, pp->labels[to].at + 1);
+        if (t == SIZE_MAX || t == w[0] || !peep_is_(pp, t, JMP) || pp->lines[t].slot == SIZE_MAX) break;
+        to = pp->lines[t].slot;
+    }
+    if (to == ln->slot) return 0;
+
+    peep_retarget_(pp, w[0], to);
+    return 1;
+}
+
+// labels nothing jumps to, so the blocks around them become one
+static int rule_dead_label_(peep_t* pp, const size_t* w, size_t wn)
+{
+    unused(wn);
+    const peep_line_t* ln = &pp->lines[w[0]];
+    if (ln->kind != PEEP_LABEL || ln->slot == SIZE_MAX || pp->labels[ln->slot].refs != 0) return 0;
+    if (strncmp(ln->text, ":L_", 3) != 0) return 0;
+
+    peep_kill_(pp, w[0]);
+    return 1;
+}
+
+// a value pushed and dropped right away
+static int rule_push_pop_(peep_t* pp, const size_t* w, size_t wn)
+{
+    unused(wn);
+    if (!peep_is_(pp, w[1], POP)) return 0;
+
+    switch (pp->lines[w[0]].kind == PEEP_INSN ? pp->lines[w[0]].op : UNDEF)
+    {
+        case PUSH: case PUSHR: case FPUSHR: case PUSHM:
+            peep_kill_(pp, w[0]);
+            peep_kill_(pp, w[1]);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// x + 0, x - 0, x * 1, x / 1 and the like on ints
+static int rule_identity_(peep_t* pp, const size_t* w, size_t wn)
+{
+    unused(wn);
+    if (!peep_is_(pp, w[0], PUSH) || pp->lines[w[1]].kind != PEEP_INSN) return 0;
+
+    const peep_line_t* k = &pp->lines[w[0]];
+    int hit = 0;
+    switch (pp->lines[w[1]].op)
+    {
+        case ADD: case SUB: case OR: case XOR: case SHL: case SHR:
+            hit = peep_arg_is_(k, "0");
+            break;
+        case MUL: case DIV:
+            hit = peep_arg_is_(k, "1");
+            break;
+        default:
+            break;
+    }
+    if (!hit) return 0;
+
+    peep_kill_(pp, w[0]);
+    peep_kill_(pp, w[1]);
+    return 1;
+}
+
+// TOPOUT / POP  ->  OUT
+static int rule_out_pop_(peep_t* pp, const size_t* w, size_t wn)
+{
+    unused(wn);
+    if (!peep_is_(pp, w[1], POP)) return 0;
+
+    peep_line_t* ln = &pp->lines[w[0]];
+    if      (peep_is_(pp, w[0], TOPOUT))  ln->op = OUT;
+    else if (peep_is_(pp, w[0], FTOPOUT)) ln->op = FOUT;
+    else return 0;
+
+    ln->changed = 1;
+    peep_kill_(pp, w[1]);
+    return 1;
+}
+
+// (F)POPR r / (F)PUSHR r with r of the matching kind
+static int peep_reload_(const peep_t* pp, size_t pop, size_t push)
+{
+    const peep_line_t* a = &pp->lines[pop];
+    const peep_line_t* b = &pp->lines[push];
+    if (a->kind != PEEP_INSN || b->kind != PEEP_INSN || !peep_same_arg_(a, b)) return 0;
+
+    return (a->op == POPR && b->op == PUSHR) || (a->op == FPOPR && b->op == FPUSHR);
+}
+
+// X / POPR t / PUSHR t / PUSHR t  ->  X / X when t is dead and X only reads
+static int rule_copy_twice_(peep_t* pp, const size_t* w, size_t wn)
+{
+    unused(wn);
+    const peep_line_t* src = &pp->lines[w[0]];
+    if (src->kind != PEEP_INSN) return 0;
+
+    switch (src->op)
+    {
+        case PUSH: case PUSHR: case FPUSHR: case PUSHM: break;
+        default: return 0;
+    }
+
+    if (!peep_reload_(pp, w[1], w[2]) || !peep_reload_(pp, w[1], w[3])) return 0;
+    if (!peep_reg_dead_(pp, w[3], &pp->lines[w[1]])) return 0;
+
+    peep_line_t* dup = &pp->lines[w[2]];
+    dup->op      = src->op;
+    dup->arg     = src->arg;
+    dup->arg_len = src->arg_len;
+    dup->changed = 1;
+
+    peep_kill_(pp, w[1]);
+    peep_kill_(pp, w[3]);
+    return 1;
+}
+
+// POPR r / PUSHR r when nothing reads r before it is written again
+static int rule_save_reload_(peep_t* pp, const size_t* w, size_t wn)
+{
+    unused(wn);
+    if (!peep_reload_(pp, w[0], w[1]) || !peep_reg_dead_(pp, w[1], &pp->lines[w[0]])) return 0;
+
+    peep_kill_(pp, w[0]);
+    peep_kill_(pp, w[1]);
+    return 1;
+}
+
+static const struct
+{
+    peep_rule_fn_t fn;
+    size_t         window;
+    unsigned       at;
+} peep_rules_[PEEP_RULE_COUNT] = {
+#define PEEP_RULE_ENTRY(sym, str, fn, window, at) [sym] = { fn, window, at },
+    PEEP_RULE_LIST(PEEP_RULE_ENTRY)
+#undef PEEP_RULE_ENTRY
+};
+
+static const char* const peep_rule_names_[PEEP_RULE_COUNT] = {
+#define PEEP_RULE_NAME(sym, str, fn, window, at) [sym] = str,
+    PEEP_RULE_LIST(PEEP_RULE_NAME)
+#undef PEEP_RULE_NAME
+};
+
+// ================================== output ==================================
+
+// untouched lines go out as they are, a run of them in one write
+static void peep_write_(peep_t* pp, FILE* out)
+{
+    const char* run = NULL;
+    size_t      run_len = 0;
+
+    for (size_t i = 0; i < pp->line_count; ++i)
+    {
+        peep_line_t* ln = &pp->lines[i];
+
+        if (!ln->dead && !ln->changed)
+        {
+            if (!run) run = ln->text;
+            ln->text[ln->len] = '\n';
+            run_len += ln->len + 1;
+            continue;
+        }
+
+        if (run) fwrite(run, 1, run_len, out);
+        run = NULL;
+        run_len = 0;
+
+        if (ln->dead) continue;
+
+        const instruction_t* meta = instruction_get(ln->op);
+        if (ln->arg)
+            fprintf(out, "%s %.*s\n", meta->name, (int)ln->arg_len, ln->arg);
+        else
+            fprintf(out, "%s\n", meta->name);
+    }
+
+    if (run) fwrite(run, 1, run_len, out);
+}
+
+// the first rule that fires at line i, PEEP_RULE_COUNT when none does
+static size_t peep_try_(peep_t* pp, size_t i, peep_report_t* report)
+{
+    const unsigned at = pp->lines[i].at;
+    if (!at) return PEEP_RULE_COUNT;
+
+    size_t w[PEEP_WINDOW_MAX];
+    const size_t wn = peep_window_(pp, i, w);
+
+    for (size_t r = 0; r < PEEP_RULE_COUNT; ++r)
+    {
+        if (!(peep_rules_[r].at & at) || wn < peep_rules_[r].window) continue;
+
+        const size_t live = pp->live;
+        if (!peep_rules_[r].fn(pp, w, wn)) continue;
+
+        if (report)
+        {
+            report->hits[r]++;
+            report->removed[r] += live - pp->live;
+        }
+        return r;
+    }
+    return PEEP_RULE_COUNT;
+}
+
+// after a rewrite at i, the first line of a window that could now match through it
+static size_t peep_back_(const peep_t* pp, size_t i)
+{
+    size_t from = i;
+    for (size_t n = 0; i > 0 && n < PEEP_WINDOW_MAX - 1; )
+    {
+        --i;
+        if (pp->lines[i].dead || pp->lines[i].kind == PEEP_NOTE) continue;
+        from = i;
+        ++n;
+    }
+    return peep_next_(pp, from);
+}
+
+err_t peep_run(peep_t* pp, char* text, size_t len, FILE* out, peep_report_t* report)
+{
+    if (!pp || !text || !out) return ERR_BAD_ARG;
+
+    peep_ops_build_();
+
+    err_t rc = peep_split_(pp, text, len);
+    if (rc == OK) rc = peep_labels_(pp);
+    if (rc != OK) return rc;
+
+    const size_t before = pp->live;
+    size_t rounds = 0;
+
+    // rules look back a window after they fire, a round is repeated only for
+    // what changed behind the scan
+    pp->again = 1;
+    for (; pp->again && rounds < PEEP_MAX_ROUNDS; ++rounds)
+    {
+        pp->again = 0;
+        for (size_t i = peep_next_(pp, 0); i != SIZE_MAX; )
+        {
+            pp->pos = i;
+            if (peep_try_(pp, i, report) == PEEP_RULE_COUNT)
+                i = peep_next_(pp, i + 1);
+            else
+                i = peep_back_(pp, i);
+        }
+    }
+
+    if (report)
+    {
+        report->insns_in  += before;
+        report->insns_out += pp->live;
+        if (rounds > report->rounds) report->rounds = rounds;
+    }
+
+    peep_write_(pp, out);
+    return OK;
+}
+
+void peep_dtor(peep_t* pp)
+{
+    if (!pp) return;
+
+    mem_free(pp->lines);
+    mem_free(pp->labels);
+    mem_free(pp->index);
+    memset(pp, 0, sizeof(*pp));
+}
+
+void peep_report_print(FILE* out, const peep_report_t* report)
+{
+    if (!out || !report) return;
+
+    size_t hits = 0;
+    fprintf(out, "%-16s %12s %12s\n", "peephole", "hits", "removed");
+    for (size_t i = 0; i < PEEP_RULE_COUNT; ++i)
+    {
+        hits += report->hits[i];
+        if (report->hits[i] == 0) continue;
+        fprintf(out, "%-16s %12zu %12zu\n", peep_rule_names_[i], report->hits[i], report->removed[i]);
+    }
+    fprintf(out, "%-16s %12zu %12zu\n", "total", hits, report->insns_in - report->insns_out);
+    fprintf(out, "%-16s %12zu -> %zu\n", "instructions", report->insns_in, report->insns_out);
+    fprintf(out, "%-16s %12zu\n", "rounds", report->rounds);
+}
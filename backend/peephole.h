@@ -0,0 +1,110 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "../libs/types.h"
+#include "../libs/instruction_set/instruction_set.h"
+
+/*
+    Peephole rules in the order they are tried at each line: the number of
+    lines a rule needs in its window and the kinds of line it starts on.
+    The window holds the next PEEP_WINDOW_MAX instructions and labels,
+    comments are skipped. Only the jump rules look past a label, so nothing
+    is moved or merged across a place another jump can land
+*/
+#define PEEP_WINDOW_MAX 4
+
+#define PEEP_AT_LABEL 1u
+#define PEEP_AT_JUMP  2u    // JMP and the conditional jumps
+#define PEEP_AT_END   4u    // JMP, RET, HLT
+#define PEEP_AT_PUSH  8u    // PUSH, PUSHR, FPUSHR, PUSHM
+#define PEEP_AT_POPR  16u   // POPR, FPOPR
+#define PEEP_AT_OUT   32u   // TOPOUT, FTOPOUT
+
+#define PEEP_RULE_LIST(X)                                                               \
+    X(PEEP_UNREACHABLE,  "unreachable",  rule_unreachable_,  1, PEEP_AT_END)            \
+    X(PEEP_JUMP_NEXT,    "jump-next",    rule_jump_next_,    2, PEEP_AT_JUMP)           \
+    X(PEEP_BRANCH_OVER,  "branch-over",  rule_branch_over_,  3, PEEP_AT_JUMP)           \
+    X(PEEP_JUMP_THREAD,  "jump-thread",  rule_jump_thread_,  1, PEEP_AT_JUMP)           \
+    X(PEEP_DEAD_LABEL,   "dead-label",   rule_dead_label_,   1, PEEP_AT_LABEL)          \
+    X(PEEP_PUSH_POP,     "push-pop",     rule_push_pop_,     2, PEEP_AT_PUSH)           \
+    X(PEEP_IDENTITY,     "identity",     rule_identity_,     2, PEEP_AT_PUSH)           \
+    X(PEEP_OUT_POP,      "out-pop",      rule_out_pop_,      2, PEEP_AT_OUT)            \
+    X(PEEP_COPY_TWICE,   "copy-twice",   rule_copy_twice_,   4, PEEP_AT_PUSH)           \
+    X(PEEP_SAVE_RELOAD,  "save-reload",  rule_save_reload_,  2, PEEP_AT_POPR)
+
+typedef enum
+{
+#define PEEP_RULE_ENUM(sym, str, fn, window, at) sym,
+    PEEP_RULE_LIST(PEEP_RULE_ENUM)
+#undef PEEP_RULE_ENUM
+
+    PEEP_RULE_COUNT
+} peep_rule_t;
+
+typedef struct
+{
+    size_t hits   [PEEP_RULE_COUNT];
+    size_t removed[PEEP_RULE_COUNT];   // instructions, labels do not count
+
+    size_t insns_in;
+    size_t insns_out;
+    size_t rounds;                     // most any unit took to settle
+} peep_report_t;
+
+typedef struct
+{
+    char*           text;     // the line without its newline
+    const char*     arg;      // operand, NULL when none
+    size_t          arg_len;
+    size_t          len;
+    size_t          slot;     // label, or the label a jump goes to, SIZE_MAX = none
+    instruction_set op;       // UNDEF for labels, comments and unknown mnemonics
+    unsigned char   kind;
+    unsigned char   at;       // PEEP_AT_* the line counts as
+    unsigned char   dead;
+    unsigned char   changed;  // written back as op and arg
+} peep_line_t;
+
+typedef struct
+{
+    const char* name;
+    size_t      at;           // line of the label
+    size_t      refs;         // jumps and calls in the unit that name it
+} peep_label_t;
+
+// scratch reused from one unit to the next
+typedef struct
+{
+    peep_line_t*  lines;
+    size_t        line_count;
+    size_t        line_cap;
+
+    peep_label_t* labels;
+    size_t        label_count;
+    size_t        label_cap;
+
+    size_t*       index;      // label hash, slot + 1, 0 = empty
+    size_t        index_cap;
+
+    size_t        live;       // instructions not removed
+    size_t        pos;        // line the scan is at
+    int           again;      // a change behind pos needs another round
+} peep_t;
+
+/*
+    Rewrite one unit of assembly text and write what is left to out.
+    Jumps only go to labels of the same unit, labels other than :L_ ones
+    are kept. text[len] must be writable, the text is changed in place.
+    Counts are added to report, which may be NULL
+*/
+err_t peep_run(peep_t* pp, char* text, size_t len, FILE* out, peep_report_t* report);
+
+void  peep_dtor(peep_t* pp);
+
+// hits and removed instructions per rule, then the totals
+void  peep_report_print(FILE* out, const peep_report_t* report);
+
+#endif
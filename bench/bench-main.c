@@ -0,0 +1,399 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "libs/types.h"
+#include "libs/logging/logging.h"
+#include "libs/io/io.h"
+#include "libs/memory/memory.h"
+
+#include "lexer/lexer.h"
+#include "ast/ast.h"
+#include "ast/syntax_analyzer.h"
+#include "middleend/middleend.h"
+#include "backend/backend.h"
+#include "bench/generator.h"
+
+#define BENCH_MAX_SIZES     32
+#define BENCH_DEFAULT_SIZES "1K,16K,256K,4M"
+
+#define BENCH_STAGE_LIST(X)           \
+    X(BENCH_GEN,       "generate")    \
+    X(BENCH_LEX,       "lex")         \
+    X(BENCH_PARSE,     "parse")       \
+    X(BENCH_EAST_OUT,  "east-write")  \
+    X(BENCH_EAST_IN,   "east-read")   \
+    X(BENCH_OPTIMIZE,  "optimize")    \
+    X(BENCH_EMIT,      "emit")
+
+typedef enum
+{
+#define BENCH_ENUM(sym, str) sym,
+    BENCH_STAGE_LIST(BENCH_ENUM)
+#undef BENCH_ENUM
+
+    BENCH_STAGE_COUNT
+} bench_stage_t;
+
+static const char* const bench_stage_names[BENCH_STAGE_COUNT] = {
+#define BENCH_NAME(sym, str) str,
+    BENCH_STAGE_LIST(BENCH_NAME)
+#undef BENCH_NAME
+};
+
+typedef struct
+{
+    size_t target;
+    size_t bytes;               // actual .rot size
+    size_t east_bytes;
+    size_t tokens;
+    size_t nodes;
+    double sec[BENCH_STAGE_COUNT]; // best of repeats
+} bench_result_t;
+
+static double now_sec_(void)
+{
+    struct timespec ts = { 0 };
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// "1K", "16M", "1G" -> bytes
+static size_t parse_size_(const char* str, const char** end)
+{
+    char* e = NULL;
+    unsigned long long v = strtoull(str, &e, 10);
+
+    switch (*e)
+    {
+        case 'k': case 'K': v <<= 10; ++e; break;
+        case 'm': case 'M': v <<= 20; ++e; break;
+        case 'g': case 'G': v <<= 30; ++e; break;
+        default: break;
+    }
+
+    if (end) *end = e;
+    return (size_t)v;
+}
+
+static size_t parse_size_list_(const char* str, size_t* sizes, size_t cap)
+{
+    size_t n = 0;
+    while (str && *str && n < cap)
+    {
+        const char* end = NULL;
+        size_t v = parse_size_(str, &end);
+        if (end == str) break;
+
+        if (v > 0) sizes[n++] = v;
+        str = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+static void print_size_(FILE* out, size_t bytes)
+{
+    if      (bytes >= (1u << 30)) fprintf(out, "%6.1fG", (double)bytes / (1u << 30));
+    else if (bytes >= (1u << 20)) fprintf(out, "%6.1fM", (double)bytes / (1u << 20));
+    else if (bytes >= (1u << 10)) fprintf(out, "%6.1fK", (double)bytes / (1u << 10));
+    else                          fprintf(out, "%6zuB", bytes);
+}
+
+static void keep_min_(double* dst, double v, size_t rep)
+{
+    if (rep == 0 || v < *dst) *dst = v;
+}
+
+// one full pipeline pass over the generated program
+static err_t bench_run_once_(FILE* src, size_t src_size, bench_result_t* res, size_t rep)
+{
+    err_t rc = OK;
+    double t = 0.0;
+
+    operational_data_t op = (operational_data_t){ 0 };
+
+    token_t*          tokens      = NULL;
+    size_t            token_count = 0;
+    nametable_t       nametable   = (nametable_t){ 0 };
+    int               nt_inited   = 0;
+    ast_tree_t        tree        = (ast_tree_t){ 0 };
+    int               tree_inited = 0;
+    syntax_analyzer_t sa          = (syntax_analyzer_t){ 0 };
+    int               sa_inited   = 0;
+
+    operational_data_t east_op  = (operational_data_t){ 0 };
+    ast_tree_t         east     = (ast_tree_t){ 0 };
+    int                east_ok  = 0;
+    FILE*              east_tmp = NULL;
+
+    op.buffer_size = src_size;
+    op.buffer = (char*)mem_calloc(MEM_TAG_IO, src_size + 1, 1);
+    if (!op.buffer) return ERR_ALLOC;
+
+    rewind(src);
+    if (fread(op.buffer, 1, src_size, src) != src_size) { rc = ERR_BAD_ARG; goto cleanup; }
+
+    t = now_sec_();
+    rc = lexer_stream(&op, &tokens, &token_count, &nametable);
+    keep_min_(&res->sec[BENCH_LEX], now_sec_() - t, rep);
+    if (rc != OK) goto cleanup;
+    nt_inited = 1;
+
+    t = now_sec_();
+    rc = ast_tree_ctor(&tree, &nametable);
+    if (rc != OK) goto cleanup;
+    tree_inited = 1;
+    nt_inited   = 0;
+
+    rc = syntax_analyzer_ctor(&sa, &op, tokens, token_count, &tree);
+    if (rc != OK) goto cleanup;
+    sa_inited = 1;
+
+    rc = syntax_analyze(&sa);
+    keep_min_(&res->sec[BENCH_PARSE], now_sec_() - t, rep);
+    if (rc != OK) goto cleanup;
+
+    east_tmp = tmpfile();
+    if (!east_tmp) { rc = ERR_BAD_ARG; goto cleanup; }
+
+    t = now_sec_();
+    ast_dump_sexpr(east_tmp, &tree, tree.root);
+    fprintf(east_tmp, "\n");
+    fflush(east_tmp);
+    keep_min_(&res->sec[BENCH_EAST_OUT], now_sec_() - t, rep);
+
+    res->tokens     = token_count;
+    res->nodes      = ast_subtree_size(tree.root);
+    res->east_bytes = (size_t)ftell(east_tmp);
+
+    rewind(east_tmp);
+    east_op.in_file = east_tmp;
+
+    t = now_sec_();
+    rc = ast_tree_ctor(&east, NULL);
+    if (rc != OK) goto cleanup;
+    east_ok = 1;
+
+    rc = ast_read_sexpr_from_op(&east, &east_op);
+    keep_min_(&res->sec[BENCH_EAST_IN], now_sec_() - t, rep);
+    if (rc != OK) goto cleanup;
+
+    int changed = 0;
+    t = now_sec_();
+    rc = ast_optimize(&east, &changed);
+    keep_min_(&res->sec[BENCH_OPTIMIZE], now_sec_() - t, rep);
+    if (rc != OK) goto cleanup;
+
+    east_op.out_file = fopen("/dev/null", "w");
+    if (!east_op.out_file) { rc = ERR_BAD_ARG; goto cleanup; }
+
+    t = now_sec_();
+    rc = backend_emit_asm(&east, &east_op, NULL);
+    fflush(east_op.out_file);
+    keep_min_(&res->sec[BENCH_EMIT], now_sec_() - t, rep);
+
+cleanup:
+    if (east_op.out_file) fclose(east_op.out_file);
+    if (east_tmp)         fclose(east_tmp);
+    mem_free(east_op.buffer);
+    if (east_ok) ast_tree_dtor(&east);
+
+    if (sa_inited)   syntax_analyzer_dtor(&sa);
+    if (tree_inited) ast_tree_dtor(&tree);
+    if (nt_inited)   nametable_dtor(&nametable);
+    mem_free(tokens);
+    mem_free(op.buffer);
+
+    return rc;
+}
+
+static err_t bench_size_(size_t target, size_t repeat, bench_result_t* res)
+{
+    bench_gen_config_t cfg = { 0 };
+    bench_gen_config_default(&cfg, target);
+
+    FILE* src = tmpfile();
+    if (!src) return ERR_BAD_ARG;
+
+    res->target = target;
+
+    double t = now_sec_();
+    err_t rc = bench_generate(src, &cfg, &res->bytes);
+    fflush(src);
+    res->sec[BENCH_GEN] = now_sec_() - t;
+
+    for (size_t rep = 0; rc == OK && rep < repeat; ++rep)
+        rc = bench_run_once_(src, res->bytes, res, rep);
+
+    fclose(src);
+    return rc;
+}
+
+static void bench_report_(FILE* out, const bench_result_t* res, size_t count)
+{
+    fprintf(out, "%-8s %10s %10s", "size", "tokens", "nodes");
+    for (size_t s = 0; s < BENCH_STAGE_COUNT; ++s)
+        fprintf(out, " %12s", bench_stage_names[s]);
+    fprintf(out, "\n");
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const bench_result_t* r = &res[i];
+
+        print_size_(out, r->bytes);
+        fprintf(out, "  %10zu %10zu", r->tokens, r->nodes);
+        for (size_t s = 0; s < BENCH_STAGE_COUNT; ++s)
+            fprintf(out, " %10.3fms", r->sec[s] * 1e3);
+        fprintf(out, "\n");
+
+        // throughput relative to .rot size, so stages are comparable
+        fprintf(out, "%-8s %10s %10s", "", "", "MB/s");
+        for (size_t s = 0; s < BENCH_STAGE_COUNT; ++s)
+        {
+            const double mbs = r->sec[s] > 0 ? (double)r->bytes / r->sec[s] / 1e6 : 0.0;
+            fprintf(out, " %12.2f", mbs);
+        }
+        fprintf(out, "\n");
+    }
+
+    if (count < 2) return;
+
+    // t ~ n^k, k = 1 means linear scaling
+    fprintf(out, "\nscaling exponent k (t ~ n^k) between consecutive sizes\n");
+    for (size_t i = 1; i < count; ++i)
+    {
+        const bench_result_t* a = &res[i - 1];
+        const bench_result_t* b = &res[i];
+
+        print_size_(out, a->bytes);
+        fprintf(out, " ->");
+        print_size_(out, b->bytes);
+        fprintf(out, "   ");
+
+        for (size_t s = 0; s < BENCH_STAGE_COUNT; ++s)
+        {
+            if (a->sec[s] <= 0 || b->sec[s] <= 0 || b->bytes < a->bytes + a->bytes / 8)
+            {
+                fprintf(out, " %12s", "-");
+                continue;
+            }
+            const double k = log(b->sec[s] / a->sec[s]) / log((double)b->bytes / (double)a->bytes);
+            fprintf(out, " %12.2f", k);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+static err_t bench_write_json_(const char* filename, const bench_result_t* res, size_t count)
+{
+    FILE* out = fopen(filename, "w");
+    if (!out)
+    {
+        LOG_ERROR("Failed to open bench report '%s'", filename);
+        return ERR_BAD_ARG;
+    }
+
+    fprintf(out, "[");
+    for (size_t i = 0; i < count; ++i)
+    {
+        const bench_result_t* r = &res[i];
+        fprintf(out, "%s\n  { \"target\": %zu, \"bytes\": %zu, \"east_bytes\": %zu, "
+                     "\"tokens\": %zu, \"nodes\": %zu, \"ms\": {",
+                i ? "," : "", r->target, r->bytes, r->east_bytes, r->tokens, r->nodes);
+
+        for (size_t s = 0; s < BENCH_STAGE_COUNT; ++s)
+            fprintf(out, "%s \"%s\": %.3f", s ? "," : "", bench_stage_names[s], r->sec[s] * 1e3);
+
+        fprintf(out, " } }");
+    }
+    fprintf(out, "\n]\n");
+
+    fclose(out);
+    return OK;
+}
+
+int main(int argc, char* const argv[])
+{
+    err_t rc = OK;
+
+    const char* in_filename  = NULL;
+    const char* out_filename = NULL;
+
+    const char* sizes_arg  = NULL;
+    const char* repeat_arg = NULL;
+    const char* json_arg   = NULL;
+    const char* gen_arg    = NULL;
+    const char* seed_arg   = NULL;
+
+    const arg_option_t options[] = {
+        { "--sizes",  ARG_VALUE, &sizes_arg  },
+        { "--repeat", ARG_VALUE, &repeat_arg },
+        { "--json",   ARG_VALUE, &json_arg   },
+        { "--gen",    ARG_VALUE, &gen_arg    },
+        { "--seed",   ARG_VALUE, &seed_arg   },
+    };
+
+    init_logging("bench.log", WARN);
+
+    size_t parsed = parse_arguments_ex(argc, argv, &in_filename, &out_filename,
+                                       options, sizeof(options) / sizeof(options[0]));
+    unused(parsed);
+
+    // --gen <size> --outfile f.rot: only emit a program
+    if (gen_arg)
+    {
+        bench_gen_config_t cfg = { 0 };
+        bench_gen_config_default(&cfg, parse_size_(gen_arg, NULL));
+        if (seed_arg) cfg.seed = (unsigned)strtoul(seed_arg, NULL, 10);
+
+        FILE* out = out_filename ? fopen(out_filename, "w") : stdout;
+        if (!out)
+        {
+            fprintf(stderr, "Failed to open output file '%s'\n", out_filename);
+            close_log_file();
+            return EXIT_FAILURE;
+        }
+
+        rc = bench_generate(out, &cfg, NULL);
+        if (out != stdout) fclose(out);
+
+        close_log_file();
+        return (rc == OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    size_t sizes[BENCH_MAX_SIZES] = { 0 };
+    const size_t size_count = parse_size_list_(sizes_arg ? sizes_arg : BENCH_DEFAULT_SIZES,
+                                               sizes, BENCH_MAX_SIZES);
+
+    size_t repeat = repeat_arg ? (size_t)strtoull(repeat_arg, NULL, 10) : 3;
+    if (repeat == 0) repeat = 1;
+
+    bench_result_t results[BENCH_MAX_SIZES] = { 0 };
+    size_t done = 0;
+
+    for (; done < size_count; ++done)
+    {
+        fprintf(stderr, "bench: ");
+        print_size_(stderr, sizes[done]);
+        fprintf(stderr, " x%zu\n", repeat);
+
+        rc = bench_size_(sizes[done], repeat, &results[done]);
+        if (rc != OK)
+        {
+            fprintf(stderr, "bench: pipeline failed at size %zu (err=%d)\n", sizes[done], rc);
+            break;
+        }
+    }
+
+    bench_report_(stdout, results, done);
+
+    if (json_arg && bench_write_json_(json_arg, results, done) != OK && rc == OK)
+        rc = ERR_BAD_ARG;
+
+    close_log_file();
+    return (rc == OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
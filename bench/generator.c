@@ -0,0 +1,340 @@
+#include "generator.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+
+#define GEN_MAX_VARS     256
+#define GEN_MAIN_CALLS   64
+
+typedef struct
+{
+    FILE*                     out;
+    const bench_gen_config_t* cfg;
+    size_t                    written;
+    unsigned long long        rng;
+
+    size_t vars[GEN_MAX_VARS];  // ids of visible int locals (v<id>), params are a/b
+    int    fixed[GEN_MAX_VARS]; // loop counters of open loops, never assigned
+    size_t var_amount;
+    size_t next_var;
+
+    size_t int_funcs;           // f_0 .. f_{int_funcs-1}
+    size_t deriv_funcs;         // g_0 .. g_{deriv_funcs-1}
+} gen_t;
+
+static void gen_printf_(gen_t* g, const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vfprintf(g->out, fmt, ap);
+    va_end(ap);
+    if (n > 0) g->written += (size_t)n;
+}
+
+static void gen_indent_(gen_t* g, size_t depth)
+{
+    for (size_t i = 0; i < depth; ++i)
+        gen_printf_(g, "    ");
+}
+
+static size_t gen_rand_(gen_t* g, size_t n)
+{
+    // xorshift64*
+    g->rng ^= g->rng >> 12;
+    g->rng ^= g->rng << 25;
+    g->rng ^= g->rng >> 27;
+    return n ? (size_t)((g->rng * 2685821657736338717ULL) >> 33) % n : 0;
+}
+
+static void gen_leaf_(gen_t* g)
+{
+    const size_t pick = gen_rand_(g, g->var_amount + 3);
+
+    if (pick == 0)      gen_printf_(g, "a");
+    else if (pick == 1) gen_printf_(g, "b");
+    else if (pick == 2) gen_printf_(g, "%zu", 1 + gen_rand_(g, 99));
+    else                gen_printf_(g, "v%zu", g->vars[pick - 3]);
+}
+
+static void gen_expr_(gen_t* g, size_t size)
+{
+    if (size == 0)
+    {
+        gen_leaf_(g);
+        return;
+    }
+
+    if (g->int_funcs > 0 && size >= 4 && gen_rand_(g, 16) == 0)
+    {
+        gen_printf_(g, "f_%zu(", gen_rand_(g, g->int_funcs));
+        gen_expr_(g, (size - 1) / 2);
+        gen_printf_(g, ", ");
+        gen_expr_(g, (size - 1) / 2);
+        gen_printf_(g, ")");
+        return;
+    }
+
+    static const char* const ops[] = { "+", "-", "*", "+", "-" };
+    const size_t lsize = gen_rand_(g, size);
+
+    gen_printf_(g, "(");
+    gen_expr_(g, lsize);
+
+    if (gen_rand_(g, 8) == 0)
+    {
+        gen_printf_(g, " / %zu)", 1 + gen_rand_(g, 9));
+        return;
+    }
+
+    gen_printf_(g, " %s ", ops[gen_rand_(g, sizeof(ops) / sizeof(ops[0]))]);
+    gen_expr_(g, size - 1 - lsize);
+    gen_printf_(g, ")");
+}
+
+static void gen_cond_(gen_t* g)
+{
+    static const char* const cmps[] = { "<", ">", "<=", ">=", "==", "!=" };
+    gen_expr_(g, 1 + gen_rand_(g, 3));
+    gen_printf_(g, " %s ", cmps[gen_rand_(g, sizeof(cmps) / sizeof(cmps[0]))]);
+    gen_expr_(g, 1 + gen_rand_(g, 3));
+}
+
+static void gen_push_var_(gen_t* g, size_t id, int fixed)
+{
+    if (g->var_amount >= GEN_MAX_VARS) return;
+    g->fixed[g->var_amount] = fixed;
+    g->vars[g->var_amount++] = id;
+}
+
+// a visible local that may be assigned, SIZE_MAX when there is none
+static size_t gen_pick_assignable_(gen_t* g)
+{
+    size_t free_amount = 0;
+    for (size_t i = 0; i < g->var_amount; ++i)
+        free_amount += !g->fixed[i];
+    if (free_amount == 0) return SIZE_MAX;
+
+    size_t k = gen_rand_(g, free_amount);
+    for (size_t i = 0; i < g->var_amount; ++i)
+        if (!g->fixed[i] && k-- == 0) return g->vars[i];
+    return SIZE_MAX;
+}
+
+static void gen_block_(gen_t* g, size_t depth);
+
+static void gen_stmt_(gen_t* g, size_t depth)
+{
+    const bench_gen_config_t* cfg = g->cfg;
+    const size_t kind = gen_rand_(g, (depth < cfg->max_depth) ? 8 : 4);
+
+    gen_indent_(g, depth);
+
+    switch (kind)
+    {
+        case 0:
+        {
+            // initializer must not see the variable being declared
+            const size_t id = g->next_var++;
+            gen_printf_(g, "npc v%zu gaslight ", id);
+            gen_expr_(g, cfg->expr_size);
+            gen_printf_(g, ";\n");
+            gen_push_var_(g, id, 0);
+            return;
+        }
+
+        case 1:
+        case 2:
+        {
+            const size_t id = gen_pick_assignable_(g);
+            if (id == SIZE_MAX) gen_printf_(g, "a gaslight ");
+            else                gen_printf_(g, "v%zu gaslight ", id);
+            gen_expr_(g, 1 + gen_rand_(g, cfg->expr_size));
+            gen_printf_(g, ";\n");
+            return;
+        }
+
+        case 3:
+            gen_printf_(g, "mid(");
+            gen_expr_(g, 1 + gen_rand_(g, 4));
+            gen_printf_(g, ");\n");
+            return;
+
+        case 4:
+        case 5:
+        {
+            gen_printf_(g, "alpha (");
+            gen_cond_(g);
+            gen_printf_(g, ")\n");
+            gen_block_(g, depth);
+
+            const size_t elifs = gen_rand_(g, 3);
+            for (size_t i = 0; i < elifs; ++i)
+            {
+                gen_indent_(g, depth);
+                gen_printf_(g, "omega (");
+                gen_cond_(g);
+                gen_printf_(g, ")\n");
+                gen_block_(g, depth);
+            }
+
+            if (gen_rand_(g, 2))
+            {
+                gen_indent_(g, depth);
+                gen_printf_(g, "sigma\n");
+                gen_block_(g, depth);
+            }
+            return;
+        }
+
+        case 6:
+        {
+            // the counter is read-only until its loop closes, so the loop ends
+            const size_t id   = g->next_var++;
+            const size_t slot = g->var_amount;
+            gen_push_var_(g, id, 1);
+            gen_printf_(g, "npc v%zu gaslight 0;\n", id);
+            gen_indent_(g, depth);
+            gen_printf_(g, "lowkey (v%zu < %zu)\n", id, 2 + gen_rand_(g, 4));
+            gen_indent_(g, depth);
+            gen_printf_(g, "yap\n");
+
+            const size_t saved = g->var_amount;
+            for (size_t i = 0; i < g->cfg->block_len / 2 + 1; ++i)
+                gen_stmt_(g, depth + 1);
+            g->var_amount = saved;
+            if (slot < g->var_amount) g->fixed[slot] = 0;
+
+            gen_indent_(g, depth + 1);
+            gen_printf_(g, "v%zu gaslight v%zu + 1;\n", id, id);
+            gen_indent_(g, depth);
+            gen_printf_(g, "yapity\n");
+            return;
+        }
+
+        default:
+        {
+            const size_t id = g->next_var++;
+            gen_printf_(g, "highkey (npc v%zu gaslight 0; v%zu < %zu; v%zu gaslight v%zu + 1)\n",
+                        id, id, 2 + gen_rand_(g, 4), id, id);
+
+            const size_t saved = g->var_amount;
+            gen_push_var_(g, id, 1);
+            gen_block_(g, depth);
+            g->var_amount = saved;
+            return;
+        }
+    }
+}
+
+static void gen_block_(gen_t* g, size_t depth)
+{
+    gen_indent_(g, depth);
+    gen_printf_(g, "yap\n");
+
+    const size_t saved = g->var_amount;
+    const size_t len   = 1 + gen_rand_(g, g->cfg->block_len);
+    for (size_t i = 0; i < len; ++i)
+        gen_stmt_(g, depth + 1);
+    g->var_amount = saved;
+
+    gen_indent_(g, depth);
+    gen_printf_(g, "yapity\n");
+}
+
+static void gen_int_func_(gen_t* g)
+{
+    g->var_amount = 0;
+
+    gen_printf_(g, "npc f_%zu(npc a, npc b)\nyap\n", g->int_funcs);
+
+    const size_t len = g->cfg->block_len + gen_rand_(g, g->cfg->block_len + 1);
+    for (size_t i = 0; i < len; ++i)
+        gen_stmt_(g, 1);
+
+    gen_printf_(g, "    micdrop ");
+    gen_expr_(g, g->cfg->expr_size);
+    gen_printf_(g, ";\nyapity\n\n");
+
+    g->int_funcs++;
+}
+
+static void gen_deriv_func_(gen_t* g)
+{
+    gen_printf_(g, "homie g_%zu(homie x)\nyap\n    homie r gaslight d(\"", g->deriv_funcs);
+
+    const size_t terms = 1 + g->cfg->deriv_terms / 2 + gen_rand_(g, g->cfg->deriv_terms + 1);
+    for (size_t i = 0; i < terms; ++i)
+    {
+        if (i) gen_printf_(g, " + ");
+
+        switch (gen_rand_(g, 3))
+        {
+            case 0:  gen_printf_(g, "%zu*x^%zu", 1 + gen_rand_(g, 9), 1 + gen_rand_(g, 6)); break;
+            case 1:  gen_printf_(g, "x/%zu", 1 + gen_rand_(g, 9));                           break;
+            default: gen_printf_(g, "%zu*x*x", 1 + gen_rand_(g, 9));                        break;
+        }
+    }
+
+    gen_printf_(g, "\", x, %zu);\n    micdrop r + x;\nyapity\n\n", g->cfg->deriv_order);
+    g->deriv_funcs++;
+}
+
+static void gen_main_(gen_t* g)
+{
+    gen_printf_(g, "npc main()\nyap\n    npc acc gaslight 0;\n");
+
+    for (size_t i = 0; i < g->int_funcs && i < GEN_MAIN_CALLS; ++i)
+        gen_printf_(g, "    acc gaslight acc + f_%zu(%zu, %zu);\n", i, i + 1, i + 2);
+
+    for (size_t i = 0; i < g->deriv_funcs && i < GEN_MAIN_CALLS; ++i)
+        gen_printf_(g, "    peak(g_%zu(1.5));\n", i);
+
+    gen_printf_(g, "    mid(acc);\n    micdrop 0;\nyapity\n");
+}
+
+void bench_gen_config_default(bench_gen_config_t* cfg, size_t target_bytes)
+{
+    if (!cfg) return;
+
+    cfg->target_bytes = target_bytes;
+    cfg->seed         = 12345;
+    cfg->max_depth    = 4;
+    cfg->block_len    = 6;
+    cfg->expr_size    = 12;
+    cfg->deriv_terms  = 8;
+    cfg->deriv_order  = 2;
+
+    // one default function is ~5-10K, keep tiny targets close to requested size
+    if (target_bytes < (16u << 10))
+    {
+        cfg->max_depth = 2;
+        cfg->block_len = 3;
+        cfg->expr_size = 6;
+    }
+}
+
+err_t bench_generate(FILE* out, const bench_gen_config_t* cfg, size_t* written)
+{
+    if (!out || !cfg) return ERR_BAD_ARG;
+
+    gen_t g = { 0 };
+    g.out = out;
+    g.cfg = cfg;
+    g.rng = 0x9E3779B97F4A7C15ULL ^ (unsigned long long)cfg->seed;
+
+    gen_printf_(&g, "// synthetic benchmark program, target %zu bytes, seed %u\n",
+                cfg->target_bytes, cfg->seed);
+
+    do
+    {
+        if (gen_rand_(&g, 4) == 0) gen_deriv_func_(&g);
+        else                       gen_int_func_(&g);
+    }
+    while (g.written < cfg->target_bytes);
+
+    gen_main_(&g);
+
+    if (written) *written = g.written;
+    return ferror(out) ? ERR_BAD_ARG : OK;
+}
@@ -0,0 +1,31 @@
+#ifndef BENCH_GENERATOR_H
+#define BENCH_GENERATOR_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "../libs/types.h"
+
+typedef struct
+{
+    size_t   target_bytes;  // generation stops once output reaches this size
+    unsigned seed;
+
+    size_t   max_depth;     // nesting of alpha/lowkey/highkey blocks
+    size_t   block_len;     // statements per block
+    size_t   expr_size;     // operators per "huge" expression
+    size_t   deriv_terms;   // terms in d("...") polynomial strings
+    size_t   deriv_order;   // n in d("...", x, n)
+} bench_gen_config_t;
+
+/*
+    Fill config with defaults for given target size
+*/
+void  bench_gen_config_default(bench_gen_config_t* cfg, size_t target_bytes);
+
+/*
+    Write synthetic, valid .rot program into out. Returns bytes written in *written
+*/
+err_t bench_generate(FILE* out, const bench_gen_config_t* cfg, size_t* written);
+
+#endif
@@ -10,6 +10,8 @@
 #include "ast/ast.h"
 #include "ast/syntax_analyzer.h"
 #include "ast/dump/dump.h"
+#include "libs/stats/stats.h"
+#include "libs/memory/memory.h"
 
 static char* make_east_filename_(const char* base)
 {
@@ -17,7 +19,7 @@ static char* make_east_filename_(const char* base)
 
     const char* dot = strrchr(base, '.');
     if (dot && strcmp(dot, ".east") == 0)
-        return strdup(base);
+        return mem_strdup(MEM_TAG_IO, base);
 
     size_t prefix_len = strlen(base);
     if (dot) prefix_len = (size_t)(dot - base);
@@ -25,11 +27,12 @@ static char* make_east_filename_(const char* base)
     const char* ext = ".east";
     const size_t ext_len = 5;
 
-    char* out = (char*)calloc(prefix_len + ext_len + 1, 1);
+    char* out = (char*)mem_calloc(MEM_TAG_IO, prefix_len + ext_len + 1, 1);
     if (!out) return NULL;
 
-    out = strdup(base);
-    strcat(out, ext);
+    memcpy(out, base, prefix_len);
+    memcpy(out + prefix_len, ext, ext_len);
+    out[prefix_len + ext_len] = '\0';
     return out;
 }
 
@@ -62,9 +65,9 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
         if ((fp) && (fp) != stdout) { fclose((fp)); (fp) = NULL; } \
     block_end
 
-#define SAFE_FREE(p)                    \
-    block_begin                         \
-        if (p) { free(p); (p) = NULL; } \
+#define SAFE_FREE(p)                        \
+    block_begin                             \
+        if (p) { mem_free(p); (p) = NULL; } \
     block_end
 
 #define FAIL_MSG(msg)                                                            \
@@ -73,7 +76,7 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
             snprintf(op_data.error_msg, sizeof(op_data.error_msg), "%s", (msg)); \
         fprintf(stderr, "%s\n", op_data.error_msg);                              \
         print_error_context_(stderr, &op_data);                                  \
-        log_printf(ERROR, "%s", op_data.error_msg);                              \
+        LOG_ERROR("%s", op_data.error_msg);                                      \
         rc = ERR_SYNTAX;                                                         \
         goto cleanup;                                                            \
     block_end
@@ -83,7 +86,7 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
         snprintf(op_data.error_msg, sizeof(op_data.error_msg), (fmt), __VA_ARGS__); \
         fprintf(stderr, "%s\n", op_data.error_msg);                                 \
         print_error_context_(stderr, &op_data);                                     \
-        log_printf(ERROR, "%s", op_data.error_msg);                                 \
+        LOG_ERROR("%s", op_data.error_msg);                                         \
         rc = ERR_SYNTAX;                                                            \
         goto cleanup;                                                               \
     block_end
@@ -111,12 +114,33 @@ int main(int argc, char* const argv[])
     char* east_name = NULL;
     FILE* east      = NULL;
 
+    const char* stats_flag = NULL;
+    const char* stats_json = NULL;
+
+    const char* dump_flag  = NULL;
+    const char* dump_path  = NULL;
+    const char* dump_max   = NULL;
+    const char* dump_func  = NULL;
+    FILE*       dump_file  = NULL;
+
+    const arg_option_t options[] = {
+        { "--stats",          ARG_FLAG,   &stats_flag },
+        { "--stats-json",     ARG_VALUE,  &stats_json },
+        { "--dump-ast",       ARG_FLAG,   &dump_flag  },
+        { "--dump-ast=",      ARG_PREFIX, &dump_path  },
+        { "--dump-max-nodes", ARG_VALUE,  &dump_max   },
+        { "--dump-func",      ARG_VALUE,  &dump_func  },
+    };
+
     init_logging("frontend.log", DEBUG);
-    log_printf(INFO, "Frontend started");
+    LOG_INFO("Frontend started");
 
-    size_t parsed = parse_arguments(argc, argv, &in_filename, &out_filename);
+    size_t parsed = parse_arguments_ex(argc, argv, &in_filename, &out_filename,
+                                       options, sizeof(options) / sizeof(options[0]));
     unused parsed;
 
+    stats_init("frontend", stats_flag || stats_json);
+
     if (!CHECK(ERROR, in_filename != NULL,
                "No input file specified. Use --infile <filename>"))
     {
@@ -124,6 +148,7 @@ int main(int argc, char* const argv[])
     }
 
     // load input
+    stats_phase_begin(STATS_PHASE_LOAD);
     op_data.in_file = load_file(in_filename, "rb");
     if (!op_data.in_file)
         FAILF("Failed to open input file '%s'", in_filename);
@@ -133,7 +158,7 @@ int main(int argc, char* const argv[])
         FAILF("Failed to stat input file '%s'", in_filename);
 
     op_data.buffer_size = (size_t)file_size;
-    op_data.buffer = (char*)calloc(op_data.buffer_size + 1, 1);
+    op_data.buffer = (char*)mem_calloc(MEM_TAG_IO, op_data.buffer_size + 1, 1);
     if (!op_data.buffer)
         FAILF("Failed to allocate %zu bytes for input buffer", op_data.buffer_size + 1);
 
@@ -146,14 +171,20 @@ int main(int argc, char* const argv[])
         FAILF("Failed to read input file '%s' or file is empty", in_filename);
 
     op_data.buffer_size = bytes_read;
+    stats_phase_end(STATS_PHASE_LOAD);
+    stats_set(STATS_INPUT_BYTES, bytes_read);
 
     // lexer
+    stats_phase_begin(STATS_PHASE_LEX);
     rc = lexer_stream(&op_data, &tokens, &token_count, &nametable);
+    stats_phase_end(STATS_PHASE_LEX);
     if (rc != OK)
         FAIL_MSG("Lexing failed.");
     nametable_inited = 1;
 
-    log_printf(INFO, "Lexing finished successfully, %zu tokens", token_count);
+    stats_set(STATS_TOKENS, token_count);
+
+    LOG_INFO("Lexing finished successfully, %zu tokens", token_count);
 
     // AST tree ctor
     rc = ast_tree_ctor(&ast_tree, &nametable);
@@ -168,16 +199,40 @@ int main(int argc, char* const argv[])
         FAIL_MSG("Failed to initialize syntax analyzer.");
     sa_inited = 1;
 
+    stats_phase_begin(STATS_PHASE_PARSE);
     rc = syntax_analyze(&sa);
+    stats_phase_end(STATS_PHASE_PARSE);
     if (rc != OK)
         FAIL_MSG("Parsing failed.");
 
-    FILE* dump_file = load_file("frontend-ast-tree-dump.html", "w");
-    if (!dump_file)
-        FAILF("Failed to open dump file '%s' for writing", "frontend-ast-tree-dump.html");
-    ast_dump_graphviz_html(&ast_tree, dump_file);
+    if (stats_enabled())
+    {
+        stats_set(STATS_AST_NODES,      ast_subtree_size(ast_tree.root));
+        stats_set(STATS_AST_ALLOCS,     ast_tree.alloced_count);
+        stats_set(STATS_NAMETABLE_SIZE, ast_tree.nametable.amount);
+        stats_set(STATS_FUNCTIONS,      ast_children_count(ast_tree.root));
+    }
 
-    log_printf(INFO, "Parsing finished successfully");
+    // graphviz dump is opt-in: --dump-ast or --dump-ast=<file.html>
+    if (dump_flag || dump_path)
+    {
+        if (!dump_path) dump_path = "frontend-ast-tree-dump.html";
+
+        ast_dump_options_t dump_opts = { 0 };
+        ast_dump_options_default(&dump_opts);
+        if (dump_max)  dump_opts.max_nodes = (size_t)strtoull(dump_max, NULL, 10);
+        if (dump_func) dump_opts.function  = dump_func;
+
+        stats_phase_begin(STATS_PHASE_DUMP);
+        dump_file = load_file(dump_path, "w");
+        if (!dump_file)
+            FAILF("Failed to open dump file '%s' for writing", dump_path);
+        ast_dump_graphviz_html_ex(&ast_tree, dump_file, &dump_opts);
+        SAFE_FCLOSE(dump_file);
+        stats_phase_end(STATS_PHASE_DUMP);
+    }
+
+    LOG_INFO("Parsing finished successfully");
 
     // save .east
     east_name = out_filename ? make_east_filename_(out_filename)
@@ -186,20 +241,25 @@ int main(int argc, char* const argv[])
     if (!east_name)
         FAIL_MSG("Failed to build .east output filename.");
 
+    stats_phase_begin(STATS_PHASE_WRITE);
     east = load_file(east_name, "w");
     if (!east)
         FAILF("Failed to open output file '%s' for writing", east_name);
 
     ast_dump_sexpr(east, &ast_tree, ast_tree.root);
     fprintf(east, "\n");
+    stats_set(STATS_OUTPUT_BYTES, (size_t)ftell(east));
+    SAFE_FCLOSE(east);
+    stats_phase_end(STATS_PHASE_WRITE);
 
-    log_printf(INFO, "Wrote AST dump: %s", east_name);
+    LOG_INFO("Wrote AST dump: %s", east_name);
 
 cleanup:
     if (sa_inited)  syntax_analyzer_dtor(&sa);
     if (ast_inited) ast_tree_dtor(&ast_tree);
 
     SAFE_FCLOSE(east);
+    SAFE_FCLOSE(dump_file);
     SAFE_FREE(east_name);
 
     SAFE_FREE(tokens);
@@ -213,6 +273,11 @@ cleanup:
 
     SAFE_FREE(op_data.buffer);
 
+    mem_leak_report(stderr);
+
+    if (stats_finish(stats_flag != NULL, stats_json) != OK && rc == OK)
+        rc = ERR_BAD_ARG;
+
     close_log_file();
     return (rc == OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,338 @@
+#include "ir.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+static const char* const ir_op_names[IR_OP_COUNT] = {
+#define IR_OP_NAME(sym, str, eff) str,
+    IR_OP_LIST(IR_OP_NAME)
+#undef IR_OP_NAME
+};
+
+static const int ir_op_effects[IR_OP_COUNT] = {
+#define IR_OP_EFFECT(sym, str, eff) eff,
+    IR_OP_LIST(IR_OP_EFFECT)
+#undef IR_OP_EFFECT
+};
+
+#define IR_GROW_(ptr, cap, want, type, fail)                                \
+    block_begin                                                             \
+        if ((want) > (cap)) {                                               \
+            size_t new_cap = (cap) ? (cap) * 2 : 4;                         \
+            while (new_cap < (want)) new_cap *= 2;                          \
+            void* np = mem_realloc(MEM_TAG_IR, (ptr), new_cap * sizeof(type)); \
+            if (!np) return (fail);                                         \
+            (ptr) = (type*)np;                                              \
+            (cap) = new_cap;                                                \
+        }                                                                   \
+    block_end
+
+const char* ir_op_name(ir_op_t op)
+{
+    return (op < IR_OP_COUNT) ? ir_op_names[op] : "?";
+}
+
+int ir_op_has_effect(ir_op_t op)
+{
+    return (op < IR_OP_COUNT) ? ir_op_effects[op] : 1;
+}
+
+ir_id_t ir_value_new(ir_func_t* fn, ir_op_t op, ast_type_t type, size_t block)
+{
+    IR_GROW_(fn->values, fn->value_cap, fn->value_count + 1, ir_value_t, IR_NONE);
+
+    fn->values[fn->value_count] = (ir_value_t){
+        .op      = op,
+        .type    = type,
+        .block   = block,
+        .name_id = SIZE_MAX,
+        .forward = IR_NONE,
+    };
+    return fn->value_count++;
+}
+
+err_t ir_value_arg(ir_func_t* fn, ir_id_t value, ir_id_t arg)
+{
+    ir_value_t* v = &fn->values[value];
+    IR_GROW_(v->args, v->arg_cap, v->arg_count + 1, ir_id_t, ERR_ALLOC);
+    v->args[v->arg_count++] = arg;
+    return OK;
+}
+
+size_t ir_block_new(ir_func_t* fn)
+{
+    IR_GROW_(fn->blocks, fn->block_cap, fn->block_count + 1, ir_block_t, IR_NONE);
+
+    fn->blocks[fn->block_count] = (ir_block_t){
+        .cond = IR_NONE,
+        .succ = { IR_NONE, IR_NONE },
+    };
+    return fn->block_count++;
+}
+
+err_t ir_block_append(ir_func_t* fn, size_t block, ir_id_t value)
+{
+    ir_block_t* b = &fn->blocks[block];
+    IR_GROW_(b->insts, b->inst_cap, b->inst_count + 1, ir_id_t, ERR_ALLOC);
+    b->insts[b->inst_count++] = value;
+    return OK;
+}
+
+err_t ir_block_pred(ir_func_t* fn, size_t block, size_t pred)
+{
+    ir_block_t* b = &fn->blocks[block];
+    IR_GROW_(b->preds, b->pred_cap, b->pred_count + 1, size_t, ERR_ALLOC);
+    b->preds[b->pred_count++] = pred;
+    return OK;
+}
+
+ir_id_t ir_resolve(const ir_func_t* fn, ir_id_t value)
+{
+    while (value != IR_NONE && fn->values[value].forward != IR_NONE)
+        value = fn->values[value].forward;
+    return value;
+}
+
+static void ir_func_dtor_(ir_func_t* fn)
+{
+    for (size_t i = 0; i < fn->value_count; ++i)
+        mem_free(fn->values[i].args);
+
+    for (size_t i = 0; i < fn->block_count; ++i)
+    {
+        mem_free(fn->blocks[i].insts);
+        mem_free(fn->blocks[i].preds);
+        mem_free(fn->blocks[i].copies);
+    }
+
+    mem_free(fn->values);
+    mem_free(fn->blocks);
+    mem_free(fn->param_types);
+    memset(fn, 0, sizeof(*fn));
+}
+
+void ir_module_dtor(ir_module_t* module)
+{
+    if (!module) return;
+
+    for (size_t i = 0; i < module->func_count; ++i)
+        ir_func_dtor_(&module->funcs[i]);
+
+    mem_free(module->funcs);
+    memset(module, 0, sizeof(*module));
+}
+
+size_t ir_module_blocks(const ir_module_t* module)
+{
+    size_t n = 0;
+    for (size_t i = 0; module && i < module->func_count; ++i)
+        for (size_t b = 0; b < module->funcs[i].block_count; ++b)
+            n += module->funcs[i].blocks[b].reachable ? 1 : 0;
+    return n;
+}
+
+size_t ir_module_values(const ir_module_t* module)
+{
+    size_t n = 0;
+    for (size_t i = 0; module && i < module->func_count; ++i)
+        for (size_t b = 0; b < module->funcs[i].block_count; ++b)
+            if (module->funcs[i].blocks[b].reachable)
+                n += module->funcs[i].blocks[b].inst_count;
+    return n;
+}
+
+// ================================ out of SSA ================================
+
+static err_t ir_add_copy_(ir_func_t* fn, size_t block, ir_id_t dst, ir_id_t src)
+{
+    ir_block_t* b = &fn->blocks[block];
+    IR_GROW_(b->copies, b->copy_cap, b->copy_count + 1, ir_copy_t, ERR_ALLOC);
+    b->copies[b->copy_count++] = (ir_copy_t){ .dst = dst, .src = src };
+    return OK;
+}
+
+// Put a block on every edge pred -> block where pred branches two ways, so
+// that copies for this edge do not run on the other one
+static err_t ir_split_edges_(ir_func_t* fn, size_t block)
+{
+    for (size_t i = 0; i < fn->blocks[block].pred_count; ++i)
+    {
+        const size_t pred = fn->blocks[block].preds[i];
+        if (fn->blocks[pred].term != IR_TERM_BR) continue;
+
+        const size_t mid = ir_block_new(fn);
+        if (mid == IR_NONE) return ERR_ALLOC;
+
+        ir_block_t* m = &fn->blocks[mid];
+        m->term      = IR_TERM_JMP;
+        m->succ[0]   = block;
+        m->sealed    = 1;
+        m->reachable = 1;
+
+        err_t rc = ir_block_pred(fn, mid, pred);
+        if (rc != OK) return rc;
+
+        ir_block_t* p = &fn->blocks[pred];
+        p->succ[(p->succ[0] == block) ? 0 : 1] = mid;
+        fn->blocks[block].preds[i] = mid;
+    }
+
+    return OK;
+}
+
+static err_t ir_func_out_of_ssa_(ir_func_t* fn)
+{
+    const size_t block_count = fn->block_count;
+
+    for (size_t bi = 0; bi < block_count; ++bi)
+    {
+        const ir_block_t* b = &fn->blocks[bi];
+        if (!b->reachable || b->inst_count == 0) continue;
+        if (fn->values[b->insts[0]].op != IR_OP_PHI) continue;
+
+        err_t rc = ir_split_edges_(fn, bi);
+        if (rc != OK) return rc;
+
+        for (size_t k = 0; k < fn->blocks[bi].inst_count; ++k)
+        {
+            const ir_id_t phi = fn->blocks[bi].insts[k];
+            if (fn->values[phi].op != IR_OP_PHI) break;
+
+            for (size_t i = 0; i < fn->values[phi].arg_count; ++i)
+            {
+                const ir_id_t src = ir_resolve(fn, fn->values[phi].args[i]);
+                if (src == phi) continue;
+
+                rc = ir_add_copy_(fn, fn->blocks[bi].preds[i], phi, src);
+                if (rc != OK) return rc;
+            }
+
+            fn->values[phi].arg_count = 0;
+        }
+    }
+
+    fn->in_ssa = 0;
+    return OK;
+}
+
+err_t ir_out_of_ssa(ir_module_t* module)
+{
+    if (!module) return ERR_BAD_ARG;
+
+    for (size_t i = 0; i < module->func_count; ++i)
+    {
+        if (!module->funcs[i].in_ssa) continue;
+
+        err_t rc = ir_func_out_of_ssa_(&module->funcs[i]);
+        if (rc != OK) return rc;
+    }
+
+    return OK;
+}
+
+// =================================== dump ===================================
+
+static void ir_dump_value_(FILE* out, const ir_module_t* module, const ir_func_t* fn, ir_id_t id)
+{
+    const ir_value_t* v = &fn->values[id];
+
+    if (v->type != AST_TYPE_VOID)
+        fprintf(out, "    v%zu = %s %s", id, ast_type_to_cstr(v->type), ir_op_name(v->op));
+    else
+        fprintf(out, "    %s", ir_op_name(v->op));
+
+    switch (v->op)
+    {
+        case IR_OP_CONST:
+            if (v->type == AST_TYPE_FLOAT) fprintf(out, " %g", (double)v->imm.f);
+            else                           fprintf(out, " %lld", (long long)v->imm.i);
+            break;
+
+        case IR_OP_PARAM:
+            fprintf(out, " %lld", (long long)v->imm.i);
+            break;
+
+        case IR_OP_PHI:
+            for (size_t i = 0; i < v->arg_count; ++i)
+                fprintf(out, " [bb%zu v%zu]", fn->blocks[v->block].preds[i], ir_resolve(fn, v->args[i]));
+            break;
+
+        case IR_OP_CALL:
+            fprintf(out, " %s(", ast_name_cstr(module->tree, v->name_id));
+            for (size_t i = 0; i < v->arg_count; ++i)
+                fprintf(out, "%sv%zu", i ? ", " : "", ir_resolve(fn, v->args[i]));
+            fprintf(out, ")");
+            break;
+
+        default:
+            for (size_t i = 0; i < v->arg_count; ++i)
+                fprintf(out, "%s v%zu", i ? "," : "", ir_resolve(fn, v->args[i]));
+            break;
+    }
+
+    if ((v->op == IR_OP_PHI || v->op == IR_OP_PARAM) && v->name_id != SIZE_MAX)
+        fprintf(out, "  ; %s", ast_name_cstr(module->tree, v->name_id));
+
+    fprintf(out, "\n");
+}
+
+static void ir_dump_func_(FILE* out, const ir_module_t* module, const ir_func_t* fn)
+{
+    fprintf(out, "fn %s(", ast_name_cstr(module->tree, fn->name_id));
+    for (size_t i = 0; i < fn->param_count; ++i)
+        fprintf(out, "%s%s", i ? ", " : "", ast_type_to_cstr(fn->param_types[i]));
+    fprintf(out, ") -> %s%s\n", ast_type_to_cstr(fn->ret_type), fn->in_ssa ? "" : "  ; out of SSA");
+
+    for (size_t bi = 0; bi < fn->block_count; ++bi)
+    {
+        const ir_block_t* b = &fn->blocks[bi];
+        if (!b->reachable) continue;
+
+        fprintf(out, "  bb%zu:", bi);
+        if (b->pred_count)
+        {
+            fprintf(out, "  ; preds");
+            for (size_t i = 0; i < b->pred_count; ++i)
+                fprintf(out, " bb%zu", b->preds[i]);
+        }
+        fprintf(out, "\n");
+
+        for (size_t i = 0; i < b->inst_count; ++i)
+            ir_dump_value_(out, module, fn, b->insts[i]);
+
+        for (size_t i = 0; i < b->copy_count; ++i)
+            fprintf(out, "    v%zu <- v%zu\n", b->copies[i].dst, b->copies[i].src);
+
+        switch (b->term)
+        {
+            case IR_TERM_JMP:
+                fprintf(out, "    jmp bb%zu\n", b->succ[0]);
+                break;
+            case IR_TERM_BR:
+                fprintf(out, "    br v%zu, bb%zu, bb%zu", ir_resolve(fn, b->cond), b->succ[0], b->succ[1]);
+                if (b->weight[0] || b->weight[1])
+                    fprintf(out, "  ; runs %zu/%zu", b->weight[0], b->weight[1]);
+                fprintf(out, "\n");
+                break;
+            case IR_TERM_RET:
+                if (b->cond != IR_NONE) fprintf(out, "    ret v%zu\n", ir_resolve(fn, b->cond));
+                else                    fprintf(out, "    ret\n");
+                break;
+            case IR_TERM_NONE:
+            default:
+                fprintf(out, "    ; no terminator\n");
+                break;
+        }
+    }
+
+    fprintf(out, "\n");
+}
+
+void ir_dump(FILE* out, const ir_module_t* module)
+{
+    if (!out || !module) return;
+
+    for (size_t i = 0; i < module->func_count; ++i)
+        ir_dump_func_(out, module, &module->funcs[i]);
+}
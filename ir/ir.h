@@ -0,0 +1,178 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "../ast/ast.h"
+#include "../libs/instruction_set/instruction_set.h"
+
+/*
+    Mid-level IR: every function is a CFG of basic blocks, every instruction
+    is an SSA value. Locals and params exist only as values, joins merge
+    them with phi nodes
+*/
+
+// X(sym, name, has_effect): values with effects are never moved or dropped
+#define IR_OP_LIST(X)                          \
+    X(IR_OP_CONST,     "const",     0)         \
+    X(IR_OP_PARAM,     "param",     0)         \
+    X(IR_OP_PHI,       "phi",       0)         \
+    X(IR_OP_ADD,       "add",       0)         \
+    X(IR_OP_SUB,       "sub",       0)         \
+    X(IR_OP_MUL,       "mul",       0)         \
+    X(IR_OP_DIV,       "div",       0)         \
+    X(IR_OP_POW,       "pow",       0)         \
+    X(IR_OP_NEG,       "neg",       0)         \
+    X(IR_OP_NOT,       "not",       0)         \
+    X(IR_OP_AND,       "and",       0)         \
+    X(IR_OP_OR,        "or",        0)         \
+    X(IR_OP_EQ,        "eq",        0)         \
+    X(IR_OP_NE,        "ne",        0)         \
+    X(IR_OP_LT,        "lt",        0)         \
+    X(IR_OP_LE,        "le",        0)         \
+    X(IR_OP_GT,        "gt",        0)         \
+    X(IR_OP_GE,        "ge",        0)         \
+    X(IR_OP_ITOF,      "itof",      0)         \
+    X(IR_OP_FTOI,      "ftoi",      0)         \
+    X(IR_OP_FLOOR,     "floor",     0)         \
+    X(IR_OP_CEIL,      "ceil",      0)         \
+    X(IR_OP_ROUND,     "round",     0)         \
+    X(IR_OP_CALL,      "call",      1)         \
+    X(IR_OP_IN,        "in",        1)         \
+    X(IR_OP_FIN,       "fin",       1)         \
+    X(IR_OP_CIN,       "cin",       1)         \
+    X(IR_OP_DRAW,      "draw",      1)         \
+    X(IR_OP_CLEANVM,   "clean_vm",  1)         \
+    X(IR_OP_OUT,       "out",       1)         \
+    X(IR_OP_FOUT,      "fout",      1)         \
+    X(IR_OP_COUT,      "cout",      1)         \
+    X(IR_OP_SET_PIXEL, "set_pixel", 1)
+
+typedef enum
+{
+#define IR_OP_ENUM(sym, str, eff) sym,
+    IR_OP_LIST(IR_OP_ENUM)
+#undef IR_OP_ENUM
+
+    IR_OP_COUNT
+} ir_op_t;
+
+typedef enum
+{
+    IR_TERM_NONE = 0,  // block still open
+    IR_TERM_JMP,       // succ[0]
+    IR_TERM_BR,        // cond ? succ[0] : succ[1]
+    IR_TERM_RET,       // cond is returned value or IR_NONE
+} ir_term_t;
+
+typedef size_t ir_id_t;
+
+#define IR_NONE SIZE_MAX
+
+typedef struct
+{
+    ir_op_t    op;
+    ast_type_t type;      // result type, VOID when there is no result
+    size_t     block;
+
+    ir_id_t*   args;      // phi: one per block pred, in pred order
+    size_t     arg_count;
+    size_t     arg_cap;
+
+    union { i64_t i; f64_t f; } imm;  // CONST value, PARAM index
+
+    size_t     name_id;   // CALL callee, PARAM/PHI source variable, SIZE_MAX if none
+    ir_id_t    forward;   // removed value is replaced by this one, IR_NONE if alive
+} ir_value_t;
+
+typedef struct
+{
+    ir_id_t dst;  // phi
+    ir_id_t src;
+} ir_copy_t;
+
+typedef struct
+{
+    ir_id_t* insts;       // phis first
+    size_t   inst_count;
+    size_t   inst_cap;
+
+    size_t*  preds;
+    size_t   pred_count;
+    size_t   pred_cap;
+
+    ir_term_t term;
+    ir_id_t   cond;
+    size_t    succ[2];
+    size_t    weight[2];  // profiled runs of each BR edge, both 0 without a profile
+
+    ir_copy_t* copies;    // parallel copies run before the terminator, out of SSA only
+    size_t     copy_count;
+    size_t     copy_cap;
+
+    int sealed;
+    int reachable;
+} ir_block_t;
+
+typedef struct
+{
+    size_t      name_id;
+    ast_type_t  ret_type;
+
+    size_t      param_count;
+    ast_type_t* param_types;
+
+    ir_block_t* blocks;   // blocks[0] is entry
+    size_t      block_count;
+    size_t      block_cap;
+
+    ir_value_t* values;
+    size_t      value_count;
+    size_t      value_cap;
+
+    int         in_ssa;   // 0 once phis are lowered to copies
+} ir_func_t;
+
+typedef struct
+{
+    const ast_tree_t* tree;
+
+    ir_func_t* funcs;     // in PROGRAM order
+    size_t     func_count;
+    size_t     func_cap;
+} ir_module_t;
+
+/*
+    Build SSA form of every function. On failure message and position go to
+    op->error_msg / op->error_pos, module is left for ir_module_dtor
+*/
+err_t ir_build(ir_module_t* module, const ast_tree_t* tree, operational_data_t* op);
+void  ir_module_dtor(ir_module_t* module);
+
+/*
+    Split critical edges and replace phi operands with parallel copies at
+    the end of predecessors. Phis stay as the copies destinations
+*/
+err_t ir_out_of_ssa(ir_module_t* module);
+
+void  ir_dump(FILE* out, const ir_module_t* module);
+
+/*
+    Helpers shared by builder and passes. Ids stay valid across growth,
+    pointers into values/blocks do not
+*/
+ir_id_t ir_value_new   (ir_func_t* fn, ir_op_t op, ast_type_t type, size_t block);
+err_t   ir_value_arg   (ir_func_t* fn, ir_id_t value, ir_id_t arg);
+size_t  ir_block_new   (ir_func_t* fn);
+err_t   ir_block_append(ir_func_t* fn, size_t block, ir_id_t value);
+err_t   ir_block_pred  (ir_func_t* fn, size_t block, size_t pred);
+ir_id_t ir_resolve     (const ir_func_t* fn, ir_id_t value);
+
+int         ir_op_has_effect(ir_op_t op);
+const char* ir_op_name      (ir_op_t op);
+
+size_t ir_module_blocks(const ir_module_t* module);
+size_t ir_module_values(const ir_module_t* module);
+
+#endif
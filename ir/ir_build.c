@@ -0,0 +1,1248 @@
+#include "ir.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+// AST -> SSA in one walk, after Braun et al. "Simple and Efficient
+// Construction of SSA Form": a variable read looks for the definition in the
+// current block and then in predecessors, placing phis at joins. Blocks whose
+// predecessors are not all known yet (loop headers) are left unsealed and get
+// operand-less phis which are completed when the block is sealed
+
+typedef struct
+{
+    size_t name_id;
+    size_t var;
+    size_t depth;
+} ir_bind_t;
+
+typedef struct
+{
+    ast_type_t type;
+    size_t     name_id;
+} ir_var_t;
+
+typedef struct
+{
+    size_t  var;
+    ir_id_t phi;
+} ir_pending_t;
+
+typedef struct
+{
+    ir_pending_t* items;
+    size_t        count;
+    size_t        cap;
+} ir_pending_list_t;
+
+typedef struct
+{
+    size_t  var;
+    size_t  block;
+    ir_id_t value;  // IR_NONE = empty slot
+} ir_def_t;
+
+typedef struct
+{
+    const ast_tree_t*   tree;
+    operational_data_t* op;
+    ir_module_t*        module;
+    ir_func_t*          fn;
+
+    size_t cur;  // block receiving code, IR_NONE right after a terminator
+
+    ir_var_t* vars;
+    size_t    var_count;
+    size_t    var_cap;
+
+    ir_bind_t* binds;
+    size_t     bind_count;
+    size_t     bind_cap;
+    size_t     depth;
+
+    size_t* loop_exits;
+    size_t  loop_count;
+    size_t  loop_cap;
+
+    ir_def_t* defs;      // (var, block) -> current value, open addressing
+    size_t    def_count;
+    size_t    def_cap;
+
+    ir_pending_list_t* pending;  // per block, phis waiting for block seal
+    size_t             pending_cap;
+} ir_builder_t;
+
+static void ib_set_error_(ir_builder_t* ib, const ast_node_t* node, const char* fmt, ...)
+{
+    if (!ib->op) return;
+
+    const token_pos_t pos = node ? node->pos : (token_pos_t){ 0 };
+    ib->op->error_pos = pos.offset;
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(ib->op->error_msg, sizeof(ib->op->error_msg), fmt, ap);
+    va_end(ap);
+
+    size_t len = strlen(ib->op->error_msg);
+    snprintf(ib->op->error_msg + len, sizeof(ib->op->error_msg) - len,
+             " at %zu:%zu (offset: %zu)", pos.line, pos.column, pos.offset);
+}
+
+#define IB_FAIL(ib, node, fmt, ...)                             \
+    block_begin                                                 \
+        ib_set_error_((ib), (node), (fmt), ##__VA_ARGS__);      \
+        return ERR_SYNTAX;                                      \
+    block_end
+
+#define IB_CHECK(ib, cond, node, fmt, ...)                      \
+    block_begin                                                 \
+        if (!(cond)) IB_FAIL((ib), (node), (fmt), ##__VA_ARGS__); \
+    block_end
+
+#define IB_GROW(ptr, cap, want, type)                                       \
+    block_begin                                                             \
+        if ((want) > (cap)) {                                               \
+            size_t new_cap = (cap) ? (cap) * 2 : 8;                         \
+            while (new_cap < (want)) new_cap *= 2;                          \
+            void* np = mem_realloc(MEM_TAG_IR, (ptr), new_cap * sizeof(type)); \
+            if (!np) return ERR_ALLOC;                                      \
+            (ptr) = (type*)np;                                              \
+            (cap) = new_cap;                                                \
+        }                                                                   \
+    block_end
+
+static int streq_(const char* a, const char* b) { return (a && b && strcmp(a, b) == 0); }
+
+static err_t ib_stmt_(ir_builder_t* ib, const ast_node_t* st);
+static err_t ib_expr_(ir_builder_t* ib, const ast_node_t* e, ir_id_t* out);
+
+// ================================== blocks ==================================
+
+static err_t ib_new_block_(ir_builder_t* ib, size_t* out)
+{
+    const size_t id = ir_block_new(ib->fn);
+    if (id == IR_NONE) return ERR_ALLOC;
+
+    if (id >= ib->pending_cap)
+    {
+        const size_t old_cap = ib->pending_cap;
+        IB_GROW(ib->pending, ib->pending_cap, id + 1, ir_pending_list_t);
+        memset(ib->pending + old_cap, 0, (ib->pending_cap - old_cap) * sizeof(ir_pending_list_t));
+    }
+
+    *out = id;
+    return OK;
+}
+
+// statements after micdrop/gg land in a fresh block nobody jumps to
+static err_t ib_ensure_block_(ir_builder_t* ib)
+{
+    if (ib->cur != IR_NONE) return OK;
+
+    err_t rc = ib_new_block_(ib, &ib->cur);
+    if (rc != OK) return rc;
+
+    ib->fn->blocks[ib->cur].sealed = 1;
+    return OK;
+}
+
+static err_t ib_jump_(ir_builder_t* ib, size_t target)
+{
+    if (ib->cur == IR_NONE) return OK;
+
+    ir_block_t* b = &ib->fn->blocks[ib->cur];
+    b->term    = IR_TERM_JMP;
+    b->succ[0] = target;
+
+    err_t rc = ir_block_pred(ib->fn, target, ib->cur);
+    ib->cur = IR_NONE;
+    return rc;
+}
+
+static err_t ib_branch_(ir_builder_t* ib, ir_id_t cond, size_t if_true, size_t if_false)
+{
+    ir_block_t* b = &ib->fn->blocks[ib->cur];
+    b->term    = IR_TERM_BR;
+    b->cond    = cond;
+    b->succ[0] = if_true;
+    b->succ[1] = if_false;
+
+    err_t rc = ir_block_pred(ib->fn, if_true, ib->cur);
+    if (rc == OK) rc = ir_block_pred(ib->fn, if_false, ib->cur);
+    ib->cur = IR_NONE;
+    return rc;
+}
+
+// ================================== values ==================================
+
+static err_t ib_value_(ir_builder_t* ib, ir_op_t op, ast_type_t type,
+                       ir_id_t a, ir_id_t b, ir_id_t* out)
+{
+    const ir_id_t v = ir_value_new(ib->fn, op, type, ib->cur);
+    if (v == IR_NONE) return ERR_ALLOC;
+
+    err_t rc = OK;
+    if (a != IR_NONE) rc = ir_value_arg(ib->fn, v, a);
+    if (rc == OK && b != IR_NONE) rc = ir_value_arg(ib->fn, v, b);
+    if (rc == OK) rc = ir_block_append(ib->fn, ib->cur, v);
+    if (rc != OK) return rc;
+
+    *out = v;
+    return OK;
+}
+
+static err_t ib_const_in_(ir_builder_t* ib, size_t block, ast_type_t type, ir_id_t* out)
+{
+    const ir_id_t v = ir_value_new(ib->fn, IR_OP_CONST, type == AST_TYPE_FLOAT ? AST_TYPE_FLOAT : AST_TYPE_INT, block);
+    if (v == IR_NONE) return ERR_ALLOC;
+
+    if (type == AST_TYPE_FLOAT) ib->fn->values[v].imm.f = 0.0;
+    else                        ib->fn->values[v].imm.i = 0;
+
+    *out = v;
+    return ir_block_append(ib->fn, block, v);
+}
+
+static ast_type_t ib_type_(const ir_builder_t* ib, ir_id_t v)
+{
+    return ib->fn->values[v].type;
+}
+
+// int <-> float conversion of v to the type of a slot/param/return
+static err_t ib_convert_(ir_builder_t* ib, ir_id_t v, ast_type_t to, ir_id_t* out)
+{
+    const ast_type_t from = ib_type_(ib, v);
+
+    if (to == AST_TYPE_FLOAT && from != AST_TYPE_FLOAT)
+        return ib_value_(ib, IR_OP_ITOF, AST_TYPE_FLOAT, v, IR_NONE, out);
+
+    if ((to == AST_TYPE_INT || to == AST_TYPE_PTR) && from == AST_TYPE_FLOAT)
+        return ib_value_(ib, IR_OP_FTOI, AST_TYPE_INT, v, IR_NONE, out);
+
+    *out = v;
+    return OK;
+}
+
+// ================================ variables =================================
+
+static err_t ib_var_new_(ir_builder_t* ib, size_t name_id, ast_type_t type, size_t* out)
+{
+    IB_GROW(ib->vars, ib->var_cap, ib->var_count + 1, ir_var_t);
+    ib->vars[ib->var_count] = (ir_var_t){ .type = type, .name_id = name_id };
+
+    IB_GROW(ib->binds, ib->bind_cap, ib->bind_count + 1, ir_bind_t);
+    ib->binds[ib->bind_count++] = (ir_bind_t){ .name_id = name_id, .var = ib->var_count, .depth = ib->depth };
+
+    *out = ib->var_count++;
+    return OK;
+}
+
+static size_t ib_var_lookup_(const ir_builder_t* ib, size_t name_id)
+{
+    for (size_t i = ib->bind_count; i > 0; --i)
+        if (ib->binds[i - 1].name_id == name_id)
+            return ib->binds[i - 1].var;
+    return IR_NONE;
+}
+
+static size_t def_hash_(size_t var, size_t block)
+{
+    return (var * 0x9E3779B97F4A7C15ull) ^ (block * 0xC2B2AE3D27D4EB4Full);
+}
+
+static ir_def_t* def_slot_(ir_def_t* defs, size_t cap, size_t var, size_t block)
+{
+    size_t i = def_hash_(var, block) & (cap - 1);
+    while (defs[i].value != IR_NONE && (defs[i].var != var || defs[i].block != block))
+        i = (i + 1) & (cap - 1);
+    return &defs[i];
+}
+
+static err_t ib_def_grow_(ir_builder_t* ib)
+{
+    const size_t new_cap = ib->def_cap ? ib->def_cap * 2 : 64;
+
+    ir_def_t* nd = (ir_def_t*)mem_alloc(MEM_TAG_IR, new_cap * sizeof(ir_def_t));
+    if (!nd) return ERR_ALLOC;
+    for (size_t i = 0; i < new_cap; ++i) nd[i].value = IR_NONE;
+
+    for (size_t i = 0; i < ib->def_cap; ++i)
+        if (ib->defs[i].value != IR_NONE)
+            *def_slot_(nd, new_cap, ib->defs[i].var, ib->defs[i].block) = ib->defs[i];
+
+    mem_free(ib->defs);
+    ib->defs    = nd;
+    ib->def_cap = new_cap;
+    return OK;
+}
+
+static err_t ib_def_write_(ir_builder_t* ib, size_t var, size_t block, ir_id_t value)
+{
+    if (2 * (ib->def_count + 1) > ib->def_cap)
+    {
+        err_t rc = ib_def_grow_(ib);
+        if (rc != OK) return rc;
+    }
+
+    ir_def_t* d = def_slot_(ib->defs, ib->def_cap, var, block);
+    if (d->value == IR_NONE) ib->def_count++;
+    *d = (ir_def_t){ .var = var, .block = block, .value = value };
+    return OK;
+}
+
+static err_t ib_insert_phi_(ir_builder_t* ib, size_t block, size_t var, ir_id_t* out)
+{
+    const ir_id_t phi = ir_value_new(ib->fn, IR_OP_PHI, ib->vars[var].type, block);
+    if (phi == IR_NONE) return ERR_ALLOC;
+    ib->fn->values[phi].name_id = ib->vars[var].name_id;
+
+    err_t rc = ir_block_append(ib->fn, block, phi);
+    if (rc != OK) return rc;
+
+    // keep phis in front of the block
+    ir_block_t* b = &ib->fn->blocks[block];
+    size_t at = 0;
+    while (at < b->inst_count - 1 && ib->fn->values[b->insts[at]].op == IR_OP_PHI) at++;
+    memmove(b->insts + at + 1, b->insts + at, (b->inst_count - 1 - at) * sizeof(ir_id_t));
+    b->insts[at] = phi;
+
+    *out = phi;
+    return OK;
+}
+
+// phi whose operands are all the same value (or the phi itself) is that value
+static err_t ib_phi_simplify_(ir_builder_t* ib, ir_id_t phi, ir_id_t* out)
+{
+    ir_id_t same = IR_NONE;
+    const ir_value_t* p = &ib->fn->values[phi];
+
+    for (size_t i = 0; i < p->arg_count; ++i)
+    {
+        const ir_id_t a = ir_resolve(ib->fn, p->args[i]);
+        if (a == same || a == phi) continue;
+        if (same != IR_NONE) { *out = phi; return OK; }
+        same = a;
+    }
+
+    // no operands besides itself: unreachable or undefined, reads as zero
+    if (same == IR_NONE)
+    {
+        err_t rc = ib_const_in_(ib, ib->fn->values[phi].block, ib->fn->values[phi].type, &same);
+        if (rc != OK) return rc;
+    }
+
+    ib->fn->values[phi].forward = same;
+    *out = same;
+    return OK;
+}
+
+static err_t ib_var_read_(ir_builder_t* ib, size_t var, size_t block, ir_id_t* out);
+
+static err_t ib_phi_operands_(ir_builder_t* ib, size_t var, ir_id_t phi, ir_id_t* out)
+{
+    const size_t block = ib->fn->values[phi].block;
+
+    for (size_t i = 0; i < ib->fn->blocks[block].pred_count; ++i)
+    {
+        ir_id_t v = IR_NONE;
+        err_t rc = ib_var_read_(ib, var, ib->fn->blocks[block].preds[i], &v);
+        if (rc == OK) rc = ir_value_arg(ib->fn, phi, v);
+        if (rc != OK) return rc;
+    }
+
+    return ib_phi_simplify_(ib, phi, out);
+}
+
+static err_t ib_var_read_rec_(ir_builder_t* ib, size_t var, size_t block, ir_id_t* out)
+{
+    const ir_block_t* b = &ib->fn->blocks[block];
+    ir_id_t v = IR_NONE;
+    err_t rc = OK;
+
+    if (!b->sealed)
+    {
+        rc = ib_insert_phi_(ib, block, var, &v);
+        if (rc != OK) return rc;
+
+        ir_pending_list_t* pl = &ib->pending[block];
+        IB_GROW(pl->items, pl->cap, pl->count + 1, ir_pending_t);
+        pl->items[pl->count++] = (ir_pending_t){ .var = var, .phi = v };
+    }
+    else if (b->pred_count == 0)
+    {
+        rc = ib_const_in_(ib, block, ib->vars[var].type, &v);
+    }
+    else if (b->pred_count == 1)
+    {
+        rc = ib_var_read_(ib, var, b->preds[0], &v);
+    }
+    else
+    {
+        ir_id_t phi = IR_NONE;
+        rc = ib_insert_phi_(ib, block, var, &phi);
+        // break cycles through loops before visiting predecessors
+        if (rc == OK) rc = ib_def_write_(ib, var, block, phi);
+        if (rc == OK) rc = ib_phi_operands_(ib, var, phi, &v);
+    }
+
+    if (rc == OK) rc = ib_def_write_(ib, var, block, v);
+    if (rc == OK) *out = v;
+    return rc;
+}
+
+static err_t ib_var_read_(ir_builder_t* ib, size_t var, size_t block, ir_id_t* out)
+{
+    if (ib->def_cap)
+    {
+        const ir_def_t* d = def_slot_(ib->defs, ib->def_cap, var, block);
+        if (d->value != IR_NONE)
+        {
+            *out = ir_resolve(ib->fn, d->value);
+            return OK;
+        }
+    }
+
+    return ib_var_read_rec_(ib, var, block, out);
+}
+
+static err_t ib_seal_(ir_builder_t* ib, size_t block)
+{
+    ir_pending_list_t* pl = &ib->pending[block];
+
+    for (size_t i = 0; i < pl->count; ++i)
+    {
+        ir_id_t v = IR_NONE;
+        err_t rc = ib_phi_operands_(ib, pl->items[i].var, pl->items[i].phi, &v);
+        if (rc != OK) return rc;
+    }
+
+    mem_free(pl->items);
+    *pl = (ir_pending_list_t){ 0 };
+
+    ib->fn->blocks[block].sealed = 1;
+    return OK;
+}
+
+// ================================ expressions ===============================
+
+static size_t arg_count_(const ast_node_t* args)
+{
+    size_t n = 0;
+    for (const ast_node_t* a = args ? args->left : NULL; a; a = a->right) n++;
+    return n;
+}
+
+static const ir_func_t* ib_find_func_(const ir_builder_t* ib, size_t name_id)
+{
+    for (size_t i = 0; i < ib->module->func_count; ++i)
+        if (ib->module->funcs[i].name_id == name_id)
+            return &ib->module->funcs[i];
+    return NULL;
+}
+
+typedef struct
+{
+    const char* name;
+    const char* alias;
+    ir_op_t     op;
+    size_t      argc;
+    ast_type_t  ret;
+    ast_type_t  arg;  // every argument is converted to this
+} ib_builtin_t;
+
+static const ib_builtin_t ib_builtins[] = {
+    { "in",        "cap",     IR_OP_IN,        0, AST_TYPE_INT,   AST_TYPE_INT   },
+    { "fin",       "nocap",   IR_OP_FIN,       0, AST_TYPE_FLOAT, AST_TYPE_INT   },
+    { "cin",       "stinky",  IR_OP_CIN,       0, AST_TYPE_INT,   AST_TYPE_INT   },
+    { "draw",      "gyat",    IR_OP_DRAW,      0, AST_TYPE_VOID,  AST_TYPE_INT   },
+    { "clean_vm",  "skibidi", IR_OP_CLEANVM,   0, AST_TYPE_VOID,  AST_TYPE_INT   },
+    { "out",       "pookie",  IR_OP_OUT,       1, AST_TYPE_INT,   AST_TYPE_INT   },
+    { "fout",      "rizz",    IR_OP_FOUT,      1, AST_TYPE_FLOAT, AST_TYPE_FLOAT },
+    { "cout",      "menace",  IR_OP_COUT,      1, AST_TYPE_INT,   AST_TYPE_INT   },
+    { "set_pixel", NULL,      IR_OP_SET_PIXEL, 3, AST_TYPE_VOID,  AST_TYPE_INT   },
+};
+
+static err_t ib_call_(ir_builder_t* ib, const ast_node_t* call, ir_id_t* out)
+{
+    const char*       name = ast_name_cstr(ib->tree, call->u.call.name_id);
+    const ast_node_t* args = call->left;
+    const size_t      argc = arg_count_(args);
+
+    ir_op_t    op       = IR_OP_CALL;
+    ast_type_t ret_type = AST_TYPE_VOID;
+    const ir_func_t*    callee  = NULL;
+    const ib_builtin_t* builtin = NULL;
+
+    for (size_t i = 0; i < sizeof(ib_builtins) / sizeof(ib_builtins[0]); ++i)
+        if (streq_(name, ib_builtins[i].name) || streq_(name, ib_builtins[i].alias))
+            { builtin = &ib_builtins[i]; break; }
+
+    if (builtin)
+    {
+        IB_CHECK(ib, argc == builtin->argc, call, "%s() takes %zu args", name, builtin->argc);
+        op       = builtin->op;
+        ret_type = builtin->ret;
+    }
+    else
+    {
+        callee = ib_find_func_(ib, call->u.call.name_id);
+        IB_CHECK(ib, callee != NULL, call, "Call to unknown function '%s'", name);
+        IB_CHECK(ib, args && args->kind == ASTK_ARG_LIST, call, "Internal: CALL missing ARG_LIST");
+        ret_type = callee->ret_type;
+    }
+
+    // arguments are evaluated left to right, set_pixel(x, y, ch) evaluates y first
+    ir_id_t argv[3] = { IR_NONE, IR_NONE, IR_NONE };
+    ir_id_t* vals = argv;
+    if (argc > 3)
+    {
+        vals = (ir_id_t*)mem_calloc(MEM_TAG_IR, argc, sizeof(ir_id_t));
+        if (!vals) return ERR_ALLOC;
+    }
+
+    err_t rc = OK;
+    size_t i = 0;
+    for (const ast_node_t* a = args ? args->left : NULL; a && rc == OK; a = a->right, ++i)
+    {
+        if (op == IR_OP_SET_PIXEL && i == 0) continue;
+
+        rc = ib_expr_(ib, a, &vals[i]);
+        if (rc == OK && op == IR_OP_SET_PIXEL && i == 1)
+            rc = ib_expr_(ib, args->left, &vals[0]);
+    }
+
+    for (i = 0; i < argc && rc == OK; ++i)
+    {
+        ast_type_t want = builtin ? builtin->arg
+                                  : (i < callee->param_count ? callee->param_types[i] : AST_TYPE_UNKNOWN);
+        if (ib_type_(ib, vals[i]) == AST_TYPE_VOID)
+        {
+            ib_set_error_(ib, call, "void value passed to '%s'", name);
+            rc = ERR_SYNTAX;
+            break;
+        }
+        rc = ib_convert_(ib, vals[i], want, &vals[i]);
+    }
+
+    ir_id_t v = IR_NONE;
+    if (rc == OK)
+    {
+        v = ir_value_new(ib->fn, op, ret_type, ib->cur);
+        if (v == IR_NONE) rc = ERR_ALLOC;
+    }
+
+    if (rc == OK && callee) ib->fn->values[v].name_id = call->u.call.name_id;
+
+    for (i = 0; i < argc && rc == OK; ++i)
+        rc = ir_value_arg(ib->fn, v, vals[i]);
+
+    if (rc == OK) rc = ir_block_append(ib->fn, ib->cur, v);
+    if (rc == OK) *out = v;
+
+    if (vals != argv) mem_free(vals);
+    return rc;
+}
+
+static ir_op_t ib_binary_op_(token_kind_t op)
+{
+    switch (op)
+    {
+        case TOK_OP_PLUS:  return IR_OP_ADD;
+        case TOK_OP_MINUS: return IR_OP_SUB;
+        case TOK_OP_MUL:   return IR_OP_MUL;
+        case TOK_OP_DIV:   return IR_OP_DIV;
+        case TOK_OP_POW:   return IR_OP_POW;
+        case TOK_OP_AND:   return IR_OP_AND;
+        case TOK_OP_OR:    return IR_OP_OR;
+        case TOK_OP_EQ:    return IR_OP_EQ;
+        case TOK_OP_NEQ:   return IR_OP_NE;
+        case TOK_OP_LT:    return IR_OP_LT;
+        case TOK_OP_LTE:   return IR_OP_LE;
+        case TOK_OP_GT:    return IR_OP_GT;
+        case TOK_OP_GTE:   return IR_OP_GE;
+        default:           return IR_OP_COUNT;
+    }
+}
+
+static err_t ib_binary_(ir_builder_t* ib, const ast_node_t* e, ir_id_t* out)
+{
+    const ast_node_t* a = e->left;
+    const ast_node_t* b = a ? a->right : NULL;
+    IB_CHECK(ib, a && b, e, "Binary missing operands");
+
+    const ir_op_t op = ib_binary_op_(e->u.binary.op);
+    IB_CHECK(ib, op != IR_OP_COUNT, e, "Unsupported binary operator");
+
+    ir_id_t va = IR_NONE, vb = IR_NONE;
+    err_t rc = ib_expr_(ib, a, &va);
+    if (rc == OK) rc = ib_expr_(ib, b, &vb);
+    if (rc != OK) return rc;
+
+    const ast_type_t ta = ib_type_(ib, va);
+    const ast_type_t tb = ib_type_(ib, vb);
+    IB_CHECK(ib, ta != AST_TYPE_VOID && tb != AST_TYPE_VOID, e, "void value used in expression");
+
+    const int any_float = (ta == AST_TYPE_FLOAT || tb == AST_TYPE_FLOAT);
+
+    switch (op)
+    {
+        case IR_OP_AND:
+        case IR_OP_OR:
+            rc = ib_convert_(ib, va, AST_TYPE_INT, &va);
+            if (rc == OK) rc = ib_convert_(ib, vb, AST_TYPE_INT, &vb);
+            if (rc != OK) return rc;
+            return ib_value_(ib, op, AST_TYPE_INT, va, vb, out);
+
+        // operand types pick POW/FPOW/POWF/FPOWF, no conversion
+        case IR_OP_POW:
+            return ib_value_(ib, op, any_float ? AST_TYPE_FLOAT : AST_TYPE_INT, va, vb, out);
+
+        case IR_OP_EQ: case IR_OP_NE:
+        case IR_OP_LT: case IR_OP_LE:
+        case IR_OP_GT: case IR_OP_GE:
+        {
+            const ast_type_t t = any_float ? AST_TYPE_FLOAT : AST_TYPE_INT;
+            rc = ib_convert_(ib, va, t, &va);
+            if (rc == OK) rc = ib_convert_(ib, vb, t, &vb);
+            if (rc != OK) return rc;
+            return ib_value_(ib, op, AST_TYPE_INT, va, vb, out);
+        }
+
+        default:
+        {
+            const ast_type_t t = any_float ? AST_TYPE_FLOAT : AST_TYPE_INT;
+            rc = ib_convert_(ib, va, t, &va);
+            if (rc == OK) rc = ib_convert_(ib, vb, t, &vb);
+            if (rc != OK) return rc;
+            return ib_value_(ib, op, t, va, vb, out);
+        }
+    }
+}
+
+static err_t ib_expr_(ir_builder_t* ib, const ast_node_t* e, ir_id_t* out)
+{
+    if (!e) return ERR_BAD_ARG;
+
+    switch (e->kind)
+    {
+        case ASTK_NUM_LIT:
+        {
+            const int is_float = (e->u.num.lit_type == LIT_FLOAT);
+            err_t rc = ib_value_(ib, IR_OP_CONST, is_float ? AST_TYPE_FLOAT : AST_TYPE_INT,
+                                 IR_NONE, IR_NONE, out);
+            if (rc != OK) return rc;
+
+            if (is_float) ib->fn->values[*out].imm.f = e->u.num.lit.f64;
+            else          ib->fn->values[*out].imm.i = e->u.num.lit.i64;
+            return OK;
+        }
+
+        case ASTK_IDENT:
+        {
+            const size_t var = ib_var_lookup_(ib, e->u.ident.name_id);
+            IB_CHECK(ib, var != IR_NONE, e, "Unknown identifier '%s'", ast_name_cstr(ib->tree, e->u.ident.name_id));
+            return ib_var_read_(ib, var, ib->cur, out);
+        }
+
+        case ASTK_CALL:
+            return ib_call_(ib, e, out);
+
+        case ASTK_UNARY:
+        {
+            IB_CHECK(ib, e->left != NULL, e, "Unary missing operand");
+
+            ir_id_t v = IR_NONE;
+            err_t rc = ib_expr_(ib, e->left, &v);
+            if (rc != OK) return rc;
+            IB_CHECK(ib, ib_type_(ib, v) != AST_TYPE_VOID, e, "void value used in expression");
+
+            switch (e->u.unary.op)
+            {
+                case TOK_OP_PLUS:
+                    *out = v;
+                    return OK;
+
+                case TOK_OP_MINUS:
+                    return ib_value_(ib, IR_OP_NEG, ib_type_(ib, v), v, IR_NONE, out);
+
+                case TOK_OP_NOT:
+                    rc = ib_convert_(ib, v, AST_TYPE_INT, &v);
+                    if (rc != OK) return rc;
+                    return ib_value_(ib, IR_OP_NOT, AST_TYPE_INT, v, IR_NONE, out);
+
+                default:
+                    IB_FAIL(ib, e, "Unsupported unary operator");
+            }
+        }
+
+        case ASTK_BUILTIN_UNARY:
+        {
+            IB_CHECK(ib, e->left != NULL, e, "builtin-unary missing operand");
+
+            ir_id_t v = IR_NONE;
+            err_t rc = ib_expr_(ib, e->left, &v);
+            if (rc != OK) return rc;
+            IB_CHECK(ib, ib_type_(ib, v) != AST_TYPE_VOID, e, "void value used in expression");
+
+            switch (e->u.builtin_unary.id)
+            {
+                case AST_BUILTIN_ITOF: return ib_convert_(ib, v, AST_TYPE_FLOAT, out);
+                case AST_BUILTIN_FTOI: return ib_convert_(ib, v, AST_TYPE_INT, out);
+                default: break;
+            }
+
+            const ir_op_t op = (e->u.builtin_unary.id == AST_BUILTIN_FLOOR) ? IR_OP_FLOOR
+                             : (e->u.builtin_unary.id == AST_BUILTIN_CEIL)  ? IR_OP_CEIL
+                             : (e->u.builtin_unary.id == AST_BUILTIN_ROUND) ? IR_OP_ROUND
+                             : IR_OP_COUNT;
+            IB_CHECK(ib, op != IR_OP_COUNT, e, "Unknown builtin-unary id");
+
+            rc = ib_convert_(ib, v, AST_TYPE_FLOAT, &v);
+            if (rc != OK) return rc;
+            return ib_value_(ib, op, AST_TYPE_FLOAT, v, IR_NONE, out);
+        }
+
+        case ASTK_BINARY:
+            return ib_binary_(ib, e, out);
+
+        default:
+            IB_FAIL(ib, e, "IR: unsupported expr kind %s", ast_kind_to_cstr(e->kind));
+    }
+}
+
+// ================================ statements ================================
+
+static err_t ib_block_(ir_builder_t* ib, const ast_node_t* block)
+{
+    ib->depth++;
+    const size_t depth = ib->depth;
+
+    for (const ast_node_t* c = block->left; c; c = c->right)
+    {
+        err_t rc = ib_stmt_(ib, c);
+        if (rc != OK) return rc;
+    }
+
+    while (ib->bind_count > 0 && ib->binds[ib->bind_count - 1].depth == depth)
+        ib->bind_count--;
+    ib->depth--;
+    return OK;
+}
+
+static err_t ib_while_(ir_builder_t* ib, const ast_node_t* w)
+{
+    const ast_node_t* cond = w->left;
+    const ast_node_t* body = cond ? cond->right : NULL;
+    IB_CHECK(ib, cond && body, w, "Internal: WHILE must have (cond, body)");
+
+    size_t header = 0, loop = 0, exit = 0;
+    err_t rc = ib_new_block_(ib, &header);
+    if (rc == OK) rc = ib_jump_(ib, header);
+    if (rc != OK) return rc;
+
+    // header stays unsealed until the back edge is known
+    ib->cur = header;
+
+    // lowkey (1): only gg leaves, the exit has no edge from the header
+    const int forever = cond->kind == ASTK_NUM_LIT && cond->u.num.lit_type == LIT_INT &&
+                        cond->u.num.lit.i64 != 0;
+
+    ir_id_t c = IR_NONE;
+    if (!forever) rc = ib_expr_(ib, cond, &c);
+    if (rc == OK) rc = ib_new_block_(ib, &loop);
+    if (rc == OK) rc = ib_new_block_(ib, &exit);
+    if (rc == OK) rc = forever ? ib_jump_(ib, loop) : ib_branch_(ib, c, loop, exit);
+    if (rc == OK) rc = ib_seal_(ib, loop);
+    if (rc != OK) return rc;
+
+    IB_GROW(ib->loop_exits, ib->loop_cap, ib->loop_count + 1, size_t);
+    ib->loop_exits[ib->loop_count++] = exit;
+
+    ib->cur = loop;
+    rc = ib_stmt_(ib, body);
+    if (rc == OK) rc = ib_jump_(ib, header);
+    ib->loop_count--;
+
+    if (rc == OK) rc = ib_seal_(ib, header);
+    if (rc == OK) rc = ib_seal_(ib, exit);
+
+    ib->cur = exit;
+    return rc;
+}
+
+static err_t ib_if_chain_(ir_builder_t* ib, const ast_node_t* ifn)
+{
+    // IF/BRANCH children: cond, stmt, [tail]
+    const ast_node_t* cond = ifn->left;
+    const ast_node_t* then = cond ? cond->right : NULL;
+    const ast_node_t* tail = then ? then->right : NULL;
+    IB_CHECK(ib, cond && then, ifn, "Internal: IF missing children");
+
+    size_t end = 0;
+    err_t rc = ib_new_block_(ib, &end);
+    if (rc != OK) return rc;
+
+    // runs of the chain left for this test, from the profile
+    size_t tested = ifn->u.arm.total;
+    const ast_node_t* arm = ifn;
+
+    while (1)
+    {
+        size_t then_b = 0, next_b = 0;
+        ir_id_t c = IR_NONE;
+
+        rc = ib_expr_(ib, cond, &c);
+        if (rc == OK) rc = ib_new_block_(ib, &then_b);
+        if (rc == OK) rc = ib_new_block_(ib, &next_b);
+
+        const size_t hits = arm->u.arm.hits;
+        if (rc == OK)
+        {
+            ir_block_t* b = &ib->fn->blocks[ib->cur];
+            b->weight[0] = hits;
+            b->weight[1] = (tested > hits) ? tested - hits : 0;
+            tested       = b->weight[1];
+        }
+        if (rc == OK) rc = ib_branch_(ib, c, then_b, next_b);
+        if (rc == OK) rc = ib_seal_(ib, then_b);
+        if (rc == OK) rc = ib_seal_(ib, next_b);
+        if (rc != OK) return rc;
+
+        ib->cur = then_b;
+        rc = ib_stmt_(ib, then);
+        if (rc == OK) rc = ib_jump_(ib, end);
+        if (rc != OK) return rc;
+
+        ib->cur = next_b;
+        if (!tail) break;
+
+        if (tail->kind == ASTK_ELSE)
+        {
+            IB_CHECK(ib, tail->left != NULL, tail, "Internal: ELSE missing body");
+            rc = ib_stmt_(ib, tail->left);
+            if (rc != OK) return rc;
+            break;
+        }
+
+        IB_CHECK(ib, tail->kind == ASTK_BRANCH, tail, "Internal: IF tail is not BRANCH/ELSE");
+
+        arm  = tail;
+        cond = tail->left;
+        then = cond ? cond->right : NULL;
+        tail = then ? then->right : NULL;
+        IB_CHECK(ib, cond && then, ifn, "Internal: BRANCH missing (cond, stmt)");
+
+        rc = ib_ensure_block_(ib);
+        if (rc != OK) return rc;
+    }
+
+    rc = ib_jump_(ib, end);
+    if (rc == OK) rc = ib_seal_(ib, end);
+    ib->cur = end;
+    return rc;
+}
+
+static err_t ib_return_(ir_builder_t* ib, const ast_node_t* r)
+{
+    ir_block_t* b = &ib->fn->blocks[ib->cur];
+    ir_id_t v = IR_NONE;
+    err_t rc = OK;
+
+    // void functions ignore the optional expression
+    if (ib->fn->ret_type != AST_TYPE_VOID)
+    {
+        if (r && r->left)
+        {
+            rc = ib_expr_(ib, r->left, &v);
+            if (rc == OK && ib_type_(ib, v) == AST_TYPE_VOID)
+                IB_FAIL(ib, r, "void value returned from '%s'", ast_name_cstr(ib->tree, ib->fn->name_id));
+        }
+        else
+            rc = ib_const_in_(ib, ib->cur, AST_TYPE_INT, &v);
+
+        if (rc == OK) rc = ib_convert_(ib, v, ib->fn->ret_type, &v);
+        if (rc != OK) return rc;
+        b = &ib->fn->blocks[ib->cur];
+    }
+
+    b->term = IR_TERM_RET;
+    b->cond = v;
+    ib->cur = IR_NONE;
+    return OK;
+}
+
+static err_t ib_store_(ir_builder_t* ib, const ast_node_t* node, size_t var, const ast_node_t* rhs)
+{
+    ir_id_t v = IR_NONE;
+    err_t rc = OK;
+
+    if (rhs)
+    {
+        rc = ib_expr_(ib, rhs, &v);
+        if (rc == OK) IB_CHECK(ib, ib_type_(ib, v) != AST_TYPE_VOID, node, "void value assigned");
+        if (rc == OK) rc = ib_convert_(ib, v, ib->vars[var].type, &v);
+    }
+    else
+        rc = ib_const_in_(ib, ib->cur, ib->vars[var].type, &v);
+
+    if (rc != OK) return rc;
+    return ib_def_write_(ib, var, ib->cur, v);
+}
+
+static err_t ib_stmt_(ir_builder_t* ib, const ast_node_t* st)
+{
+    if (!st) return OK;
+
+    err_t rc = ib_ensure_block_(ib);
+    if (rc != OK) return rc;
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:  return ib_block_(ib, st);
+        case ASTK_WHILE:  return ib_while_(ib, st);
+        case ASTK_IF:     return ib_if_chain_(ib, st);
+        case ASTK_RETURN: return ib_return_(ib, st);
+
+        case ASTK_BREAK:
+            IB_CHECK(ib, ib->loop_count > 0, st, "gg used outside of a loop");
+            return ib_jump_(ib, ib->loop_exits[ib->loop_count - 1]);
+
+        case ASTK_VAR_DECL:
+        {
+            // init is evaluated before the name comes into scope
+            ir_id_t v = IR_NONE;
+            if (st->left)
+            {
+                rc = ib_expr_(ib, st->left, &v);
+                if (rc == OK) IB_CHECK(ib, ib_type_(ib, v) != AST_TYPE_VOID, st, "void value assigned");
+                if (rc == OK) rc = ib_convert_(ib, v, st->u.vdecl.type, &v);
+            }
+            else
+                rc = ib_const_in_(ib, ib->cur, st->u.vdecl.type, &v);
+
+            size_t var = 0;
+            if (rc == OK) rc = ib_var_new_(ib, st->u.vdecl.name_id, st->u.vdecl.type, &var);
+            if (rc == OK) rc = ib_def_write_(ib, var, ib->cur, v);
+            return rc;
+        }
+
+        case ASTK_ASSIGN:
+        {
+            IB_CHECK(ib, st->left != NULL, st, "Assignment missing RHS");
+            const size_t var = ib_var_lookup_(ib, st->u.assign.name_id);
+            IB_CHECK(ib, var != IR_NONE, st, "Assignment to unknown '%s'", ast_name_cstr(ib->tree, st->u.assign.name_id));
+            return ib_store_(ib, st, var, st->left);
+        }
+
+        case ASTK_EXPR_STMT:
+        case ASTK_CALL_STMT:
+        {
+            IB_CHECK(ib, st->left != NULL, st, "statement missing expression");
+            ir_id_t v = IR_NONE;
+            return ib_expr_(ib, st->left, &v);
+        }
+
+        case ASTK_COUT:
+        case ASTK_ICOUT:
+        case ASTK_FCOUT:
+        {
+            IB_CHECK(ib, st->left != NULL, st, "print missing expression");
+
+            const int is_float = (st->kind == ASTK_FCOUT);
+            ir_id_t v = IR_NONE;
+            rc = ib_expr_(ib, st->left, &v);
+            if (rc == OK) IB_CHECK(ib, ib_type_(ib, v) != AST_TYPE_VOID, st, "void value printed");
+            if (rc == OK) rc = ib_convert_(ib, v, is_float ? AST_TYPE_FLOAT : AST_TYPE_INT, &v);
+            if (rc == OK) rc = ib_value_(ib, is_float ? IR_OP_FOUT : IR_OP_OUT,
+                                         is_float ? AST_TYPE_FLOAT : AST_TYPE_INT, v, IR_NONE, &v);
+            return rc;
+        }
+
+        default:
+            IB_FAIL(ib, st, "IR: unsupported statement kind %s", ast_kind_to_cstr(st->kind));
+    }
+}
+
+// ================================= functions ================================
+
+static void ib_mark_reachable_(ir_func_t* fn)
+{
+    size_t* stack = (size_t*)mem_alloc(MEM_TAG_IR, (fn->block_count + 1) * sizeof(size_t));
+    if (!stack)
+    {
+        // conservative: keep everything
+        for (size_t i = 0; i < fn->block_count; ++i) fn->blocks[i].reachable = 1;
+        return;
+    }
+
+    size_t top = 0;
+    stack[top++] = 0;
+    fn->blocks[0].reachable = 1;
+
+    while (top > 0)
+    {
+        const ir_block_t* b = &fn->blocks[stack[--top]];
+        const size_t succ_count = (b->term == IR_TERM_BR) ? 2 : (b->term == IR_TERM_JMP) ? 1 : 0;
+
+        for (size_t i = 0; i < succ_count; ++i)
+            if (!fn->blocks[b->succ[i]].reachable)
+            {
+                fn->blocks[b->succ[i]].reachable = 1;
+                stack[top++] = b->succ[i];
+            }
+    }
+
+    mem_free(stack);
+}
+
+// A block whose only predecessor jumps straight to it is glued onto that
+// predecessor, so values computed there reach its copies without a slot
+static err_t ib_merge_blocks_(ir_func_t* fn)
+{
+    for (size_t bi = 1; bi < fn->block_count; ++bi)
+    {
+        ir_block_t* b = &fn->blocks[bi];
+        if (!b->reachable || b->pred_count != 1 || b->preds[0] == bi) continue;
+        if (b->inst_count > 0 && fn->values[b->insts[0]].op == IR_OP_PHI) continue;
+
+        const size_t pi = b->preds[0];
+        if (fn->blocks[pi].term != IR_TERM_JMP) continue;
+
+        for (size_t k = 0; k < b->inst_count; ++k)
+        {
+            fn->values[b->insts[k]].block = pi;
+            err_t rc = ir_block_append(fn, pi, b->insts[k]);
+            if (rc != OK) return rc;
+        }
+
+        b = &fn->blocks[bi];
+        ir_block_t* p = &fn->blocks[pi];
+        p->term    = b->term;
+        p->cond    = b->cond;
+        p->succ[0] = b->succ[0];
+        p->succ[1] = b->succ[1];
+        p->weight[0] = b->weight[0];
+        p->weight[1] = b->weight[1];
+
+        // successors keep the operand order of their phis
+        const size_t succ_count = (b->term == IR_TERM_BR) ? 2 : (b->term == IR_TERM_JMP) ? 1 : 0;
+        for (size_t i = 0; i < succ_count; ++i)
+        {
+            ir_block_t* s = &fn->blocks[b->succ[i]];
+            for (size_t k = 0; k < s->pred_count; ++k)
+                if (s->preds[k] == bi) s->preds[k] = pi;
+        }
+
+        b->inst_count = 0;
+        b->pred_count = 0;
+        b->term       = IR_TERM_NONE;
+        b->reachable  = 0;
+    }
+
+    return OK;
+}
+
+// drop unreachable predecessors (with their phi operands), fold phis that
+// became trivial and compact instruction lists
+static err_t ib_finish_func_(ir_builder_t* ib)
+{
+    ir_func_t* fn = ib->fn;
+    ib_mark_reachable_(fn);
+
+    for (size_t bi = 0; bi < fn->block_count; ++bi)
+    {
+        ir_block_t* b = &fn->blocks[bi];
+        if (!b->reachable) continue;
+
+        size_t keep = 0;
+        for (size_t i = 0; i < b->pred_count; ++i)
+        {
+            const int live = fn->blocks[b->preds[i]].reachable;
+
+            for (size_t k = 0; k < b->inst_count; ++k)
+            {
+                ir_value_t* phi = &fn->values[b->insts[k]];
+                if (phi->op != IR_OP_PHI) break;
+                if (live && i < phi->arg_count) phi->args[keep] = phi->args[i];
+            }
+
+            if (live) b->preds[keep++] = b->preds[i];
+        }
+
+        for (size_t k = 0; k < b->inst_count; ++k)
+        {
+            ir_value_t* phi = &fn->values[b->insts[k]];
+            if (phi->op != IR_OP_PHI) break;
+            if (phi->arg_count > keep) phi->arg_count = keep;
+        }
+        b->pred_count = keep;
+    }
+
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (size_t bi = 0; bi < fn->block_count; ++bi)
+        {
+            if (!fn->blocks[bi].reachable) continue;
+
+            for (size_t k = 0; k < fn->blocks[bi].inst_count; ++k)
+            {
+                const ir_id_t phi = fn->blocks[bi].insts[k];
+                if (fn->values[phi].op != IR_OP_PHI) break;
+                if (fn->values[phi].forward != IR_NONE) continue;
+
+                ir_id_t v = IR_NONE;
+                err_t rc = ib_phi_simplify_(ib, phi, &v);
+                if (rc != OK) return rc;
+                if (v != phi) changed = 1;
+            }
+        }
+    }
+
+    for (size_t vi = 0; vi < fn->value_count; ++vi)
+        for (size_t i = 0; i < fn->values[vi].arg_count; ++i)
+            fn->values[vi].args[i] = ir_resolve(fn, fn->values[vi].args[i]);
+
+    for (size_t bi = 0; bi < fn->block_count; ++bi)
+    {
+        ir_block_t* b = &fn->blocks[bi];
+        b->cond = ir_resolve(fn, b->cond);
+
+        size_t keep = 0;
+        for (size_t k = 0; k < b->inst_count; ++k)
+            if (fn->values[b->insts[k]].forward == IR_NONE)
+                b->insts[keep++] = b->insts[k];
+        b->inst_count = keep;
+    }
+
+    return ib_merge_blocks_(fn);
+}
+
+static void ib_reset_(ir_builder_t* ib, ir_func_t* fn)
+{
+    ib->fn         = fn;
+    ib->cur        = IR_NONE;
+    ib->var_count  = 0;
+    ib->bind_count = 0;
+    ib->depth      = 0;
+    ib->loop_count = 0;
+    ib->def_count  = 0;
+
+    for (size_t i = 0; i < ib->def_cap; ++i) ib->defs[i].value = IR_NONE;
+
+    for (size_t i = 0; i < ib->pending_cap; ++i)
+    {
+        mem_free(ib->pending[i].items);
+        ib->pending[i] = (ir_pending_list_t){ 0 };
+    }
+}
+
+static err_t ib_func_(ir_builder_t* ib, ir_func_t* fn, const ast_node_t* node)
+{
+    ib_reset_(ib, fn);
+    fn->in_ssa = 1;
+
+    size_t entry = 0;
+    err_t rc = ib_new_block_(ib, &entry);
+    if (rc != OK) return rc;
+
+    fn->blocks[entry].sealed = 1;
+    ib->cur   = entry;
+    ib->depth = 1;
+
+    const ast_node_t* plist = node->left;
+    size_t i = 0;
+    for (const ast_node_t* p = plist ? plist->left : NULL; p; p = p->right, ++i)
+    {
+        size_t  var = 0;
+        ir_id_t v   = IR_NONE;
+
+        rc = ib_var_new_(ib, p->u.param.name_id, p->u.param.type, &var);
+        if (rc == OK) rc = ib_value_(ib, IR_OP_PARAM, p->u.param.type, IR_NONE, IR_NONE, &v);
+        if (rc != OK) return rc;
+
+        fn->values[v].imm.i   = (i64_t)i;
+        fn->values[v].name_id = p->u.param.name_id;
+
+        rc = ib_def_write_(ib, var, ib->cur, v);
+        if (rc != OK) return rc;
+    }
+
+    const ast_node_t* body = plist ? plist->right : NULL;
+    IB_CHECK(ib, body != NULL, node, "Function has no body");
+
+    rc = ib_stmt_(ib, body);
+    if (rc != OK) return rc;
+
+    // falling off the end returns 0 (nothing for void)
+    if (ib->cur != IR_NONE)
+    {
+        rc = ib_return_(ib, NULL);
+        if (rc != OK) return rc;
+    }
+
+    return ib_finish_func_(ib);
+}
+
+static void ib_dtor_(ir_builder_t* ib)
+{
+    for (size_t i = 0; i < ib->pending_cap; ++i)
+        mem_free(ib->pending[i].items);
+
+    mem_free(ib->pending);
+    mem_free(ib->defs);
+    mem_free(ib->vars);
+    mem_free(ib->binds);
+    mem_free(ib->loop_exits);
+}
+
+err_t ir_build(ir_module_t* module, const ast_tree_t* tree, operational_data_t* op)
+{
+    if (!module || !tree || !tree->root) return ERR_BAD_ARG;
+
+    const ast_node_t* program = tree->root;
+
+    *module = (ir_module_t){ .tree = tree };
+
+    ir_builder_t ib = { .tree = tree, .op = op, .module = module };
+    IB_CHECK(&ib, program->kind == ASTK_PROGRAM, program, "Root is not PROGRAM");
+
+    // signatures first, calls may go forward
+    const size_t func_count = ast_children_count(program);
+    module->funcs = (ir_func_t*)mem_calloc(MEM_TAG_IR, func_count ? func_count : 1, sizeof(ir_func_t));
+    if (!module->funcs) return ERR_ALLOC;
+    module->func_cap = func_count;
+
+    for (const ast_node_t* fn = program->left; fn; fn = fn->right)
+    {
+        IB_CHECK(&ib, fn->kind == ASTK_FUNC, fn, "Internal: PROGRAM child is not FUNC");
+        IB_CHECK(&ib, fn->left && fn->left->kind == ASTK_PARAM_LIST, fn, "Internal: FUNC missing PARAM_LIST");
+
+        ir_func_t* f = &module->funcs[module->func_count++];
+        f->name_id     = fn->u.func.name_id;
+        f->ret_type    = fn->u.func.ret_type;
+        f->param_count = ast_children_count(fn->left);
+
+        if (f->param_count)
+        {
+            f->param_types = (ast_type_t*)mem_calloc(MEM_TAG_IR, f->param_count, sizeof(ast_type_t));
+            if (!f->param_types) return ERR_ALLOC;
+
+            size_t i = 0;
+            for (const ast_node_t* p = fn->left->left; p; p = p->right)
+                f->param_types[i++] = p->u.param.type;
+        }
+    }
+
+    err_t rc = OK;
+    size_t i = 0;
+    for (const ast_node_t* fn = program->left; fn && rc == OK; fn = fn->right, ++i)
+        rc = ib_func_(&ib, &module->funcs[i], fn);
+
+    ib_dtor_(&ib);
+    return rc;
+}
@@ -6,6 +6,8 @@
 #include <limits.h>
 #include <stdio.h>
 
+#include "../libs/memory/memory.h"
+
 static int is_ident_start(int c)
 {
     return isalpha(c) || c == '_';
@@ -21,9 +23,11 @@ err_t nametable_ctor(nametable_t* nametable)
     if (!nametable)
         return ERR_BAD_ARG;
 
-    nametable->data     = NULL;
-    nametable->amount   = 0;
-    nametable->capacity = 0;
+    nametable->data      = NULL;
+    nametable->amount    = 0;
+    nametable->capacity  = 0;
+    nametable->slots     = NULL;
+    nametable->slots_cap = 0;
 
     return OK;
 }
@@ -37,16 +41,20 @@ err_t nametable_dtor(nametable_t* nametable)
     {
         for (size_t i = 0; i < nametable->amount; ++i)
         {
-            free(nametable->data[i].name);
+            mem_free(nametable->data[i].name);
             nametable->data[i].name = NULL;
         }
 
-        free(nametable->data);
+        mem_free(nametable->data);
         nametable->data = NULL;
     }
 
-    nametable->amount   = 0;
-    nametable->capacity = 0;
+    mem_free(nametable->slots);
+    nametable->slots = NULL;
+
+    nametable->amount    = 0;
+    nametable->capacity  = 0;
+    nametable->slots_cap = 0;
 
     return OK;
 }
@@ -63,7 +71,7 @@ static err_t nametable_ensure_capacity(nametable_t* nametable, size_t min_capaci
     if (new_cap < min_capacity)
         new_cap = min_capacity;
 
-    nametable_entry_t* new_data = (nametable_entry_t*)realloc(nametable->data, new_cap * sizeof(nametable_entry_t));
+    nametable_entry_t* new_data = (nametable_entry_t*)mem_realloc(MEM_TAG_NAMETABLE, nametable->data, new_cap * sizeof(nametable_entry_t));
     if (!new_data)
         return ERR_ALLOC;
 
@@ -79,6 +87,35 @@ static err_t nametable_ensure_capacity(nametable_t* nametable, size_t min_capaci
     return OK;
 }
 
+// keeps the index at most half full, rehashing every entry on growth
+static err_t nametable_ensure_slots(nametable_t* nametable, size_t min_amount)
+{
+    if (nametable->slots_cap >= 2 * min_amount)
+        return OK;
+
+    size_t new_cap = (nametable->slots_cap > 0 ? nametable->slots_cap * 2 : 16);
+    while (new_cap < 2 * min_amount)
+        new_cap *= 2;
+
+    size_t* slots = (size_t*)mem_calloc(MEM_TAG_NAMETABLE, new_cap, sizeof(size_t));
+    if (!slots)
+        return ERR_ALLOC;
+
+    for (size_t i = 0; i < nametable->amount; ++i)
+    {
+        size_t s = nametable->data[i].hash & (new_cap - 1);
+        while (slots[s])
+            s = (s + 1) & (new_cap - 1);
+        slots[s] = i + 1;
+    }
+
+    mem_free(nametable->slots);
+    nametable->slots     = slots;
+    nametable->slots_cap = new_cap;
+
+    return OK;
+}
+
 size_t nametable_insert(nametable_t* nametable, const char* buffer, size_t length)
 {
     if (!nametable || !buffer)
@@ -86,13 +123,15 @@ size_t nametable_insert(nametable_t* nametable, const char* buffer, size_t lengt
 
     size_t h = sdbm_n(buffer, length);
 
-    for (size_t i = 0; i < nametable->amount; ++i)
+    if (nametable_ensure_slots(nametable, nametable->amount + 1) != OK)
+        return SIZE_MAX;
+
+    size_t s = h & (nametable->slots_cap - 1);
+    for (; nametable->slots[s]; s = (s + 1) & (nametable->slots_cap - 1))
     {
-        if (nametable->data[i].hash == h &&
-            nametable->data[i].length == length)
-        {
-            return i;
-        }
+        const nametable_entry_t* e = &nametable->data[nametable->slots[s] - 1];
+        if (e->hash == h && e->length == length && memcmp(e->name, buffer, length) == 0)
+            return nametable->slots[s] - 1;
     }
 
     if (nametable_ensure_capacity(nametable, nametable->amount + 1) != OK)
@@ -100,7 +139,7 @@ size_t nametable_insert(nametable_t* nametable, const char* buffer, size_t lengt
 
     nametable_entry_t* entry = &nametable->data[nametable->amount];
 
-    entry->name = (char*)calloc(length + 1, 1);
+    entry->name = (char*)mem_calloc(MEM_TAG_NAMETABLE, length + 1, 1);
     if (!entry->name)
         return SIZE_MAX;
 
@@ -109,9 +148,26 @@ size_t nametable_insert(nametable_t* nametable, const char* buffer, size_t lengt
     entry->length       = length;
     entry->hash         = h;
 
+    nametable->slots[s] = nametable->amount + 1;
     return nametable->amount++;
 }
 
+size_t nametable_find(const nametable_t* nametable, const char* buffer, size_t length)
+{
+    if (!nametable || !buffer || !nametable->slots_cap)
+        return SIZE_MAX;
+
+    const size_t h = sdbm_n(buffer, length);
+
+    for (size_t s = h & (nametable->slots_cap - 1); nametable->slots[s]; s = (s + 1) & (nametable->slots_cap - 1))
+    {
+        const nametable_entry_t* e = &nametable->data[nametable->slots[s] - 1];
+        if (e->hash == h && e->length == length && memcmp(e->name, buffer, length) == 0)
+            return nametable->slots[s] - 1;
+    }
+    return SIZE_MAX;
+}
+
 typedef struct
 {
     const char*  text;
@@ -283,7 +339,7 @@ static void scan_identifier(lexer_t* lexer,   token_t* tok,
             _op->error_pos = (pos_);                         \
             snprintf(_op->error_msg, sizeof(_op->error_msg), \
                      fmt, ##__VA_ARGS__);                    \
-            log_printf(ERROR, "%s", _op->error_msg);         \
+            LOG_ERROR("%s", _op->error_msg);                 \
         }                                                    \
     block_end
 
@@ -308,7 +364,7 @@ static void scan_number(lexer_t* lexer,   token_t* tok,
     char* buf = NULL;
     if (tok->buffer)
     {
-        buf = strndup(tok->buffer, tok->length);
+        buf = mem_strndup(MEM_TAG_LEXER, tok->buffer, tok->length);
         buf[tok->length] = '\0';
     }
 
@@ -356,7 +412,7 @@ static void scan_number(lexer_t* lexer,   token_t* tok,
                         "Invalid numeric literal at line %zu, column %zu: \"%s\"",
                         start_line, start_col, buf);
 
-        free(buf);
+        mem_free(buf);
         return;
     }
 
@@ -371,7 +427,7 @@ static void scan_number(lexer_t* lexer,   token_t* tok,
         tok->lit.f64  = strtod(buf, NULL);
     }
 
-    free(buf);
+    mem_free(buf);
 }
 
 static int is_valid_escape_char(char e)
@@ -702,46 +758,27 @@ const char* token_kind_to_cstr(token_kind_t kind)
     }
 }
 
-#define LEXER_LOG_TOKEN(_extra_fmt, ...)             \
-    log_printf(DEBUG,                                \
-               "TOKEN %-18s at %zu:%zu " _extra_fmt, \
-               kind_str,                             \
-               tok->pos.line,                        \
-               tok->pos.column,                      \
-               __VA_ARGS__)
+#define LEXER_LOG_TOKEN(_extra_fmt, ...)                                  \
+    LOG_DEBUG("TOKEN %-18s at %zu:%zu " _extra_fmt "text=\"%.*s\"",         \
+              token_kind_to_cstr(tok->kind),                              \
+              tok->pos.line,                                              \
+              tok->pos.column,                                            \
+              __VA_ARGS__,                                                \
+              (int)(tok->buffer ? tok->length : 0),                       \
+              tok->buffer ? tok->buffer : "")
 
 static err_t lexer_dump_token(const token_t* tok)
 {
     if (!tok)
         return ERR_BAD_ARG;
 
-    const char* kind_str = token_kind_to_cstr(tok->kind);
-
-    char* snippet = NULL;
-    if (tok->buffer)
-    {
-        snippet = strdup(tok->buffer);
-        snippet[tok->length] = '\0';
-    }
-
-    if (tok->kind == TOK_NUMERIC_LITERAL)
-    {
-        if (tok->lit_type == LIT_INT)
-            LEXER_LOG_TOKEN("int=%lld text=\"%s\"",
-                            (long long)tok->lit.i64,
-                            snippet);
-        else if (tok->lit_type == LIT_FLOAT)
-            LEXER_LOG_TOKEN("float=%g text=\"%s\"",
-                            tok->lit.f64,
-                            snippet);
-        else
-            LEXER_LOG_TOKEN("text=\"%s\"",
-                            snippet);
-    }
+    if (tok->kind == TOK_NUMERIC_LITERAL && tok->lit_type == LIT_INT)
+        LEXER_LOG_TOKEN("int=%lld ", (long long)tok->lit.i64);
+    else if (tok->kind == TOK_NUMERIC_LITERAL && tok->lit_type == LIT_FLOAT)
+        LEXER_LOG_TOKEN("float=%g ", tok->lit.f64);
     else
-        LEXER_LOG_TOKEN("text=\"%s\"",
-                        snippet); 
-    free(snippet);
+        LEXER_LOG_TOKEN("%s", "");
+
     return OK;
 }
 
@@ -777,7 +814,7 @@ err_t lexer_stream(operational_data_t* op_data,
     {
         snprintf(op_data->error_msg, sizeof(op_data->error_msg),
                  "Failed to construct name table (err=%d)", rc);
-        log_printf(ERROR, "%s", op_data->error_msg);
+        LOG_ERROR("%s", op_data->error_msg);
         return rc;
     }
 
@@ -787,7 +824,7 @@ err_t lexer_stream(operational_data_t* op_data,
     {
         snprintf(op_data->error_msg, sizeof(op_data->error_msg),
                  "Failed to initialize lexer (err=%d)", rc);
-        log_printf(ERROR, "%s", op_data->error_msg);
+        LOG_ERROR("%s", op_data->error_msg);
 
         nametable_dtor(out_nametable);
         return rc;
@@ -811,15 +848,16 @@ err_t lexer_stream(operational_data_t* op_data,
                                 lexer.line, lexer.column, rc);
             }
 
-            log_printf(ERROR, "%s", op_data->error_msg);
+            LOG_ERROR("%s", op_data->error_msg);
 
-            free(tokens);
+            mem_free(tokens);
             lexer_dtor(&lexer);
             nametable_dtor(out_nametable);
             return rc;
         }
 
-        lexer_dump_token(&tok);
+        if (LOG_IS_ENABLED(DEBUG))
+            lexer_dump_token(&tok);
 
         if (tok.kind == TOK_ERROR)
         {
@@ -831,18 +869,18 @@ err_t lexer_stream(operational_data_t* op_data,
                 size_t len        = tok.buffer ? tok.length : 1;
 
                 char* snippet = NULL;
-                snippet = strdup(start);
+                snippet = mem_strdup(MEM_TAG_LEXER, start);
                 snippet[len] = '\0';
 
                 LEXER_SET_ERROR(&lexer, tok.pos.offset, 
                                 "Lexical error at line %zu, column %zu near \"%s\"", 
                                 tok.pos.line, tok.pos.column, snippet[0] ? snippet : "?");
-                free(snippet);
+                mem_free(snippet);
             }
 
-            log_printf(ERROR, "%s", op_data->error_msg);
+            LOG_ERROR("%s", op_data->error_msg);
 
-            free(tokens);
+            mem_free(tokens);
             lexer_dtor(&lexer);
             nametable_dtor(out_nametable);
             return ERR_SYNTAX;
@@ -851,14 +889,14 @@ err_t lexer_stream(operational_data_t* op_data,
         if (count >= capacity)
         {
             size_t new_cap = capacity ? capacity * 2 : 8;
-            token_t* new_tokens = (token_t*)realloc(tokens, new_cap * sizeof(token_t));
+            token_t* new_tokens = (token_t*)mem_realloc(MEM_TAG_LEXER, tokens, new_cap * sizeof(token_t));
             if (!new_tokens)
             {
                 snprintf(op_data->error_msg, sizeof(op_data->error_msg),
                          "Out of memory in lexer_stream while growing token buffer");
-                log_printf(ERROR, "%s", op_data->error_msg);
+                LOG_ERROR("%s", op_data->error_msg);
 
-                free(tokens);
+                mem_free(tokens);
                 lexer_dtor(&lexer);
                 nametable_dtor(out_nametable);
                 return ERR_ALLOC;
@@ -59,6 +59,10 @@ typedef struct
     nametable_entry_t* data;
     size_t             amount;
     size_t             capacity;
+
+    /* open-addressed index into data, holds id + 1 (0 = empty slot) */
+    size_t*            slots;
+    size_t             slots_cap;
 } nametable_t;
 
 typedef struct
@@ -80,6 +84,9 @@ err_t nametable_dtor(nametable_t* nametable);
 
 size_t nametable_insert(nametable_t* nametable, const char* start, const size_t length);
 
+// id of the name, SIZE_MAX when it is not there; does not write the table
+size_t nametable_find  (const nametable_t* nametable, const char* start, const size_t length);
+
 err_t lexer_ctor (lexer_t* lexer, operational_data_t* op_data, nametable_t* nametable);
 err_t lexer_dtor (lexer_t* lexer);
 err_t lexer_reset(lexer_t* lexer);
@@ -2,6 +2,52 @@
 
 size_t parse_arguments(const int argc, char* const argv[],          \
                        const char** in_file, const char** out_file)
+{
+    return parse_arguments_ex(argc, argv, in_file, out_file, NULL, 0);
+}
+
+static int parse_option_(const int argc, char* const argv[], int* i,
+                         const arg_option_t* options, size_t options_count)
+{
+    const char* current = argv[*i];
+
+    for (size_t k = 0; k < options_count; ++k)
+    {
+        const arg_option_t* opt = &options[k];
+        if (!opt->name || !opt->value) continue;
+
+        switch (opt->kind)
+        {
+            case ARG_FLAG:
+                if (strcmp(current, opt->name) != 0) break;
+                *opt->value = opt->name;
+                return 1;
+
+            case ARG_VALUE:
+                if (strcmp(current, opt->name) != 0) break;
+                if (!CHECK(ERROR, *i + 1 < argc, "%s flag requires a value", opt->name)) return -1;
+                *opt->value = argv[++(*i)];
+                return 1;
+
+            case ARG_PREFIX:
+            {
+                const size_t len = strlen(opt->name);
+                if (strncmp(current, opt->name, len) != 0) break;
+                *opt->value = current + len;
+                return 1;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+size_t parse_arguments_ex(const int argc, char* const argv[],
+                          const char** in_file, const char** out_file,
+                          const arg_option_t* options, size_t options_count)
 {
     if (!CHECK(ERROR, argv != NULL, "Argv is NULL")) return 0;
 
@@ -38,7 +84,15 @@ size_t parse_arguments(const int argc, char* const argv[],          \
             continue;
         }
 
-        log_printf(WARN, "Unknown argument '%s' ignored", current);
+        const int opt_rc = parse_option_(argc, argv, &i, options, options_count);
+        if (opt_rc < 0) return 0;
+        if (opt_rc > 0)
+        {
+            parsed++;
+            continue;
+        }
+
+        LOG_WARN("Unknown argument '%s' ignored", current);
     }
 
     return parsed;
@@ -64,7 +118,7 @@ ssize_t get_file_size_stat(const char * const filename) {
     if (stat(filename, &st) == 0) {
         return (ssize_t)st.st_size;
     } else {
-        log_printf(ERROR, "Error getting file stats for %s", filename);
+        LOG_ERROR("Error getting file stats for %s", filename);
         return -1;
     }
 }
@@ -81,7 +135,7 @@ size_t read_file(FILE *file, operational_data_t* op_data)
     {
         if (ferror(file))
         {
-            log_printf(ERROR, "Failed to read from file");
+            LOG_ERROR("Failed to read from file");
         }
         return 0;
     }
@@ -26,12 +26,34 @@ typedef struct
     char   error_msg[512];
 } operational_data_t;
 
+typedef enum
+{
+    ARG_FLAG,   // "--stats"            -> value = option name
+    ARG_VALUE,  // "--stats-json <val>" -> value = next argument
+    ARG_PREFIX, // "-O2", "--passes=x"  -> value = text after the prefix
+} arg_kind_t;
+
+typedef struct
+{
+    const char*  name;
+    arg_kind_t   kind;
+    const char** value;
+} arg_option_t;
+
 /*
     Function to parse shell arguments (files to interact with)
 */
 size_t parse_arguments(const int argc, char* const argv[],          \
                        const char** in_file, const char** out_file);
 
+/*
+    Function to parse shell arguments: files plus driver specific options.
+    Options that are not given keep their previous value
+*/
+size_t parse_arguments_ex(const int argc, char* const argv[],
+                          const char** in_file, const char** out_file,
+                          const arg_option_t* options, size_t options_count);
+
 /*
     Function to load file under name in mode (r, w, a, etc)
 */
@@ -43,15 +43,20 @@ void log_printf (const logging_level level, const char* fmt, ...)
     fflush(logging.file);
 }
 
+bool log_enabled (const logging_level level)
+{
+    return logging.file != NULL && level >= logging.level;
+}
+
 static void get_timestamp (char * const timestamp)
 {
-    time_t    current_time;
-    struct tm *local_time_info;
-    
-    current_time    = time(NULL);
-    local_time_info = localtime(&current_time);
+    time_t    current_time = time(NULL);
+    struct tm local_time_info;
+
+    // passes may log from worker threads
+    localtime_r(&current_time, &local_time_info);
 
-    strftime(timestamp, STR_TIMESTAMP_SIZE, "%d-%m-%Y %H:%M:%S", local_time_info);
+    strftime(timestamp, STR_TIMESTAMP_SIZE, "%d-%m-%Y %H:%M:%S", &local_time_info);
 }
 
 static void format_log (const logging_level level, const char * const str, char* res_str)
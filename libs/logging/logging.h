@@ -28,6 +28,14 @@ static const char *const logging_levels[5] = {
     "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
 };
 
+/*
+    Compile-time threshold (numeric value of logging_level). LOG_* calls below
+    it are compiled out, e.g. -DLOG_MIN_LEVEL=2 keeps WARN and up
+*/
+#ifndef LOG_MIN_LEVEL
+  #define LOG_MIN_LEVEL 0
+#endif
+
 #define log_printe(level, format, ...)                                       \
     {                                                                        \
         log_printf(level, "[File %s at line %d at %s] " format,              \
@@ -57,11 +65,69 @@ void init_logging (const char * const filename, const logging_level level);
 */
 void log_printf  (const logging_level level, const char* fmt, ...);
 
+/*
+    Check if message of given level would be written (runtime level)
+    Parameters:
+        level - level of log output
+*/
+bool log_enabled (const logging_level level);
+
 /*
     Close log file
 */
 void close_log_file ();
 
+/*
+    True when a message of given level passes both compile-time and runtime
+    thresholds. Use it to guard expensive preparation of log arguments
+*/
+#define LOG_IS_ENABLED(level) \
+    ((int)(level) >= LOG_MIN_LEVEL && log_enabled(level))
+
+/*
+    Log with lazy argument evaluation: arguments are evaluated only if
+    the message is actually written
+*/
+#define LOG_AT(level, format, ...)                               \
+    do {                                                         \
+        if (LOG_IS_ENABLED(level))                               \
+            log_printf((level), (format), ##__VA_ARGS__);        \
+    } while (0)
+
+// Below-threshold call: never executed, folded away by the compiler, but
+// still type-checked and keeps log-only variables "used"
+#define LOG_DISABLED_(format, ...)                               \
+    do {                                                         \
+        if (0)                                                   \
+            log_printf(DEBUG, (format), ##__VA_ARGS__);          \
+    } while (0)
+
+#if LOG_MIN_LEVEL <= 0
+  #define LOG_DEBUG(format, ...) LOG_AT(DEBUG, format, ##__VA_ARGS__)
+#else
+  #define LOG_DEBUG(format, ...) LOG_DISABLED_(format, ##__VA_ARGS__)
+#endif
+
+#if LOG_MIN_LEVEL <= 1
+  #define LOG_INFO(format, ...)  LOG_AT(INFO,  format, ##__VA_ARGS__)
+#else
+  #define LOG_INFO(format, ...)  LOG_DISABLED_(format, ##__VA_ARGS__)
+#endif
+
+#if LOG_MIN_LEVEL <= 2
+  #define LOG_WARN(format, ...)  LOG_AT(WARN,  format, ##__VA_ARGS__)
+#else
+  #define LOG_WARN(format, ...)  LOG_DISABLED_(format, ##__VA_ARGS__)
+#endif
+
+#if LOG_MIN_LEVEL <= 3
+  #define LOG_ERROR(format, ...) LOG_AT(ERROR, format, ##__VA_ARGS__)
+#else
+  #define LOG_ERROR(format, ...) LOG_DISABLED_(format, ##__VA_ARGS__)
+#endif
+
+#define LOG_FATAL(format, ...)   LOG_AT(FATAL, format, ##__VA_ARGS__)
+
 /*
     Checks that work in debug and exits and in release not. Also logs errors
 */
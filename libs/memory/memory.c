@@ -0,0 +1,301 @@
+#include "memory.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../logging/logging.h"
+
+#define MEM_MAGIC 0x6D656D5F7461675FULL // "mem_tag_"
+
+static void* libc_alloc_  (void* ctx, size_t size)            { unused ctx; return malloc(size); }
+static void* libc_realloc_(void* ctx, void* ptr, size_t size) { unused ctx; return realloc(ptr, size); }
+static void  libc_free_   (void* ctx, void* ptr)              { unused ctx; free(ptr); }
+
+static const mem_allocator_t libc_allocator = {
+    .alloc   = libc_alloc_,
+    .realloc = libc_realloc_,
+    .free    = libc_free_,
+    .ctx     = NULL,
+};
+
+static mem_allocator_t allocator = {
+    .alloc   = libc_alloc_,
+    .realloc = libc_realloc_,
+    .free    = libc_free_,
+    .ctx     = NULL,
+};
+
+static const char* const mem_tag_names[MEM_TAG_COUNT] = {
+#define MEM_NAME(sym, str) str,
+    MEM_TAG_LIST(MEM_NAME)
+#undef MEM_NAME
+};
+
+#if MEM_TRACKING
+
+// prefix of every tracked block, keeps user pointer max-aligned
+typedef union
+{
+    struct
+    {
+        size_t    size;
+        mem_tag_t tag;
+        uint64_t  magic;
+    } h;
+    max_align_t align;
+} mem_header_t;
+
+// the middle end allocates from several threads, counters are updated atomically
+typedef struct
+{
+    atomic_size_t live_bytes;
+    atomic_size_t peak_bytes;
+    atomic_size_t total_bytes;
+
+    atomic_size_t allocs;
+    atomic_size_t reallocs;
+    atomic_size_t frees;
+} mem_counters_t;
+
+static mem_counters_t tag_stats[MEM_TAG_COUNT];
+static mem_counters_t total_stats;
+
+#define MEM_ADD_(counter, v) atomic_fetch_add_explicit(&(counter), (v), memory_order_relaxed)
+#define MEM_SUB_(counter, v) atomic_fetch_sub_explicit(&(counter), (v), memory_order_relaxed)
+#define MEM_GET_(counter)    atomic_load_explicit(&(counter), memory_order_relaxed)
+
+static void counters_add_(mem_counters_t* c, size_t size)
+{
+    const size_t live = MEM_ADD_(c->live_bytes, size) + size;
+    MEM_ADD_(c->total_bytes, size);
+
+    size_t peak = MEM_GET_(c->peak_bytes);
+    while (live > peak &&
+           !atomic_compare_exchange_weak_explicit(&c->peak_bytes, &peak, live,
+                                                  memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+static void account_add_(mem_tag_t tag, size_t size)
+{
+    counters_add_(&tag_stats[tag], size);
+    counters_add_(&total_stats, size);
+}
+
+static void account_sub_(mem_tag_t tag, size_t size)
+{
+    MEM_SUB_(tag_stats[tag].live_bytes, size);
+    MEM_SUB_(total_stats.live_bytes,    size);
+}
+
+static void counters_load_(const mem_counters_t* c, mem_tag_stats_t* out)
+{
+    out->live_bytes  = MEM_GET_(c->live_bytes);
+    out->peak_bytes  = MEM_GET_(c->peak_bytes);
+    out->total_bytes = MEM_GET_(c->total_bytes);
+    out->allocs      = MEM_GET_(c->allocs);
+    out->reallocs    = MEM_GET_(c->reallocs);
+    out->frees       = MEM_GET_(c->frees);
+}
+
+static mem_header_t* header_of_(void* ptr)
+{
+    mem_header_t* h = (mem_header_t*)ptr - 1;
+    if (h->h.magic != MEM_MAGIC || h->h.tag >= MEM_TAG_COUNT)
+    {
+        LOG_FATAL("mem: pointer %p was not allocated by mem_alloc", ptr);
+        abort();
+    }
+    return h;
+}
+
+#endif
+
+void mem_set_allocator(const mem_allocator_t* new_allocator)
+{
+    allocator = new_allocator ? *new_allocator : libc_allocator;
+}
+
+void* mem_alloc(mem_tag_t tag, size_t size)
+{
+    if (tag >= MEM_TAG_COUNT) tag = MEM_TAG_OTHER;
+
+#if MEM_TRACKING
+    if (size > SIZE_MAX - sizeof(mem_header_t)) return NULL;
+
+    mem_header_t* h = (mem_header_t*)allocator.alloc(allocator.ctx, sizeof(mem_header_t) + size);
+    if (!h) return NULL;
+
+    h->h.size  = size;
+    h->h.tag   = tag;
+    h->h.magic = MEM_MAGIC;
+
+    MEM_ADD_(tag_stats[tag].allocs, 1);
+    MEM_ADD_(total_stats.allocs, 1);
+    account_add_(tag, size);
+
+    return h + 1;
+#else
+    unused tag;
+    return allocator.alloc(allocator.ctx, size);
+#endif
+}
+
+void* mem_calloc(mem_tag_t tag, size_t count, size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+
+    void* p = mem_alloc(tag, count * size);
+    if (p) memset(p, 0, count * size);
+    return p;
+}
+
+void* mem_realloc(mem_tag_t tag, void* ptr, size_t size)
+{
+    if (!ptr) return mem_alloc(tag, size);
+
+#if MEM_TRACKING
+    if (size > SIZE_MAX - sizeof(mem_header_t)) return NULL;
+
+    // block keeps the tag it was allocated with
+    mem_header_t* old = header_of_(ptr);
+    const mem_tag_t old_tag  = old->h.tag;
+    const size_t    old_size = old->h.size;
+
+    mem_header_t* h = (mem_header_t*)allocator.realloc(allocator.ctx, old, sizeof(mem_header_t) + size);
+    if (!h) return NULL;
+
+    h->h.size = size;
+
+    MEM_ADD_(tag_stats[old_tag].reallocs, 1);
+    MEM_ADD_(total_stats.reallocs, 1);
+    account_sub_(old_tag, old_size);
+    account_add_(old_tag, size);
+
+    return h + 1;
+#else
+    unused tag;
+    return allocator.realloc(allocator.ctx, ptr, size);
+#endif
+}
+
+char* mem_strdup(mem_tag_t tag, const char* str)
+{
+    if (!str) return NULL;
+    return mem_strndup(tag, str, strlen(str));
+}
+
+char* mem_strndup(mem_tag_t tag, const char* str, size_t length)
+{
+    if (!str) return NULL;
+
+    const char* nul = memchr(str, '\0', length);
+    if (nul) length = (size_t)(nul - str);
+
+    char* s = (char*)mem_alloc(tag, length + 1);
+    if (!s) return NULL;
+
+    memcpy(s, str, length);
+    s[length] = '\0';
+    return s;
+}
+
+void mem_free(void* ptr)
+{
+    if (!ptr) return;
+
+#if MEM_TRACKING
+    mem_header_t* h = header_of_(ptr);
+
+    MEM_ADD_(tag_stats[h->h.tag].frees, 1);
+    MEM_ADD_(total_stats.frees, 1);
+    account_sub_(h->h.tag, h->h.size);
+
+    h->h.magic = 0;
+    allocator.free(allocator.ctx, h);
+#else
+    allocator.free(allocator.ctx, ptr);
+#endif
+}
+
+bool mem_tracking_enabled(void)
+{
+    return MEM_TRACKING;
+}
+
+void mem_tag_stats(mem_tag_t tag, mem_tag_stats_t* out)
+{
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+
+#if MEM_TRACKING
+    if (tag < MEM_TAG_COUNT) counters_load_(&tag_stats[tag], out);
+#else
+    unused tag;
+#endif
+}
+
+void mem_total_stats(mem_tag_stats_t* out)
+{
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+
+#if MEM_TRACKING
+    counters_load_(&total_stats, out);
+#endif
+}
+
+const char* mem_tag_name(mem_tag_t tag)
+{
+    return (tag < MEM_TAG_COUNT) ? mem_tag_names[tag] : "?";
+}
+
+void mem_report(FILE* out)
+{
+    if (!out || !MEM_TRACKING) return;
+
+    fprintf(out, "%-16s %12s %12s %10s %10s %10s\n",
+            "memory", "live", "peak", "allocs", "reallocs", "frees");
+
+    for (size_t i = 0; i < MEM_TAG_COUNT; ++i)
+    {
+        mem_tag_stats_t s = { 0 };
+        mem_tag_stats((mem_tag_t)i, &s);
+        if (s.allocs == 0) continue;
+
+        fprintf(out, "%-16s %12zu %12zu %10zu %10zu %10zu\n", mem_tag_names[i],
+                s.live_bytes, s.peak_bytes, s.allocs, s.reallocs, s.frees);
+    }
+
+    mem_tag_stats_t t = { 0 };
+    mem_total_stats(&t);
+    fprintf(out, "%-16s %12zu %12zu %10zu %10zu %10zu\n", "total",
+            t.live_bytes, t.peak_bytes, t.allocs, t.reallocs, t.frees);
+}
+
+size_t mem_leak_report(FILE* out)
+{
+    size_t leaked = 0;
+
+#if MEM_TRACKING
+    for (size_t i = 0; i < MEM_TAG_COUNT; ++i)
+    {
+        mem_tag_stats_t s = { 0 };
+        counters_load_(&tag_stats[i], &s);
+
+        const size_t blocks = s.allocs - s.frees;
+        if (blocks == 0) continue;
+
+        leaked += blocks;
+        LOG_WARN("mem: leak in '%s': %zu blocks, %zu bytes", mem_tag_names[i], blocks, s.live_bytes);
+        if (out)
+            fprintf(out, "mem: leak in '%s': %zu blocks, %zu bytes\n",
+                    mem_tag_names[i], blocks, s.live_bytes);
+    }
+#else
+    unused out;
+#endif
+
+    return leaked;
+}
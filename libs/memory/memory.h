@@ -0,0 +1,101 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../types.h"
+
+/*
+    Allocation tracking. On by default in debug builds, release builds
+    (-DNDEBUG) pass straight through to the installed allocator. The
+    counters are atomic, mem_* may be called from any thread
+*/
+#ifndef MEM_TRACKING
+  #ifdef NDEBUG
+    #define MEM_TRACKING 0
+  #else
+    #define MEM_TRACKING 1
+  #endif
+#endif
+
+#define MEM_TAG_LIST(X)                  \
+    X(MEM_TAG_OTHER,     "other")        \
+    X(MEM_TAG_IO,        "io")           \
+    X(MEM_TAG_LEXER,     "lexer")        \
+    X(MEM_TAG_NAMETABLE, "nametable")    \
+    X(MEM_TAG_PARSER,    "parser")       \
+    X(MEM_TAG_AST,       "ast")          \
+    X(MEM_TAG_SYMTABLE,  "symtable")     \
+    X(MEM_TAG_DIFF_TREE, "diff-tree")    \
+    X(MEM_TAG_OPT,       "optimizer")    \
+    X(MEM_TAG_IR,        "ir")           \
+    X(MEM_TAG_BACKEND,   "backend")      \
+    X(MEM_TAG_DUMP,      "dump")         \
+    X(MEM_TAG_STACK,     "stack")
+
+typedef enum
+{
+#define MEM_ENUM(sym, str) sym,
+    MEM_TAG_LIST(MEM_ENUM)
+#undef MEM_ENUM
+
+    MEM_TAG_COUNT
+} mem_tag_t;
+
+typedef struct
+{
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t total_bytes;  // sum of all requested sizes
+
+    size_t allocs;
+    size_t reallocs;
+    size_t frees;
+} mem_tag_stats_t;
+
+/*
+    Backing allocator. Any of the hooks may be replaced (arena, pool, fault
+    injection); ctx is passed through untouched
+*/
+typedef struct
+{
+    void* (*alloc)  (void* ctx, size_t size);
+    void* (*realloc)(void* ctx, void* ptr, size_t size);
+    void  (*free)   (void* ctx, void* ptr);
+    void*   ctx;
+} mem_allocator_t;
+
+/*
+    Install allocator, NULL restores libc one. Must be called before the
+    first allocation: memory has to be freed by the allocator that made it
+*/
+void  mem_set_allocator(const mem_allocator_t* allocator);
+
+void* mem_alloc  (mem_tag_t tag, size_t size);
+void* mem_calloc (mem_tag_t tag, size_t count, size_t size);
+void* mem_realloc(mem_tag_t tag, void* ptr, size_t size);
+char* mem_strdup (mem_tag_t tag, const char* str);
+char* mem_strndup(mem_tag_t tag, const char* str, size_t length);
+void  mem_free   (void* ptr);
+
+/*
+    Counters, all zero when MEM_TRACKING is off
+*/
+bool  mem_tracking_enabled(void);
+void  mem_tag_stats       (mem_tag_t tag, mem_tag_stats_t* out);
+void  mem_total_stats     (mem_tag_stats_t* out);
+const char* mem_tag_name  (mem_tag_t tag);
+
+/*
+    Per-subsystem table of live/peak bytes and call counts
+*/
+void  mem_report     (FILE* out);
+
+/*
+    Print tags that still hold memory. Returns number of live blocks
+*/
+size_t mem_leak_report(FILE* out);
+
+#endif
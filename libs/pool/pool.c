@@ -0,0 +1,120 @@
+#include "pool.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include "../memory/memory.h"
+
+static void pool_drain_(pool_t* pool, pool_task_fn_t fn, void* ctx, size_t count)
+{
+    for (;;)
+    {
+        const size_t i = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed);
+        if (i >= count) return;
+        fn(ctx, i);
+    }
+}
+
+static void* pool_worker_(void* arg)
+{
+    pool_t* pool = (pool_t*)arg;
+    size_t  seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (!pool->stop && pool->generation == seen)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->stop) break;
+
+        seen = pool->generation;
+        const pool_task_fn_t fn    = pool->fn;
+        void*                ctx   = pool->ctx;
+        const size_t         count = pool->count;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_drain_(pool, fn, ctx, count);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+size_t pool_cores(void)
+{
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (size_t)n : 1;
+}
+
+err_t pool_ctor(pool_t* pool, size_t threads)
+{
+    if (!pool) return ERR_BAD_ARG;
+    memset(pool, 0, sizeof(*pool));
+
+    if (threads == 0) threads = pool_cores();
+    if (threads <= 1) return OK;
+
+    pool->workers = (pthread_t*)mem_calloc(MEM_TAG_OTHER, threads - 1, sizeof(pthread_t));
+    if (!pool->workers) return ERR_ALLOC;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    // fewer workers than asked for still run every job
+    for (size_t i = 0; i < threads - 1; ++i)
+    {
+        if (pthread_create(&pool->workers[i], NULL, pool_worker_, pool) != 0) break;
+        pool->worker_count++;
+    }
+    return OK;
+}
+
+void pool_dtor(pool_t* pool)
+{
+    if (!pool || !pool->workers) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->worker_count; ++i)
+        pthread_join(pool->workers[i], NULL);
+
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    mem_free(pool->workers);
+    memset(pool, 0, sizeof(*pool));
+}
+
+void pool_run(pool_t* pool, size_t count, pool_task_fn_t fn, void* ctx)
+{
+    if (!pool || !fn) return;
+
+    if (pool->worker_count == 0 || count <= 1)
+    {
+        for (size_t i = 0; i < count; ++i) fn(ctx, i);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn    = fn;
+    pool->ctx   = ctx;
+    pool->count = count;
+    pool->busy  = pool->worker_count;
+    atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_drain_(pool, fn, ctx, count);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
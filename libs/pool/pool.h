@@ -0,0 +1,46 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "../types.h"
+
+typedef void (*pool_task_fn_t)(void* ctx, size_t index);
+
+/*
+    Fixed set of worker threads that run the indices of one job at a time.
+    The thread calling pool_run works on the job as well, so a pool of one
+    thread has no workers and runs everything in place
+*/
+typedef struct
+{
+    pthread_t*      workers;
+    size_t          worker_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;       // a job was posted or the pool stops
+    pthread_cond_t  idle;       // the last worker left the job
+
+    // current job, written under lock
+    pool_task_fn_t  fn;
+    void*           ctx;
+    size_t          count;
+    size_t          generation;
+    size_t          busy;       // workers still on the job
+    int             stop;
+
+    atomic_size_t   next;       // next index to hand out
+} pool_t;
+
+// threads counts the caller, 0 = one per online core
+err_t  pool_ctor(pool_t* pool, size_t threads);
+void   pool_dtor(pool_t* pool);
+
+// fn(ctx, i) for every i in [0, count), in any order and on any thread; returns when all are done
+void   pool_run (pool_t* pool, size_t count, pool_task_fn_t fn, void* ctx);
+
+size_t pool_cores(void);
+
+#endif
@@ -1,4 +1,5 @@
 #include "stack.h"
+#include "../memory/memory.h"
 
 typedef struct
 {
@@ -41,7 +42,7 @@ static inline stack_t* get_stack(stack_id id)
 static int free_slot(stack_id slot)
 {
     if (!CHECK(ERROR, id_in_range(slot), "free_slot: stack_id incorrect")) return 1;
-    free(stack_array[slot]);
+    mem_free(stack_array[slot]);
     stack_array[slot] = NULL;
     return 0;
 }
@@ -51,7 +52,7 @@ static int ensure_registry(void)
     if (stack_array == NULL || stack_array_cap == 0)
     {
         stack_array_cap = INITIAL_CAPACITY;
-        stack_array = (stack_t**) calloc(stack_array_cap, sizeof(*stack_array));
+        stack_array = (stack_t**) mem_calloc(MEM_TAG_STACK, stack_array_cap, sizeof(*stack_array));
         if (!CHECK(ERROR, stack_array != NULL, "ensure_registry: failed to allocate stack_array")) return 0;
         return 1;
     }
@@ -69,7 +70,7 @@ static stack_id alloc_slot(void)
   
     size_t old_cap = stack_array_cap;
     size_t new_cap = old_cap ? old_cap * 2 : INITIAL_CAPACITY;
-    void* p = realloc(stack_array, new_cap * sizeof(*stack_array));
+    void* p = mem_realloc(MEM_TAG_STACK, stack_array, new_cap * sizeof(*stack_array));
     if (!CHECK(ERROR, p != NULL, "alloc_slot: failed reallocate stack_array")) return 0;
 
     stack_array = (stack_t**)p;
@@ -112,7 +113,7 @@ static err_t stack_realloc(stack_id stack, const size_t new_capacity)
 
     if (new_capacity == 0)
     {
-        free(st->raw_data);
+        mem_free(st->raw_data);
         st->data       = NULL;
         st->raw_data   = NULL;
         st->capacity   = 0;
@@ -121,7 +122,7 @@ static err_t stack_realloc(stack_id stack, const size_t new_capacity)
         return OK;
     }
 
-    void* p = (void*) realloc(st->raw_data, new_bytes);
+    void* p = (void*) mem_realloc(MEM_TAG_STACK, st->raw_data, new_bytes);
     STACK_ERR_CHECK(ERROR, p != NULL, stack, ERR_ALLOC,
                     "stack_realloc: realloc failed");
 
@@ -159,7 +160,7 @@ err_t stack_ctor(stack_id* stack, element_info_t info,
     }
 
     stack_id slot = alloc_slot();
-    stack_t* st   = (stack_t*)calloc(1, sizeof(*st));
+    stack_t* st   = (stack_t*)mem_calloc(MEM_TAG_STACK, 1, sizeof(*st));
     if (!CHECK(ERROR, st != NULL, "stack_ctor: st failed to alloc")) return ERR_ALLOC;
 
 
@@ -178,7 +179,7 @@ err_t stack_ctor(stack_id* stack, element_info_t info,
     st->sprinter = sprinter;
 
     size_t to_alloc = INITIAL_CAPACITY * st->elem_info.elem_stride + 2 * sizeof(STACK_CANARY);
-    void* res       = (void*) calloc(1, to_alloc); 
+    void* res       = (void*) mem_calloc(MEM_TAG_STACK, 1, to_alloc); 
     if (!CHECK(ERROR, res != NULL, "stack_ctor: res == NULL")) { free_slot(slot); return ERR_BAD_ARG; }
     st->capacity = INITIAL_CAPACITY;
     st->alloc_size  = to_alloc;
@@ -205,7 +206,7 @@ err_t stack_dtor(stack_id stack)
 
     if (st->data)
     {
-        free(st->raw_data);
+        mem_free(st->raw_data);
         st->data     = NULL;
         st->raw_data = NULL;
     }
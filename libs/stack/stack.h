@@ -18,7 +18,7 @@
 #include "libs/types.h"
 
 #ifdef LOGGING_H
-  #define IFLOG(level, fmt, ...)  log_printf((level), (fmt), ##__VA_ARGS__)
+  #define IFLOG(level, fmt, ...)  LOG_AT((level), (fmt), ##__VA_ARGS__)
 #else
   #include <stdio.h>
   #define IFLOG(level, fmt, ...)  printf((fmt), ##__VA_ARGS__)
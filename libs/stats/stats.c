@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats.h"
+
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "../logging/logging.h"
+#include "../memory/memory.h"
+
+static stats_t stats = { 0 };
+
+static const char* const stats_phase_names[STATS_PHASE_COUNT] = {
+#define STATS_NAME(sym, str) str,
+    STATS_PHASE_LIST(STATS_NAME)
+#undef STATS_NAME
+};
+
+static const char* const stats_counter_names[STATS_COUNTER_COUNT] = {
+#define STATS_NAME(sym, str) str,
+    STATS_COUNTER_LIST(STATS_NAME)
+#undef STATS_NAME
+};
+
+static double clock_sec_(clockid_t id)
+{
+    struct timespec ts = { 0 };
+    if (clock_gettime(id, &ts) != 0) return 0.0;
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static size_t peak_rss_kb_(void)
+{
+    struct rusage ru = { 0 };
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+    return (size_t)ru.ru_maxrss; // KiB on Linux
+}
+
+// src as a JSON string literal, quotes included
+static void json_str_(FILE* out, const char* src)
+{
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*)src; *c; ++c)
+    {
+        switch (*c)
+        {
+            case '"':  fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '\n': fputs("\\n", out);  break;
+            case '\r': fputs("\\r", out);  break;
+            case '\t': fputs("\\t", out);  break;
+            default:
+                if (*c < 0x20) fprintf(out, "\\u%04x", *c);
+                else           fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+double stats_wall_now(void)
+{
+    return clock_sec_(CLOCK_MONOTONIC);
+}
+
+void stats_init(const char* tool, bool enabled)
+{
+    memset(&stats, 0, sizeof(stats));
+    stats.tool    = tool ? tool : "?";
+    stats.enabled = enabled;
+
+    if (!enabled) return;
+
+    stats.wall_start = clock_sec_(CLOCK_MONOTONIC);
+    stats.cpu_start  = clock_sec_(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+bool stats_enabled(void)
+{
+    return stats.enabled;
+}
+
+void stats_phase_begin(stats_phase_t phase)
+{
+    if (!stats.enabled || phase >= STATS_PHASE_COUNT) return;
+
+    stats_phase_info_t* p = &stats.phases[phase];
+    p->calls++;
+
+    // only the outermost entry of a recursive phase is timed
+    if (p->depth++ > 0) return;
+
+    p->wall_start = clock_sec_(CLOCK_MONOTONIC);
+    p->cpu_start  = clock_sec_(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void stats_phase_end(stats_phase_t phase)
+{
+    if (!stats.enabled || phase >= STATS_PHASE_COUNT) return;
+
+    stats_phase_info_t* p = &stats.phases[phase];
+    if (p->depth == 0 || --p->depth > 0) return;
+
+    p->wall_sec += clock_sec_(CLOCK_MONOTONIC)          - p->wall_start;
+    p->cpu_sec  += clock_sec_(CLOCK_PROCESS_CPUTIME_ID) - p->cpu_start;
+}
+
+void stats_set(stats_counter_t counter, size_t value)
+{
+    if (!stats.enabled || counter >= STATS_COUNTER_COUNT) return;
+    stats.counters[counter]    = value;
+    stats.counter_set[counter] = true;
+}
+
+void stats_add(stats_counter_t counter, size_t delta)
+{
+    if (!stats.enabled || counter >= STATS_COUNTER_COUNT) return;
+    stats.counters[counter]   += delta;
+    stats.counter_set[counter] = true;
+}
+
+void stats_report(FILE* out)
+{
+    if (!stats.enabled || !out) return;
+
+    const double wall = clock_sec_(CLOCK_MONOTONIC)          - stats.wall_start;
+    const double cpu  = clock_sec_(CLOCK_PROCESS_CPUTIME_ID) - stats.cpu_start;
+
+    fprintf(out, "=== %s stats ===\n", stats.tool);
+    fprintf(out, "%-16s %12s %12s %8s\n", "phase", "wall ms", "cpu ms", "calls");
+
+    for (size_t i = 0; i < STATS_PHASE_COUNT; ++i)
+    {
+        const stats_phase_info_t* p = &stats.phases[i];
+        if (p->calls == 0) continue;
+
+        fprintf(out, "%-16s %12.3f %12.3f %8zu\n",
+                stats_phase_names[i], p->wall_sec * 1e3, p->cpu_sec * 1e3, p->calls);
+    }
+
+    fprintf(out, "%-16s %12.3f %12.3f\n", "total", wall * 1e3, cpu * 1e3);
+
+    for (size_t i = 0; i < STATS_COUNTER_COUNT; ++i)
+    {
+        if (!stats.counter_set[i]) continue;
+        fprintf(out, "%-16s %12zu\n", stats_counter_names[i], stats.counters[i]);
+    }
+
+    fprintf(out, "%-16s %12zu\n", "peak_rss_kb", peak_rss_kb_());
+
+    if (mem_tracking_enabled())
+        mem_report(out);
+}
+
+err_t stats_write_json(const char* filename)
+{
+    if (!stats.enabled) return OK;
+    if (!filename) return ERR_BAD_ARG;
+
+    FILE* out = fopen(filename, "w");
+    if (!out)
+    {
+        LOG_ERROR("Failed to open stats file '%s'", filename);
+        return ERR_BAD_ARG;
+    }
+
+    const double wall = clock_sec_(CLOCK_MONOTONIC)          - stats.wall_start;
+    const double cpu  = clock_sec_(CLOCK_PROCESS_CPUTIME_ID) - stats.cpu_start;
+
+    fprintf(out, "{\n  \"tool\": ");
+    json_str_(out, stats.tool);
+    fprintf(out, ",\n");
+    fprintf(out, "  \"total\": { \"wall_ms\": %.3f, \"cpu_ms\": %.3f },\n", wall * 1e3, cpu * 1e3);
+
+    fprintf(out, "  \"phases\": {");
+    const char* sep = "";
+    for (size_t i = 0; i < STATS_PHASE_COUNT; ++i)
+    {
+        const stats_phase_info_t* p = &stats.phases[i];
+        if (p->calls == 0) continue;
+
+        fprintf(out, "%s\n    \"%s\": { \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"calls\": %zu }",
+                sep, stats_phase_names[i], p->wall_sec * 1e3, p->cpu_sec * 1e3, p->calls);
+        sep = ",";
+    }
+    fprintf(out, "\n  },\n");
+
+    fprintf(out, "  \"counters\": {");
+    sep = "";
+    for (size_t i = 0; i < STATS_COUNTER_COUNT; ++i)
+    {
+        if (!stats.counter_set[i]) continue;
+        fprintf(out, "%s\n    \"%s\": %zu", sep, stats_counter_names[i], stats.counters[i]);
+        sep = ",";
+    }
+    fprintf(out, "%s\n    \"peak_rss_kb\": %zu\n  }", sep, peak_rss_kb_());
+
+    if (mem_tracking_enabled())
+    {
+        fprintf(out, ",\n  \"memory\": {");
+        sep = "";
+        for (size_t i = 0; i < MEM_TAG_COUNT; ++i)
+        {
+            mem_tag_stats_t m = { 0 };
+            mem_tag_stats((mem_tag_t)i, &m);
+            if (m.allocs == 0) continue;
+
+            fprintf(out, "%s\n    \"%s\": { \"live\": %zu, \"peak\": %zu, \"allocs\": %zu, "
+                         "\"reallocs\": %zu, \"frees\": %zu }",
+                    sep, mem_tag_name((mem_tag_t)i), m.live_bytes, m.peak_bytes,
+                    m.allocs, m.reallocs, m.frees);
+            sep = ",";
+        }
+        fprintf(out, "\n  }");
+    }
+
+    fprintf(out, "\n}\n");
+
+    fclose(out);
+    return OK;
+}
+
+err_t stats_finish(bool print_report, const char* json_filename)
+{
+    if (!stats.enabled) return OK;
+
+    if (print_report)
+        stats_report(stderr);
+
+    return json_filename ? stats_write_json(json_filename) : OK;
+}
@@ -0,0 +1,117 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../types.h"
+
+#define STATS_PHASE_LIST(X)                 \
+    X(STATS_PHASE_LOAD,     "load")         \
+    X(STATS_PHASE_LEX,      "lex")          \
+    X(STATS_PHASE_PARSE,    "parse")        \
+    X(STATS_PHASE_DERIV,    "derivative")   \
+    X(STATS_PHASE_OPTIMIZE, "optimize")     \
+    X(STATS_PHASE_IR,       "ir")           \
+    X(STATS_PHASE_EMIT,     "emit")         \
+    X(STATS_PHASE_DUMP,     "dump")         \
+    X(STATS_PHASE_WRITE,    "write")
+
+#define STATS_COUNTER_LIST(X)                   \
+    X(STATS_INPUT_BYTES,    "input_bytes")      \
+    X(STATS_OUTPUT_BYTES,   "output_bytes")     \
+    X(STATS_TOKENS,         "tokens")           \
+    X(STATS_AST_NODES,      "ast_nodes")        \
+    X(STATS_AST_ALLOCS,     "ast_allocs")       \
+    X(STATS_NAMETABLE_SIZE, "nametable_size")   \
+    X(STATS_FUNCTIONS,      "functions")        \
+    X(STATS_IR_BLOCKS,      "ir_blocks")        \
+    X(STATS_IR_VALUES,      "ir_values")
+
+typedef enum
+{
+#define STATS_ENUM(sym, str) sym,
+    STATS_PHASE_LIST(STATS_ENUM)
+#undef STATS_ENUM
+
+    STATS_PHASE_COUNT
+} stats_phase_t;
+
+typedef enum
+{
+#define STATS_ENUM(sym, str) sym,
+    STATS_COUNTER_LIST(STATS_ENUM)
+#undef STATS_ENUM
+
+    STATS_COUNTER_COUNT
+} stats_counter_t;
+
+typedef struct
+{
+    double wall_sec;
+    double cpu_sec;
+    size_t calls;
+
+    double wall_start;
+    double cpu_start;
+    size_t depth;
+} stats_phase_info_t;
+
+typedef struct
+{
+    const char*        tool;
+    bool               enabled;
+
+    stats_phase_info_t phases  [STATS_PHASE_COUNT];
+    size_t             counters[STATS_COUNTER_COUNT];
+    bool               counter_set[STATS_COUNTER_COUNT];
+
+    double             wall_start;
+    double             cpu_start;
+} stats_t;
+
+/*
+    Init statistics module
+    Parameters:
+        tool    - driver name written into the report
+        enabled - when false every other call is a cheap no-op
+*/
+void  stats_init       (const char* tool, bool enabled);
+bool  stats_enabled    (void);
+
+/*
+    Start/stop timing of a phase. Phases may nest (derivative inside parse)
+    and may be entered many times; time is accumulated
+*/
+void  stats_phase_begin(stats_phase_t phase);
+void  stats_phase_end  (stats_phase_t phase);
+
+/*
+    Set or increase a counter
+*/
+void  stats_set        (stats_counter_t counter, size_t value);
+void  stats_add        (stats_counter_t counter, size_t delta);
+
+/*
+    Monotonic wall clock in seconds, for callers timing their own sections.
+    Works whether or not the module is enabled
+*/
+double stats_wall_now  (void);
+
+/*
+    Print human readable report (phases, counters, peak RSS)
+*/
+void  stats_report     (FILE* out);
+
+/*
+    Write machine readable JSON report into file
+*/
+err_t stats_write_json (const char* filename);
+
+/*
+    Report to stderr if print_report, and to JSON file if json_filename != NULL
+*/
+err_t stats_finish     (bool print_report, const char* json_filename);
+
+#endif
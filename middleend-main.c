@@ -5,6 +5,8 @@
 #include "libs/types.h"
 #include "libs/logging/logging.h"
 #include "libs/io/io.h"
+#include "libs/stats/stats.h"
+#include "libs/memory/memory.h"
 
 #include "ast/ast.h"
 #include "middleend/middleend.h"
@@ -37,9 +39,9 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
         if ((fp) && (fp) != stdout) { fclose((fp)); (fp) = NULL; } \
     block_end
 
-#define SAFE_FREE(p)                    \
-    block_begin                         \
-        if (p) { free(p); (p) = NULL; } \
+#define SAFE_FREE(p)                        \
+    block_begin                             \
+        if (p) { mem_free(p); (p) = NULL; } \
     block_end
 
 #define FAIL_MSG(msg)                                                            \
@@ -48,7 +50,7 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
             snprintf(op_data.error_msg, sizeof(op_data.error_msg), "%s", (msg)); \
         fprintf(stderr, "%s\n", op_data.error_msg);                              \
         print_error_context_(stderr, &op_data);                                  \
-        log_printf(ERROR, "%s", op_data.error_msg);                              \
+        LOG_ERROR("%s", op_data.error_msg);                                      \
         rc = ERR_SYNTAX;                                                         \
         goto cleanup;                                                            \
     block_end
@@ -58,7 +60,7 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
         snprintf(op_data.error_msg, sizeof(op_data.error_msg), (fmt), __VA_ARGS__); \
         fprintf(stderr, "%s\n", op_data.error_msg);                                 \
         print_error_context_(stderr, &op_data);                                     \
-        log_printf(ERROR, "%s", op_data.error_msg);                                 \
+        LOG_ERROR("%s", op_data.error_msg);                                         \
         rc = ERR_SYNTAX;                                                            \
         goto cleanup;                                                               \
     block_end
@@ -75,17 +77,80 @@ int main(int argc, char* const argv[])
     ast_tree_t ast_tree   = (ast_tree_t){ 0 };
     int        ast_inited = 0;
 
+    const char* stats_flag = NULL;
+    const char* stats_json = NULL;
+
+    const char* max_iterations = NULL;
+    const char* inline_budget  = NULL;
+    const char* unroll_budget  = NULL;
+    const char* opt_level      = NULL;
+    const char* pass_list      = NULL;
+    const char* time_passes    = NULL;
+    const char* memo           = NULL;
+    const char* fast_math      = NULL;
+    const char* memo_entries   = NULL;
+    const char* profile        = NULL;
+    const char* hot_budget     = NULL;
+    const char* jobs           = NULL;
+
+    const arg_option_t options[] = {
+        { "--stats",          ARG_FLAG,   &stats_flag     },
+        { "--stats-json",     ARG_VALUE,  &stats_json     },
+        { "--max-iterations", ARG_VALUE,  &max_iterations },
+        { "--inline-budget",  ARG_VALUE,  &inline_budget  },
+        { "--unroll-budget",  ARG_VALUE,  &unroll_budget  },
+        { "-O",               ARG_PREFIX, &opt_level      },
+        { "--passes=",        ARG_PREFIX, &pass_list      },
+        { "--time-passes",    ARG_FLAG,   &time_passes    },
+        { "--memo",           ARG_FLAG,   &memo           },
+        { "--fast-math",      ARG_FLAG,   &fast_math      },
+        { "--memo-entries",   ARG_VALUE,  &memo_entries   },
+        { "--profile",        ARG_VALUE,  &profile        },
+        { "--hot-budget",     ARG_VALUE,  &hot_budget     },
+        { "--jobs",           ARG_VALUE,  &jobs           },
+    };
+
     init_logging("middleend.log", DEBUG);
-    log_printf(INFO, "Middle-end started");
+    LOG_INFO("Middle-end started");
 
-    size_t parsed = parse_arguments(argc, argv, &in_filename, &out_filename);
+    size_t parsed = parse_arguments_ex(argc, argv, &in_filename, &out_filename,
+                                       options, sizeof(options) / sizeof(options[0]));
     unused(parsed);
 
+    stats_init("middleend", stats_flag || stats_json);
+
     if (!in_filename)
         FAIL_MSG("Input file not specified. Use --infile <file.east>");
     if (!out_filename)
         FAIL_MSG("Output file not specified. Use --outfile <file.east>");
 
+    opt_config_t opt_cfg = { 0 };
+    opt_config_default(&opt_cfg);
+    if (jobs)
+        opt_cfg.jobs = (size_t)strtoull(jobs, NULL, 10);
+    if (max_iterations)
+        opt_cfg.max_iterations = (size_t)strtoull(max_iterations, NULL, 10);
+    if (inline_budget)
+        opt_cfg.inline_budget = (size_t)strtoull(inline_budget, NULL, 10);
+    if (hot_budget)
+        opt_cfg.hot_budget = (size_t)strtoull(hot_budget, NULL, 10);
+    if (unroll_budget)
+        opt_cfg.unroll_budget = (size_t)strtoull(unroll_budget, NULL, 10);
+    if (memo_entries)
+        opt_cfg.memo_entries = (size_t)strtoull(memo_entries, NULL, 10);
+
+    // --passes= picks the exact set, -O only when it is not given
+    if (opt_level && (opt_level[0] == '\0' || opt_level[1] != '\0' ||
+                      opt_config_level(&opt_cfg, opt_level[0] - '0') != OK))
+        FAILF("Unknown optimization level '-O%s', expected 0..%d", opt_level, OPT_LEVEL_MAX);
+    if (pass_list && opt_config_passes(&opt_cfg, pass_list) != OK)
+        FAILF("Bad pass list '%s'", pass_list);
+    if (memo)
+        opt_cfg.passes[OPT_PASS_MEMO] = 1;
+    opt_cfg.time_passes = (time_passes != NULL);
+    opt_cfg.fast_math   = (fast_math != NULL);
+
+    stats_phase_begin(STATS_PHASE_LOAD);
     op_data.in_file = load_file(in_filename, "rb");
     if (!op_data.in_file)
         FAILF("Failed to open input file '%s'", in_filename);
@@ -95,7 +160,7 @@ int main(int argc, char* const argv[])
         FAILF("Failed to stat input file '%s'", in_filename);
 
     op_data.buffer_size = (size_t)file_size;
-    op_data.buffer = (char*)calloc(op_data.buffer_size + 1, 1);
+    op_data.buffer = (char*)mem_calloc(MEM_TAG_IO, op_data.buffer_size + 1, 1);
     if (!op_data.buffer)
         FAILF("Failed to allocate %zu bytes for input buffer", op_data.buffer_size + 1);
 
@@ -118,20 +183,52 @@ int main(int argc, char* const argv[])
     ast_inited = 1;
 
     rc = ast_read_sexpr_from_op(&ast_tree, &op_data);
+    stats_phase_end(STATS_PHASE_LOAD);
     if (rc != OK)
         FAIL_MSG("Failed to read .east AST.");
 
-    int changed = 0;
-    rc = ast_optimize(&ast_tree, &changed);
+    if (profile)
+    {
+        rc = ast_profile_read(&ast_tree, profile);
+        if (rc == ERR_CORRUPT)
+            FAILF("Profile '%s' has no counters for this program", profile);
+        if (rc != OK)
+            FAILF("Failed to read profile '%s'", profile);
+    }
+
+    stats_set(STATS_INPUT_BYTES, op_data.buffer_size);
+
+    opt_report_t opt_report = { 0 };
+    stats_phase_begin(STATS_PHASE_OPTIMIZE);
+    rc = ast_optimize_ex(&ast_tree, &opt_cfg, &opt_report);
+    stats_phase_end(STATS_PHASE_OPTIMIZE);
     if (rc != OK)
         FAIL_MSG("Optimization failed.");
 
-    log_printf(INFO, "Optimizations finished (changed=%d)", changed);
+    if (stats_flag)
+        opt_report_print(stderr, &opt_report);
+    if (time_passes)
+        opt_report_print_passes(stderr, &opt_report);
+
+    if (stats_enabled())
+    {
+        stats_set(STATS_AST_NODES,      ast_subtree_size(ast_tree.root));
+        stats_set(STATS_AST_ALLOCS,     ast_tree.alloced_count);
+        stats_set(STATS_NAMETABLE_SIZE, ast_tree.nametable.amount);
+        stats_set(STATS_FUNCTIONS,      ast_children_count(ast_tree.root));
+    }
+
+    LOG_INFO("Optimizations finished: %zu rewrites in %zu visits",
+             opt_report.rewrites, opt_report.iterations);
 
+    stats_phase_begin(STATS_PHASE_WRITE);
     ast_dump_sexpr(op_data.out_file, &ast_tree, ast_tree.root);
     fprintf(op_data.out_file, "\n");
+    stats_set(STATS_OUTPUT_BYTES, (size_t)ftell(op_data.out_file));
+    SAFE_FCLOSE(op_data.out_file);
+    stats_phase_end(STATS_PHASE_WRITE);
 
-    log_printf(INFO, "Wrote optimized .east: %s", out_filename);
+    LOG_INFO("Wrote optimized .east: %s", out_filename);
 
 cleanup:
     if (ast_inited) ast_tree_dtor(&ast_tree);
@@ -141,6 +238,11 @@ cleanup:
 
     SAFE_FREE(op_data.buffer);
 
+    mem_leak_report(stderr);
+
+    if (stats_finish(stats_flag != NULL, stats_json) != OK && rc == OK)
+        rc = ERR_BAD_ARG;
+
     close_log_file();
     return (rc == OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,618 @@
+#include "middleend.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Compile-time evaluation. A function is pure when it prints nothing,
+    calls no builtin (all of them do I/O or touch the screen), uses no sus
+    values and calls only pure functions. A call of a pure function whose
+    arguments are all literals is run by a small AST interpreter and
+    replaced by the literal it returns. Operators go through the folding
+    rules, so results are the ones folding would give; anything the rules
+    leave alone (division by zero, int overflow, reading a local before
+    its first store) abandons the call. Steps are shared by all calls of
+    a run, memory counts live locals plus three cells per frame like the
+    call protocol
+*/
+
+#define CE_FRAME_CELLS 3
+
+typedef struct
+{
+    literal_type_t lit_type;  // LIT_INT or LIT_FLOAT
+    cell64_t       lit;
+} ce_val_t;
+
+typedef struct
+{
+    ast_node_t* fn;
+    size_t      name_id;
+    int         pure;
+} ce_func_t;
+
+typedef struct
+{
+    size_t     name_id;
+    ast_type_t type;
+    ce_val_t   val;
+    int        init;
+} ce_bind_t;
+
+typedef enum
+{
+    CE_NEXT = 0,
+    CE_BREAK,
+    CE_RETURN,
+    CE_FAIL,      // not evaluable: the call stays
+} ce_flow_t;
+
+typedef struct
+{
+    ast_tree_t* tree;
+
+    ce_func_t*  funcs;
+    size_t      func_count;
+
+    ce_bind_t*  binds;        // locals of every active frame
+    size_t      bind_count;
+    size_t      bind_cap;
+    size_t      frame;        // first bind of the innermost call
+
+    size_t      steps_left;
+    size_t      mem_limit;
+    size_t      depth;        // active calls
+    ce_val_t    ret;          // value of the last micdrop
+
+    int         alloc_failed;
+    size_t      evaluated;
+} ce_ctx_t;
+
+// builtins go before user functions in both backends
+static const char* const ce_builtins[] = {
+    "in", "fin", "cin", "cap", "nocap", "stinky",
+    "draw", "clean_vm", "gyat", "skibidi",
+    "out", "fout", "cout", "pookie", "rizz", "menace",
+    "set_pixel",
+};
+
+static int ce_is_builtin_(const ast_tree_t* tree, size_t name_id)
+{
+    const char* name = ast_name_cstr(tree, name_id);
+    if (!name) return 0;
+
+    for (size_t i = 0; i < sizeof(ce_builtins) / sizeof(ce_builtins[0]); ++i)
+        if (strcmp(name, ce_builtins[i]) == 0) return 1;
+    return 0;
+}
+
+static ce_func_t* ce_find_(const ce_ctx_t* cx, size_t name_id)
+{
+    if (ce_is_builtin_(cx->tree, name_id)) return NULL;
+
+    for (size_t i = 0; i < cx->func_count; ++i)
+        if (cx->funcs[i].name_id == name_id) return &cx->funcs[i];
+    return NULL;
+}
+
+static ast_node_t* ce_body_(const ast_node_t* fn)
+{
+    return fn->left ? fn->left->right : NULL;
+}
+
+// ================================== purity ==================================
+
+static int ce_body_pure_(const ce_ctx_t* cx, const ast_node_t* n)
+{
+    for (; n; n = n->right)
+    {
+        switch (n->kind)
+        {
+            case ASTK_COUT:
+            case ASTK_ICOUT:
+            case ASTK_FCOUT:
+            case ASTK_STR_LIT:
+                return 0;
+
+            case ASTK_CALL:
+            {
+                const ce_func_t* g = ce_find_(cx, n->u.call.name_id);
+                if (!g || !g->pure) return 0;
+                break;
+            }
+
+            case ASTK_VAR_DECL:
+                if (n->u.vdecl.type == AST_TYPE_PTR) return 0;
+                break;
+
+            default:
+                break;
+        }
+
+        if (!ce_body_pure_(cx, n->left)) return 0;
+    }
+    return 1;
+}
+
+static int ce_signature_ok_(const ast_node_t* fn)
+{
+    if (fn->u.func.ret_type == AST_TYPE_PTR) return 0;
+
+    for (const ast_node_t* p = fn->left ? fn->left->left : NULL; p; p = p->right)
+        if (p->u.param.type != AST_TYPE_INT && p->u.param.type != AST_TYPE_FLOAT) return 0;
+    return 1;
+}
+
+// optimistic start, impure callees spread to callers until nothing changes
+static void ce_purity_(ce_ctx_t* cx)
+{
+    for (size_t i = 0; i < cx->func_count; ++i)
+        cx->funcs[i].pure = cx->funcs[i].fn->kind == ASTK_FUNC && ce_signature_ok_(cx->funcs[i].fn);
+
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (size_t i = 0; i < cx->func_count; ++i)
+        {
+            ce_func_t* f = &cx->funcs[i];
+            if (!f->pure || ce_body_pure_(cx, ce_body_(f->fn))) continue;
+
+            f->pure = 0;
+            changed = 1;
+        }
+    }
+}
+
+// ================================== values ==================================
+
+static int ce_spend_(ce_ctx_t* cx)
+{
+    if (cx->steps_left == 0) return 0;
+    cx->steps_left--;
+    return 1;
+}
+
+// same conversions as a store into a variable of type t
+static int ce_to_type_(ce_val_t* v, ast_type_t t)
+{
+    if (t == AST_TYPE_FLOAT && v->lit_type == LIT_INT)
+    {
+        v->lit.f64  = (f64_t)v->lit.i64;
+        v->lit_type = LIT_FLOAT;
+    }
+    else if (t != AST_TYPE_FLOAT && v->lit_type == LIT_FLOAT)
+    {
+        // out of range has no defined result
+        if (!(v->lit.f64 > -9223372036854775808.0 && v->lit.f64 < 9223372036854775808.0)) return 0;
+        v->lit.i64  = (i64_t)v->lit.f64;
+        v->lit_type = LIT_INT;
+    }
+    return 1;
+}
+
+// int results the VM would wrap or trap on are not folded
+static int ce_int_ok_(const ast_node_t* e, const ce_val_t* ops, size_t count)
+{
+    if (count == 1)
+    {
+        if (e->kind == ASTK_UNARY && e->u.unary.op == TOK_OP_MINUS)
+            return ops[0].lit_type != LIT_INT || ops[0].lit.i64 != INT64_MIN;
+        if (e->kind == ASTK_BUILTIN_UNARY && e->u.builtin_unary.id == AST_BUILTIN_FTOI)
+        {
+            ce_val_t v = ops[0];
+            return ce_to_type_(&v, AST_TYPE_INT);
+        }
+        return 1;
+    }
+
+    if (ops[0].lit_type != LIT_INT || ops[1].lit_type != LIT_INT) return 1;
+
+    const i64_t a = ops[0].lit.i64;
+    const i64_t b = ops[1].lit.i64;
+    i64_t r = 0;
+
+    switch (e->u.binary.op)
+    {
+        case TOK_OP_PLUS:  return !__builtin_add_overflow(a, b, &r);
+        case TOK_OP_MINUS: return !__builtin_sub_overflow(a, b, &r);
+        case TOK_OP_MUL:   return !__builtin_mul_overflow(a, b, &r);
+        case TOK_OP_DIV:   return !(a == INT64_MIN && b == -1);
+
+        case TOK_OP_POW:
+        {
+            r = 1;
+            for (i64_t i = 0; i < b; ++i)
+            {
+                if (__builtin_mul_overflow(r, a, &r)) return 0;
+                if (r == 0 || a == 1 || a == -1) break;
+            }
+            return 1;
+        }
+
+        default:
+            return 1;
+    }
+}
+
+// run the folding rules on a copy of e with literal operands
+static int ce_fold_(const ast_node_t* e, const ce_val_t* ops, size_t count, ce_val_t* out)
+{
+    if (!ce_int_ok_(e, ops, count)) return 0;
+
+    ast_node_t tmp     = *e;
+    ast_node_t kids[2] = { 0 };
+
+    tmp.left = tmp.right = tmp.parent = NULL;
+    for (size_t i = 0; i < count; ++i)
+    {
+        kids[i].kind           = ASTK_NUM_LIT;
+        kids[i].parent         = &tmp;
+        kids[i].u.num.lit_type = ops[i].lit_type;
+        kids[i].u.num.lit      = ops[i].lit;
+        if (i > 0) kids[i - 1].right = &kids[i];
+    }
+    tmp.left = &kids[0];
+
+    const ast_node_t* r = opt_fold_once(&tmp);
+    if (!r || r->kind != ASTK_NUM_LIT) return 0;
+    if (r->u.num.lit_type != LIT_INT && r->u.num.lit_type != LIT_FLOAT) return 0;
+
+    *out = (ce_val_t){ .lit_type = r->u.num.lit_type, .lit = r->u.num.lit };
+    return 1;
+}
+
+static ce_bind_t* ce_lookup_(ce_ctx_t* cx, size_t name_id)
+{
+    for (size_t i = cx->bind_count; i > cx->frame; --i)
+        if (cx->binds[i - 1].name_id == name_id) return &cx->binds[i - 1];
+    return NULL;
+}
+
+static int ce_bind_(ce_ctx_t* cx, size_t name_id, ast_type_t type)
+{
+    if (cx->bind_count + CE_FRAME_CELLS * cx->depth >= cx->mem_limit) return 0;
+
+    if (cx->bind_count == cx->bind_cap)
+    {
+        const size_t new_cap = cx->bind_cap ? cx->bind_cap * 2 : 16;
+        ce_bind_t* nb = (ce_bind_t*)mem_realloc(MEM_TAG_OPT, cx->binds, new_cap * sizeof(ce_bind_t));
+        if (!nb)
+        {
+            cx->alloc_failed = 1;
+            cx->steps_left   = 0;
+            return 0;
+        }
+        cx->binds    = nb;
+        cx->bind_cap = new_cap;
+    }
+
+    cx->binds[cx->bind_count++] = (ce_bind_t){ .name_id = name_id, .type = type };
+    return 1;
+}
+
+// ================================ interpreter ===============================
+
+static int ce_call_(ce_ctx_t* cx, const ast_node_t* call, ce_val_t* out);
+
+static int ce_expr_(ce_ctx_t* cx, const ast_node_t* e, ce_val_t* out)
+{
+    if (!e || !ce_spend_(cx)) return 0;
+
+    switch (e->kind)
+    {
+        case ASTK_NUM_LIT:
+            if (e->u.num.lit_type != LIT_INT && e->u.num.lit_type != LIT_FLOAT) return 0;
+            *out = (ce_val_t){ .lit_type = e->u.num.lit_type, .lit = e->u.num.lit };
+            return 1;
+
+        case ASTK_IDENT:
+        {
+            const ce_bind_t* b = ce_lookup_(cx, e->u.ident.name_id);
+            if (!b || !b->init) return 0;
+            *out = b->val;
+            return 1;
+        }
+
+        case ASTK_UNARY:
+        case ASTK_BUILTIN_UNARY:
+        case ASTK_BINARY:
+        {
+            ce_val_t ops[2] = { 0 };
+            size_t count = 0;
+
+            for (const ast_node_t* c = e->left; c; c = c->right)
+            {
+                if (count == 2 || !ce_expr_(cx, c, &ops[count])) return 0;
+                count++;
+            }
+
+            if (count != ((e->kind == ASTK_BINARY) ? 2u : 1u)) return 0;
+            return ce_fold_(e, ops, count, out);
+        }
+
+        case ASTK_CALL:
+            return ce_call_(cx, e, out);
+
+        default:
+            return 0;
+    }
+}
+
+static ce_flow_t ce_stmt_(ce_ctx_t* cx, const ast_node_t* st);
+
+static ce_flow_t ce_list_(ce_ctx_t* cx, const ast_node_t* first)
+{
+    const size_t binds = cx->bind_count;
+    ce_flow_t flow = CE_NEXT;
+
+    for (const ast_node_t* st = first; st && flow == CE_NEXT; st = st->right)
+        flow = ce_stmt_(cx, st);
+
+    cx->bind_count = binds;
+    return flow;
+}
+
+static int ce_truth_(const ce_val_t* v)
+{
+    return (v->lit_type == LIT_FLOAT) ? v->lit.f64 != 0.0 : v->lit.i64 != 0;
+}
+
+static ce_flow_t ce_stmt_(ce_ctx_t* cx, const ast_node_t* st)
+{
+    if (!ce_spend_(cx)) return CE_FAIL;
+
+    ce_val_t v = { 0 };
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:
+            return ce_list_(cx, st->left);
+
+        case ASTK_VAR_DECL:
+        {
+            // bound before its init, as in the backend
+            if (!ce_bind_(cx, st->u.vdecl.name_id, st->u.vdecl.type)) return CE_FAIL;
+            if (!st->left) return CE_NEXT;
+
+            // calls in the init may move binds
+            const size_t at = cx->bind_count - 1;
+            if (!ce_expr_(cx, st->left, &v) || !ce_to_type_(&v, st->u.vdecl.type)) return CE_FAIL;
+
+            cx->binds[at].val  = v;
+            cx->binds[at].init = 1;
+            return CE_NEXT;
+        }
+
+        case ASTK_ASSIGN:
+        {
+            if (!ce_expr_(cx, st->left, &v)) return CE_FAIL;
+
+            ce_bind_t* b = ce_lookup_(cx, st->u.assign.name_id);
+            if (!b || !ce_to_type_(&v, b->type)) return CE_FAIL;
+
+            b->val  = v;
+            b->init = 1;
+            return CE_NEXT;
+        }
+
+        case ASTK_EXPR_STMT:
+        case ASTK_CALL_STMT:
+            return ce_expr_(cx, st->left, &v) ? CE_NEXT : CE_FAIL;
+
+        case ASTK_RETURN:
+            if (st->left && !ce_expr_(cx, st->left, &cx->ret)) return CE_FAIL;
+            return CE_RETURN;
+
+        case ASTK_BREAK:
+            return CE_BREAK;
+
+        case ASTK_IF:
+        {
+            // IF/BRANCH: cond, stmt, [next arm]; ELSE: stmt
+            for (const ast_node_t* arm = st; arm; )
+            {
+                if (arm->kind == ASTK_ELSE) return ce_stmt_(cx, arm->left);
+
+                const ast_node_t* cond = arm->left;
+                const ast_node_t* then = cond ? cond->right : NULL;
+                if (!then || !ce_expr_(cx, cond, &v)) return CE_FAIL;
+
+                if (ce_truth_(&v)) return ce_stmt_(cx, then);
+                arm = then->right;
+            }
+            return CE_NEXT;
+        }
+
+        case ASTK_WHILE:
+        {
+            const ast_node_t* cond = st->left;
+            const ast_node_t* body = cond ? cond->right : NULL;
+            if (!body) return CE_FAIL;
+
+            for (;;)
+            {
+                if (!ce_expr_(cx, cond, &v)) return CE_FAIL;
+                if (!ce_truth_(&v)) return CE_NEXT;
+
+                // a bare declaration as the body lives for one iteration
+                const size_t binds = cx->bind_count;
+                const ce_flow_t flow = ce_stmt_(cx, body);
+                cx->bind_count = binds;
+
+                if (flow == CE_BREAK) return CE_NEXT;
+                if (flow != CE_NEXT)  return flow;
+            }
+        }
+
+        default:
+            return CE_FAIL;
+    }
+}
+
+static int ce_call_(ce_ctx_t* cx, const ast_node_t* call, ce_val_t* out)
+{
+    const ce_func_t* g = ce_find_(cx, call->u.call.name_id);
+    if (!g || !g->pure) return 0;
+
+    const ast_node_t* fn    = g->fn;
+    const ast_node_t* plist = fn->left;
+    if (ast_children_count(call->left) != ast_children_count(plist)) return 0;
+
+    // args are evaluated in the caller's frame into nameless binds, which
+    // become the params once all of them are there
+    const size_t base = cx->bind_count;
+    const ast_node_t* arg = call->left ? call->left->left : NULL;
+    for (const ast_node_t* p = plist->left; p; p = p->right, arg = arg->right)
+    {
+        ce_val_t v = { 0 };
+        if (!ce_expr_(cx, arg, &v) || !ce_to_type_(&v, p->u.param.type) ||
+            !ce_bind_(cx, SIZE_MAX, p->u.param.type))
+        {
+            cx->bind_count = base;
+            return 0;
+        }
+
+        cx->binds[cx->bind_count - 1].val  = v;
+        cx->binds[cx->bind_count - 1].init = 1;
+    }
+
+    size_t at = base;
+    for (const ast_node_t* p = plist->left; p; p = p->right)
+        cx->binds[at++].name_id = p->u.param.name_id;
+
+    const size_t frame = cx->frame;
+    cx->frame = base;
+    cx->depth++;
+
+    int ok = cx->bind_count + CE_FRAME_CELLS * cx->depth < cx->mem_limit;
+    ce_flow_t flow = CE_NEXT;
+    if (ok)
+    {
+        flow = ce_stmt_(cx, ce_body_(fn));
+        ok = (flow == CE_NEXT || flow == CE_RETURN);
+    }
+
+    cx->depth--;
+    cx->frame      = frame;
+    cx->bind_count = base;
+
+    if (!ok) return 0;
+    if (fn->u.func.ret_type == AST_TYPE_VOID)
+    {
+        *out = (ce_val_t){ .lit_type = LIT_INT };
+        return 1;
+    }
+
+    // a non-void function falling off its end returns 0
+    if (flow == CE_NEXT) cx->ret = (ce_val_t){ .lit_type = LIT_INT };
+    *out = cx->ret;
+    return ce_to_type_(out, fn->u.func.ret_type);
+}
+
+// ================================= rewriting ================================
+
+static int ce_is_lit_(const ast_node_t* n)
+{
+    return n && n->kind == ASTK_NUM_LIT &&
+           (n->u.num.lit_type == LIT_INT || n->u.num.lit_type == LIT_FLOAT);
+}
+
+static void ce_try_(ce_ctx_t* cx, ast_node_t* call)
+{
+    const ce_func_t* g = ce_find_(cx, call->u.call.name_id);
+    if (!g || !g->pure || g->fn->u.func.ret_type == AST_TYPE_VOID) return;
+
+    for (const ast_node_t* a = call->left ? call->left->left : NULL; a; a = a->right)
+        if (!ce_is_lit_(a)) return;
+
+    // a failed run still spends its steps, the budget bounds the whole pass
+    cx->bind_count = 0;
+    cx->frame      = 0;
+    cx->depth      = 0;
+
+    ce_val_t v = { 0 };
+    if (!ce_call_(cx, call, &v)) return;
+
+    call->kind           = ASTK_NUM_LIT;
+    call->left           = NULL;
+    call->type           = (v.lit_type == LIT_FLOAT) ? AST_TYPE_FLOAT : AST_TYPE_INT;
+    call->u.num.lit_type = v.lit_type;
+    call->u.num.lit      = v.lit;
+    cx->evaluated++;
+
+    // operators above that become literals in place are folded right away
+    // instead of by another full pass; the walk goes on from call->right
+    for (ast_node_t* n = call->parent; n; n = n->parent)
+    {
+        if (n->kind != ASTK_UNARY && n->kind != ASTK_BUILTIN_UNARY && n->kind != ASTK_BINARY) break;
+        if (opt_fold_once(n) != n) break;
+    }
+}
+
+// operands first, so f(g(2)) sees g's value
+static void ce_walk_(ce_ctx_t* cx, ast_node_t* n)
+{
+    for (; n && cx->steps_left > 0; n = n->right)
+    {
+        ce_walk_(cx, n->left);
+        if (n->kind == ASTK_CALL) ce_try_(cx, n);
+    }
+}
+
+static err_t ce_funcs_(ce_ctx_t* cx, ast_node_t* program)
+{
+    cx->func_count = ast_children_count(program);
+    cx->funcs = (ce_func_t*)mem_calloc(MEM_TAG_OPT, cx->func_count + 1, sizeof(ce_func_t));
+    if (!cx->funcs) return ERR_ALLOC;
+
+    size_t i = 0;
+    for (ast_node_t* fn = program->left; fn; fn = fn->right, ++i)
+    {
+        cx->funcs[i].fn      = fn;
+        cx->funcs[i].name_id = (fn->kind == ASTK_FUNC) ? fn->u.func.name_id : SIZE_MAX;
+    }
+
+    ce_purity_(cx);
+    return OK;
+}
+
+err_t opt_purity(ast_tree_t* tree, int* out_pure)
+{
+    if (!tree || !out_pure) return ERR_BAD_ARG;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM) return OK;
+
+    ce_ctx_t cx = { .tree = tree };
+    err_t rc = ce_funcs_(&cx, program);
+
+    for (size_t i = 0; i < cx.func_count && rc == OK; ++i)
+        out_pure[i] = cx.funcs[i].pure;
+
+    mem_free(cx.funcs);
+    return rc;
+}
+
+err_t opt_ceval(ast_tree_t* tree, size_t steps, size_t mem, size_t* out_evaluated)
+{
+    if (!tree || !out_evaluated) return ERR_BAD_ARG;
+    *out_evaluated = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM || steps == 0 || mem == 0) return OK;
+
+    ce_ctx_t cx = { .tree = tree, .steps_left = steps, .mem_limit = mem };
+
+    err_t rc = ce_funcs_(&cx, program);
+    if (rc != OK) return rc;
+
+    ce_walk_(&cx, program->left);
+
+    mem_free(cx.funcs);
+    mem_free(cx.binds);
+
+    *out_evaluated = cx.evaluated;
+    return cx.alloc_failed ? ERR_ALLOC : OK;
+}
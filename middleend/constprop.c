@@ -0,0 +1,564 @@
+#include "middleend.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Flow-sensitive constant propagation over locals and params. Every
+    function is walked as structured control flow with an environment of
+    per-variable lattice values: branches whose condition is known are not
+    entered, joins meet the environments of the arms that reach them, loops
+    iterate from the entry environment to a fixed point. Once a loop has
+    converged, a last walk replaces reads of constant variables by literals
+*/
+
+typedef enum
+{
+    CP_UNDEF = 0,  // no definition reaches yet
+    CP_CONST,
+    CP_VARYING,
+} cp_state_t;
+
+typedef struct
+{
+    cp_state_t     state;
+    literal_type_t lit_type;  // CP_CONST only, LIT_INT or LIT_FLOAT
+    cell64_t       lit;
+} cp_value_t;
+
+typedef struct
+{
+    cp_value_t* vals;
+    size_t      cap;
+    int         live;         // 0 once control cannot reach this point
+} cp_env_t;
+
+typedef struct
+{
+    size_t     name_id;
+    ast_type_t type;
+} cp_bind_t;
+
+typedef struct
+{
+    const ast_tree_t* tree;
+
+    cp_bind_t* binds;         // variable index == bind index, popped with the scope
+    size_t     bind_count;
+    size_t     bind_cap;
+
+    cp_env_t*  breaks;        // per enclosing loop: meet of environments at gg
+    size_t     loop_count;
+    size_t     loop_cap;
+
+    int        rewrite;       // replace constant reads, only on a converged walk
+    size_t     budget;        // node visits left in the current function
+    int        exhausted;
+    size_t     replaced;
+} cp_ctx_t;
+
+static const cp_value_t cp_varying_ = { .state = CP_VARYING };
+
+#define CP_GROW_(ptr, cap, want, type)                                         \
+    block_begin                                                                \
+        if ((want) > (cap)) {                                                  \
+            size_t new_cap = (cap) ? (cap) * 2 : 16;                           \
+            while (new_cap < (want)) new_cap *= 2;                             \
+            void* np = mem_realloc(MEM_TAG_OPT, (ptr), new_cap * sizeof(type)); \
+            if (!np) return ERR_ALLOC;                                         \
+            (ptr) = (type*)np;                                                 \
+            (cap) = new_cap;                                                   \
+        }                                                                      \
+    block_end
+
+// ================================= lattice ==================================
+
+static int cp_same_(const cp_value_t* a, const cp_value_t* b)
+{
+    if (a->state != b->state) return 0;
+    if (a->state != CP_CONST) return 1;
+    if (a->lit_type != b->lit_type) return 0;
+
+    return (a->lit_type == LIT_FLOAT) ? memcmp(&a->lit.f64, &b->lit.f64, sizeof(a->lit.f64)) == 0
+                                      : a->lit.i64 == b->lit.i64;
+}
+
+static void cp_meet_(cp_value_t* dst, const cp_value_t* src)
+{
+    if (src->state == CP_UNDEF || dst->state == CP_VARYING) return;
+    if (dst->state == CP_UNDEF) { *dst = *src; return; }
+    if (!cp_same_(dst, src)) *dst = cp_varying_;
+}
+
+// value as stored into a variable of type t, same conversions as the backend
+static cp_value_t cp_to_type_(cp_value_t v, ast_type_t t)
+{
+    if (v.state != CP_CONST) return v;
+
+    if (t == AST_TYPE_FLOAT && v.lit_type == LIT_INT)
+    {
+        v.lit.f64  = (f64_t)v.lit.i64;
+        v.lit_type = LIT_FLOAT;
+    }
+    else if (t != AST_TYPE_FLOAT && v.lit_type == LIT_FLOAT)
+    {
+        v.lit.i64  = (i64_t)v.lit.f64;
+        v.lit_type = LIT_INT;
+    }
+    return v;
+}
+
+// 1 / 0 for a known condition, -1 otherwise; float conditions are left alone
+static int cp_truth_(const cp_value_t* v)
+{
+    if (v->state != CP_CONST || v->lit_type != LIT_INT) return -1;
+    return v->lit.i64 != 0;
+}
+
+static err_t cp_env_reserve_(cp_env_t* env, size_t n)
+{
+    CP_GROW_(env->vals, env->cap, n, cp_value_t);
+    return OK;
+}
+
+static err_t cp_env_copy_(cp_env_t* dst, const cp_env_t* src, size_t n)
+{
+    err_t rc = cp_env_reserve_(dst, n);
+    if (rc != OK) return rc;
+
+    // a dead environment carries no values
+    if (src->live && n) memcpy(dst->vals, src->vals, n * sizeof(cp_value_t));
+    dst->live = src->live;
+    return OK;
+}
+
+static err_t cp_env_meet_(cp_env_t* dst, const cp_env_t* src, size_t n)
+{
+    if (!src->live) return OK;
+    if (!dst->live) return cp_env_copy_(dst, src, n);
+
+    for (size_t i = 0; i < n; ++i)
+        cp_meet_(&dst->vals[i], &src->vals[i]);
+    return OK;
+}
+
+static int cp_env_same_(const cp_env_t* a, const cp_env_t* b, size_t n)
+{
+    if (a->live != b->live) return 0;
+    if (!a->live) return 1;
+
+    for (size_t i = 0; i < n; ++i)
+        if (!cp_same_(&a->vals[i], &b->vals[i])) return 0;
+    return 1;
+}
+
+// ================================ expressions ===============================
+
+static size_t cp_lookup_(const cp_ctx_t* cx, size_t name_id)
+{
+    for (size_t i = cx->bind_count; i > 0; --i)
+        if (cx->binds[i - 1].name_id == name_id) return i - 1;
+    return SIZE_MAX;
+}
+
+static err_t cp_bind_(cp_ctx_t* cx, cp_env_t* env, size_t name_id, ast_type_t type, size_t* out)
+{
+    CP_GROW_(cx->binds, cx->bind_cap, cx->bind_count + 1, cp_bind_t);
+
+    err_t rc = cp_env_reserve_(env, cx->bind_count + 1);
+    if (rc != OK) return rc;
+
+    cx->binds[cx->bind_count] = (cp_bind_t){ .name_id = name_id, .type = type };
+    env->vals[cx->bind_count] = cp_varying_;
+    *out = cx->bind_count++;
+    return OK;
+}
+
+static int cp_spend_(cp_ctx_t* cx)
+{
+    if (cx->budget == 0) cx->exhausted = 1;
+    else                 cx->budget--;
+    return !cx->exhausted;
+}
+
+// run the folding rules on a copy of e whose operands are literals or opaque
+static cp_value_t cp_fold_(const ast_node_t* e, const cp_value_t* ops, size_t count)
+{
+    ast_node_t tmp     = *e;
+    ast_node_t kids[2] = { 0 };
+
+    tmp.left = tmp.right = tmp.parent = NULL;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        kids[i].kind   = ASTK_EMPTY;
+        kids[i].parent = &tmp;
+        if (ops[i].state == CP_CONST)
+        {
+            kids[i].kind             = ASTK_NUM_LIT;
+            kids[i].u.num.lit_type   = ops[i].lit_type;
+            kids[i].u.num.lit        = ops[i].lit;
+        }
+        if (i > 0) kids[i - 1].right = &kids[i];
+    }
+    tmp.left = count ? &kids[0] : NULL;
+
+    const ast_node_t* r = opt_fold_once(&tmp);
+    if (!r || r->kind != ASTK_NUM_LIT) return cp_varying_;
+    if (r->u.num.lit_type != LIT_INT && r->u.num.lit_type != LIT_FLOAT) return cp_varying_;
+
+    return (cp_value_t){ .state = CP_CONST, .lit_type = r->u.num.lit_type, .lit = r->u.num.lit };
+}
+
+static cp_value_t cp_expr_(cp_ctx_t* cx, const cp_env_t* env, ast_node_t* e)
+{
+    if (!e || !cp_spend_(cx)) return cp_varying_;
+
+    switch (e->kind)
+    {
+        case ASTK_NUM_LIT:
+            if (e->u.num.lit_type != LIT_INT && e->u.num.lit_type != LIT_FLOAT) return cp_varying_;
+            return (cp_value_t){ .state = CP_CONST, .lit_type = e->u.num.lit_type, .lit = e->u.num.lit };
+
+        case ASTK_IDENT:
+        {
+            const size_t var = cp_lookup_(cx, e->u.ident.name_id);
+            if (var == SIZE_MAX) return cp_varying_;
+
+            const cp_value_t v = env->vals[var];
+            const ast_type_t t = cx->binds[var].type;
+
+            if (cx->rewrite && v.state == CP_CONST && (t == AST_TYPE_INT || t == AST_TYPE_FLOAT))
+            {
+                e->kind           = ASTK_NUM_LIT;
+                e->type           = (v.lit_type == LIT_FLOAT) ? AST_TYPE_FLOAT : AST_TYPE_INT;
+                e->u.num.lit_type = v.lit_type;
+                e->u.num.lit      = v.lit;
+                cx->replaced++;
+            }
+            return v;
+        }
+
+        case ASTK_UNARY:
+        case ASTK_BUILTIN_UNARY:
+        case ASTK_BINARY:
+        {
+            cp_value_t ops[2] = { cp_varying_, cp_varying_ };
+            size_t count = 0;
+
+            for (ast_node_t* c = e->left; c; c = c->right)
+            {
+                const cp_value_t v = cp_expr_(cx, env, c);
+                if (count < 2) ops[count] = v;
+                count++;
+            }
+
+            const size_t want = (e->kind == ASTK_BINARY) ? 2 : 1;
+            if (count != want) return cp_varying_;
+            return cp_fold_(e, ops, count);
+        }
+
+        default:
+            // calls and the rest: operands may still hold constant reads
+            for (ast_node_t* c = e->left; c; c = c->right)
+                cp_expr_(cx, env, c);
+            return cp_varying_;
+    }
+}
+
+// ================================ statements ================================
+
+static err_t cp_stmt_(cp_ctx_t* cx, cp_env_t* env, ast_node_t* st);
+
+// a statement in its own scope, as an arm of IF or the body of WHILE
+static err_t cp_scoped_(cp_ctx_t* cx, cp_env_t* env, ast_node_t* st)
+{
+    const size_t binds = cx->bind_count;
+    err_t rc = cp_stmt_(cx, env, st);
+    cx->bind_count = binds;
+    return rc;
+}
+
+static err_t cp_if_(cp_ctx_t* cx, cp_env_t* env, ast_node_t* ifn)
+{
+    // IF/BRANCH children: cond, stmt, [tail]
+    ast_node_t* cond = ifn->left;
+    ast_node_t* then = cond ? cond->right : NULL;
+    ast_node_t* tail = then ? then->right : NULL;
+    if (!cond || !then) return OK;
+
+    const size_t n = cx->bind_count;
+    cp_env_t out = { 0 };
+    cp_env_t arm = { 0 };
+    err_t rc = OK;
+
+    while (rc == OK)
+    {
+        const cp_value_t c = cp_expr_(cx, env, cond);
+        const int taken = cp_truth_(&c);
+
+        if (taken != 0)
+        {
+            rc = cp_env_copy_(&arm, env, n);
+            if (rc == OK) rc = cp_scoped_(cx, &arm, then);
+            if (rc == OK) rc = cp_env_meet_(&out, &arm, n);
+        }
+
+        // later arms are unreachable
+        if (taken == 1) { env->live = 0; break; }
+
+        if (!tail) break;
+
+        if (tail->kind == ASTK_ELSE)
+        {
+            rc = cp_scoped_(cx, env, tail->left);
+            break;
+        }
+
+        cond = tail->left;
+        then = cond ? cond->right : NULL;
+        tail = then ? then->right : NULL;
+        if (!cond || !then) break;
+    }
+
+    if (rc == OK) rc = cp_env_meet_(&out, env, n);
+    if (rc == OK) rc = cp_env_copy_(env, &out, n);
+
+    mem_free(out.vals);
+    mem_free(arm.vals);
+    return rc;
+}
+
+static err_t cp_push_loop_(cp_ctx_t* cx)
+{
+    if (cx->loop_count == cx->loop_cap)
+    {
+        const size_t old = cx->loop_cap;
+        CP_GROW_(cx->breaks, cx->loop_cap, cx->loop_count + 1, cp_env_t);
+        memset(cx->breaks + old, 0, (cx->loop_cap - old) * sizeof(cp_env_t));
+    }
+
+    cx->breaks[cx->loop_count++].live = 0;
+    return OK;
+}
+
+// header test and one walk of the body from in, gg environments are collected anew
+static err_t cp_loop_pass_(cp_ctx_t* cx, const cp_env_t* in, cp_env_t* iter,
+                           ast_node_t* cond, ast_node_t* body, int* taken)
+{
+    cx->breaks[cx->loop_count - 1].live = 0;
+
+    const cp_value_t c = cp_expr_(cx, in, cond);
+    *taken = cp_truth_(&c);
+
+    iter->live = 0;
+    if (*taken == 0) return OK;
+
+    err_t rc = cp_env_copy_(iter, in, cx->bind_count);
+    if (rc == OK) rc = cp_scoped_(cx, iter, body);
+    return rc;
+}
+
+static err_t cp_while_(cp_ctx_t* cx, cp_env_t* env, ast_node_t* w)
+{
+    ast_node_t* cond = w->left;
+    ast_node_t* body = cond ? cond->right : NULL;
+    if (!cond || !body) return OK;
+
+    err_t rc = cp_push_loop_(cx);
+    if (rc != OK) return rc;
+
+    const size_t n       = cx->bind_count;
+    const int    rewrite = cx->rewrite;
+
+    cp_env_t in   = { 0 };
+    cp_env_t iter = { 0 };
+    cp_env_t next = { 0 };
+    int taken = -1;
+
+    rc = cp_env_copy_(&in, env, n);
+
+    // header = entry meet back edge, until it stops changing
+    cx->rewrite = 0;
+    while (rc == OK && !cx->exhausted)
+    {
+        rc = cp_loop_pass_(cx, &in, &iter, cond, body, &taken);
+        if (rc == OK) rc = cp_env_copy_(&next, env, n);
+        if (rc == OK) rc = cp_env_meet_(&next, &iter, n);
+        if (rc != OK || cp_env_same_(&next, &in, n)) break;
+
+        rc = cp_env_copy_(&in, &next, n);
+    }
+
+    if (rc == OK && rewrite && !cx->exhausted)
+    {
+        cx->rewrite = 1;
+        rc = cp_loop_pass_(cx, &in, &iter, cond, body, &taken);
+    }
+    cx->rewrite = rewrite;
+
+    // exits: condition false at the header, and every gg
+    if (taken == 1) in.live = 0;
+    if (rc == OK) rc = cp_env_meet_(&in, &cx->breaks[cx->loop_count - 1], n);
+    if (rc == OK) rc = cp_env_copy_(env, &in, n);
+
+    cx->loop_count--;
+
+    mem_free(in.vals);
+    mem_free(iter.vals);
+    mem_free(next.vals);
+    return rc;
+}
+
+// a declaration used as an arm without a block stays bound after the
+// statement in the backend, with a value from whichever path ran
+static err_t cp_bare_decl_(cp_ctx_t* cx, cp_env_t* env, const ast_node_t* arm)
+{
+    if (!arm || arm->kind != ASTK_VAR_DECL) return OK;
+
+    size_t var = 0;
+    return cp_bind_(cx, env, arm->u.vdecl.name_id, arm->u.vdecl.type, &var);
+}
+
+static err_t cp_stmt_(cp_ctx_t* cx, cp_env_t* env, ast_node_t* st)
+{
+    // unreachable statements are left as they are
+    if (!st || !env->live || cx->exhausted) return OK;
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:
+        {
+            const size_t binds = cx->bind_count;
+            err_t rc = OK;
+            for (ast_node_t* c = st->left; c && rc == OK; c = c->right)
+                rc = cp_stmt_(cx, env, c);
+            cx->bind_count = binds;
+            return rc;
+        }
+
+        case ASTK_IF:
+        {
+            err_t rc = cp_if_(cx, env, st);
+            if (rc != OK) return rc;
+
+            for (const ast_node_t* arm = st; arm && rc == OK; )
+            {
+                const ast_node_t* then = arm->left ? arm->left->right : NULL;
+                const ast_node_t* tail = then ? then->right : NULL;
+
+                if (arm->kind == ASTK_ELSE) then = arm->left, tail = NULL;
+                rc = cp_bare_decl_(cx, env, then);
+                arm = tail;
+            }
+            return rc;
+        }
+
+        case ASTK_WHILE:
+        {
+            err_t rc = cp_while_(cx, env, st);
+            if (rc == OK && st->left) rc = cp_bare_decl_(cx, env, st->left->right);
+            return rc;
+        }
+
+        case ASTK_VAR_DECL:
+        {
+            // the name is in scope in its own init, as in the backend
+            size_t var = 0;
+            err_t rc = cp_bind_(cx, env, st->u.vdecl.name_id, st->u.vdecl.type, &var);
+            if (rc != OK) return rc;
+
+            cp_value_t v = { .state = CP_CONST, .lit_type = LIT_INT };
+            if (st->left) v = cp_expr_(cx, env, st->left);
+
+            env->vals[var] = cp_to_type_(v, st->u.vdecl.type);
+            return OK;
+        }
+
+        case ASTK_ASSIGN:
+        {
+            const cp_value_t v   = cp_expr_(cx, env, st->left);
+            const size_t     var = cp_lookup_(cx, st->u.assign.name_id);
+            if (var != SIZE_MAX)
+                env->vals[var] = cp_to_type_(v, cx->binds[var].type);
+            return OK;
+        }
+
+        case ASTK_RETURN:
+            cp_expr_(cx, env, st->left);
+            env->live = 0;
+            return OK;
+
+        case ASTK_BREAK:
+        {
+            err_t rc = OK;
+            if (cx->loop_count > 0)
+                rc = cp_env_meet_(&cx->breaks[cx->loop_count - 1], env, cx->bind_count);
+            env->live = 0;
+            return rc;
+        }
+
+        default:
+            for (ast_node_t* c = st->left; c; c = c->right)
+                cp_expr_(cx, env, c);
+            return OK;
+    }
+}
+
+// ================================= functions ================================
+
+static err_t cp_func_(cp_ctx_t* cx, ast_node_t* fn)
+{
+    ast_node_t* plist = fn->left;
+    ast_node_t* body  = plist ? plist->right : NULL;
+    if (!plist || !body) return OK;
+
+    cx->bind_count = 0;
+    cx->loop_count = 0;
+    cx->exhausted  = 0;
+    cx->rewrite    = 1;
+    cx->budget     = 64 * ast_subtree_size(fn) + 1024;
+
+    cp_env_t env = { .live = 1 };
+    err_t rc = OK;
+
+    for (ast_node_t* p = plist->left; p && rc == OK; p = p->right)
+    {
+        size_t var = 0;
+        rc = cp_bind_(cx, &env, p->u.param.name_id, p->u.param.type, &var);
+    }
+
+    if (rc == OK) rc = cp_stmt_(cx, &env, body);
+
+    if (cx->exhausted)
+        LOG_DEBUG("Const-prop: budget exhausted in '%s', rest left as is",
+                  ast_name_cstr(cx->tree, fn->u.func.name_id));
+
+    mem_free(env.vals);
+    return rc;
+}
+
+err_t opt_constprop(ast_tree_t* tree, size_t* out_replaced)
+{
+    if (!tree || !out_replaced) return ERR_BAD_ARG;
+    *out_replaced = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM) return OK;
+
+    cp_ctx_t cx = { .tree = tree };
+    err_t rc = OK;
+
+    for (ast_node_t* fn = program->left; fn && rc == OK; fn = fn->right)
+        if (fn->kind == ASTK_FUNC)
+            rc = cp_func_(&cx, fn);
+
+    for (size_t i = 0; i < cx.loop_cap; ++i)
+        mem_free(cx.breaks[i].vals);
+    mem_free(cx.breaks);
+    mem_free(cx.binds);
+
+    *out_replaced = cx.replaced;
+    return rc;
+}
@@ -0,0 +1,680 @@
+#include "middleend.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Common subexpression elimination by value numbering over the statements
+    of one block. An operator node is numbered from its operator and the
+    numbers of its operands, a variable read from the variable and the
+    stores to it seen so far, so equal numbers are equal values at run time.
+    A value met again is read from the local it was last assigned to while
+    that still holds it, else from a new local set right before its first
+    occurrence. Locals are slots on the VM, so only values dearer than the
+    slot traffic are taken. Calls, compares and a division or ^ that could
+    trap are never taken; nested blocks are numbered on their own
+*/
+
+// VM instructions of a local read or store: frame address, then PUSHM/POPM
+#define CSE_SLOT_COST 7
+
+typedef struct
+{
+    ast_kind_t  kind;
+    int         op;
+    uint64_t    a, b;        // operand numbers, name and store, or literal bits
+
+    ast_type_t  type;
+    size_t      cost;        // VM instructions to compute it
+    int         pure;        // no call, no trap, reads locals only
+    int         reuse;       // pure operator of known type, may go to a local
+
+    size_t      count;       // occurrences in the block
+    ast_node_t* first;       // first occurrence, still in place
+    size_t      holder;      // local holding the value, SIZE_MAX if none
+    size_t      holder_ver;  // store to holder that put the value there
+} cse_val_t;
+
+typedef struct
+{
+    const ast_node_t* node;
+    size_t            val;
+} cse_num_t;
+
+typedef struct
+{
+    cse_val_t* vals;
+    size_t     val_count;
+    size_t     val_cap;
+
+    size_t*    slots;        // open-addressed index into vals, val + 1
+    size_t     slot_cap;
+
+    cse_num_t* nums;         // number of each node, open-addressed by node
+    size_t     num_count;
+    size_t     num_cap;
+} cse_run_t;
+
+typedef struct
+{
+    size_t     name_id;
+    ast_type_t type;
+} cse_bind_t;
+
+typedef struct
+{
+    ast_tree_t* tree;
+
+    cse_bind_t* binds;
+    size_t      bind_count;
+    size_t      bind_cap;
+
+    size_t*     ver;         // last store per name while numbering
+    size_t*     live;        // last store per name while rewriting
+    size_t      ver_cap;
+    size_t      clock;
+
+    size_t      fresh;
+    size_t      temps;
+    size_t      eliminated;
+} cse_ctx_t;
+
+#define CSE_GROW_(ptr, cap, want, type)                                        \
+    block_begin                                                                \
+        if ((want) > (cap)) {                                                  \
+            size_t new_cap = (cap) ? (cap) * 2 : 16;                           \
+            while (new_cap < (want)) new_cap *= 2;                             \
+            void* np = mem_realloc(MEM_TAG_OPT, (ptr), new_cap * sizeof(type)); \
+            if (!np) return ERR_ALLOC;                                         \
+            (ptr) = (type*)np;                                                 \
+            (cap) = new_cap;                                                   \
+        }                                                                      \
+    block_end
+
+static err_t cse_bind_(cse_ctx_t* cx, size_t name_id, ast_type_t type)
+{
+    CSE_GROW_(cx->binds, cx->bind_cap, cx->bind_count + 1, cse_bind_t);
+    cx->binds[cx->bind_count++] = (cse_bind_t){ .name_id = name_id, .type = type };
+    return OK;
+}
+
+static ast_type_t cse_lookup_(const cse_ctx_t* cx, size_t name_id)
+{
+    for (size_t i = cx->bind_count; i > 0; --i)
+        if (cx->binds[i - 1].name_id == name_id) return cx->binds[i - 1].type;
+    return AST_TYPE_UNKNOWN;
+}
+
+// ------------------------------------------------------------------ stores
+
+static size_t cse_ver_(const size_t* ver, size_t cap, size_t name_id)
+{
+    return (name_id < cap) ? ver[name_id] : 0;
+}
+
+// a store to name_id, seen while numbering or, with live, while rewriting
+static err_t cse_store_(cse_ctx_t* cx, int live, size_t name_id)
+{
+    if (name_id >= cx->ver_cap)
+    {
+        const size_t old_cap = cx->ver_cap;
+        size_t new_cap = old_cap ? old_cap : 64;
+        while (new_cap <= name_id) new_cap *= 2;
+
+        size_t* ver = (size_t*)mem_realloc(MEM_TAG_OPT, cx->ver, new_cap * sizeof(size_t));
+        if (!ver) return ERR_ALLOC;
+        cx->ver = ver;
+
+        size_t* lv = (size_t*)mem_realloc(MEM_TAG_OPT, cx->live, new_cap * sizeof(size_t));
+        if (!lv) return ERR_ALLOC;
+        cx->live = lv;
+
+        memset(cx->ver  + old_cap, 0, (new_cap - old_cap) * sizeof(size_t));
+        memset(cx->live + old_cap, 0, (new_cap - old_cap) * sizeof(size_t));
+        cx->ver_cap = new_cap;
+    }
+
+    (live ? cx->live : cx->ver)[name_id] = ++cx->clock;
+    return OK;
+}
+
+// every name st writes counts as stored, whether or not that part runs
+static err_t cse_store_all_(cse_ctx_t* cx, int live, const ast_node_t* n)
+{
+    for (; n; n = n->right)
+    {
+        err_t rc = OK;
+        if (n->kind == ASTK_ASSIGN)   rc = cse_store_(cx, live, n->u.assign.name_id);
+        if (n->kind == ASTK_VAR_DECL) rc = cse_store_(cx, live, n->u.vdecl.name_id);
+        if (rc == OK) rc = cse_store_all_(cx, live, n->left);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+// ------------------------------------------------------------------ tables
+
+static size_t cse_hash_(const cse_val_t* v)
+{
+    uint64_t h = (uint64_t)v->kind * 0x9e3779b97f4a7c15ull;
+    h = (h ^ (uint64_t)v->op) * 0xff51afd7ed558ccdull;
+    h = (h ^ v->a)            * 0xc4ceb9fe1a85ec53ull;
+    h = (h ^ v->b)            * 0x9e3779b97f4a7c15ull;
+    return (size_t)(h ^ (h >> 29));
+}
+
+static size_t cse_ptr_hash_(const ast_node_t* n)
+{
+    const uint64_t h = (uint64_t)(uintptr_t)n * 0x9e3779b97f4a7c15ull;
+    return (size_t)(h ^ (h >> 32));
+}
+
+static int cse_same_(const cse_val_t* x, const cse_val_t* y)
+{
+    return x->kind == y->kind && x->op == y->op && x->a == y->a && x->b == y->b;
+}
+
+static err_t cse_index_grow_(cse_run_t* r)
+{
+    if (r->slot_cap >= 2 * (r->val_count + 1)) return OK;
+
+    size_t new_cap = r->slot_cap ? r->slot_cap * 2 : 64;
+    size_t* slots = (size_t*)mem_calloc(MEM_TAG_OPT, new_cap, sizeof(size_t));
+    if (!slots) return ERR_ALLOC;
+
+    for (size_t i = 0; i < r->val_count; ++i)
+    {
+        if (!r->vals[i].pure) continue;  // unique, never looked up
+
+        size_t s = cse_hash_(&r->vals[i]) & (new_cap - 1);
+        while (slots[s]) s = (s + 1) & (new_cap - 1);
+        slots[s] = i + 1;
+    }
+
+    mem_free(r->slots);
+    r->slots    = slots;
+    r->slot_cap = new_cap;
+    return OK;
+}
+
+// the number of key, a new one unless a pure value like it is there already
+static err_t cse_intern_(cse_run_t* r, const cse_val_t* key, size_t* out)
+{
+    err_t rc = cse_index_grow_(r);
+    if (rc != OK) return rc;
+    CSE_GROW_(r->vals, r->val_cap, r->val_count + 1, cse_val_t);
+
+    size_t s = cse_hash_(key) & (r->slot_cap - 1);
+    if (key->pure)
+    {
+        for (; r->slots[s]; s = (s + 1) & (r->slot_cap - 1))
+        {
+            const size_t id = r->slots[s] - 1;
+            if (cse_same_(&r->vals[id], key))
+            {
+                *out = id;
+                return OK;
+            }
+        }
+        r->slots[s] = r->val_count + 1;
+    }
+
+    r->vals[r->val_count] = *key;
+    *out = r->val_count++;
+    return OK;
+}
+
+static err_t cse_num_put_(cse_run_t* r, const ast_node_t* n, size_t val)
+{
+    if (2 * (r->num_count + 1) > r->num_cap)
+    {
+        const size_t new_cap = r->num_cap ? r->num_cap * 2 : 64;
+        cse_num_t* nums = (cse_num_t*)mem_calloc(MEM_TAG_OPT, new_cap, sizeof(cse_num_t));
+        if (!nums) return ERR_ALLOC;
+
+        for (size_t i = 0; i < r->num_cap; ++i)
+        {
+            if (!r->nums[i].node) continue;
+            size_t s = cse_ptr_hash_(r->nums[i].node) & (new_cap - 1);
+            while (nums[s].node) s = (s + 1) & (new_cap - 1);
+            nums[s] = r->nums[i];
+        }
+
+        mem_free(r->nums);
+        r->nums    = nums;
+        r->num_cap = new_cap;
+    }
+
+    size_t s = cse_ptr_hash_(n) & (r->num_cap - 1);
+    while (r->nums[s].node) s = (s + 1) & (r->num_cap - 1);
+    r->nums[s] = (cse_num_t){ .node = n, .val = val };
+    r->num_count++;
+    return OK;
+}
+
+static size_t cse_num_get_(const cse_run_t* r, const ast_node_t* n)
+{
+    if (!r->num_cap) return SIZE_MAX;
+
+    for (size_t s = cse_ptr_hash_(n) & (r->num_cap - 1); r->nums[s].node; s = (s + 1) & (r->num_cap - 1))
+        if (r->nums[s].node == n) return r->nums[s].val;
+    return SIZE_MAX;
+}
+
+static void cse_run_dtor_(cse_run_t* r)
+{
+    mem_free(r->vals);
+    mem_free(r->slots);
+    mem_free(r->nums);
+}
+
+// ------------------------------------------------------------------ numbering
+
+static int cse_nonzero_lit_(const ast_node_t* n)
+{
+    if (!n || n->kind != ASTK_NUM_LIT) return 0;
+    return (n->u.num.lit_type == LIT_FLOAT) ? (n->u.num.lit.f64 != 0.0) : (n->u.num.lit.i64 != 0);
+}
+
+static ast_type_t cse_arith_type_(ast_type_t lt, ast_type_t rt)
+{
+    if (lt == AST_TYPE_UNKNOWN || rt == AST_TYPE_UNKNOWN) return AST_TYPE_UNKNOWN;
+    return (lt == AST_TYPE_FLOAT || rt == AST_TYPE_FLOAT) ? AST_TYPE_FLOAT : AST_TYPE_INT;
+}
+
+static err_t cse_number_(cse_ctx_t* cx, cse_run_t* r, const ast_node_t* e, size_t* out)
+{
+    cse_val_t key = { .kind = e->kind, .holder = SIZE_MAX };
+    size_t    x = 0, y = 0;
+    err_t     rc = OK;
+
+    switch (e->kind)
+    {
+        case ASTK_NUM_LIT:
+            key.op   = (int)e->u.num.lit_type;
+            key.type = (e->u.num.lit_type == LIT_FLOAT) ? AST_TYPE_FLOAT : AST_TYPE_INT;
+            key.a    = e->u.num.lit.u64;
+            key.cost = 1;
+            key.pure = 1;
+            break;
+
+        case ASTK_IDENT:
+            key.a    = e->u.ident.name_id;
+            key.b    = cse_ver_(cx->ver, cx->ver_cap, e->u.ident.name_id);
+            key.type = cse_lookup_(cx, e->u.ident.name_id);
+            key.cost = CSE_SLOT_COST;
+            key.pure = (key.type != AST_TYPE_UNKNOWN);
+            break;
+
+        case ASTK_UNARY:
+        case ASTK_BUILTIN_UNARY:
+        {
+            rc = cse_number_(cx, r, e->left, &x);
+            if (rc != OK) return rc;
+
+            const cse_val_t* xv = &r->vals[x];
+            key.a    = x;
+            key.cost = xv->cost + 1;
+            key.pure = xv->pure;
+
+            if (e->kind == ASTK_UNARY)
+            {
+                key.op    = (int)e->u.unary.op;
+                key.type  = (e->u.unary.op == TOK_OP_NOT) ? AST_TYPE_INT : xv->type;
+                key.reuse = (e->u.unary.op != TOK_OP_NOT);
+            }
+            else
+            {
+                key.op    = (int)e->u.builtin_unary.id;
+                key.type  = (e->u.builtin_unary.id == AST_BUILTIN_FTOI) ? AST_TYPE_INT : AST_TYPE_FLOAT;
+                key.reuse = 1;
+            }
+            break;
+        }
+
+        case ASTK_BINARY:
+        {
+            const ast_node_t* rhs = e->left->right;
+            const token_kind_t op = e->u.binary.op;
+
+            rc = cse_number_(cx, r, e->left, &x);
+            if (rc == OK) rc = cse_number_(cx, r, rhs, &y);
+            if (rc != OK) return rc;
+
+            const cse_val_t* xv = &r->vals[x];
+            const cse_val_t* yv = &r->vals[y];
+            key.op   = (int)op;
+            key.a    = x;
+            key.b    = y;
+            key.cost = xv->cost + yv->cost + 1;
+            key.pure = xv->pure && yv->pure;
+
+            if (opt_is_bool_op(op))
+            {
+                key.type = AST_TYPE_INT;
+                break;
+            }
+
+            key.type  = cse_arith_type_(xv->type, yv->type);
+            key.reuse = 1;
+
+            // int division and ^ trap on some operands, floats never do
+            if (key.type == AST_TYPE_INT && op == TOK_OP_DIV && !cse_nonzero_lit_(rhs)) key.pure = 0;
+            if (key.type == AST_TYPE_INT && op == TOK_OP_POW && rhs->kind != ASTK_NUM_LIT) key.pure = 0;
+            break;
+        }
+
+        default:
+            // calls and the like: numbered so their arguments are, never equal to anything
+            for (const ast_node_t* c = e->left; c && rc == OK; c = c->right)
+                rc = cse_number_(cx, r, c, &x);
+            if (rc != OK) return rc;
+            break;
+    }
+
+    key.reuse = key.reuse && key.pure &&
+                (key.type == AST_TYPE_INT || key.type == AST_TYPE_FLOAT);
+
+    rc = cse_intern_(r, &key, out);
+    if (rc == OK) rc = cse_num_put_(r, e, *out);
+    if (rc == OK) r->vals[*out].count++;
+    return rc;
+}
+
+static err_t cse_number_list_(cse_ctx_t* cx, cse_run_t* r, const ast_node_t* n)
+{
+    size_t id = 0;
+    for (; n; n = n->right)
+    {
+        err_t rc = cse_number_(cx, r, n, &id);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+// the expressions st evaluates once where it stands, then what it stores
+static err_t cse_number_stmt_(cse_ctx_t* cx, cse_run_t* r, const ast_node_t* st)
+{
+    err_t rc = OK;
+
+    switch (st->kind)
+    {
+        case ASTK_VAR_DECL:
+            rc = cse_number_list_(cx, r, st->left);
+            if (rc == OK) rc = cse_bind_(cx, st->u.vdecl.name_id, st->u.vdecl.type);
+            if (rc == OK) rc = cse_store_(cx, 0, st->u.vdecl.name_id);
+            return rc;
+
+        case ASTK_ASSIGN:
+            rc = cse_number_list_(cx, r, st->left);
+            if (rc == OK) rc = cse_store_(cx, 0, st->u.assign.name_id);
+            return rc;
+
+        case ASTK_RETURN:
+        case ASTK_EXPR_STMT:
+        case ASTK_CALL_STMT:
+        case ASTK_COUT:
+        case ASTK_ICOUT:
+        case ASTK_FCOUT:
+            return cse_number_list_(cx, r, st->left);
+
+        case ASTK_IF:
+        {
+            size_t id = 0;
+            rc = st->left ? cse_number_(cx, r, st->left, &id) : OK;
+            if (rc == OK) rc = cse_store_all_(cx, 0, st->left);
+            return rc;
+        }
+
+        default:
+            return cse_store_all_(cx, 0, st->left);
+    }
+}
+
+// ------------------------------------------------------------------ rewriting
+
+static int cse_holds_(const cse_ctx_t* cx, const cse_val_t* v)
+{
+    return v->holder != SIZE_MAX &&
+           cse_ver_(cx->live, cx->ver_cap, v->holder) == v->holder_ver;
+}
+
+// k evaluations against one into a new local, a store and k reads
+static int cse_worth_temp_(const cse_val_t* v)
+{
+    return (v->count - 1) * v->cost > (v->count + 1) * CSE_SLOT_COST;
+}
+
+// e becomes a read of name, *out is what stands in its place
+static err_t cse_use_(cse_ctx_t* cx, ast_node_t* e, size_t name, ast_type_t type, ast_node_t** out)
+{
+    ast_node_t* id = ast_new(cx->tree, ASTK_IDENT, e->pos);
+    if (!id) return ERR_ALLOC;
+
+    id->u.ident.name_id = name;
+    id->type = type;
+    ast_replace(e, id);
+
+    cx->eliminated += ast_subtree_size(e) - 1;
+    *out = id;
+    return OK;
+}
+
+// the first occurrence of v goes into a new local declared right before its statement
+static err_t cse_keep_(cse_ctx_t* cx, ast_node_t* block, cse_val_t* v)
+{
+    ast_node_t* f = v->first;
+
+    ast_node_t* anchor = f;
+    while (anchor->parent && anchor->parent != block) anchor = anchor->parent;
+
+    ast_node_t** link = &block->left;
+    while (*link && *link != anchor) link = &(*link)->right;
+    if (!*link) return ERR_BAD_ARG;
+
+    size_t name = 0;
+    err_t rc = opt_fresh_name(cx->tree, "cse", "t", &cx->fresh, &name);
+    if (rc != OK) return rc;
+
+    ast_node_t* id = ast_new(cx->tree, ASTK_IDENT, f->pos);
+    ast_node_t* vd = ast_new(cx->tree, ASTK_VAR_DECL, f->pos);
+    if (!id || !vd) return ERR_ALLOC;
+
+    id->u.ident.name_id = name;
+    id->type = v->type;
+    ast_replace(f, id);
+
+    f->right = NULL;
+    vd->u.vdecl.name_id = name;
+    vd->u.vdecl.type    = v->type;
+    vd->type            = v->type;
+    ast_add_child(vd, f);
+
+    vd->parent = block;
+    vd->right  = anchor;
+    *link = vd;
+
+    v->first      = NULL;
+    v->holder     = name;
+    v->holder_ver = cse_ver_(cx->live, cx->ver_cap, name);
+    cx->temps++;
+    return OK;
+}
+
+static err_t cse_rewrite_list_(cse_ctx_t* cx, cse_run_t* r, ast_node_t* block, ast_node_t* n);
+
+// e and below, parents first; *out is what stands in place of e afterwards
+static err_t cse_rewrite_(cse_ctx_t* cx, cse_run_t* r, ast_node_t* block, ast_node_t* e, ast_node_t** out)
+{
+    const size_t n = cse_num_get_(r, e);
+    *out = e;
+
+    if (n != SIZE_MAX && r->vals[n].reuse && r->vals[n].count > 1)
+    {
+        cse_val_t* v = &r->vals[n];
+
+        if (cse_holds_(cx, v) && v->cost > CSE_SLOT_COST)
+            return cse_use_(cx, e, v->holder, v->type, out);
+
+        if (v->first && cse_worth_temp_(v))
+        {
+            err_t rc = cse_keep_(cx, block, v);
+            return (rc == OK) ? cse_use_(cx, e, v->holder, v->type, out) : rc;
+        }
+
+        if (!v->first) v->first = e;
+    }
+
+    return cse_rewrite_list_(cx, r, block, e);
+}
+
+// the children of n, in place
+static err_t cse_rewrite_list_(cse_ctx_t* cx, cse_run_t* r, ast_node_t* block, ast_node_t* n)
+{
+    for (ast_node_t* c = n->left; c; c = c->right)
+    {
+        c->parent = n;
+        err_t rc = cse_rewrite_(cx, r, block, c, &c);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+static err_t cse_block_(cse_ctx_t* cx, ast_node_t* block);
+
+// blocks under st, each numbered apart from the one st is in
+static err_t cse_nested_(cse_ctx_t* cx, ast_node_t* st)
+{
+    err_t rc = OK;
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:
+            return cse_block_(cx, st);
+
+        case ASTK_WHILE:
+        case ASTK_IF:
+        case ASTK_BRANCH:
+            for (ast_node_t* c = st->left ? st->left->right : NULL; c && rc == OK; c = c->right)
+                rc = cse_nested_(cx, c);
+            return rc;
+
+        case ASTK_ELSE:
+            return st->left ? cse_nested_(cx, st->left) : OK;
+
+        default:
+            return OK;
+    }
+}
+
+// st after its expressions are rewritten: what it stores, and what that now holds
+static err_t cse_stored_(cse_ctx_t* cx, cse_run_t* r, const ast_node_t* st, size_t name, ast_type_t type)
+{
+    err_t rc = cse_store_(cx, 1, name);
+    if (rc != OK || !st->left) return rc;
+
+    const size_t n = cse_num_get_(r, st->left);
+    if (n == SIZE_MAX) return OK;
+
+    cse_val_t* v = &r->vals[n];
+    if (v->reuse && v->type == type && !cse_holds_(cx, v))
+    {
+        v->holder     = name;
+        v->holder_ver = cse_ver_(cx->live, cx->ver_cap, name);
+    }
+    return OK;
+}
+
+static err_t cse_block_(cse_ctx_t* cx, ast_node_t* block)
+{
+    cse_run_t    r     = { 0 };
+    const size_t binds = cx->bind_count;
+    err_t        rc    = OK;
+
+    for (const ast_node_t* st = block->left; st && rc == OK; st = st->right)
+        rc = cse_number_stmt_(cx, &r, st);
+    cx->bind_count = binds;
+
+    for (ast_node_t* st = block->left; st && rc == OK; st = st->right)
+    {
+        st->parent = block;
+
+        switch (st->kind)
+        {
+            case ASTK_VAR_DECL:
+                rc = cse_rewrite_list_(cx, &r, block, st);
+                if (rc == OK) rc = cse_bind_(cx, st->u.vdecl.name_id, st->u.vdecl.type);
+                if (rc == OK) rc = cse_stored_(cx, &r, st, st->u.vdecl.name_id, st->u.vdecl.type);
+                break;
+
+            case ASTK_ASSIGN:
+                rc = cse_rewrite_list_(cx, &r, block, st);
+                if (rc == OK) rc = cse_stored_(cx, &r, st, st->u.assign.name_id, cse_lookup_(cx, st->u.assign.name_id));
+                break;
+
+            case ASTK_RETURN:
+            case ASTK_EXPR_STMT:
+            case ASTK_CALL_STMT:
+            case ASTK_COUT:
+            case ASTK_ICOUT:
+            case ASTK_FCOUT:
+                rc = cse_rewrite_list_(cx, &r, block, st);
+                break;
+
+            case ASTK_IF:
+                if (st->left)
+                {
+                    ast_node_t* cond = st->left;
+                    cond->parent = st;
+                    rc = cse_rewrite_(cx, &r, block, cond, &cond);
+                }
+                if (rc == OK) rc = cse_nested_(cx, st);
+                if (rc == OK) rc = cse_store_all_(cx, 1, st->left);
+                break;
+
+            default:
+                rc = cse_nested_(cx, st);
+                if (rc == OK) rc = cse_store_all_(cx, 1, st->left);
+                break;
+        }
+    }
+
+    cx->bind_count = binds;
+    cse_run_dtor_(&r);
+    return rc;
+}
+
+err_t opt_cse(ast_tree_t* tree, size_t* out_temps, size_t* out_eliminated)
+{
+    if (!tree || !out_temps || !out_eliminated) return ERR_BAD_ARG;
+    *out_temps      = 0;
+    *out_eliminated = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM) return OK;
+
+    cse_ctx_t cx = { .tree = tree };
+    err_t rc = OK;
+
+    for (ast_node_t* fn = program->left; fn && rc == OK; fn = fn->right)
+    {
+        if (fn->kind != ASTK_FUNC || !fn->left) continue;
+
+        cx.bind_count = 0;
+        for (const ast_node_t* p = fn->left->left; p && rc == OK; p = p->right)
+            rc = cse_bind_(&cx, p->u.param.name_id, p->u.param.type);
+
+        ast_node_t* body = fn->left->right;
+        if (rc == OK && body && body->kind == ASTK_BLOCK)
+            rc = cse_block_(&cx, body);
+    }
+
+    mem_free(cx.binds);
+    mem_free(cx.ver);
+    mem_free(cx.live);
+
+    *out_temps      = cx.temps;
+    *out_eliminated = cx.eliminated;
+    return rc;
+}
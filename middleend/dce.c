@@ -0,0 +1,477 @@
+#include "middleend.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Dead code elimination in two steps. Structural: statements after
+    micdrop/gg, IF arms whose condition is a known int and lowkey (0) loops
+    are cut out. Then stores: a local that is never read loses its
+    VAR_DECL and every assignment to it; values with calls in them are
+    kept as expression statements
+*/
+
+typedef struct
+{
+    ast_node_t* decl;
+    size_t      reads;
+} dce_var_t;
+
+typedef struct
+{
+    size_t name_id;
+    size_t var;              // SIZE_MAX for params
+} dce_bind_t;
+
+typedef struct
+{
+    ast_node_t* assign;
+    size_t      var;
+} dce_store_t;
+
+typedef struct
+{
+    dce_var_t*   vars;
+    size_t       var_count;
+    size_t       var_cap;
+
+    dce_bind_t*  binds;
+    size_t       bind_count;
+    size_t       bind_cap;
+
+    dce_store_t* stores;
+    size_t       store_count;
+    size_t       store_cap;
+
+    size_t       target;     // variable being stored while its value is walked
+    int          target_pure;
+
+    size_t       removed;
+} dce_ctx_t;
+
+#define DCE_GROW_(ptr, cap, want, type)                                        \
+    block_begin                                                                \
+        if ((want) > (cap)) {                                                  \
+            size_t new_cap = (cap) ? (cap) * 2 : 16;                           \
+            while (new_cap < (want)) new_cap *= 2;                             \
+            void* np = mem_realloc(MEM_TAG_OPT, (ptr), new_cap * sizeof(type)); \
+            if (!np) return ERR_ALLOC;                                         \
+            (ptr) = (type*)np;                                                 \
+            (cap) = new_cap;                                                   \
+        }                                                                      \
+    block_end
+
+static int dce_int_lit_(const ast_node_t* n, i64_t* out)
+{
+    if (!n || n->kind != ASTK_NUM_LIT || n->u.num.lit_type != LIT_INT) return 0;
+    *out = n->u.num.lit.i64;
+    return 1;
+}
+
+static int dce_has_call_(const ast_node_t* n)
+{
+    if (!n) return 0;
+    if (n->kind == ASTK_CALL) return 1;
+
+    for (const ast_node_t* c = n->left; c; c = c->right)
+        if (dce_has_call_(c)) return 1;
+    return 0;
+}
+
+// n takes the place of src, keeping its own position among siblings
+static void dce_become_(ast_node_t* n, const ast_node_t* src)
+{
+    ast_node_t* right  = n->right;
+    ast_node_t* parent = n->parent;
+
+    *n = *src;
+    n->right  = right;
+    n->parent = parent;
+
+    for (ast_node_t* c = n->left; c; c = c->right)
+        c->parent = n;
+}
+
+static void dce_make_empty_(ast_node_t* n)
+{
+    n->kind = ASTK_BLOCK;
+    n->left = NULL;
+}
+
+// ================================ structure =================================
+
+static int dce_prune_(dce_ctx_t* cx, ast_node_t* st);
+
+// Returns 1 when no arm falls through
+static int dce_prune_if_(dce_ctx_t* cx, ast_node_t* ifn)
+{
+    // IF/BRANCH children: cond, stmt, [tail]; known leading arms go first
+    while (ifn->left && ifn->left->right)
+    {
+        ast_node_t* then = ifn->left->right;
+        ast_node_t* tail = then->right;
+
+        i64_t c = 0;
+        if (!dce_int_lit_(ifn->left, &c)) break;
+
+        cx->removed++;
+
+        if (c != 0)
+        {
+            then->right = NULL;
+            dce_become_(ifn, then);
+            return dce_prune_(cx, ifn);
+        }
+
+        if (!tail)
+        {
+            dce_make_empty_(ifn);
+            return 0;
+        }
+
+        if (tail->kind == ASTK_ELSE)
+        {
+            dce_become_(ifn, tail->left);
+            return dce_prune_(cx, ifn);
+        }
+
+        // first BRANCH becomes the head arm
+        ifn->left = tail->left;
+    }
+
+    ast_node_t* prev = ifn->left ? ifn->left->right : NULL;
+    if (!prev) return 0;
+
+    int all_end  = dce_prune_(cx, prev);
+    int has_else = 0;
+
+    for (ast_node_t* cur = prev->right; cur; )
+    {
+        if (cur->kind == ASTK_ELSE)
+        {
+            all_end &= dce_prune_(cx, cur->left);
+            has_else = 1;
+            break;
+        }
+
+        ast_node_t* cond = cur->left;
+        ast_node_t* then = cond ? cond->right : NULL;
+        if (!then) break;
+
+        i64_t c = 0;
+        if (dce_int_lit_(cond, &c))
+        {
+            cx->removed++;
+
+            if (c == 0)
+            {
+                prev->right = then->right;
+                cur = then->right;
+                continue;
+            }
+
+            // always taken: the rest of the chain is unreachable
+            cur->kind   = ASTK_ELSE;
+            cur->left   = then;
+            then->right = NULL;
+            continue;
+        }
+
+        all_end &= dce_prune_(cx, then);
+        prev = then;
+        cur  = then->right;
+    }
+
+    return has_else && all_end;
+}
+
+// Returns 1 when control never reaches the statement after st
+static int dce_prune_(dce_ctx_t* cx, ast_node_t* st)
+{
+    if (!st) return 0;
+
+    switch (st->kind)
+    {
+        case ASTK_RETURN:
+        case ASTK_BREAK:
+            return 1;
+
+        case ASTK_BLOCK:
+            for (ast_node_t* c = st->left; c; c = c->right)
+            {
+                if (!dce_prune_(cx, c)) continue;
+
+                if (c->right)
+                {
+                    c->right = NULL;
+                    cx->removed++;
+                }
+                return 1;
+            }
+            return 0;
+
+        case ASTK_IF:
+            return dce_prune_if_(cx, st);
+
+        case ASTK_WHILE:
+        {
+            i64_t c = 0;
+            if (dce_int_lit_(st->left, &c) && c == 0)
+            {
+                dce_make_empty_(st);
+                cx->removed++;
+                return 0;
+            }
+
+            // gg inside ends the loop, not the enclosing statement list
+            if (st->left) dce_prune_(cx, st->left->right);
+            return 0;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+// drop empty blocks left in statement lists
+static void dce_sweep_(dce_ctx_t* cx, ast_node_t* n)
+{
+    if (!n) return;
+
+    // children first, blocks emptied there go too
+    for (ast_node_t* c = n->left; c; c = c->right)
+        if (c->kind != ASTK_NUM_LIT && c->kind != ASTK_IDENT)
+            dce_sweep_(cx, c);
+
+    if (n->kind == ASTK_BLOCK)
+    {
+        ast_node_t** link = &n->left;
+        while (*link)
+        {
+            ast_node_t* c = *link;
+            if (c->kind == ASTK_BLOCK && !c->left)
+            {
+                *link = c->right;
+                continue;
+            }
+            link = &c->right;
+        }
+    }
+}
+
+// ================================== stores ==================================
+
+static size_t dce_lookup_(const dce_ctx_t* cx, size_t name_id)
+{
+    for (size_t i = cx->bind_count; i > 0; --i)
+        if (cx->binds[i - 1].name_id == name_id) return cx->binds[i - 1].var;
+    return SIZE_MAX;
+}
+
+static err_t dce_bind_(dce_ctx_t* cx, size_t name_id, size_t var)
+{
+    DCE_GROW_(cx->binds, cx->bind_cap, cx->bind_count + 1, dce_bind_t);
+    cx->binds[cx->bind_count++] = (dce_bind_t){ .name_id = name_id, .var = var };
+    return OK;
+}
+
+static void dce_reads_(dce_ctx_t* cx, const ast_node_t* e)
+{
+    if (!e) return;
+
+    if (e->kind == ASTK_IDENT)
+    {
+        const size_t var = dce_lookup_(cx, e->u.ident.name_id);
+        if (var == SIZE_MAX) return;
+
+        // x = x + 1 alone does not keep x alive; if the store stays for
+        // its calls, the read has to resolve and counts
+        if (var == cx->target && cx->target_pure) return;
+        cx->vars[var].reads++;
+        return;
+    }
+
+    for (const ast_node_t* c = e->left; c; c = c->right)
+        dce_reads_(cx, c);
+}
+
+static void dce_value_(dce_ctx_t* cx, size_t var, const ast_node_t* value)
+{
+    cx->target      = var;
+    cx->target_pure = !dce_has_call_(value);
+    dce_reads_(cx, value);
+    cx->target      = SIZE_MAX;
+}
+
+static err_t dce_scan_(dce_ctx_t* cx, ast_node_t* st)
+{
+    if (!st) return OK;
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:
+        {
+            const size_t binds = cx->bind_count;
+            err_t rc = OK;
+            for (ast_node_t* c = st->left; c && rc == OK; c = c->right)
+                rc = dce_scan_(cx, c);
+            cx->bind_count = binds;
+            return rc;
+        }
+
+        case ASTK_VAR_DECL:
+        {
+            // the name is in scope in its own init, as in the backend, so
+            // a self read keeps the declaration
+            DCE_GROW_(cx->vars, cx->var_cap, cx->var_count + 1, dce_var_t);
+            const size_t var = cx->var_count++;
+            cx->vars[var] = (dce_var_t){ .decl = st };
+
+            err_t rc = dce_bind_(cx, st->u.vdecl.name_id, var);
+            if (rc == OK) dce_reads_(cx, st->left);
+            return rc;
+        }
+
+        case ASTK_ASSIGN:
+        {
+            const size_t var = dce_lookup_(cx, st->u.assign.name_id);
+            dce_value_(cx, var, st->left);
+            if (var == SIZE_MAX) return OK;
+
+            DCE_GROW_(cx->stores, cx->store_cap, cx->store_count + 1, dce_store_t);
+            cx->stores[cx->store_count++] = (dce_store_t){ .assign = st, .var = var };
+            return OK;
+        }
+
+        // arms without a block share the enclosing scope, as in the backend
+        case ASTK_WHILE:
+            dce_reads_(cx, st->left);
+            return st->left ? dce_scan_(cx, st->left->right) : OK;
+
+        case ASTK_IF:
+        case ASTK_BRANCH:
+        {
+            const ast_node_t* cond = st->left;
+            if (!cond) return OK;
+
+            dce_reads_(cx, cond);
+            err_t rc = dce_scan_(cx, cond->right);
+            if (rc == OK && cond->right) rc = dce_scan_(cx, cond->right->right);
+            return rc;
+        }
+
+        case ASTK_ELSE:
+            return dce_scan_(cx, st->left);
+
+        default:
+            dce_reads_(cx, st->left);
+            return OK;
+    }
+}
+
+// a dead store keeps only the calls of its value
+static void dce_drop_store_(dce_ctx_t* cx, ast_node_t* st)
+{
+    if (st->left && dce_has_call_(st->left))
+    {
+        st->kind = ASTK_EXPR_STMT;
+        st->left->right = NULL;
+    }
+    else
+        dce_make_empty_(st);
+
+    cx->removed++;
+}
+
+// Returns number of stores dropped in this round
+static err_t dce_stores_(dce_ctx_t* cx, ast_node_t* fn, size_t* dropped)
+{
+    cx->var_count   = 0;
+    cx->bind_count  = 0;
+    cx->store_count = 0;
+    cx->target      = SIZE_MAX;
+    *dropped        = 0;
+
+    ast_node_t* plist = fn->left;
+    for (ast_node_t* p = plist ? plist->left : NULL; p; p = p->right)
+    {
+        err_t rc = dce_bind_(cx, p->u.param.name_id, SIZE_MAX);
+        if (rc != OK) return rc;
+    }
+
+    err_t rc = dce_scan_(cx, plist ? plist->right : NULL);
+    if (rc != OK) return rc;
+
+    for (size_t i = 0; i < cx->store_count; ++i)
+    {
+        const dce_var_t* v = &cx->vars[cx->stores[i].var];
+        if (v->reads) continue;
+
+        dce_drop_store_(cx, cx->stores[i].assign);
+        (*dropped)++;
+    }
+
+    for (size_t i = 0; i < cx->var_count; ++i)
+    {
+        const dce_var_t* v = &cx->vars[i];
+        if (v->reads) continue;
+
+        dce_drop_store_(cx, v->decl);
+        (*dropped)++;
+    }
+
+    return OK;
+}
+
+err_t opt_dce(ast_tree_t* tree, size_t* out_removed)
+{
+    if (!tree || !out_removed) return ERR_BAD_ARG;
+    *out_removed = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM) return OK;
+
+    dce_ctx_t cx = { .target = SIZE_MAX };
+    err_t rc = OK;
+
+    for (ast_node_t* fn = program->left; fn && rc == OK; fn = fn->right)
+    {
+        if (fn->kind != ASTK_FUNC || !fn->left) continue;
+
+        // a non-void function has to end with micdrop even where an if
+        // before it already returns on every path
+        ast_node_t* body = fn->left->right;
+        ast_node_t* prev = NULL;
+        ast_node_t* last = body ? body->left : NULL;
+        for (; last && last->right; last = last->right) prev = last;
+        if (fn->u.func.ret_type == AST_TYPE_VOID || (last && last->kind != ASTK_RETURN)) last = NULL;
+
+        dce_prune_(&cx, body);
+
+        if (last && body->left)
+        {
+            ast_node_t* end = body->left;
+            while (end->right) end = end->right;
+            if (end != last)
+            {
+                end->right = last;
+                if (end == prev) cx.removed--;
+            }
+        }
+
+        // dropping a store may leave the variables it read unread
+        size_t dropped = 0;
+        do rc = dce_stores_(&cx, fn, &dropped);
+        while (rc == OK && dropped > 0);
+
+        dce_sweep_(&cx, fn);
+    }
+
+    mem_free(cx.vars);
+    mem_free(cx.binds);
+    mem_free(cx.stores);
+
+    *out_removed = cx.removed;
+    return rc;
+}
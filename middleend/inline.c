@@ -0,0 +1,579 @@
+#include "middleend.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Inliner. A call to a small non-recursive function whose only micdrop is
+    its last statement is replaced, in the statement list of the caller, by
+
+        <ret> r;                      (non-void callees only)
+        yap
+            <param> p' gaslight arg;  (one per param, fresh names)
+            ...callee body...
+            r gaslight <returned expr>;
+        yapity
+
+    and the call itself by a read of r. Declarations do the same argument
+    and result conversions as the call protocol. A call is taken out of its
+    statement only while it is the first call evaluated there, so calls run
+    in the original order. Callees are processed before their callers.
+    Sites the profile counts at least 1/16 of the hottest one take callees
+    up to hot_budget nodes instead of budget
+*/
+
+typedef struct
+{
+    ast_node_t* fn;
+    size_t      name_id;
+    size_t      size;        // nodes, refreshed after inlining into it
+    int         recursive;   // on a call cycle
+    int         inlinable;
+
+    size_t*     callees;
+    size_t      callee_count;
+    size_t      callee_cap;
+
+    size_t      index;       // Tarjan
+    size_t      low;
+    int         visited;
+    int         on_stack;
+} inl_func_t;
+
+typedef struct
+{
+    size_t from;
+    size_t to;
+} inl_bind_t;
+
+typedef struct
+{
+    ast_tree_t* tree;
+    size_t      budget;
+    size_t      hot_budget;
+    size_t      hot_floor;   // profile count that makes a call site hot
+
+    inl_func_t* funcs;
+    size_t      func_count;
+
+    size_t*     stack;       // Tarjan stack, then callees-first order
+    size_t      stack_count;
+    size_t*     order;
+    size_t      order_count;
+    size_t      next_index;
+
+    inl_bind_t* binds;       // callee names -> fresh names while renaming
+    size_t      bind_count;
+    size_t      bind_cap;
+
+    size_t      caller;      // function being inlined into
+    size_t      growth_left; // nodes the caller may still grow by
+    size_t      fresh;
+    size_t      inlined;
+} inl_ctx_t;
+
+#define INL_GROW_(ptr, cap, want, type)                                        \
+    block_begin                                                                \
+        if ((want) > (cap)) {                                                  \
+            size_t new_cap = (cap) ? (cap) * 2 : 8;                            \
+            while (new_cap < (want)) new_cap *= 2;                             \
+            void* np = mem_realloc(MEM_TAG_OPT, (ptr), new_cap * sizeof(type)); \
+            if (!np) return ERR_ALLOC;                                         \
+            (ptr) = (type*)np;                                                 \
+            (cap) = new_cap;                                                   \
+        }                                                                      \
+    block_end
+
+// builtins go before user functions in both backends
+static const char* const inl_builtins[] = {
+    "in", "fin", "cin", "cap", "nocap", "stinky",
+    "draw", "clean_vm", "gyat", "skibidi",
+    "out", "fout", "cout", "pookie", "rizz", "menace",
+    "set_pixel",
+};
+
+static int inl_is_builtin_(const ast_tree_t* tree, size_t name_id)
+{
+    const char* name = ast_name_cstr(tree, name_id);
+    if (!name) return 0;
+
+    for (size_t i = 0; i < sizeof(inl_builtins) / sizeof(inl_builtins[0]); ++i)
+        if (strcmp(name, inl_builtins[i]) == 0) return 1;
+    return 0;
+}
+
+static size_t inl_find_(const inl_ctx_t* cx, size_t name_id)
+{
+    if (inl_is_builtin_(cx->tree, name_id)) return SIZE_MAX;
+
+    for (size_t i = 0; i < cx->func_count; ++i)
+        if (cx->funcs[i].name_id == name_id) return i;
+    return SIZE_MAX;
+}
+
+static ast_node_t* inl_body_(const ast_node_t* fn)
+{
+    return fn->left ? fn->left->right : NULL;
+}
+
+// ================================ call graph ================================
+
+static err_t inl_edges_(inl_ctx_t* cx, inl_func_t* f, const ast_node_t* n)
+{
+    for (; n; n = n->right)
+    {
+        if (n->kind == ASTK_CALL)
+        {
+            const size_t callee = inl_find_(cx, n->u.call.name_id);
+            if (callee != SIZE_MAX)
+            {
+                INL_GROW_(f->callees, f->callee_cap, f->callee_count + 1, size_t);
+                f->callees[f->callee_count++] = callee;
+            }
+        }
+
+        err_t rc = inl_edges_(cx, f, n->left);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+static void inl_tarjan_(inl_ctx_t* cx, size_t v)
+{
+    inl_func_t* f = &cx->funcs[v];
+    f->visited  = 1;
+    f->index    = f->low = cx->next_index++;
+    f->on_stack = 1;
+    cx->stack[cx->stack_count++] = v;
+
+    for (size_t i = 0; i < f->callee_count; ++i)
+    {
+        const size_t w = f->callees[i];
+        if (w == v) f->recursive = 1;
+
+        if (!cx->funcs[w].visited)
+        {
+            inl_tarjan_(cx, w);
+            if (cx->funcs[w].low < f->low) f->low = cx->funcs[w].low;
+        }
+        else if (cx->funcs[w].on_stack && cx->funcs[w].index < f->low)
+            f->low = cx->funcs[w].index;
+    }
+
+    if (f->low != f->index) return;
+
+    // SCCs come out callees first
+    const size_t first = cx->order_count;
+    size_t w = 0;
+    do
+    {
+        w = cx->stack[--cx->stack_count];
+        cx->funcs[w].on_stack = 0;
+        cx->order[cx->order_count++] = w;
+    } while (w != v);
+
+    if (cx->order_count - first > 1)
+        for (size_t i = first; i < cx->order_count; ++i)
+            cx->funcs[cx->order[i]].recursive = 1;
+}
+
+// only micdrop is the last statement of the body
+static int inl_count_returns_(const ast_node_t* n)
+{
+    int count = 0;
+    for (; n; n = n->right)
+        count += (n->kind == ASTK_RETURN) + inl_count_returns_(n->left);
+    return count;
+}
+
+static void inl_classify_(inl_ctx_t* cx, inl_func_t* f)
+{
+    const ast_node_t* body = inl_body_(f->fn);
+    f->size      = ast_subtree_size(body);
+    f->inlinable = 0;
+
+    if (f->recursive || !body || body->kind != ASTK_BLOCK) return;
+    if (f->size > cx->budget && f->size > cx->hot_budget) return;
+
+    const char* name = ast_name_cstr(cx->tree, f->name_id);
+    if (name && strcmp(name, "main") == 0) return;
+
+    const ast_node_t* last = body->left;
+    while (last && last->right) last = last->right;
+
+    const int returns = inl_count_returns_(body->left);
+    if (f->fn->u.func.ret_type == AST_TYPE_VOID)
+    {
+        if (returns == 0 || (returns == 1 && last->kind == ASTK_RETURN))
+            f->inlinable = 1;
+        return;
+    }
+
+    if (returns == 1 && last->kind == ASTK_RETURN && last->left)
+        f->inlinable = 1;
+}
+
+// ================================= renaming =================================
+
+static size_t inl_rename_lookup_(const inl_ctx_t* cx, size_t name_id)
+{
+    for (size_t i = cx->bind_count; i > 0; --i)
+        if (cx->binds[i - 1].from == name_id) return cx->binds[i - 1].to;
+    return name_id;
+}
+
+static err_t inl_rename_bind_(inl_ctx_t* cx, size_t from, size_t to)
+{
+    INL_GROW_(cx->binds, cx->bind_cap, cx->bind_count + 1, inl_bind_t);
+    cx->binds[cx->bind_count++] = (inl_bind_t){ .from = from, .to = to };
+    return OK;
+}
+
+// callee locals keep their names, they can only shadow params
+static err_t inl_rename_(inl_ctx_t* cx, ast_node_t* n)
+{
+    for (; n; n = n->right)
+    {
+        err_t rc = OK;
+
+        switch (n->kind)
+        {
+            case ASTK_IDENT:
+                n->u.ident.name_id = inl_rename_lookup_(cx, n->u.ident.name_id);
+                break;
+
+            case ASTK_ASSIGN:
+                n->u.assign.name_id = inl_rename_lookup_(cx, n->u.assign.name_id);
+                rc = inl_rename_(cx, n->left);
+                break;
+
+            case ASTK_VAR_DECL:
+                // bound before its init, as in the backend
+                rc = inl_rename_bind_(cx, n->u.vdecl.name_id, n->u.vdecl.name_id);
+                if (rc == OK) rc = inl_rename_(cx, n->left);
+                break;
+
+            case ASTK_BLOCK:
+            {
+                const size_t binds = cx->bind_count;
+                rc = inl_rename_(cx, n->left);
+                cx->bind_count = binds;
+                break;
+            }
+
+            default:
+                rc = inl_rename_(cx, n->left);
+                break;
+        }
+
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+// ================================= inlining =================================
+
+static ast_node_t* inl_first_call_(ast_node_t* e)
+{
+    if (!e) return NULL;
+
+    for (ast_node_t* c = e->left; c; c = c->right)
+    {
+        ast_node_t* r = inl_first_call_(c);
+        if (r) return r;
+    }
+    return (e->kind == ASTK_CALL) ? e : NULL;
+}
+
+// set_pixel does not evaluate its operands left to right
+static int inl_has_multi_arg_builtin_(const inl_ctx_t* cx, const ast_node_t* e)
+{
+    if (!e) return 0;
+
+    if (e->kind == ASTK_CALL && inl_is_builtin_(cx->tree, e->u.call.name_id) &&
+        e->left && ast_children_count(e->left) > 1)
+        return 1;
+
+    for (const ast_node_t* c = e->left; c; c = c->right)
+        if (inl_has_multi_arg_builtin_(cx, c)) return 1;
+    return 0;
+}
+
+static ast_node_t* inl_decl_(inl_ctx_t* cx, token_pos_t pos, size_t name_id, ast_type_t type, ast_node_t* init)
+{
+    ast_node_t* vd = ast_new(cx->tree, ASTK_VAR_DECL, pos);
+    if (!vd) return NULL;
+
+    vd->u.vdecl.name_id = name_id;
+    vd->u.vdecl.type    = type;
+    vd->type            = type;
+    if (init) ast_add_child(vd, init);
+    return vd;
+}
+
+/*
+    Expand call (the first one evaluated in *link) in front of *link. On
+    return *link is the statement again, the nodes before it are the
+    expansion. call turns into a read of the result
+*/
+static err_t inl_expand_(inl_ctx_t* cx, ast_node_t** link, ast_node_t* call, const inl_func_t* g)
+{
+    const ast_node_t* gfn    = g->fn;
+    const ast_node_t* plist  = gfn->left;
+    const ast_type_t  ret    = gfn->u.func.ret_type;
+    const token_pos_t pos    = call->pos;
+    ast_node_t*       st     = *link;
+
+    ast_node_t* block = ast_new(cx->tree, ASTK_BLOCK, pos);
+    if (!block) return ERR_ALLOC;
+
+    cx->bind_count = 0;
+
+    // params: fresh names, the arguments become their inits
+    ast_node_t* arg = call->left ? call->left->left : NULL;
+    for (const ast_node_t* p = plist->left; p; p = p->right)
+    {
+        ast_node_t* next = arg->right;
+        arg->right = NULL;
+
+        size_t fresh = 0;
+        err_t rc = opt_fresh_name(cx->tree, ast_name_cstr(cx->tree, p->u.param.name_id), "i", &cx->fresh, &fresh);
+        if (rc == OK) rc = inl_rename_bind_(cx, p->u.param.name_id, fresh);
+        if (rc != OK) return rc;
+
+        ast_node_t* vd = inl_decl_(cx, pos, fresh, p->u.param.type, arg);
+        if (!vd) return ERR_ALLOC;
+        ast_add_child(block, vd);
+
+        arg = next;
+    }
+
+    ast_node_t* body = ast_clone(cx->tree, inl_body_(gfn));
+    if (!body) return ERR_ALLOC;
+
+    err_t rc = inl_rename_(cx, body->left);
+    if (rc != OK) return rc;
+
+    // body statements follow the params in the same block, so callee
+    // locals cannot shadow the fresh names any more than the params
+    ast_node_t** tail = &block->left;
+    while (*tail) tail = &(*tail)->right;
+    *tail = body->left;
+    for (ast_node_t* c = body->left; c; c = c->right) c->parent = block;
+
+    // final micdrop -> store into the result
+    ast_node_t* last = NULL;
+    for (tail = &block->left; *tail && (*tail)->right; tail = &(*tail)->right) {}
+    last = *tail;
+
+    size_t result = SIZE_MAX;
+    if (ret != AST_TYPE_VOID)
+    {
+        rc = opt_fresh_name(cx->tree, ast_name_cstr(cx->tree, gfn->u.func.name_id), "r", &cx->fresh, &result);
+        if (rc != OK) return rc;
+
+        last->kind = ASTK_ASSIGN;
+        last->u.assign.name_id = result;
+    }
+    else if (last && last->kind == ASTK_RETURN)
+        *tail = NULL;
+
+    ast_node_t* first = block;
+    if (ret != AST_TYPE_VOID)
+    {
+        first = inl_decl_(cx, pos, result, ret, NULL);
+        if (!first) return ERR_ALLOC;
+        first->right = block;
+    }
+    block->right = st;
+    *link = first;
+
+    // the call becomes a read of the result
+    call->kind = ASTK_IDENT;
+    call->left = NULL;
+    call->u.ident.name_id = result;
+    call->type = ret;
+
+    cx->inlined++;
+    cx->growth_left = (cx->growth_left > g->size) ? cx->growth_left - g->size : 0;
+    return OK;
+}
+
+static ast_node_t** inl_stmt_expr_(ast_node_t* st)
+{
+    switch (st->kind)
+    {
+        case ASTK_VAR_DECL:
+        case ASTK_ASSIGN:
+        case ASTK_RETURN:
+        case ASTK_EXPR_STMT:
+        case ASTK_CALL_STMT:
+        case ASTK_COUT:
+        case ASTK_ICOUT:
+        case ASTK_FCOUT:
+        case ASTK_IF:        // first condition only, later ones are conditional
+            return &st->left;
+        default:
+            return NULL;
+    }
+}
+
+// Inline calls of st while they are first in evaluation order. *link is
+// moved past st and the expansions in front of it
+static err_t inl_stmt_(inl_ctx_t* cx, ast_node_t*** link)
+{
+    ast_node_t*  st   = **link;
+    ast_node_t** expr = inl_stmt_expr_(st);
+
+    for (;;)
+    {
+        ast_node_t* call = NULL;
+        if (expr && *expr && !inl_has_multi_arg_builtin_(cx, *expr))
+            call = inl_first_call_(*expr);
+
+        const size_t gi = call ? inl_find_(cx, call->u.call.name_id) : SIZE_MAX;
+        const inl_func_t* g = (gi != SIZE_MAX) ? &cx->funcs[gi] : NULL;
+
+        // a void call can only be a statement of its own
+        const int whole = call && (*expr == call) &&
+                          (st->kind == ASTK_EXPR_STMT || st->kind == ASTK_CALL_STMT);
+
+        const int    hot   = call && call->u.call.hits != 0 && call->u.call.hits >= cx->hot_floor;
+        const size_t limit = (hot && cx->hot_budget > cx->budget) ? cx->hot_budget : cx->budget;
+
+        if (!g || gi == cx->caller || !g->inlinable || g->size > limit || cx->growth_left == 0 ||
+            ast_children_count(call->left) != ast_children_count(g->fn->left) ||
+            (g->fn->u.func.ret_type == AST_TYPE_VOID && !whole))
+        {
+            *link = &st->right;
+            return OK;
+        }
+
+        err_t rc = inl_expand_(cx, *link, call, g);
+        if (rc != OK) return rc;
+
+        // step over the expansion
+        while (**link != st) *link = &(**link)->right;
+
+        if (whole)
+        {
+            // nothing left to evaluate
+            **link = st->right;
+            return OK;
+        }
+    }
+}
+
+static err_t inl_nested_(inl_ctx_t* cx, ast_node_t* st);
+
+static err_t inl_block_(inl_ctx_t* cx, ast_node_t* block)
+{
+    ast_node_t** link = &block->left;
+    while (*link)
+    {
+        err_t rc = inl_nested_(cx, *link);
+        if (rc == OK) rc = inl_stmt_(cx, &link);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+static err_t inl_nested_(inl_ctx_t* cx, ast_node_t* st)
+{
+    if (!st) return OK;
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:
+            return inl_block_(cx, st);
+
+        case ASTK_WHILE:
+            return st->left ? inl_nested_(cx, st->left->right) : OK;
+
+        case ASTK_IF:
+        case ASTK_BRANCH:
+        {
+            ast_node_t* then = st->left ? st->left->right : NULL;
+            err_t rc = inl_nested_(cx, then);
+            if (rc == OK && then) rc = inl_nested_(cx, then->right);
+            return rc;
+        }
+
+        case ASTK_ELSE:
+            return inl_nested_(cx, st->left);
+
+        default:
+            return OK;
+    }
+}
+
+static size_t inl_max_hits_(const ast_node_t* n)
+{
+    size_t max = 0;
+    for (; n; n = n->right)
+    {
+        if (n->kind == ASTK_CALL && n->u.call.hits > max) max = n->u.call.hits;
+
+        const size_t sub = inl_max_hits_(n->left);
+        if (sub > max) max = sub;
+    }
+    return max;
+}
+
+err_t opt_inline(ast_tree_t* tree, size_t budget, size_t hot_budget, size_t* out_inlined)
+{
+    if (!tree || !out_inlined) return ERR_BAD_ARG;
+    *out_inlined = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM || budget == 0) return OK;
+
+    inl_ctx_t cx = { .tree = tree, .budget = budget, .hot_budget = hot_budget };
+    cx.hot_floor = inl_max_hits_(program) / 16;
+    err_t rc = OK;
+
+    cx.func_count = ast_children_count(program);
+    cx.funcs = (inl_func_t*)mem_calloc(MEM_TAG_OPT, cx.func_count + 1, sizeof(inl_func_t));
+    cx.stack = (size_t*)    mem_calloc(MEM_TAG_OPT, cx.func_count + 1, sizeof(size_t));
+    cx.order = (size_t*)    mem_calloc(MEM_TAG_OPT, cx.func_count + 1, sizeof(size_t));
+    if (!cx.funcs || !cx.stack || !cx.order) rc = ERR_ALLOC;
+
+    size_t i = 0;
+    for (ast_node_t* fn = program->left; fn && rc == OK; fn = fn->right, ++i)
+    {
+        cx.funcs[i].fn      = fn;
+        cx.funcs[i].name_id = (fn->kind == ASTK_FUNC) ? fn->u.func.name_id : SIZE_MAX;
+    }
+
+    for (i = 0; i < cx.func_count && rc == OK; ++i)
+        if (cx.funcs[i].fn->kind == ASTK_FUNC)
+            rc = inl_edges_(&cx, &cx.funcs[i], inl_body_(cx.funcs[i].fn));
+
+    for (i = 0; i < cx.func_count && rc == OK; ++i)
+        if (!cx.funcs[i].visited) inl_tarjan_(&cx, i);
+
+    for (i = 0; i < cx.order_count && rc == OK; ++i)
+    {
+        inl_func_t* f = &cx.funcs[cx.order[i]];
+        ast_node_t* body = (f->fn->kind == ASTK_FUNC) ? inl_body_(f->fn) : NULL;
+        if (!body) continue;
+
+        // callees are final by now; bound the caller's growth
+        cx.caller      = cx.order[i];
+        cx.growth_left = 4 * ast_subtree_size(body) + 256;
+
+        rc = inl_nested_(&cx, body);
+        if (rc == OK) inl_classify_(&cx, f);
+    }
+
+    for (i = 0; cx.funcs && i < cx.func_count; ++i)
+        mem_free(cx.funcs[i].callees);
+    mem_free(cx.funcs);
+    mem_free(cx.stack);
+    mem_free(cx.order);
+    mem_free(cx.binds);
+
+    *out_inlined = cx.inlined;
+    return rc;
+}
@@ -0,0 +1,389 @@
+#include "middleend.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Loop-invariant code motion. An operator subtree of a lowkey loop (highkey
+    loops are lowkey loops by now) that reads no variable assigned or
+    declared in the loop and calls nothing is computed once, into a new
+    local declared right before the loop. Left in place is division by
+    anything but a nonzero literal and ^ by anything but a literal; the rest
+    cannot trap, so taking it out of arms and loops that may not run at all
+    is safe. Inner loops go first, what they hoist may leave outer ones too
+*/
+
+typedef struct
+{
+    size_t     name_id;
+    ast_type_t type;
+} licm_bind_t;
+
+typedef struct
+{
+    ast_tree_t*  tree;
+
+    licm_bind_t* binds;      // variables in scope where the loop starts
+    size_t       bind_count;
+    size_t       bind_cap;
+
+    size_t*      defs;       // names written anywhere in the current loop
+    size_t       def_count;
+    size_t       def_cap;
+
+    ast_node_t*  pre;        // declarations that go before the loop
+    ast_node_t** pre_tail;
+
+    size_t*      temps;      // locals made here, each stored once
+    size_t       temp_count;
+    size_t       temp_cap;
+
+    size_t       fresh;
+    size_t       hoisted;
+} licm_ctx_t;
+
+#define LICM_GROW_(ptr, cap, want, type)                                       \
+    block_begin                                                                \
+        if ((want) > (cap)) {                                                  \
+            size_t new_cap = (cap) ? (cap) * 2 : 16;                           \
+            while (new_cap < (want)) new_cap *= 2;                             \
+            void* np = mem_realloc(MEM_TAG_OPT, (ptr), new_cap * sizeof(type)); \
+            if (!np) return ERR_ALLOC;                                         \
+            (ptr) = (type*)np;                                                 \
+            (cap) = new_cap;                                                   \
+        }                                                                      \
+    block_end
+
+static err_t licm_bind_(licm_ctx_t* cx, size_t name_id, ast_type_t type)
+{
+    LICM_GROW_(cx->binds, cx->bind_cap, cx->bind_count + 1, licm_bind_t);
+    cx->binds[cx->bind_count++] = (licm_bind_t){ .name_id = name_id, .type = type };
+    return OK;
+}
+
+static ast_type_t licm_lookup_(const licm_ctx_t* cx, size_t name_id)
+{
+    for (size_t i = cx->bind_count; i > 0; --i)
+        if (cx->binds[i - 1].name_id == name_id) return cx->binds[i - 1].type;
+    return AST_TYPE_UNKNOWN;
+}
+
+static int licm_is_def_(const licm_ctx_t* cx, size_t name_id)
+{
+    for (size_t i = 0; i < cx->def_count; ++i)
+        if (cx->defs[i] == name_id) return 1;
+    return 0;
+}
+
+static err_t licm_collect_defs_(licm_ctx_t* cx, const ast_node_t* n)
+{
+    for (; n; n = n->right)
+    {
+        size_t name = SIZE_MAX;
+        if (n->kind == ASTK_ASSIGN)   name = n->u.assign.name_id;
+        if (n->kind == ASTK_VAR_DECL) name = n->u.vdecl.name_id;
+
+        if (name != SIZE_MAX && !licm_is_def_(cx, name))
+        {
+            LICM_GROW_(cx->defs, cx->def_cap, cx->def_count + 1, size_t);
+            cx->defs[cx->def_count++] = name;
+        }
+
+        err_t rc = licm_collect_defs_(cx, n->left);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+// type the backend gives e, UNKNOWN if it cannot be told here
+static ast_type_t licm_type_(const licm_ctx_t* cx, const ast_node_t* e)
+{
+    switch (e->kind)
+    {
+        case ASTK_NUM_LIT:
+            return (e->u.num.lit_type == LIT_FLOAT) ? AST_TYPE_FLOAT : AST_TYPE_INT;
+
+        case ASTK_IDENT:
+            return licm_lookup_(cx, e->u.ident.name_id);
+
+        case ASTK_BUILTIN_UNARY:
+            return (e->u.builtin_unary.id == AST_BUILTIN_FTOI) ? AST_TYPE_INT : AST_TYPE_FLOAT;
+
+        case ASTK_UNARY:
+            return (e->u.unary.op == TOK_OP_NOT) ? AST_TYPE_INT : licm_type_(cx, e->left);
+
+        case ASTK_BINARY:
+        {
+            if (opt_is_bool_op(e->u.binary.op)) return AST_TYPE_INT;
+
+            const ast_type_t lt = licm_type_(cx, e->left);
+            const ast_type_t rt = licm_type_(cx, e->left->right);
+            if (lt == AST_TYPE_UNKNOWN || rt == AST_TYPE_UNKNOWN) return AST_TYPE_UNKNOWN;
+
+            return (lt == AST_TYPE_FLOAT || rt == AST_TYPE_FLOAT) ? AST_TYPE_FLOAT : AST_TYPE_INT;
+        }
+
+        default:
+            return AST_TYPE_UNKNOWN;
+    }
+}
+
+static int licm_nonzero_lit_(const ast_node_t* n)
+{
+    if (!n || n->kind != ASTK_NUM_LIT) return 0;
+    return (n->u.num.lit_type == LIT_FLOAT) ? (n->u.num.lit.f64 != 0.0) : (n->u.num.lit.i64 != 0);
+}
+
+static int licm_invariant_(const licm_ctx_t* cx, const ast_node_t* e)
+{
+    switch (e->kind)
+    {
+        case ASTK_NUM_LIT:
+            return 1;
+
+        case ASTK_IDENT:
+            return !licm_is_def_(cx, e->u.ident.name_id) &&
+                   licm_lookup_(cx, e->u.ident.name_id) != AST_TYPE_UNKNOWN;
+
+        case ASTK_UNARY:
+        case ASTK_BUILTIN_UNARY:
+            return licm_invariant_(cx, e->left);
+
+        case ASTK_BINARY:
+        {
+            const ast_node_t* rhs = e->left->right;
+            if (e->u.binary.op == TOK_OP_DIV && !licm_nonzero_lit_(rhs)) return 0;
+            if (e->u.binary.op == TOK_OP_POW && rhs->kind != ASTK_NUM_LIT) return 0;
+
+            return licm_invariant_(cx, e->left) && licm_invariant_(cx, rhs);
+        }
+
+        default:
+            return 0;
+    }
+}
+
+// *slot becomes a read of a new local, its value goes before the loop
+static err_t licm_hoist_(licm_ctx_t* cx, ast_node_t** slot, ast_type_t type)
+{
+    ast_node_t* e = *slot;
+
+    size_t name = 0;
+    err_t rc = opt_fresh_name(cx->tree, "licm", "t", &cx->fresh, &name);
+    if (rc != OK) return rc;
+
+    ast_node_t* id = ast_new(cx->tree, ASTK_IDENT, e->pos);
+    ast_node_t* vd = ast_new(cx->tree, ASTK_VAR_DECL, e->pos);
+    if (!id || !vd) return ERR_ALLOC;
+
+    id->u.ident.name_id = name;
+    id->type   = type;
+    id->parent = e->parent;
+    id->right  = e->right;
+    *slot = id;
+
+    e->right = NULL;
+    vd->u.vdecl.name_id = name;
+    vd->u.vdecl.type    = type;
+    vd->type            = type;
+    ast_add_child(vd, e);
+
+    LICM_GROW_(cx->temps, cx->temp_cap, cx->temp_count + 1, size_t);
+    cx->temps[cx->temp_count++] = name;
+
+    *cx->pre_tail = vd;
+    cx->pre_tail  = &vd->right;
+    cx->hoisted++;
+    return OK;
+}
+
+// what an inner loop hoisted moves on whole, no copy is left behind
+static int licm_movable_decl_(const licm_ctx_t* cx, const ast_node_t* st)
+{
+    if (st->kind != ASTK_VAR_DECL || !st->left) return 0;
+
+    for (size_t i = 0; i < cx->temp_count; ++i)
+        if (cx->temps[i] == st->u.vdecl.name_id)
+            return licm_invariant_(cx, st->left);
+    return 0;
+}
+
+static err_t licm_expr_(licm_ctx_t* cx, ast_node_t** slot)
+{
+    ast_node_t* e = *slot;
+
+    if ((e->kind == ASTK_BINARY || e->kind == ASTK_UNARY || e->kind == ASTK_BUILTIN_UNARY) &&
+        licm_invariant_(cx, e))
+    {
+        const ast_type_t type = licm_type_(cx, e);
+        if (type == AST_TYPE_INT || type == AST_TYPE_FLOAT)
+            return licm_hoist_(cx, slot, type);
+    }
+
+    for (ast_node_t** c = &e->left; *c; c = &(*c)->right)
+    {
+        err_t rc = licm_expr_(cx, c);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+// a compare stays, the backend jumps on it directly
+static err_t licm_cond_(licm_ctx_t* cx, ast_node_t** slot)
+{
+    ast_node_t* c = *slot;
+    if (!(c->kind == ASTK_BINARY && opt_is_bool_op(c->u.binary.op)))
+        return licm_expr_(cx, slot);
+
+    err_t rc = licm_expr_(cx, &c->left);
+    if (rc == OK) rc = licm_expr_(cx, &c->left->right);
+    return rc;
+}
+
+static err_t licm_stmt_(licm_ctx_t* cx, ast_node_t* st)
+{
+    err_t rc = OK;
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:
+            for (ast_node_t** c = &st->left; *c && rc == OK; )
+            {
+                ast_node_t* cur = *c;
+                if (!licm_movable_decl_(cx, cur))
+                {
+                    rc = licm_stmt_(cx, cur);
+                    c = &cur->right;
+                    continue;
+                }
+
+                *c = cur->right;
+                cur->right = NULL;
+                *cx->pre_tail = cur;
+                cx->pre_tail  = &cur->right;
+            }
+            return rc;
+
+        case ASTK_WHILE:
+        case ASTK_IF:
+        case ASTK_BRANCH:
+            rc = licm_cond_(cx, &st->left);
+            for (ast_node_t* c = st->left->right; c && rc == OK; c = c->right)
+                rc = licm_stmt_(cx, c);
+            return rc;
+
+        case ASTK_ELSE:
+            return st->left ? licm_stmt_(cx, st->left) : OK;
+
+        case ASTK_VAR_DECL:
+        case ASTK_ASSIGN:
+        case ASTK_RETURN:
+        case ASTK_EXPR_STMT:
+        case ASTK_CALL_STMT:
+        case ASTK_COUT:
+        case ASTK_ICOUT:
+        case ASTK_FCOUT:
+            for (ast_node_t** c = &st->left; *c && rc == OK; c = &(*c)->right)
+                rc = licm_expr_(cx, c);
+            return rc;
+
+        default:
+            return OK;
+    }
+}
+
+static err_t licm_loop_(licm_ctx_t* cx, ast_node_t** link)
+{
+    ast_node_t* w = *link;
+    if (!w->left || !w->left->right) return OK;
+
+    cx->def_count = 0;
+    cx->pre       = NULL;
+    cx->pre_tail  = &cx->pre;
+
+    err_t rc = licm_collect_defs_(cx, w->left);
+    if (rc == OK) rc = licm_stmt_(cx, w);
+    if (rc != OK || !cx->pre) return rc;
+
+    *cx->pre_tail = w;
+    *link = cx->pre;
+    for (ast_node_t* n = cx->pre; n != w; n = n->right)
+        n->parent = w->parent;
+    return OK;
+}
+
+// link is where st hangs in a statement list, NULL for a bare arm
+static err_t licm_walk_(licm_ctx_t* cx, ast_node_t* st, ast_node_t** link)
+{
+    err_t rc = OK;
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:
+        {
+            const size_t binds = cx->bind_count;
+            for (ast_node_t** c = &st->left; *c && rc == OK; )
+            {
+                ast_node_t* cur = *c;
+                rc = licm_walk_(cx, cur, c);
+                c = &cur->right;
+            }
+            cx->bind_count = binds;
+            return rc;
+        }
+
+        case ASTK_VAR_DECL:
+            return licm_bind_(cx, st->u.vdecl.name_id, st->u.vdecl.type);
+
+        case ASTK_IF:
+        case ASTK_BRANCH:
+            for (ast_node_t* c = st->left->right; c && rc == OK; c = c->right)
+                rc = licm_walk_(cx, c, NULL);
+            return rc;
+
+        case ASTK_ELSE:
+            return st->left ? licm_walk_(cx, st->left, NULL) : OK;
+
+        case ASTK_WHILE:
+            // inner loops first
+            if (st->left && st->left->right)
+                rc = licm_walk_(cx, st->left->right, NULL);
+            if (rc == OK && link) rc = licm_loop_(cx, link);
+            return rc;
+
+        default:
+            return OK;
+    }
+}
+
+err_t opt_licm(ast_tree_t* tree, size_t* out_hoisted)
+{
+    if (!tree || !out_hoisted) return ERR_BAD_ARG;
+    *out_hoisted = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM) return OK;
+
+    licm_ctx_t cx = { .tree = tree };
+    err_t rc = OK;
+
+    for (ast_node_t* fn = program->left; fn && rc == OK; fn = fn->right)
+    {
+        if (fn->kind != ASTK_FUNC || !fn->left) continue;
+
+        cx.bind_count = 0;
+        for (const ast_node_t* p = fn->left->left; p && rc == OK; p = p->right)
+            rc = licm_bind_(&cx, p->u.param.name_id, p->u.param.type);
+
+        if (rc == OK && fn->left->right)
+            rc = licm_walk_(&cx, fn->left->right, NULL);
+    }
+
+    mem_free(cx.binds);
+    mem_free(cx.defs);
+    mem_free(cx.temps);
+
+    *out_hoisted = cx.hoisted;
+    return rc;
+}
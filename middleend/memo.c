@@ -0,0 +1,81 @@
+#include "middleend.h"
+
+#include "../libs/memory/memory.h"
+
+/*
+    Memoization marks. A pure function returning int from one or two int
+    params that may call itself more than once per call, from two sites or
+    from a loop, gets u.func.memo, the bound its params are checked
+    against; the backend gives it a table of (done, value) cells in RAM and
+    a guard at entry that returns the stored value. Params outside of
+    [0, memo) take the plain path. The table has entries slots for one
+    param, the square root of that per param for two
+*/
+
+// self calls below n, one in a loop counts as many
+static size_t memo_self_calls_(const ast_node_t* n, size_t name_id, int in_loop)
+{
+    size_t calls = 0;
+    for (; n; n = n->right)
+    {
+        if (n->kind == ASTK_CALL && n->u.call.name_id == name_id) calls += in_loop ? 2 : 1;
+        calls += memo_self_calls_(n->left, name_id, in_loop || n->kind == ASTK_WHILE);
+    }
+    return calls;
+}
+
+static int memo_signature_ok_(const ast_node_t* fn)
+{
+    if (fn->u.func.ret_type != AST_TYPE_INT) return 0;
+
+    const size_t params = ast_children_count(fn->left);
+    if (params < 1 || params > 2) return 0;
+
+    for (const ast_node_t* p = fn->left->left; p; p = p->right)
+        if (p->u.param.type != AST_TYPE_INT) return 0;
+    return 1;
+}
+
+static size_t memo_isqrt_(size_t v)
+{
+    size_t r = 0;
+    while ((r + 1) * (r + 1) <= v) ++r;
+    return r;
+}
+
+err_t opt_memo(ast_tree_t* tree, size_t entries, size_t* out_memoized)
+{
+    if (!tree || !out_memoized) return ERR_BAD_ARG;
+    *out_memoized = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM) return OK;
+
+    int* pure = (int*)mem_calloc(MEM_TAG_OPT, ast_children_count(program) + 1, sizeof(int));
+    if (!pure) return ERR_ALLOC;
+
+    err_t rc = opt_purity(tree, pure);
+
+    size_t i = 0;
+    for (ast_node_t* fn = program->left; fn && rc == OK; fn = fn->right, ++i)
+    {
+        if (fn->kind != ASTK_FUNC) continue;
+
+        const size_t bound = (ast_children_count(fn->left) == 1) ? entries : memo_isqrt_(entries);
+        const int    take  = pure[i] && bound > 0 && memo_signature_ok_(fn) &&
+                             memo_self_calls_(fn->left ? fn->left->right : NULL, fn->u.func.name_id, 0) >= 2;
+
+        if (!take)
+        {
+            fn->u.func.memo = 0;
+            continue;
+        }
+
+        // the pipeline may run this again, count each function once
+        if (fn->u.func.memo == 0) (*out_memoized)++;
+        fn->u.func.memo = bound;
+    }
+
+    mem_free(pure);
+    return rc;
+}
@@ -2,6 +2,11 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+#include "../libs/pool/pool.h"
+#include "../libs/stats/stats.h"
 
 static inline int is_num_lit_(const ast_node_t* n)
 {
@@ -69,11 +74,12 @@ static int ipow_ok_(i64_t base, i64_t exp, i64_t* out)
     i64_t b   = base;
     i64_t e   = exp;
 
+    // overflow is left for the program to hit at run time
     while (e > 0)
     {
-        if (e & 1) res *= b;
+        if ((e & 1) && __builtin_mul_overflow(res, b, &res)) return 0;
         e >>= 1;
-        if (e) b *= b;
+        if (e && __builtin_mul_overflow(b, b, &b)) return 0;
     }
 
     *out = res;
@@ -85,27 +91,17 @@ static inline ast_node_t* child_(ast_node_t* n, size_t idx)
     return ast_child(n, idx);
 }
 
-static ast_node_t* replace_with_(ast_node_t* node, ast_node_t* repl)
+static int any_float_lit_(const ast_node_t* l, const ast_node_t* r)
 {
-    if (!node || !repl) return node;
-
-    ast_node_t* sib = node->right;
-
-    repl->right = sib;
-
-    return repl;
+    return (is_num_lit_(l) && l->u.num.lit_type == LIT_FLOAT) ||
+           (is_num_lit_(r) && r->u.num.lit_type == LIT_FLOAT);
 }
 
-#define OPT_MARK_CHANGED_() block_begin *changed = 1; block_end
-#define OPT_RETURN_(x)      block_begin return (x);   block_end
-
-#define OPT_DONE_RET_N_()   block_begin OPT_MARK_CHANGED_(); OPT_RETURN_(n); block_end
+// A rule returns the node that now stands in place of n (n itself when it
+// was rewritten in place), or NULL when it does not apply
 
-#define OPT_MAKE_NUM_FI_(float_expr, int_expr)                   \
-    block_begin                                                  \
-        if (any_float) make_num_float_(n, (double)(float_expr)); \
-        else           make_num_int_(n,   (i64_t)(int_expr));    \
-    block_end
+#define OPT_RETURN_(x)      block_begin return (x); block_end
+#define OPT_DONE_RET_N_()   OPT_RETURN_(n)
 
 #define OPT_UNARY_COPY_(a_)                    \
     block_begin                                \
@@ -120,8 +116,10 @@ static ast_node_t* replace_with_(ast_node_t* node, ast_node_t* repl)
     block_begin                                \
         if ((a_)->u.num.lit_type == LIT_FLOAT) \
             make_num_float_(n, -as_f64_(a_));  \
-        else                                   \
+        else if (as_i64_(a_) != INT64_MIN)     \
             make_num_int_(n, -as_i64_(a_));    \
+        else                                   \
+            OPT_RETURN_(NULL);                 \
         OPT_DONE_RET_N_();                     \
     block_end
 
@@ -137,24 +135,37 @@ static ast_node_t* replace_with_(ast_node_t* node, ast_node_t* repl)
         OPT_DONE_RET_N_();                   \
     block_end
 
-#define OPT_BIN_ARITH_(float_expr, int_expr)        \
-    block_begin                                     \
-        OPT_MAKE_NUM_FI_((float_expr), (int_expr)); \
-        OPT_DONE_RET_N_();                          \
+// int_ovf is one of __builtin_{add,sub,mul}_overflow, no fold on overflow;
+// nor to inf or nan, a literal cannot spell them
+#define OPT_BIN_ARITH_(float_expr, int_ovf)                                 \
+    block_begin                                                             \
+        if (any_float) {                                                    \
+            const double fv = (double)(float_expr);                         \
+            if (!isfinite(fv)) OPT_RETURN_(NULL);                           \
+            make_num_float_(n, fv);                                         \
+        } else {                                                            \
+            i64_t out = 0;                                                  \
+            if (int_ovf(as_i64_(l), as_i64_(r), &out)) OPT_RETURN_(NULL);   \
+            make_num_int_(n, out);                                          \
+        }                                                                   \
+        OPT_DONE_RET_N_();                                                  \
     block_end
 
-#define OPT_BIN_DIV_()                           \
-    block_begin                                  \
-        if (any_float) {                         \
-            const double rv = as_f64_(r);        \
-            if (rv == 0.0) OPT_RETURN_(n);       \
-            make_num_float_(n, as_f64_(l) / rv); \
-        } else {                                 \
-            const i64_t rv = as_i64_(r);         \
-            if (rv == 0) OPT_RETURN_(n);         \
-            make_num_int_(n, as_i64_(l) / rv);   \
-        }                                        \
-        OPT_DONE_RET_N_();                       \
+#define OPT_BIN_DIV_()                                                  \
+    block_begin                                                         \
+        if (any_float) {                                                \
+            const double rv = as_f64_(r);                               \
+            if (rv == 0.0) OPT_RETURN_(NULL);                           \
+            const double fv = as_f64_(l) / rv;                          \
+            if (!isfinite(fv)) OPT_RETURN_(NULL);                       \
+            make_num_float_(n, fv);                                     \
+        } else {                                                        \
+            const i64_t rv = as_i64_(r);                                \
+            if (rv == 0) OPT_RETURN_(NULL);                             \
+            if (rv == -1 && as_i64_(l) == INT64_MIN) OPT_RETURN_(NULL); \
+            make_num_int_(n, as_i64_(l) / rv);                          \
+        }                                                               \
+        OPT_DONE_RET_N_();                                              \
     block_end
 
 #define OPT_BIN_POW_()                                    \
@@ -165,212 +176,1124 @@ static ast_node_t* replace_with_(ast_node_t* node, ast_node_t* repl)
                 make_num_int_(n, out);                    \
                 OPT_DONE_RET_N_();                        \
             }                                             \
+            if (as_i64_(r) >= 0) OPT_RETURN_(NULL);       \
         }                                                 \
-        make_num_float_(n, pow(as_f64_(l), as_f64_(r)));  \
+        const double fv = pow(as_f64_(l), as_f64_(r));    \
+        if (!isfinite(fv)) OPT_RETURN_(NULL);             \
+        make_num_float_(n, fv);                           \
         OPT_DONE_RET_N_();                                \
     block_end
 
-static ast_node_t* optimize_chain_(ast_node_t* head, ast_node_t* parent, int* changed);
+static int is_binary_(const ast_node_t* n, token_kind_t op)
+{
+    return n->kind == ASTK_BINARY && n->u.binary.op == op && n->left && n->left->right;
+}
 
-static ast_node_t* optimize_one_(ast_node_t* n, ast_node_t* parent, int* changed)
+static ast_node_t* rule_fold_unary_(ast_node_t* n)
 {
-    if (!n) return NULL;
+    if (n->kind != ASTK_UNARY) return NULL;
+
+    ast_node_t* a = child_(n, 0);
+    if (!is_num_lit_(a)) return NULL;
+
+    switch (n->u.unary.op)
+    {
+        case TOK_OP_PLUS:  OPT_UNARY_COPY_(a);
+        case TOK_OP_MINUS: OPT_UNARY_NEG_(a);
+        case TOK_OP_NOT:   OPT_UNARY_NOT_(a);
+        default:           return NULL;
+    }
+}
+
+static ast_node_t* rule_fold_builtin_(ast_node_t* n)
+{
+    if (n->kind != ASTK_BUILTIN_UNARY) return NULL;
+
+    ast_node_t* a = child_(n, 0);
+    if (!is_num_lit_(a)) return NULL;
+
+    const double x = as_f64_(a);
+
+    switch (n->u.builtin_unary.id)
+    {
+        case AST_BUILTIN_FLOOR: make_num_float_(n, floor(x));          return n;
+        case AST_BUILTIN_CEIL:  make_num_float_(n, ceil(x));           return n;
+        case AST_BUILTIN_ROUND: make_num_float_(n, round(x));          return n;
+        case AST_BUILTIN_ITOF:  make_num_float_(n, (double)as_i64_(a)); return n;
+        case AST_BUILTIN_FTOI:  make_num_int_(n, (i64_t)as_f64_(a));   return n;
+        default:                return NULL;
+    }
+}
+
+// x + 0 => x, 0 + x => x
+static ast_node_t* rule_add_zero_(ast_node_t* n)
+{
+    if (!is_binary_(n, TOK_OP_PLUS)) return NULL;
+
+    ast_node_t* l = child_(n, 0);
+    ast_node_t* r = child_(n, 1);
+
+    if (is_zero_(r)) return l;
+    if (is_zero_(l)) return r;
+    return NULL;
+}
+
+// calls may print or read input, an operand holding one cannot be dropped
+static int has_call_(const ast_node_t* n)
+{
+    if (!n) return 0;
+    if (n->kind == ASTK_CALL) return 1;
+
+    for (const ast_node_t* c = n->left; c; c = c->right)
+        if (has_call_(c)) return 1;
+    return 0;
+}
+
+// x * 0 / 0 * x => 0, x without calls
+static ast_node_t* rule_mul_zero_(ast_node_t* n)
+{
+    if (!is_binary_(n, TOK_OP_MUL)) return NULL;
+
+    ast_node_t* l = child_(n, 0);
+    ast_node_t* r = child_(n, 1);
+    if (!is_zero_(l) && !is_zero_(r)) return NULL;
+    if (has_call_(l) || has_call_(r)) return NULL;
+
+    if (any_float_lit_(l, r)) make_num_float_(n, 0.0);
+    else                      make_num_int_(n,   0);
+    return n;
+}
+
+// x * 1 => x, 1 * x => x
+static ast_node_t* rule_mul_one_(ast_node_t* n)
+{
+    if (!is_binary_(n, TOK_OP_MUL)) return NULL;
+
+    ast_node_t* l = child_(n, 0);
+    ast_node_t* r = child_(n, 1);
+
+    if (is_one_(r)) return l;
+    if (is_one_(l)) return r;
+    return NULL;
+}
+
+// x ^ 0 => 1, float 1.0 if exponent or base is a float literal, x without calls
+static ast_node_t* rule_pow_zero_(ast_node_t* n)
+{
+    if (!is_binary_(n, TOK_OP_POW)) return NULL;
+
+    ast_node_t* l = child_(n, 0);
+    ast_node_t* r = child_(n, 1);
+    if (!is_zero_(r) || has_call_(l)) return NULL;
+
+    if (any_float_lit_(l, r)) make_num_float_(n, 1.0);
+    else                      make_num_int_(n,   1);
+    return n;
+}
+
+// x ^ 1 => x
+static ast_node_t* rule_pow_one_(ast_node_t* n)
+{
+    if (!is_binary_(n, TOK_OP_POW)) return NULL;
+    return is_one_(child_(n, 1)) ? child_(n, 0) : NULL;
+}
+
+// 1 ^ x => 1, x without calls
+static ast_node_t* rule_one_pow_(ast_node_t* n)
+{
+    if (!is_binary_(n, TOK_OP_POW)) return NULL;
+
+    ast_node_t* l = child_(n, 0);
+    ast_node_t* r = child_(n, 1);
+    if (!is_one_(l) || has_call_(r)) return NULL;
 
-    n->parent = parent;
-    if (n->left)
-        n->left = optimize_chain_(n->left, n, changed);
- 
-    if (n->kind == ASTK_UNARY)
+    if (any_float_lit_(l, r)) make_num_float_(n, 1.0);
+    else                      make_num_int_(n,   1);
+    return n;
+}
+
+static ast_node_t* rule_fold_binary_(ast_node_t* n)
+{
+    if (n->kind != ASTK_BINARY) return NULL;
+
+    ast_node_t* l = child_(n, 0);
+    ast_node_t* r = child_(n, 1);
+    if (!is_num_lit_(l) || !is_num_lit_(r)) return NULL;
+
+    const int any_float =
+        (l->u.num.lit_type == LIT_FLOAT) ||
+        (r->u.num.lit_type == LIT_FLOAT);
+
+    switch (n->u.binary.op)
     {
-        ast_node_t* a = child_(n, 0);
-        if (is_num_lit_(a))
+        case TOK_OP_OR:   OPT_BIN_TO_INT_((truthy_(l) || truthy_(r)) ? 1 : 0);
+        case TOK_OP_AND:  OPT_BIN_TO_INT_((truthy_(l) && truthy_(r)) ? 1 : 0);
+
+        case TOK_OP_EQ:   OPT_BIN_TO_INT_((as_f64_(l) == as_f64_(r)) ? 1 : 0);
+        case TOK_OP_NEQ:  OPT_BIN_TO_INT_((as_f64_(l) != as_f64_(r)) ? 1 : 0);
+        case TOK_OP_GT:   OPT_BIN_TO_INT_((as_f64_(l) >  as_f64_(r)) ? 1 : 0);
+        case TOK_OP_LT:   OPT_BIN_TO_INT_((as_f64_(l) <  as_f64_(r)) ? 1 : 0);
+        case TOK_OP_GTE:  OPT_BIN_TO_INT_((as_f64_(l) >= as_f64_(r)) ? 1 : 0);
+        case TOK_OP_LTE:  OPT_BIN_TO_INT_((as_f64_(l) <= as_f64_(r)) ? 1 : 0);
+
+        case TOK_OP_PLUS:  OPT_BIN_ARITH_(as_f64_(l) + as_f64_(r), __builtin_add_overflow);
+        case TOK_OP_MINUS: OPT_BIN_ARITH_(as_f64_(l) - as_f64_(r), __builtin_sub_overflow);
+        case TOK_OP_MUL:   OPT_BIN_ARITH_(as_f64_(l) * as_f64_(r), __builtin_mul_overflow);
+
+        case TOK_OP_DIV:   OPT_BIN_DIV_();
+        case TOK_OP_POW:   OPT_BIN_POW_();
+
+        default:
+            return NULL;
+    }
+}
+
+/*
+    A chain of + and - or of * over one type is taken apart into its terms,
+    at most OPT_CHAIN_MAX of them. Its literals fold into one constant that
+    goes last, the other terms keep their order for their side effects:
+
+        (x + 1) - (y - 2) => x - y + 3        2 * x * 3 => x * 6
+
+    Int chains give the same result in any order, so they always
+    reassociate, unless their constant overflows: that is not folded, the
+    same as a single operator. Float chains round differently and only do
+    with fast_math
+*/
+
+#define OPT_CHAIN_MAX 32
+
+typedef struct
+{
+    ast_node_t* terms[OPT_CHAIN_MAX];
+    int         neg[OPT_CHAIN_MAX];     // subtracted, + chains only
+    ast_node_t* ops[OPT_CHAIN_MAX];     // operator nodes, the root first
+    size_t      term_count;
+    size_t      op_count;
+    ast_type_t  type;
+    int         mul;
+    int         left_deep;              // no operator of the chain on a right side
+} opt_chain_t;
+
+static int chain_op_(const opt_chain_t* ch, const ast_node_t* n)
+{
+    if (n->kind != ASTK_BINARY || n->type != ch->type || !n->left || !n->left->right) return 0;
+
+    const token_kind_t op = n->u.binary.op;
+    return ch->mul ? (op == TOK_OP_MUL) : (op == TOK_OP_PLUS || op == TOK_OP_MINUS);
+}
+
+// pending: right sides above n still to come, each at least one term
+static void chain_flatten_(opt_chain_t* ch, ast_node_t* n, int neg, size_t pending, int right)
+{
+    if (!chain_op_(ch, n) || ch->term_count + pending + 2 > OPT_CHAIN_MAX)
+    {
+        ch->terms[ch->term_count] = n;
+        ch->neg[ch->term_count++] = neg;
+        return;
+    }
+
+    ch->ops[ch->op_count++] = n;
+    if (right) ch->left_deep = 0;
+
+    ast_node_t* l = n->left;
+    ast_node_t* r = l->right;
+    chain_flatten_(ch, l, neg, pending + 1, 0);
+    chain_flatten_(ch, r, neg ^ (n->u.binary.op == TOK_OP_MINUS), pending, 1);
+}
+
+static ast_node_t* chain_reassoc_(ast_node_t* n, ast_type_t type)
+{
+    if (n->kind != ASTK_BINARY || n->type != type) return NULL;
+
+    const token_kind_t root_op = n->u.binary.op;
+    if (root_op != TOK_OP_MUL && root_op != TOK_OP_PLUS && root_op != TOK_OP_MINUS) return NULL;
+
+    opt_chain_t ch;
+    ch.term_count = 0;
+    ch.op_count   = 0;
+    ch.type       = type;
+    ch.mul        = (root_op == TOK_OP_MUL);
+    ch.left_deep  = 1;
+
+    // the root takes the whole chain, it is visited after the operators below it
+    if (n->parent && chain_op_(&ch, n->parent)) return NULL;
+    chain_flatten_(&ch, n, 0, 0, 0);
+
+    const int is_float = (type == AST_TYPE_FLOAT);
+    ast_node_t* lit   = NULL;   // the first literal, it keeps the constant
+    size_t      lits  = 0;
+    i64_t       k     = ch.mul ? 1 : 0;
+    double      kf    = ch.mul ? 1.0 : 0.0;
+
+    for (size_t i = 0; i < ch.term_count; ++i)
+    {
+        const ast_node_t* t = ch.terms[i];
+        if (!is_num_lit_(t))
         {
-            switch (n->u.unary.op)
-            {
-                case TOK_OP_PLUS:  OPT_UNARY_COPY_(a);
-                case TOK_OP_MINUS: OPT_UNARY_NEG_(a);
-                case TOK_OP_NOT:   OPT_UNARY_NOT_(a);
-                default:           return n;
-            }
+            if (t->type != type && !is_float) return NULL;
+            continue;
+        }
+        if (!is_float && t->u.num.lit_type != LIT_INT) return NULL;
+
+        if (!lit) lit = ch.terms[i];
+        lits++;
+
+        if (is_float)
+        {
+            const double v = as_f64_(t);
+            kf = ch.mul ? kf * v : (ch.neg[i] ? kf - v : kf + v);
+        }
+        else
+        {
+            const i64_t v   = t->u.num.lit.i64;
+            const int   ovf = ch.mul     ? __builtin_mul_overflow(k, v, &k)
+                            : ch.neg[i] ? __builtin_sub_overflow(k, v, &k)
+                                        : __builtin_add_overflow(k, v, &k);
+            if (ovf) return NULL;
         }
-        return n;
     }
+    if (lits == 0 || lits == ch.term_count) return NULL;
+    if (is_float && !isfinite(kf)) return NULL;
 
-    if (n->kind == ASTK_BUILTIN_UNARY)
+    // canonical order: the other terms, then the constant unless it is the identity
+    ast_node_t* out[OPT_CHAIN_MAX];
+    int         out_neg[OPT_CHAIN_MAX];
+    size_t      s = 0;
+
+    for (size_t i = 0; i < ch.term_count; ++i)
+        if (!is_num_lit_(ch.terms[i])) { out[s] = ch.terms[i]; out_neg[s++] = ch.neg[i]; }
+
+    const int   ident  = is_float ? (kf == (ch.mul ? 1.0 : 0.0)) : (k == (ch.mul ? 1 : 0));
+    const int   head_k = out_neg[0];    // - x + 2 reads 2 - x
+    int         k_neg  = 0;
+    if (!head_k && !ch.mul) k_neg = is_float ? (kf < 0.0) : (k < 0 && k != INT64_MIN);
+
+    const int keep_k = head_k || !ident;
+    if (keep_k)
     {
-        ast_node_t* a = child_(n, 0);
-        if (is_num_lit_(a))
+        if (head_k)
         {
-            const double x = as_f64_(a);
+            memmove(out + 1, out, s * sizeof(out[0]));
+            memmove(out_neg + 1, out_neg, s * sizeof(out_neg[0]));
+            out[0] = lit; out_neg[0] = 0;
+            s++;
+        }
+        else { out[s] = lit; out_neg[s++] = k_neg; }
+    }
+
+    const int lit_same = is_float
+        ? (lit->u.num.lit_type == LIT_FLOAT && lit->u.num.lit.f64 == (k_neg ? -kf : kf))
+        : (lit->u.num.lit.i64 == (k_neg ? -k : k));
 
-            switch (n->u.builtin_unary.id)
+    int same = ch.left_deep && lit_same && s == ch.term_count;
+    for (size_t i = 0; i < s && same; ++i)
+        same = (out[i] == ch.terms[i] && out_neg[i] == ch.neg[i]);
+    if (same) return NULL;
+
+    if (is_float) make_num_float_(lit, k_neg ? -kf : kf);
+    else          make_num_int_(lit, k_neg ? -k : k);
+
+    // nodes left over become lone literals, a worklist may still hold them
+    for (size_t i = 0; i < ch.term_count; ++i)
+        if (is_num_lit_(ch.terms[i]) && (ch.terms[i] != lit || !keep_k)) make_num_int_(ch.terms[i], 0);
+    for (size_t i = (s > 1) ? s - 1 : 1; i < ch.op_count; ++i)
+        make_num_int_(ch.ops[i], 0);
+
+    if (s == 1) return out[0];
+
+    // left-deep, the root keeps its place and ops[j] joins the last j + 1 terms
+    ast_node_t* prefix = out[0];
+    for (size_t j = 1; j < s; ++j)
+    {
+        ast_node_t* op = ch.ops[s - 1 - j];
+        op->u.binary.op = ch.mul ? TOK_OP_MUL : (out_neg[j] ? TOK_OP_MINUS : TOK_OP_PLUS);
+        op->type        = type;
+        op->left        = prefix;
+        prefix->right   = out[j];
+        out[j]->right   = NULL;
+        prefix->parent  = op;
+        out[j]->parent  = op;
+        prefix = op;
+    }
+    return n;
+}
+
+static ast_node_t* rule_reassoc_(ast_node_t* n)
+{
+    return chain_reassoc_(n, AST_TYPE_INT);
+}
+
+static ast_node_t* rule_fast_reassoc_(ast_node_t* n)
+{
+    return chain_reassoc_(n, AST_TYPE_FLOAT);
+}
+
+// float x / 2^k => x * 2^-k, exact while 2^-k is a normal number
+static ast_node_t* rule_div_pow2_(ast_node_t* n)
+{
+    if (!is_binary_(n, TOK_OP_DIV) || n->type != AST_TYPE_FLOAT) return NULL;
+
+    ast_node_t* r = child_(n, 1);
+    if (!is_num_lit_(r)) return NULL;
+
+    int exp = 0;
+    const double c = as_f64_(r);
+    if (fabs(frexp(c, &exp)) != 0.5 || !isnormal(1.0 / c)) return NULL;
+
+    make_num_float_(r, 1.0 / c);
+    n->u.binary.op = TOK_OP_MUL;
+    return n;
+}
+
+// float x / c => x * (1 / c)
+static ast_node_t* rule_div_const_(ast_node_t* n)
+{
+    if (!is_binary_(n, TOK_OP_DIV) || n->type != AST_TYPE_FLOAT) return NULL;
+
+    ast_node_t* r = child_(n, 1);
+    if (!is_num_lit_(r)) return NULL;
+
+    const double c = as_f64_(r);
+    if (!isfinite(c) || !isnormal(1.0 / c)) return NULL;
+
+    make_num_float_(r, 1.0 / c);
+    n->u.binary.op = TOK_OP_MUL;
+    return n;
+}
+
+typedef ast_node_t* (*opt_rule_fn_t)(ast_node_t* n);
+
+// order matters: identities are tried before folding, as 2 + 0.0 => 2
+static const opt_rule_fn_t opt_rules[OPT_RULE_COUNT] = {
+#define OPT_RULE_FN(sym, str, fn, flags) fn,
+    OPT_RULE_LIST(OPT_RULE_FN)
+#undef OPT_RULE_FN
+};
+
+static const char* const opt_rule_names[OPT_RULE_COUNT] = {
+#define OPT_RULE_NAME(sym, str, fn, flags) str,
+    OPT_RULE_LIST(OPT_RULE_NAME)
+#undef OPT_RULE_NAME
+};
+
+static const unsigned opt_rule_flags[OPT_RULE_COUNT] = {
+#define OPT_RULE_FLAGS(sym, str, fn, flags) flags,
+    OPT_RULE_LIST(OPT_RULE_FLAGS)
+#undef OPT_RULE_FLAGS
+};
+
+static const char* const opt_pass_names[OPT_PASS_COUNT] = {
+#define OPT_PASS_NAME(sym, str, level, fn) str,
+    OPT_PASS_LIST(OPT_PASS_NAME)
+#undef OPT_PASS_NAME
+};
+
+static const int opt_pass_levels[OPT_PASS_COUNT] = {
+#define OPT_PASS_LEVEL(sym, str, level, fn) level,
+    OPT_PASS_LIST(OPT_PASS_LEVEL)
+#undef OPT_PASS_LEVEL
+};
+
+static const int opt_pass_per_fn[OPT_PASS_COUNT] = {
+#define OPT_PASS_PER_FN(sym, str, level, fn) fn,
+    OPT_PASS_LIST(OPT_PASS_PER_FN)
+#undef OPT_PASS_PER_FN
+};
+
+typedef struct
+{
+    ast_node_t** items;
+    size_t       head;
+    size_t       tail;
+    size_t       cap;
+} opt_worklist_t;
+
+static err_t worklist_push_(opt_worklist_t* wl, ast_node_t* n)
+{
+    if (!n || (n->flags & AST_FLAG_QUEUED)) return OK;
+
+    if (wl->tail == wl->cap)
+    {
+        // reuse the consumed prefix before growing
+        if (wl->head > 0)
+        {
+            memmove(wl->items, wl->items + wl->head, (wl->tail - wl->head) * sizeof(*wl->items));
+            wl->tail -= wl->head;
+            wl->head  = 0;
+        }
+
+        if (wl->tail == wl->cap)
+        {
+            size_t nc = wl->cap ? wl->cap * 2 : 256;
+            ast_node_t** ni = (ast_node_t**)mem_realloc(MEM_TAG_OPT, wl->items, nc * sizeof(*ni));
+            if (!ni) return ERR_ALLOC;
+            wl->items = ni;
+            wl->cap   = nc;
+        }
+    }
+
+    n->flags |= AST_FLAG_QUEUED;
+    wl->items[wl->tail++] = n;
+    return OK;
+}
+
+static ast_node_t* worklist_pop_(opt_worklist_t* wl)
+{
+    if (wl->head == wl->tail) return NULL;
+
+    ast_node_t* n = wl->items[wl->head++];
+    n->flags &= ~AST_FLAG_QUEUED;
+    return n;
+}
+
+// postorder, so children are visited before their parents; also repairs parent links
+static err_t worklist_seed_(opt_worklist_t* wl, ast_node_t* root)
+{
+    size_t cap = 64, top = 0;
+    struct { ast_node_t* node; int expanded; }* stack = mem_calloc(MEM_TAG_OPT, cap, sizeof(*stack));
+    if (!stack) return ERR_ALLOC;
+
+    err_t rc = OK;
+
+    for (ast_node_t* r = root; r; r = r->right)
+    {
+        r->parent = NULL;
+        stack[top].node = r;
+        stack[top].expanded = 0;
+        top++;
+
+        while (top > 0 && rc == OK)
+        {
+            if (stack[top - 1].expanded)
             {
-                case AST_BUILTIN_FLOOR: make_num_float_(n, floor(x)); *changed = 1; return n;
-                case AST_BUILTIN_CEIL:  make_num_float_(n, ceil(x));  *changed = 1; return n;
-                case AST_BUILTIN_ROUND: make_num_float_(n, round(x)); *changed = 1; return n;
-
-                case AST_BUILTIN_ITOF:
-                    make_num_float_(n, (double)as_i64_(a));
-                    *changed = 1;
-                    return n;
-
-                case AST_BUILTIN_FTOI:
-                    make_num_int_(n, (i64_t)as_f64_(a));
-                    *changed = 1;
-                    return n;
-
-                default:
-                    return n;
+                rc = worklist_push_(wl, stack[--top].node);
+                continue;
             }
+
+            ast_node_t* n = stack[top - 1].node;
+            stack[top - 1].expanded = 1;
+
+            size_t kids = 0;
+            for (ast_node_t* c = n->left; c; c = c->right) kids++;
+
+            if (top + kids > cap)
+            {
+                size_t nc = cap;
+                while (top + kids > nc) nc *= 2;
+                void* ns = mem_realloc(MEM_TAG_OPT, stack, nc * sizeof(*stack));
+                if (!ns) { rc = ERR_ALLOC; break; }
+                stack = ns;
+                cap   = nc;
+            }
+
+            // push reversed so the first child is visited first
+            size_t at = top + kids;
+            for (ast_node_t* c = n->left; c; c = c->right)
+            {
+                c->parent = n;
+                --at;
+                stack[at].node     = c;
+                stack[at].expanded = 0;
+            }
+            top += kids;
         }
 
-        return n;
+        if (rc != OK) break;
     }
 
-    if (n->kind == ASTK_BINARY)
+    mem_free(stack);
+    return rc;
+}
+
+void opt_config_default(opt_config_t* cfg)
+{
+    if (!cfg) return;
+    memset(cfg, 0, sizeof(*cfg));
+    opt_config_level(cfg, OPT_LEVEL_MAX);
+
+    cfg->jobs          = 0;
+    cfg->inline_budget = 40;
+    cfg->hot_budget    = 160;
+    cfg->unroll_budget = 64;
+    cfg->eval_steps    = 1000000;
+    cfg->eval_mem      = 4096;
+    cfg->memo_entries  = 1024;
+}
+
+err_t opt_config_level(opt_config_t* cfg, int level)
+{
+    if (!cfg || level < 0 || level > OPT_LEVEL_MAX) return ERR_BAD_ARG;
+
+    for (size_t i = 0; i < OPT_PASS_COUNT; ++i)
+        cfg->passes[i] = (opt_pass_levels[i] <= level);
+    return OK;
+}
+
+err_t opt_config_passes(opt_config_t* cfg, const char* list)
+{
+    if (!cfg || !list) return ERR_BAD_ARG;
+
+    int passes[OPT_PASS_COUNT] = { 0 };
+
+    for (const char* p = list; *p; )
     {
-        ast_node_t* l = child_(n, 0);
-        ast_node_t* r = child_(n, 1);
+        const char* end = strchr(p, ',');
+        const size_t len = end ? (size_t)(end - p) : strlen(p);
 
-        if (!l || !r) return n;
+        size_t i = 0;
+        while (i < OPT_PASS_COUNT &&
+               !(strlen(opt_pass_names[i]) == len && strncmp(opt_pass_names[i], p, len) == 0))
+            ++i;
 
-        switch (n->u.binary.op)
+        if (i == OPT_PASS_COUNT)
         {
-            case TOK_OP_PLUS:
-                // x + 0 => x
-                if (is_zero_(r))
-                {
-                    *changed = 1;
-                    return replace_with_(n, l);
-                }
-                // 0 + x => x
-                if (is_zero_(l))
-                {
-                    *changed = 1;
-                    return replace_with_(n, r);
-                }
-                break;
-
-            case TOK_OP_MUL:
-            {
-                // x * 0 / 0 * x => 0
-                if (is_zero_(l) || is_zero_(r))
-                {
-                    const int any_float = (is_num_lit_(l) && l->u.num.lit_type == LIT_FLOAT) ||
-                                          (is_num_lit_(r) && r->u.num.lit_type == LIT_FLOAT);
-                    if (any_float) make_num_float_(n, 0.0);
-                    else           make_num_int_(n,   0);
-                    *changed = 1;
-                    return n;
-                }
-
-                // x * 1 => x
-                if (is_one_(r))
-                {
-                    *changed = 1;
-                    return replace_with_(n, l);
-                }
-
-                // 1 * x => x
-                if (is_one_(l))
-                {
-                    *changed = 1;
-                    return replace_with_(n, r);
-                }
-                break;
-            }
+            LOG_ERROR("Unknown pass '%.*s'", (int)len, p);
+            return ERR_BAD_ARG;
+        }
+        passes[i] = 1;
+
+        p += len;
+        if (*p == ',') ++p;
+    }
+
+    memcpy(cfg->passes, passes, sizeof(passes));
+    return OK;
+}
+
+err_t opt_fresh_name(ast_tree_t* tree, const char* base, const char* tag, size_t* counter, size_t* out_name_id)
+{
+    if (!tree || !base || !tag || !counter || !out_name_id) return ERR_BAD_ARG;
 
-            case TOK_OP_POW:
-                // x ^ 0 => 1
-                if (is_zero_(r))
-                {
-                    // if exponent was float literal 0.0 or base is float literal, choose float 1.0
-                    const int want_float = (is_num_lit_(l) && l->u.num.lit_type == LIT_FLOAT) ||
-                                           (is_num_lit_(r) && r->u.num.lit_type == LIT_FLOAT);
-                    if (want_float) make_num_float_(n, 1.0);
-                    else            make_num_int_(n,   1);
-                    *changed = 1;
-                    return n;
-                }
-
-                // x ^ 1 => x
-                if (is_one_(r))
-                {
-                    *changed = 1;
-                    return replace_with_(n, l);
-                }
-
-                // 1 ^ x => 1
-                if (is_one_(l))
-                {
-                    const int want_float = (is_num_lit_(l) && l->u.num.lit_type == LIT_FLOAT) ||
-                                           (is_num_lit_(r) && r->u.num.lit_type == LIT_FLOAT);
-                    if (want_float) make_num_float_(n, 1.0);
-                    else            make_num_int_(n,   1);
-                    *changed = 1;
-                    return n;
-                }
-                break;
-
-            default:
-                break;
+    char buf[128] = "";
+    for (;;)
+    {
+        snprintf(buf, sizeof(buf), "%s_%s%zu", base, tag, (*counter)++);
+
+        // a name already in the table may be in use somewhere, so only a fresh entry will do
+        int added = 0;
+        const size_t id = ast_name_insert(tree, buf, strlen(buf), &added);
+        if (id == SIZE_MAX) return ERR_ALLOC;
+        if (!added) continue;
+
+        *out_name_id = id;
+        return OK;
+    }
+}
+
+int opt_is_bool_op(token_kind_t op)
+{
+    return op == TOK_OP_EQ  || op == TOK_OP_NEQ ||
+           op == TOK_OP_LT  || op == TOK_OP_GT  ||
+           op == TOK_OP_LTE || op == TOK_OP_GTE ||
+           op == TOK_OP_AND || op == TOK_OP_OR;
+}
+
+const char* opt_rule_name(opt_rule_t rule)
+{
+    return (rule < OPT_RULE_COUNT) ? opt_rule_names[rule] : "?";
+}
+
+const char* opt_pass_name(opt_pass_t pass)
+{
+    return (pass < OPT_PASS_COUNT) ? opt_pass_names[pass] : "?";
+}
+
+ast_node_t* opt_fold_once(ast_node_t* n)
+{
+    if (!n) return NULL;
+
+    for (size_t i = 0; i < OPT_RULE_COUNT; ++i)
+    {
+        if (opt_rule_flags[i]) continue;
+
+        ast_node_t* repl = opt_rules[i](n);
+        if (repl) return repl;
+    }
+    return NULL;
+}
+
+// every node is visited once, afterwards only parents of rewritten nodes
+static err_t opt_fold_tree_(ast_tree_t* tree, const opt_config_t* cfg, opt_report_t* report)
+{
+    opt_worklist_t wl = { 0 };
+    err_t rc = worklist_seed_(&wl, tree->root);
+
+    ast_node_t* n = NULL;
+    while (rc == OK && (n = worklist_pop_(&wl)) != NULL)
+    {
+        if (cfg->max_iterations && report->iterations >= cfg->max_iterations)
+        {
+            report->hit_cap = 1;
+            break;
         }
+        report->iterations++;
 
-        // constant folding       
-        if (is_num_lit_(l) && is_num_lit_(r))
+        for (size_t i = 0; i < OPT_RULE_COUNT; ++i)
         {
-            const int any_float =
-                (l->u.num.lit_type == LIT_FLOAT) ||
-                (r->u.num.lit_type == LIT_FLOAT);
+            if ((opt_rule_flags[i] & OPT_RULE_FAST) && !cfg->fast_math) continue;
 
-            switch (n->u.binary.op)
-            {
-                case TOK_OP_OR:   OPT_BIN_TO_INT_((truthy_(l) || truthy_(r)) ? 1 : 0);
-                case TOK_OP_AND:  OPT_BIN_TO_INT_((truthy_(l) && truthy_(r)) ? 1 : 0);
+            ast_node_t* repl = opt_rules[i](n);
+            if (!repl) continue;
 
-                case TOK_OP_EQ:   OPT_BIN_TO_INT_((as_f64_(l) == as_f64_(r)) ? 1 : 0);
-                case TOK_OP_NEQ:  OPT_BIN_TO_INT_((as_f64_(l) != as_f64_(r)) ? 1 : 0);
-                case TOK_OP_GT:   OPT_BIN_TO_INT_((as_f64_(l) >  as_f64_(r)) ? 1 : 0);
-                case TOK_OP_LT:   OPT_BIN_TO_INT_((as_f64_(l) <  as_f64_(r)) ? 1 : 0);
-                case TOK_OP_GTE:  OPT_BIN_TO_INT_((as_f64_(l) >= as_f64_(r)) ? 1 : 0);
-                case TOK_OP_LTE:  OPT_BIN_TO_INT_((as_f64_(l) <= as_f64_(r)) ? 1 : 0);
+            report->rule_hits[i]++;
+            report->rewrites++;
 
-                case TOK_OP_PLUS:  OPT_BIN_ARITH_(as_f64_(l) + as_f64_(r), as_i64_(l) + as_i64_(r));
-                case TOK_OP_MINUS: OPT_BIN_ARITH_(as_f64_(l) - as_f64_(r), as_i64_(l) - as_i64_(r));
-                case TOK_OP_MUL:   OPT_BIN_ARITH_(as_f64_(l) * as_f64_(r), as_i64_(l) * as_i64_(r));
+            ast_replace(n, repl);
 
-                case TOK_OP_DIV:   OPT_BIN_DIV_();
-                case TOK_OP_POW:   OPT_BIN_POW_();
+            // rewritten node may match again, its parent may match now
+            rc = worklist_push_(&wl, repl);
+            if (rc == OK) rc = worklist_push_(&wl, repl->parent);
+            break;
+        }
+    }
 
-                default:
-                    return n;
-            }
+    // drop marks of nodes left on the list when stopped early
+    while ((n = worklist_pop_(&wl)) != NULL) {}
+    mem_free(wl.items);
+
+    return rc;
+}
+
+// one step of the pipeline; rewrites is what the pass counts as a change
+static err_t opt_run_pass_(ast_tree_t* tree, const opt_config_t* cfg, opt_report_t* report,
+                           opt_pass_t pass, size_t* rewrites)
+{
+    err_t  rc = OK;
+    size_t n  = 0;
+
+    switch (pass)
+    {
+        case OPT_PASS_REORDER:
+            rc = opt_reorder(tree, &n);
+            report->reordered += n;
+            break;
+
+        case OPT_PASS_TAILCALL:
+            rc = opt_tailcall(tree, &n);
+            report->tail_calls += n;
+            break;
+
+        case OPT_PASS_INLINE:
+            rc = opt_inline(tree, cfg->inline_budget, cfg->hot_budget, &n);
+            report->inlined += n;
+            break;
+
+        case OPT_PASS_FOLD:
+        {
+            const size_t before = report->rewrites;
+            rc = opt_fold_tree_(tree, cfg, report);
+            n  = report->rewrites - before;
+            break;
+        }
+
+        case OPT_PASS_CONSTPROP:
+            rc = opt_constprop(tree, &n);
+            report->const_reads += n;
+            break;
+
+        case OPT_PASS_UNROLL:
+            rc = opt_unroll(tree, cfg->unroll_budget, &n);
+            report->unrolled += n;
+            break;
+
+        case OPT_PASS_EVAL:
+            rc = opt_ceval(tree, cfg->eval_steps, cfg->eval_mem, &n);
+            report->evaluated += n;
+            break;
+
+        case OPT_PASS_RANGE:
+        {
+            size_t retyped = 0;
+            rc = opt_range(tree, &retyped, &n);
+            report->range_retyped += retyped;
+            report->range_removed += n;
+            n += retyped;
+            break;
         }
-        return n;
+
+        case OPT_PASS_DCE:
+            rc = opt_dce(tree, &n);
+            report->dce_removed += n;
+            break;
+
+        case OPT_PASS_LICM:
+            rc = opt_licm(tree, &n);
+            report->licm_hoisted += n;
+            break;
+
+        case OPT_PASS_CSE:
+        {
+            size_t temps = 0;
+            rc = opt_cse(tree, &temps, &n);
+            report->cse_temps      += temps;
+            report->cse_eliminated += n;
+            break;
+        }
+
+        case OPT_PASS_MEMO:
+            rc = opt_memo(tree, cfg->memo_entries, &n);
+            report->memoized += n;
+            break;
+
+        case OPT_PASS_COUNT:
+        default:
+            return ERR_BAD_ARG;
     }
 
-    return n;
+    *rewrites = n;
+    return rc;
+}
+
+typedef struct
+{
+    opt_pass_t pass;
+    int        after_change;    // only when the step before changed something
+} opt_step_t;
+
+static const opt_step_t opt_pipeline[] = {
+    // profile counts sit on the arms as written, before anything moves them
+    { OPT_PASS_REORDER,   0 },
+    // first, so the loops left behind go through the passes below
+    { OPT_PASS_TAILCALL,  0 },
+    // inlined bodies see the caller's constants in the passes below
+    { OPT_PASS_INLINE,    0 },
+    { OPT_PASS_FOLD,      0 },
+    // folded expressions make more variables constant and the other way
+    // round; propagation sees through folding, so one more round is enough
+    { OPT_PASS_CONSTPROP, 0 },
+    { OPT_PASS_FOLD,      1 },
+    // bounds are literals by now; copies read the counter as one
+    { OPT_PASS_UNROLL,    0 },
+    { OPT_PASS_FOLD,      1 },
+    // calls with literal args exist only now
+    { OPT_PASS_EVAL,      0 },
+    // conditions it settles leave dead arms behind for dce
+    { OPT_PASS_RANGE,     0 },
+    { OPT_PASS_DCE,       0 },
+    { OPT_PASS_LICM,      0 },
+    // last, its temps would stop the others
+    { OPT_PASS_CSE,       0 },
+    // marks only, after everything that may still remove a recursive call
+    { OPT_PASS_MEMO,      0 },
+};
+
+static int opt_step_enabled_(const opt_config_t* cfg, opt_pass_t pass)
+{
+    if (!cfg->passes[pass]) return 0;
+    if (pass == OPT_PASS_INLINE) return cfg->inline_budget != 0;
+    if (pass == OPT_PASS_UNROLL) return cfg->unroll_budget != 0;
+    if (pass == OPT_PASS_EVAL)   return cfg->eval_steps    != 0;
+    if (pass == OPT_PASS_MEMO)   return cfg->memo_entries  != 0;
+    return 1;
+}
+
+// one pipeline step; *last is what the step before rewrote and becomes what this one did
+static err_t opt_step_(ast_tree_t* tree, const opt_config_t* cfg, opt_report_t* report,
+                       const opt_step_t* step, size_t* last)
+{
+    if (!opt_step_enabled_(cfg, step->pass) || (step->after_change && *last == 0))
+    {
+        *last = 0;
+        return OK;
+    }
+
+    opt_pass_stats_t* ps = &report->passes[step->pass];
+
+    double start = 0.0;
+    size_t size  = 0;
+    if (cfg->time_passes)
+    {
+        size  = ast_subtree_size(tree->root);
+        start = stats_wall_now();
+    }
+
+    const size_t iterations = report->iterations;
+
+    err_t rc = opt_run_pass_(tree, cfg, report, step->pass, last);
+
+    ps->runs++;
+    ps->rewrites += *last;
+    ps->visits   += (step->pass == OPT_PASS_FOLD) ? report->iterations - iterations : size;
+
+    if (cfg->time_passes)
+    {
+        ps->wall_sec    += stats_wall_now() - start;
+        ps->nodes        = ast_subtree_size(tree->root);
+        ps->nodes_delta += (ptrdiff_t)ps->nodes - (ptrdiff_t)size;
+    }
+    return rc;
 }
 
-static ast_node_t* optimize_chain_(ast_node_t* head, ast_node_t* parent, int* changed)
+typedef struct
 {
-    if (!head) return NULL;
-    ast_node_t* cur = optimize_one_(head, parent, changed);
+    ast_node_t*  fn;        // child of the program, detached while the task runs
+    ast_node_t   program;   // root of the view
+    ast_tree_t   view;
+    opt_report_t report;    // kept over the whole pipeline, summed at the end
+    size_t       last;
+    err_t        rc;
+} opt_task_t;
 
-    if (cur)
-        cur->right = optimize_chain_(cur->right, parent, changed);
+typedef struct
+{
+    ast_tree_t*         tree;
+    const opt_config_t* cfg;
+    pool_t              pool;
+    int                 pool_up;
 
-    return cur;
+    opt_task_t*         tasks;
+    size_t              task_count;
+    size_t              task_cap;
+
+    size_t              first;  // steps [first, end) of the current job
+    size_t              end;
+} opt_par_t;
+
+static void opt_task_run_(void* ctx, size_t index)
+{
+    opt_par_t*  par = (opt_par_t*)ctx;
+    opt_task_t* t   = &par->tasks[index];
+    if (t->fn->kind != ASTK_FUNC) return;
+
+    for (size_t i = par->first; i < par->end && t->rc == OK && !t->report.hit_cap; ++i)
+        t->rc = opt_step_(&t->view, par->cfg, &t->report, &opt_pipeline[i], &t->last);
+}
+
+static void opt_report_add_(opt_report_t* dst, const opt_report_t* src)
+{
+    for (size_t i = 0; i < OPT_RULE_COUNT; ++i) dst->rule_hits[i] += src->rule_hits[i];
+
+    dst->rewrites       += src->rewrites;
+    dst->reordered      += src->reordered;
+    dst->tail_calls     += src->tail_calls;
+    dst->inlined        += src->inlined;
+    dst->iterations     += src->iterations;
+    dst->const_reads    += src->const_reads;
+    dst->unrolled       += src->unrolled;
+    dst->evaluated      += src->evaluated;
+    dst->range_retyped  += src->range_retyped;
+    dst->range_removed  += src->range_removed;
+    dst->dce_removed    += src->dce_removed;
+    dst->licm_hoisted   += src->licm_hoisted;
+    dst->cse_temps      += src->cse_temps;
+    dst->cse_eliminated += src->cse_eliminated;
+    dst->memoized       += src->memoized;
+    dst->hit_cap        |= src->hit_cap;
+
+    for (size_t i = 0; i < OPT_PASS_COUNT; ++i)
+    {
+        opt_pass_stats_t*       d = &dst->passes[i];
+        const opt_pass_stats_t* p = &src->passes[i];
+        if (p->runs == 0) continue;
+
+        // runs of the pipeline, not of each function; sizes without the view root
+        if (p->runs > d->runs) d->runs = p->runs;
+        d->visits      += p->visits;
+        d->rewrites    += p->rewrites;
+        d->nodes       += p->nodes ? p->nodes - 1 : 0;
+        d->nodes_delta += p->nodes_delta;
+        d->wall_sec    += p->wall_sec;
+    }
+}
+
+// Steps [first, end) on every function of the program, each on a view of
+// its own. Views are merged back in program order
+static err_t opt_par_steps_(opt_par_t* par, size_t first, size_t end, size_t* last)
+{
+    ast_node_t* program = par->tree->root;
+
+    const size_t count = ast_children_count(program);
+    if (count > par->task_cap)
+    {
+        opt_task_t* p = (opt_task_t*)mem_realloc(MEM_TAG_OPT, par->tasks, count * sizeof(opt_task_t));
+        if (!p) return ERR_ALLOC;
+
+        memset(p + par->task_cap, 0, (count - par->task_cap) * sizeof(opt_task_t));
+        par->tasks    = p;
+        par->task_cap = count;
+    }
+    par->task_count = count;
+
+    if (!par->pool_up && count > 1 && par->cfg->jobs != 1)
+    {
+        err_t rc = pool_ctor(&par->pool, par->cfg->jobs);
+        if (rc != OK) return rc;
+        par->pool_up = 1;
+    }
+
+    err_t  rc = OK;
+    size_t i  = 0;
+    for (ast_node_t* fn = program->left; fn; ++i)
+    {
+        opt_task_t* t = &par->tasks[i];
+        ast_node_t* next = fn->right;
+
+        memset(&t->program, 0, sizeof(t->program));
+        t->program.kind = ASTK_PROGRAM;
+        t->program.left = fn;
+
+        t->fn       = fn;
+        t->last     = *last;
+        fn->parent  = &t->program;
+        fn->right   = NULL;
+
+        err_t vrc = ast_tree_view(&t->view, par->tree);
+        t->view.root = &t->program;
+        if (rc == OK) rc = vrc;
+
+        fn = next;
+    }
+    program->left = NULL;
+
+    par->first = first;
+    par->end   = end;
+    if (rc == OK)
+    {
+        if (par->pool_up) pool_run(&par->pool, count, opt_task_run_, par);
+        else              for (i = 0; i < count; ++i) opt_task_run_(par, i);
+    }
+
+    // back in place, in order; a task may have put another node where its function was
+    ast_node_t** link = &program->left;
+    *last = 0;
+    for (i = 0; i < count; ++i)
+    {
+        opt_task_t* t  = &par->tasks[i];
+        ast_node_t* fn = t->program.left;
+
+        *link      = fn;
+        fn->parent = program;
+        link       = &fn->right;
+
+        err_t mrc = ast_tree_merge(par->tree, &t->view, fn);
+        if (rc == OK) rc = (t->rc != OK) ? t->rc : mrc;
+
+        *last += t->last;
+    }
+    return rc;
+}
+
+err_t ast_optimize_ex(ast_tree_t* tree, const opt_config_t* cfg, opt_report_t* report)
+{
+    if (!tree) return ERR_BAD_ARG;
+
+    opt_config_t def = { 0 };
+    if (!cfg)
+    {
+        opt_config_default(&def);
+        cfg = &def;
+    }
+
+    opt_report_t local = { 0 };
+    if (!report) report = &local;
+    memset(report, 0, sizeof(*report));
+
+    opt_par_t par = { .tree = tree, .cfg = cfg };
+    const int split = tree->root && tree->root->kind == ASTK_PROGRAM;
+
+    const size_t steps = sizeof(opt_pipeline) / sizeof(opt_pipeline[0]);
+    err_t  rc   = OK;
+    size_t last = 0;    // rewrites of the step before
+
+    for (size_t i = 0; i < steps && rc == OK; )
+    {
+        if (!split || !opt_pass_per_fn[opt_pipeline[i].pass])
+        {
+            rc = opt_step_(tree, cfg, report, &opt_pipeline[i], &last);
+            ++i;
+        }
+        else
+        {
+            size_t end = i + 1;
+            while (end < steps && opt_pass_per_fn[opt_pipeline[end].pass]) ++end;
+
+            rc = opt_par_steps_(&par, i, end, &last);
+            i  = end;
+
+            for (size_t k = 0; k < par.task_count; ++k) report->hit_cap |= par.tasks[k].report.hit_cap;
+        }
+
+        if (report->hit_cap) break;
+    }
+
+    // task sizes leave out the program node
+    for (size_t k = 0; k < par.task_cap; ++k) opt_report_add_(report, &par.tasks[k].report);
+    for (size_t k = 0; k < OPT_PASS_COUNT && split; ++k)
+        if (opt_pass_per_fn[k] && report->passes[k].nodes) report->passes[k].nodes++;
+
+    if (par.pool_up) pool_dtor(&par.pool);
+    mem_free(par.tasks);
+
+    for (size_t k = 0; k < OPT_PASS_COUNT; ++k)
+        if (report->passes[k].runs)
+            LOG_DEBUG("Pass %s: %zu rewrites", opt_pass_names[k], report->passes[k].rewrites);
+    LOG_DEBUG("Optimizer: %zu visits, %zu rewrites%s", report->iterations, report->rewrites,
+              report->hit_cap ? " (iteration cap reached)" : "");
+
+    // rewrites below an expression leave its type stale
+    if (rc == OK) rc = ast_annotate_types(tree, 0);
+    return rc;
 }
 
 err_t ast_optimize(ast_tree_t* tree, int* out_changed)
 {
     if (!tree || !out_changed) return ERR_BAD_ARG;
 
-    int changed = 0;
-    tree->root = optimize_chain_(tree->root, NULL, &changed);
-    if (tree->root) tree->root->parent = NULL;
+    opt_report_t report = { 0 };
+    err_t rc = ast_optimize_ex(tree, NULL, &report);
 
-    *out_changed = changed;
-    return OK;
+    *out_changed = (report.rewrites > 0);
+    return rc;
+}
+
+void opt_report_print(FILE* out, const opt_report_t* report)
+{
+    if (!out || !report) return;
+
+    fprintf(out, "%-16s %12s\n", "rule", "rewrites");
+    for (size_t i = 0; i < OPT_RULE_COUNT; ++i)
+    {
+        if (report->rule_hits[i] == 0) continue;
+        fprintf(out, "%-16s %12zu\n", opt_rule_names[i], report->rule_hits[i]);
+    }
+    fprintf(out, "%-16s %12zu\n", "total", report->rewrites);
+    fprintf(out, "%-16s %12zu\n", "reordered", report->reordered);
+    fprintf(out, "%-16s %12zu\n", "tail-calls", report->tail_calls);
+    fprintf(out, "%-16s %12zu\n", "inlined", report->inlined);
+    fprintf(out, "%-16s %12zu\n", "const-reads", report->const_reads);
+    fprintf(out, "%-16s %12zu\n", "unrolled", report->unrolled);
+    fprintf(out, "%-16s %12zu\n", "evaluated", report->evaluated);
+    fprintf(out, "%-16s %12zu\n", "range-retyped", report->range_retyped);
+    fprintf(out, "%-16s %12zu\n", "range-removed", report->range_removed);
+    fprintf(out, "%-16s %12zu\n", "dce-removed", report->dce_removed);
+    fprintf(out, "%-16s %12zu\n", "licm-hoisted", report->licm_hoisted);
+    fprintf(out, "%-16s %12zu\n", "cse-temps", report->cse_temps);
+    fprintf(out, "%-16s %12zu\n", "cse-eliminated", report->cse_eliminated);
+    fprintf(out, "%-16s %12zu\n", "memoized", report->memoized);
+    fprintf(out, "%-16s %12zu%s\n", "visits", report->iterations,
+            report->hit_cap ? " (cap reached)" : "");
+}
+
+void opt_report_print_passes(FILE* out, const opt_report_t* report)
+{
+    if (!out || !report) return;
+
+    double total = 0.0;
+    for (size_t i = 0; i < OPT_PASS_COUNT; ++i) total += report->passes[i].wall_sec;
+
+    fprintf(out, "%-12s %5s %10s %6s %12s %12s %12s %12s\n",
+            "pass", "runs", "wall ms", "%", "visits", "rewrites", "nodes", "delta");
+
+    for (size_t i = 0; i < OPT_PASS_COUNT; ++i)
+    {
+        const opt_pass_stats_t* ps = &report->passes[i];
+        if (ps->runs == 0) continue;
+
+        fprintf(out, "%-12s %5zu %10.3f %5.1f%% %12zu %12zu %12zu %+12td\n",
+                opt_pass_names[i], ps->runs, ps->wall_sec * 1e3,
+                (total > 0.0) ? 100.0 * ps->wall_sec / total : 0.0,
+                ps->visits, ps->rewrites, ps->nodes, ps->nodes_delta);
+    }
+    fprintf(out, "%-12s %5s %10.3f %5.1f%%\n", "total", "", total * 1e3, 100.0);
 }
@@ -1,8 +1,247 @@
 #ifndef MIDDLEEND_H
 #define MIDDLEEND_H
 
+#include <stdio.h>
+
 #include "../ast/ast.h"
 
-err_t ast_optimize(ast_tree_t* tree, int* out_changed);
+/*
+    Fold rules in the order they are tried. tree rules rewrite below n and
+    only run in the fold pass, never through opt_fold_once. fast rules may
+    round floats differently and only run with fast_math
+*/
+#define OPT_RULE_TREE 1u
+#define OPT_RULE_FAST 2u
+
+#define OPT_RULE_LIST(X)                                                                        \
+    X(OPT_RULE_FOLD_UNARY,   "fold-unary",   rule_fold_unary_,   0)                             \
+    X(OPT_RULE_FOLD_BUILTIN, "fold-builtin", rule_fold_builtin_, 0)                             \
+    X(OPT_RULE_ADD_ZERO,     "add-zero",     rule_add_zero_,     0)                             \
+    X(OPT_RULE_MUL_ZERO,     "mul-zero",     rule_mul_zero_,     0)                             \
+    X(OPT_RULE_MUL_ONE,      "mul-one",      rule_mul_one_,      0)                             \
+    X(OPT_RULE_POW_ZERO,     "pow-zero",     rule_pow_zero_,     0)                             \
+    X(OPT_RULE_POW_ONE,      "pow-one",      rule_pow_one_,      0)                             \
+    X(OPT_RULE_ONE_POW,      "one-pow",      rule_one_pow_,      0)                             \
+    X(OPT_RULE_FOLD_BINARY,  "fold-binary",  rule_fold_binary_,  0)                             \
+    X(OPT_RULE_REASSOC,      "reassoc",      rule_reassoc_,      OPT_RULE_TREE)                 \
+    X(OPT_RULE_FAST_REASSOC, "fast-reassoc", rule_fast_reassoc_, OPT_RULE_TREE | OPT_RULE_FAST) \
+    X(OPT_RULE_DIV_POW2,     "div-pow2",     rule_div_pow2_,     0)                             \
+    X(OPT_RULE_DIV_CONST,    "div-const",    rule_div_const_,    OPT_RULE_FAST)
+
+typedef enum
+{
+#define OPT_RULE_ENUM(sym, str, fn, flags) sym,
+    OPT_RULE_LIST(OPT_RULE_ENUM)
+#undef OPT_RULE_ENUM
+
+    OPT_RULE_COUNT
+} opt_rule_t;
+
+/*
+    Passes in pipeline order with the lowest -O level that turns them on.
+    fold runs again right after constprop and unroll when they changed
+    something. memo is above every level, only --passes or --memo take it.
+    Passes marked fn look at one function at a time: consecutive ones run
+    on each function as a task of its own, in parallel
+*/
+#define OPT_PASS_LIST(X)                          \
+    X(OPT_PASS_REORDER,   "reorder",   1, 1)      \
+    X(OPT_PASS_TAILCALL,  "tailcall",  1, 1)      \
+    X(OPT_PASS_INLINE,    "inline",    2, 0)      \
+    X(OPT_PASS_FOLD,      "fold",      1, 1)      \
+    X(OPT_PASS_CONSTPROP, "constprop", 1, 1)      \
+    X(OPT_PASS_UNROLL,    "unroll",    2, 1)      \
+    X(OPT_PASS_EVAL,      "eval",      2, 0)      \
+    X(OPT_PASS_RANGE,     "range",     2, 0)      \
+    X(OPT_PASS_DCE,       "dce",       1, 1)      \
+    X(OPT_PASS_LICM,      "licm",      2, 1)      \
+    X(OPT_PASS_CSE,       "cse",       2, 1)      \
+    X(OPT_PASS_MEMO,      "memo",      3, 0)
+
+typedef enum
+{
+#define OPT_PASS_ENUM(sym, str, level, fn) sym,
+    OPT_PASS_LIST(OPT_PASS_ENUM)
+#undef OPT_PASS_ENUM
+
+    OPT_PASS_COUNT
+} opt_pass_t;
+
+#define OPT_LEVEL_MAX 2
+
+typedef struct
+{
+    int    passes[OPT_PASS_COUNT];  // enabled passes
+    int    time_passes;     // clock passes and count the nodes they see
+    int    fast_math;       // float chains reassociate, x / c becomes x * (1 / c)
+    size_t jobs;            // threads for per-function passes, 0 = one per core
+    size_t max_iterations;  // worklist visits per function before giving up, 0 = until fixed point
+    size_t inline_budget;   // max callee body size in nodes, 0 = no inlining
+    size_t hot_budget;      // the same for call sites the profile counts hot
+    size_t unroll_budget;   // max nodes of the copies replacing one loop, 0 = off
+    size_t eval_steps;      // interpreter steps for calls of pure functions, 0 = off
+    size_t eval_mem;        // cells one such call may use
+    size_t memo_entries;    // table cells per memoized function, 0 = off
+} opt_config_t;
+
+typedef struct
+{
+    size_t    runs;
+    size_t    visits;       // worklist visits for fold, tree size on entry for the rest
+    size_t    rewrites;     // what the pass counts as one change
+    size_t    nodes;        // tree size after the last run, only with time_passes
+    ptrdiff_t nodes_delta;  // summed over runs, only with time_passes
+    double    wall_sec;     // only with time_passes, summed over threads
+} opt_pass_stats_t;
+
+typedef struct
+{
+    size_t rule_hits[OPT_RULE_COUNT];
+    size_t rewrites;
+    size_t reordered;       // arm chains put in profile order
+    size_t tail_calls;      // self tail calls turned into loops
+    size_t inlined;         // call sites replaced by the callee body
+    size_t iterations;      // worklist visits
+    size_t const_reads;     // variable reads replaced by constants
+    size_t unrolled;        // counted loops unrolled, fully or by a factor
+    size_t evaluated;       // calls replaced by the value they return
+    size_t range_retyped;   // homie locals declared npc, they only hold whole numbers
+    size_t range_removed;   // conversions, roundings and conditions the ranges settle
+    size_t dce_removed;     // statements, arms and loops dropped as dead
+    size_t licm_hoisted;    // expressions moved in front of their loop
+    size_t cse_temps;       // locals introduced for repeated expressions
+    size_t cse_eliminated;  // expression nodes replaced by a read of a local
+    size_t memoized;        // functions marked for a memo table
+    int    hit_cap;         // stopped by max_iterations, not by fixed point
+
+    opt_pass_stats_t passes[OPT_PASS_COUNT];
+} opt_report_t;
+
+// -O2 with the default budgets
+void  opt_config_default(opt_config_t* cfg);
+
+// enable exactly the passes of -O<level>, 0..OPT_LEVEL_MAX
+err_t opt_config_level  (opt_config_t* cfg, int level);
+
+// enable exactly the passes of a comma separated list such as "fold,dce"
+err_t opt_config_passes (opt_config_t* cfg, const char* list);
+
+/*
+    Run the enabled passes in pipeline order, stopping early when fold hits
+    max_iterations. Per-function passes see a view of the tree: names they
+    add are numbered after all of them finish, in program order, so the
+    result does not depend on cfg->jobs. cfg NULL means defaults, report
+    may be NULL
+*/
+err_t ast_optimize_ex(ast_tree_t* tree, const opt_config_t* cfg, opt_report_t* report);
+err_t ast_optimize   (ast_tree_t* tree, int* out_changed);
+
+/*
+    Apply the first matching rule to n alone, children are not visited and
+    tree and fast rules are left out. Returns the node that stands in place
+    of n, NULL when nothing applies
+*/
+ast_node_t* opt_fold_once(ast_node_t* n);
+
+/*
+    Turn self calls in tail position outside of loops into param stores and
+    a jump back to the start of the body
+*/
+err_t opt_tailcall(ast_tree_t* tree, size_t* out_replaced);
+
+/*
+    Test the arms of an alpha/omega chain in the order of their profile counts
+    when every condition compares one int variable with a literal and no
+    two of them can hold at once. Chains without counts are left alone
+*/
+err_t opt_reorder(ast_tree_t* tree, size_t* out_reordered);
+
+/*
+    Substitute calls of non-recursive functions of at most budget body nodes
+    with a single micdrop at the end, hot_budget for sites the profile counts
+    among the hottest. Only calls evaluated first in a statement are taken,
+    so evaluation order is kept
+*/
+err_t opt_inline(ast_tree_t* tree, size_t budget, size_t hot_budget, size_t* out_inlined);
+
+/*
+    Replace reads of locals and params that hold the same constant on every
+    path reaching them. Conditions known at a branch keep its dead arms out
+    of the analysis
+*/
+err_t opt_constprop(ast_tree_t* tree, size_t* out_replaced);
+
+/*
+    Unroll loops of a known trip count: npc i gaslight c0 right before
+    lowkey (i op literal) whose body ends in i gaslight i + s. Fully when
+    the copies take at most budget nodes, else by a factor of 8, 4 or 2
+    with the remainder peeled in front
+*/
+err_t opt_unroll(ast_tree_t* tree, size_t budget, size_t* out_unrolled);
+
+/*
+    Run calls of pure functions with literal arguments at compile time and
+    put the result in their place. steps bounds the whole run, mem the
+    locals and frames of one call
+*/
+err_t opt_ceval(ast_tree_t* tree, size_t steps, size_t mem, size_t* out_evaluated);
+
+/*
+    Track the interval of every local and param through each function.
+    Conditions they settle become literals, literals at a conversion take
+    the other type, floor/ceil/round of whole numbers go, and homie locals
+    that only hold whole numbers are declared npc where that leaves fewer
+    ITOF/FTOI behind
+*/
+err_t opt_range(ast_tree_t* tree, size_t* out_retyped, size_t* out_removed);
+
+/*
+    Cut statements after micdrop/gg, arms and lowkey loops with a known int
+    condition, then locals that are never read with all their stores. Calls
+    in dropped values stay as expression statements
+*/
+err_t opt_dce(ast_tree_t* tree, size_t* out_removed);
+
+/*
+    Compute operator subtrees of a loop that read nothing the loop writes
+    and call nothing once, in new locals declared before the loop
+*/
+err_t opt_licm(ast_tree_t* tree, size_t* out_hoisted);
+
+/*
+    Number the values of each block; an expression computed before and
+    still held in a local is read from it, one computed often enough gets
+    a new local before its first use
+*/
+err_t opt_cse(ast_tree_t* tree, size_t* out_temps, size_t* out_eliminated);
+
+/*
+    Mark pure functions returning int from one or two int params that
+    recurse from two sites or from a loop for memoization, see
+    u.func.memo. entries bounds the table of each
+*/
+err_t opt_memo(ast_tree_t* tree, size_t entries, size_t* out_memoized);
+
+/*
+    Purity of each child of the program, in order: no output, no builtins,
+    no sus values, only pure callees. out_pure holds one int per child
+*/
+err_t opt_purity(ast_tree_t* tree, int* out_pure);
+
+/*
+    Put a new name <base>_<tag><n> into the name table, n counts up from
+    *counter until the name is not there yet
+*/
+err_t opt_fresh_name(ast_tree_t* tree, const char* base, const char* tag, size_t* counter, size_t* out_name_id);
+
+// compares, && and ||: int 0/1 whatever the operands
+int opt_is_bool_op(token_kind_t op);
+
+const char* opt_rule_name (opt_rule_t rule);
+const char* opt_pass_name (opt_pass_t pass);
+void        opt_report_print(FILE* out, const opt_report_t* report);
+
+// one line per pass run: time, share, visits, rewrites, size change
+void        opt_report_print_passes(FILE* out, const opt_report_t* report);
 
 #endif
@@ -0,0 +1,1587 @@
+#include "middleend.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Value ranges of locals and params. Every function is walked as in
+    constprop, with an interval per variable and whether it holds whole
+    numbers only. A compare narrows the variables it tests on the path it
+    guards, loop headers send bounds that keep growing to infinity and
+    take one step back down once stable. The converged walk then:
+
+        - decides int conditions the ranges settle, dce drops what they guard
+        - gives a literal the backend would convert the other type at once
+        - drops floor/ceil/round of whole values
+        - declares homie locals that only ever hold whole numbers within
+          2^53 as npc, when that leaves fewer conversions; one in a loop
+          counts eight times as much as one outside
+
+    Up to 2^53 int and float + - * give the same whole numbers, so a
+    retyped local changes the instructions, not the values
+*/
+
+#define RG_EXACT       9007199254740992.0  // 2^53
+#define RG_WIDEN_AFTER 0                   // header rounds before bounds that grow go to infinity
+#define RG_GREEDY_MAX  64                  // candidates tried one by one, beyond that all or none
+#define RG_DEPTH_MAX   6                   // loop levels the cost tells apart
+
+typedef struct
+{
+    f64_t lo;
+    f64_t hi;
+    int   whole;  // finite whole numbers only
+    int   wild;   // may be NaN or infinite, floats only
+} rg_value_t;
+
+typedef struct
+{
+    rg_value_t* vals;
+    size_t      cap;
+    int         live;         // 0 once control cannot reach this point
+} rg_env_t;
+
+typedef struct
+{
+    size_t     name_id;
+    ast_type_t type;
+    size_t     cand;          // index into cands for a homie local, SIZE_MAX otherwise
+} rg_bind_t;
+
+typedef struct
+{
+    rg_env_t    exit;         // join of environments at gg
+    size_t      binds;        // variables bound outside the loop
+} rg_loop_t;
+
+typedef struct
+{
+    ast_node_t* decl;
+    int         whole;        // every store on the converged walk is whole and within 2^53
+    int         seen;         // the converged walk reached the declaration
+    int         retype;       // in the set being tried
+    int         saved;
+} rg_cand_t;
+
+typedef struct
+{
+    const ast_node_t* node;
+    rg_value_t        val;
+} rg_note_t;
+
+typedef struct
+{
+    ast_node_t* cond;
+    int         truth;
+} rg_check_t;
+
+typedef enum
+{
+    RG_CALL_USER = 0,
+    RG_CALL_INT_ARGS,         // out, cout, set_pixel: float args go through FTOI
+    RG_CALL_FLOAT_ARG,        // fout: an int arg goes through ITOF
+    RG_CALL_OTHER,
+} rg_call_t;
+
+typedef struct
+{
+    ast_tree_t*        tree;
+    const ast_node_t** funcs;       // per name id: the function of that name
+    unsigned char*     calls;       // per name id: rg_call_t
+    size_t             names;
+
+    rg_bind_t*  binds;              // variable index == bind index, popped with the scope
+    size_t      bind_count;
+    size_t      bind_cap;
+
+    rg_loop_t*  loops;              // enclosing loops, innermost last
+    size_t      loop_count;
+    size_t      loop_cap;
+
+    rg_env_t*   spare;              // scratch environments of finished ifs and loops
+    size_t      spare_count;
+    size_t      spare_cap;
+
+    rg_cand_t*  cands;
+    size_t      cand_count;
+    size_t      cand_cap;
+
+    rg_note_t*  notes;              // value of every float expression on the converged walk
+    size_t      note_count;
+    size_t      note_cap;
+
+    rg_check_t* checks;             // conditions on the converged walk
+    size_t      check_count;
+    size_t      check_cap;
+
+    int         rewrite;            // record notes, checks and stores, converged walk only
+    size_t      budget;             // node visits left in the current function
+    int         exhausted;
+    err_t       rc;                 // allocation failure where no err_t goes back
+
+    // type walk
+    ast_type_t  ret_type;
+    size_t      depth;              // loops around the current node
+    size_t      cost;
+    int         apply;              // rewrite literals and rounding instead of counting
+    int         dropped;            // an illegal retype was taken back, walk again
+
+    size_t      retyped;
+    size_t      removed;
+} rg_ctx_t;
+
+#define RG_GROW_(ptr, cap, want, type)                                         \
+    block_begin                                                                \
+        if ((want) > (cap)) {                                                  \
+            size_t new_cap = (cap) ? (cap) * 2 : 16;                           \
+            while (new_cap < (want)) new_cap *= 2;                             \
+            void* np = mem_realloc(MEM_TAG_OPT, (ptr), new_cap * sizeof(type)); \
+            if (!np) return ERR_ALLOC;                                         \
+            (ptr) = (type*)np;                                                 \
+            (cap) = new_cap;                                                   \
+        }                                                                      \
+    block_end
+
+// ================================= lattice ==================================
+
+static rg_value_t rg_top_(ast_type_t t)
+{
+    if (t == AST_TYPE_INT) return (rg_value_t){ .lo = -INFINITY, .hi = INFINITY, .whole = 1 };
+    return (rg_value_t){ .lo = -INFINITY, .hi = INFINITY, .wild = 1 };
+}
+
+static rg_value_t rg_const_(f64_t k)
+{
+    if (!isfinite(k)) return rg_top_(AST_TYPE_FLOAT);
+    return (rg_value_t){ .lo = k, .hi = k, .whole = (floor(k) == k) };
+}
+
+// an int result: past 2^53 it may have wrapped
+static rg_value_t rg_int_(f64_t lo, f64_t hi)
+{
+    if (!(lo >= -RG_EXACT && hi <= RG_EXACT)) return rg_top_(AST_TYPE_INT);
+    return (rg_value_t){ .lo = lo, .hi = hi, .whole = 1 };
+}
+
+// a float result: whole only while every value is exact
+static rg_value_t rg_float_(f64_t lo, f64_t hi, int whole, int wild)
+{
+    if (isnan(lo) || isnan(hi)) return rg_top_(AST_TYPE_FLOAT);
+
+    wild  |= !isfinite(lo) || !isfinite(hi);
+    whole &= !wild && lo >= -RG_EXACT && hi <= RG_EXACT;
+    return (rg_value_t){ .lo = lo, .hi = hi, .whole = whole, .wild = wild };
+}
+
+static int rg_exact_(const rg_value_t* v)
+{
+    return v->whole && !v->wild && v->lo >= -RG_EXACT && v->hi <= RG_EXACT;
+}
+
+static int rg_same_(const rg_value_t* a, const rg_value_t* b)
+{
+    return a->lo == b->lo && a->hi == b->hi && a->whole == b->whole && a->wild == b->wild;
+}
+
+static void rg_join_(rg_value_t* dst, const rg_value_t* src)
+{
+    dst->lo     = fmin(dst->lo, src->lo);
+    dst->hi     = fmax(dst->hi, src->hi);
+    dst->whole &= src->whole;
+    dst->wild  |= src->wild;
+}
+
+// value as it arrives where type to is expected, same conversions as the backend
+static rg_value_t rg_to_type_(rg_value_t v, ast_type_t from, ast_type_t to)
+{
+    if (to == AST_TYPE_FLOAT && (from == AST_TYPE_INT || from == AST_TYPE_FLOAT)) return v;
+
+    if (to == AST_TYPE_INT || to == AST_TYPE_PTR)
+    {
+        if (from == AST_TYPE_INT) return v;
+        if (from == AST_TYPE_FLOAT && !v.wild) return rg_int_(trunc(v.lo), trunc(v.hi));
+    }
+    return rg_top_(to);
+}
+
+// 1 / 0 for a known int condition, -1 otherwise
+static int rg_truth_(const rg_value_t* v, ast_type_t t)
+{
+    if (t != AST_TYPE_INT) return -1;
+    if (v->lo == 0.0 && v->hi == 0.0) return 0;
+    if (v->lo > 0.0 || v->hi < 0.0)   return 1;
+    return -1;
+}
+
+static rg_value_t rg_bool_(int truth)
+{
+    if (truth < 0) return (rg_value_t){ .lo = 0.0, .hi = 1.0, .whole = 1 };
+    return (rg_value_t){ .lo = (f64_t)truth, .hi = (f64_t)truth, .whole = 1 };
+}
+
+static rg_value_t rg_arith_(token_kind_t op, rg_value_t a, rg_value_t b, int is_float)
+{
+    const ast_type_t t = is_float ? AST_TYPE_FLOAT : AST_TYPE_INT;
+    f64_t c[4] = { 0 };
+    f64_t lo = 0.0, hi = 0.0;
+
+    switch (op)
+    {
+        case TOK_OP_PLUS:  lo = a.lo + b.lo; hi = a.hi + b.hi; break;
+        case TOK_OP_MINUS: lo = a.lo - b.hi; hi = a.hi - b.lo; break;
+
+        case TOK_OP_MUL:
+        case TOK_OP_DIV:
+            if (op == TOK_OP_DIV)
+            {
+                if (b.lo <= 0.0 && b.hi >= 0.0) return rg_top_(t);
+                c[0] = a.lo / b.lo; c[1] = a.lo / b.hi; c[2] = a.hi / b.lo; c[3] = a.hi / b.hi;
+            }
+            else
+            {
+                c[0] = a.lo * b.lo; c[1] = a.lo * b.hi; c[2] = a.hi * b.lo; c[3] = a.hi * b.hi;
+            }
+
+            lo = hi = c[0];
+            for (size_t i = 0; i < 4; ++i)
+            {
+                if (isnan(c[i])) return rg_top_(t);
+                lo = fmin(lo, c[i]);
+                hi = fmax(hi, c[i]);
+            }
+
+            // int division truncates, float division is rarely whole
+            if (op == TOK_OP_DIV && !is_float) { lo = trunc(lo); hi = trunc(hi); }
+            if (op == TOK_OP_DIV &&  is_float) return rg_float_(lo, hi, 0, a.wild || b.wild);
+            break;
+
+        default:
+            return rg_top_(t);
+    }
+
+    if (isnan(lo) || isnan(hi)) return rg_top_(t);
+    if (!is_float) return rg_int_(lo, hi);
+    return rg_float_(lo, hi, a.whole && b.whole, a.wild || b.wild);
+}
+
+static rg_value_t rg_compare_(token_kind_t op, const rg_value_t* a, const rg_value_t* b)
+{
+    // NaN fails every compare but !=
+    if (a->wild || b->wild) return rg_bool_(-1);
+
+    const int point = (a->lo == a->hi && b->lo == b->hi && a->lo == b->lo);
+    const int apart = (a->hi < b->lo || b->hi < a->lo);
+    int t = -1;
+
+    switch (op)
+    {
+        case TOK_OP_LT:  t = (a->hi <  b->lo) ? 1 : (a->lo >= b->hi) ? 0 : -1; break;
+        case TOK_OP_LTE: t = (a->hi <= b->lo) ? 1 : (a->lo >  b->hi) ? 0 : -1; break;
+        case TOK_OP_GT:  t = (a->lo >  b->hi) ? 1 : (a->hi <= b->lo) ? 0 : -1; break;
+        case TOK_OP_GTE: t = (a->lo >= b->hi) ? 1 : (a->hi <  b->lo) ? 0 : -1; break;
+        case TOK_OP_EQ:  t = point ? 1 : apart ? 0 : -1; break;
+        case TOK_OP_NEQ: t = point ? 0 : apart ? 1 : -1; break;
+        default: break;
+    }
+    return rg_bool_(t);
+}
+
+// ============================== environments ================================
+
+static err_t rg_env_reserve_(rg_env_t* env, size_t n)
+{
+    RG_GROW_(env->vals, env->cap, n, rg_value_t);
+    return OK;
+}
+
+static err_t rg_env_copy_(rg_env_t* dst, const rg_env_t* src, size_t n)
+{
+    err_t rc = rg_env_reserve_(dst, n);
+    if (rc != OK) return rc;
+
+    if (src->live && n) memcpy(dst->vals, src->vals, n * sizeof(rg_value_t));
+    dst->live = src->live;
+    return OK;
+}
+
+static err_t rg_env_join_(rg_env_t* dst, const rg_env_t* src, size_t n)
+{
+    if (!src->live) return OK;
+    if (!dst->live) return rg_env_copy_(dst, src, n);
+
+    for (size_t i = 0; i < n; ++i)
+        rg_join_(&dst->vals[i], &src->vals[i]);
+    return OK;
+}
+
+// for an environment that is not needed any more, instead of a copy
+static void rg_env_swap_(rg_env_t* a, rg_env_t* b)
+{
+    const rg_env_t t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static int rg_env_same_(const rg_env_t* a, const rg_env_t* b, size_t n)
+{
+    if (a->live != b->live) return 0;
+    if (!a->live) return 1;
+
+    for (size_t i = 0; i < n; ++i)
+        if (!rg_same_(&a->vals[i], &b->vals[i])) return 0;
+    return 1;
+}
+
+// bounds that grew since the last round go to infinity; 1 when one did
+static int rg_env_widen_(rg_env_t* next, const rg_env_t* prev, size_t n)
+{
+    if (!next->live || !prev->live) return 0;
+
+    int grew = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (next->vals[i].lo < prev->vals[i].lo) { next->vals[i].lo = -INFINITY; grew = 1; }
+        if (next->vals[i].hi > prev->vals[i].hi) { next->vals[i].hi =  INFINITY; grew = 1; }
+    }
+    return grew;
+}
+
+// an environment of ifs and loops, keeping the storage of earlier ones
+static rg_env_t rg_env_take_(rg_ctx_t* cx)
+{
+    rg_env_t env = { 0 };
+    if (cx->spare_count) env = cx->spare[--cx->spare_count];
+
+    env.live = 0;
+    return env;
+}
+
+static void rg_env_give_(rg_ctx_t* cx, rg_env_t* env)
+{
+    if (cx->spare_count == cx->spare_cap)
+    {
+        const size_t cap = cx->spare_cap ? cx->spare_cap * 2 : 16;
+        rg_env_t* p = (rg_env_t*)mem_realloc(MEM_TAG_OPT, cx->spare, cap * sizeof(rg_env_t));
+        if (!p) { mem_free(env->vals); return; }
+
+        cx->spare     = p;
+        cx->spare_cap = cap;
+    }
+    cx->spare[cx->spare_count++] = *env;
+}
+
+// ================================ bookkeeping ===============================
+
+static size_t rg_lookup_(const rg_ctx_t* cx, size_t name_id)
+{
+    for (size_t i = cx->bind_count; i > 0; --i)
+        if (cx->binds[i - 1].name_id == name_id) return i - 1;
+    return SIZE_MAX;
+}
+
+static size_t rg_cand_find_(const rg_ctx_t* cx, const ast_node_t* decl)
+{
+    for (size_t i = cx->cand_count; i > 0; --i)
+        if (cx->cands[i - 1].decl == decl) return i - 1;
+    return SIZE_MAX;
+}
+
+static err_t rg_cand_(rg_ctx_t* cx, ast_node_t* decl, size_t* out)
+{
+    *out = rg_cand_find_(cx, decl);
+    if (*out != SIZE_MAX) return OK;
+
+    RG_GROW_(cx->cands, cx->cand_cap, cx->cand_count + 1, rg_cand_t);
+    cx->cands[cx->cand_count] = (rg_cand_t){ .decl = decl, .whole = 1 };
+    *out = cx->cand_count++;
+    return OK;
+}
+
+static err_t rg_push_bind_(rg_ctx_t* cx, size_t name_id, ast_type_t type, size_t cand)
+{
+    RG_GROW_(cx->binds, cx->bind_cap, cx->bind_count + 1, rg_bind_t);
+    cx->binds[cx->bind_count++] = (rg_bind_t){ .name_id = name_id, .type = type, .cand = cand };
+    return OK;
+}
+
+// decl is a VAR_DECL or NULL for a param
+static err_t rg_bind_(rg_ctx_t* cx, rg_env_t* env, ast_node_t* decl, size_t name_id,
+                      ast_type_t type, size_t* out)
+{
+    size_t cand = SIZE_MAX;
+    err_t  rc   = OK;
+
+    if (decl && type == AST_TYPE_FLOAT) rc = rg_cand_(cx, decl, &cand);
+    if (rc == OK) rc = rg_env_reserve_(env, cx->bind_count + 1);
+    if (rc == OK) rc = rg_push_bind_(cx, name_id, type, cand);
+    if (rc != OK) return rc;
+
+    env->vals[cx->bind_count - 1] = rg_top_(type);
+    *out = cx->bind_count - 1;
+    return OK;
+}
+
+static void rg_note_(rg_ctx_t* cx, const ast_node_t* e, const rg_value_t* v)
+{
+    if (!cx->rewrite || cx->rc != OK) return;
+
+    if (cx->note_count == cx->note_cap)
+    {
+        const size_t cap = cx->note_cap ? cx->note_cap * 2 : 64;
+        rg_note_t* p = (rg_note_t*)mem_realloc(MEM_TAG_OPT, cx->notes, cap * sizeof(rg_note_t));
+        if (!p) { cx->rc = ERR_ALLOC; return; }
+
+        cx->notes    = p;
+        cx->note_cap = cap;
+    }
+    cx->notes[cx->note_count++] = (rg_note_t){ .node = e, .val = *v };
+}
+
+static err_t rg_check_(rg_ctx_t* cx, ast_node_t* cond, int truth)
+{
+    if (!cx->rewrite) return OK;
+
+    RG_GROW_(cx->checks, cx->check_cap, cx->check_count + 1, rg_check_t);
+    cx->checks[cx->check_count++] = (rg_check_t){ .cond = cond, .truth = truth };
+    return OK;
+}
+
+static void rg_store_(rg_ctx_t* cx, rg_env_t* env, size_t var, rg_value_t v, ast_type_t from)
+{
+    const rg_bind_t* b = &cx->binds[var];
+    env->vals[var] = rg_to_type_(v, from, b->type);
+
+    if (cx->rewrite && b->cand != SIZE_MAX)
+        cx->cands[b->cand].whole &= rg_exact_(&env->vals[var]);
+}
+
+static int rg_spend_(rg_ctx_t* cx)
+{
+    if (cx->budget == 0) cx->exhausted = 1;
+    else                 cx->budget--;
+    return !cx->exhausted;
+}
+
+// ================================ expressions ===============================
+
+static ast_type_t rg_arith_type_(ast_type_t a, ast_type_t b)
+{
+    if (a == AST_TYPE_FLOAT || b == AST_TYPE_FLOAT)     return AST_TYPE_FLOAT;
+    if (a == AST_TYPE_UNKNOWN || b == AST_TYPE_UNKNOWN) return AST_TYPE_UNKNOWN;
+    return AST_TYPE_INT;
+}
+
+static int rg_is_compare_(token_kind_t op)
+{
+    return opt_is_bool_op(op) && op != TOK_OP_AND && op != TOK_OP_OR;
+}
+
+static rg_value_t rg_expr_(rg_ctx_t* cx, const rg_env_t* env, ast_node_t* e, ast_type_t* out_type);
+
+static rg_value_t rg_binary_(rg_ctx_t* cx, const rg_env_t* env, ast_node_t* e, ast_type_t* t)
+{
+    ast_node_t* a = e->left;
+    ast_node_t* b = a ? a->right : NULL;
+    if (!b) return rg_top_(*t = AST_TYPE_UNKNOWN);
+
+    ast_type_t ta = AST_TYPE_UNKNOWN, tb = AST_TYPE_UNKNOWN;
+    rg_value_t va = rg_expr_(cx, env, a, &ta);
+    rg_value_t vb = rg_expr_(cx, env, b, &tb);
+
+    const token_kind_t op = e->u.binary.op;
+
+    if (op == TOK_OP_AND || op == TOK_OP_OR)
+    {
+        va = rg_to_type_(va, ta, AST_TYPE_INT);
+        vb = rg_to_type_(vb, tb, AST_TYPE_INT);
+
+        const int x = rg_truth_(&va, AST_TYPE_INT);
+        const int y = rg_truth_(&vb, AST_TYPE_INT);
+        *t = AST_TYPE_INT;
+
+        if (op == TOK_OP_AND) return rg_bool_((x == 0 || y == 0) ? 0 : (x == 1 && y == 1) ? 1 : -1);
+        return rg_bool_((x == 1 || y == 1) ? 1 : (x == 0 && y == 0) ? 0 : -1);
+    }
+
+    if (rg_is_compare_(op))
+    {
+        *t = AST_TYPE_INT;
+        if (ta == AST_TYPE_UNKNOWN || tb == AST_TYPE_UNKNOWN) return rg_bool_(-1);
+        return rg_compare_(op, &va, &vb);
+    }
+
+    if (op == TOK_OP_POW)
+    {
+        *t = (ta == AST_TYPE_INT && tb == AST_TYPE_INT) ? AST_TYPE_INT : AST_TYPE_FLOAT;
+        return rg_top_(*t);
+    }
+
+    *t = rg_arith_type_(ta, tb);
+    if (*t == AST_TYPE_UNKNOWN) return rg_top_(*t);
+    return rg_arith_(op, va, vb, *t == AST_TYPE_FLOAT);
+}
+
+static rg_value_t rg_builtin_(rg_ctx_t* cx, const rg_env_t* env, ast_node_t* e, ast_type_t* t)
+{
+    ast_type_t st = AST_TYPE_UNKNOWN;
+    rg_value_t v  = e->left ? rg_expr_(cx, env, e->left, &st) : rg_top_(AST_TYPE_UNKNOWN);
+
+    if (e->u.builtin_unary.id == AST_BUILTIN_FTOI)
+    {
+        *t = AST_TYPE_INT;
+        return rg_to_type_(v, st, AST_TYPE_INT);
+    }
+
+    *t = AST_TYPE_FLOAT;
+    v  = rg_to_type_(v, st, AST_TYPE_FLOAT);
+    if (e->u.builtin_unary.id == AST_BUILTIN_ITOF || v.wild) return v;
+
+    switch (e->u.builtin_unary.id)
+    {
+        case AST_BUILTIN_FLOOR: return (rg_value_t){ .lo = floor(v.lo), .hi = floor(v.hi), .whole = 1 };
+        case AST_BUILTIN_CEIL:  return (rg_value_t){ .lo = ceil(v.lo),  .hi = ceil(v.hi),  .whole = 1 };
+        case AST_BUILTIN_ROUND: return (rg_value_t){ .lo = round(v.lo), .hi = round(v.hi), .whole = 1 };
+        default:                return rg_top_(AST_TYPE_FLOAT);
+    }
+}
+
+static rg_value_t rg_expr_(rg_ctx_t* cx, const rg_env_t* env, ast_node_t* e, ast_type_t* out_type)
+{
+    ast_type_t t = AST_TYPE_UNKNOWN;
+    rg_value_t v = rg_top_(t);
+
+    if (!e || !rg_spend_(cx))
+    {
+        if (out_type) *out_type = t;
+        return v;
+    }
+
+    switch (e->kind)
+    {
+        case ASTK_NUM_LIT:
+            if (e->u.num.lit_type == LIT_FLOAT)
+            {
+                t = AST_TYPE_FLOAT;
+                v = rg_const_(e->u.num.lit.f64);
+            }
+            else if (e->u.num.lit_type == LIT_INT)
+            {
+                t = AST_TYPE_INT;
+                v = rg_int_((f64_t)e->u.num.lit.i64, (f64_t)e->u.num.lit.i64);
+            }
+            break;
+
+        case ASTK_IDENT:
+        {
+            const size_t var = rg_lookup_(cx, e->u.ident.name_id);
+            if (var != SIZE_MAX)
+            {
+                t = cx->binds[var].type;
+                v = env->vals[var];
+            }
+            break;
+        }
+
+        case ASTK_UNARY:
+        {
+            ast_type_t st = AST_TYPE_UNKNOWN;
+            const rg_value_t s = e->left ? rg_expr_(cx, env, e->left, &st) : rg_top_(st);
+
+            if (e->u.unary.op == TOK_OP_NOT)
+            {
+                const rg_value_t i = rg_to_type_(s, st, AST_TYPE_INT);
+                const int truth    = rg_truth_(&i, AST_TYPE_INT);
+
+                t = AST_TYPE_INT;
+                v = rg_bool_(truth < 0 ? -1 : !truth);
+            }
+            else if (e->u.unary.op == TOK_OP_MINUS && (st == AST_TYPE_INT || st == AST_TYPE_FLOAT))
+            {
+                t = st;
+                v = (st == AST_TYPE_INT) ? rg_int_(-s.hi, -s.lo) : rg_float_(-s.hi, -s.lo, s.whole, s.wild);
+            }
+            else if (e->u.unary.op == TOK_OP_PLUS)
+            {
+                t = st;
+                v = s;
+            }
+            break;
+        }
+
+        case ASTK_BUILTIN_UNARY:
+            v = rg_builtin_(cx, env, e, &t);
+            break;
+
+        case ASTK_BINARY:
+            v = rg_binary_(cx, env, e, &t);
+            break;
+
+        case ASTK_CALL:
+            for (ast_node_t* a = e->left ? e->left->left : NULL; a; a = a->right)
+                rg_expr_(cx, env, a, NULL);
+            t = e->type;
+            v = rg_top_(t);
+            break;
+
+        default:
+            for (ast_node_t* c = e->left; c; c = c->right)
+                rg_expr_(cx, env, c, NULL);
+            break;
+    }
+
+    // only float nodes may turn int or lose a rounding
+    if (t == AST_TYPE_FLOAT) rg_note_(cx, e, &v);
+    if (out_type) *out_type = t;
+    return v;
+}
+
+// ================================ narrowing =================================
+
+static token_kind_t rg_negate_(token_kind_t op)
+{
+    switch (op)
+    {
+        case TOK_OP_LT:  return TOK_OP_GTE;
+        case TOK_OP_LTE: return TOK_OP_GT;
+        case TOK_OP_GT:  return TOK_OP_LTE;
+        case TOK_OP_GTE: return TOK_OP_LT;
+        case TOK_OP_EQ:  return TOK_OP_NEQ;
+        case TOK_OP_NEQ: return TOK_OP_EQ;
+        default:         return op;
+    }
+}
+
+// b <op> a for a <op> b
+static token_kind_t rg_mirror_(token_kind_t op)
+{
+    switch (op)
+    {
+        case TOK_OP_LT:  return TOK_OP_GT;
+        case TOK_OP_LTE: return TOK_OP_GTE;
+        case TOK_OP_GT:  return TOK_OP_LT;
+        case TOK_OP_GTE: return TOK_OP_LTE;
+        default:         return op;
+    }
+}
+
+// keep the values of the variable a names for which a <op> b holds
+static void rg_narrow_(rg_ctx_t* cx, rg_env_t* env, const ast_node_t* a, token_kind_t op, const rg_value_t* b)
+{
+    if (a->kind != ASTK_IDENT) return;
+
+    const size_t var = rg_lookup_(cx, a->u.ident.name_id);
+    if (var == SIZE_MAX) return;
+
+    rg_value_t* v = &env->vals[var];
+    const int   w = v->whole;
+    f64_t lo = v->lo, hi = v->hi;
+
+    switch (op)
+    {
+        case TOK_OP_LT:  hi = fmin(hi, w ? ceil(b->hi) - 1.0 : b->hi); break;
+        case TOK_OP_LTE: hi = fmin(hi, w ? floor(b->hi) : b->hi);      break;
+        case TOK_OP_GT:  lo = fmax(lo, w ? floor(b->lo) + 1.0 : b->lo); break;
+        case TOK_OP_GTE: lo = fmax(lo, w ? ceil(b->lo) : b->lo);       break;
+
+        case TOK_OP_EQ:
+            lo = fmax(lo, w ? ceil(b->lo) : b->lo);
+            hi = fmin(hi, w ? floor(b->hi) : b->hi);
+            break;
+
+        case TOK_OP_NEQ:
+            if (!w || b->wild || b->lo != b->hi) return;
+            if (lo == b->lo) lo += 1.0;
+            if (hi == b->hi) hi -= 1.0;
+            break;
+
+        default:
+            return;
+    }
+
+    if (lo > hi) { env->live = 0; return; }
+    v->lo = lo;
+    v->hi = hi;
+}
+
+// env on the path where cond is truth
+static void rg_refine_(rg_ctx_t* cx, rg_env_t* env, const ast_node_t* cond, int truth)
+{
+    if (!cond || !env->live) return;
+
+    if (cond->kind == ASTK_UNARY && cond->u.unary.op == TOK_OP_NOT)
+    {
+        rg_refine_(cx, env, cond->left, !truth);
+        return;
+    }
+    if (cond->kind != ASTK_BINARY || !cond->left || !cond->left->right) return;
+
+    const ast_node_t* a  = cond->left;
+    const ast_node_t* b  = a->right;
+    token_kind_t      op = cond->u.binary.op;
+
+    if ((op == TOK_OP_AND && truth) || (op == TOK_OP_OR && !truth))
+    {
+        rg_refine_(cx, env, a, truth);
+        rg_refine_(cx, env, b, truth);
+        return;
+    }
+    if (!rg_is_compare_(op)) return;
+
+    // only a variable compared as a whole is narrowed
+    if (a->kind != ASTK_IDENT && b->kind != ASTK_IDENT) return;
+
+    // both sides before either is narrowed, nothing recorded twice
+    const int rewrite = cx->rewrite;
+    cx->rewrite = 0;
+
+    ast_type_t ta = AST_TYPE_UNKNOWN, tb = AST_TYPE_UNKNOWN;
+    const rg_value_t va = rg_expr_(cx, env, (ast_node_t*)a, &ta);
+    const rg_value_t vb = rg_expr_(cx, env, (ast_node_t*)b, &tb);
+    cx->rewrite = rewrite;
+
+    if (ta == AST_TYPE_UNKNOWN || tb == AST_TYPE_UNKNOWN) return;
+
+    // NaN makes every compare but != false
+    if (!truth && (va.wild || vb.wild)) return;
+    if (!truth) op = rg_negate_(op);
+
+    rg_narrow_(cx, env, a, op, &vb);
+    if (env->live) rg_narrow_(cx, env, b, rg_mirror_(op), &va);
+}
+
+// ================================ statements ================================
+
+static err_t rg_stmt_(rg_ctx_t* cx, rg_env_t* env, ast_node_t* st);
+
+static err_t rg_scoped_(rg_ctx_t* cx, rg_env_t* env, ast_node_t* st)
+{
+    const size_t binds = cx->bind_count;
+    err_t rc = rg_stmt_(cx, env, st);
+    cx->bind_count = binds;
+    return rc;
+}
+
+static err_t rg_cond_(rg_ctx_t* cx, const rg_env_t* env, ast_node_t* cond, int* taken)
+{
+    ast_type_t t = AST_TYPE_UNKNOWN;
+    const rg_value_t c = rg_expr_(cx, env, cond, &t);
+
+    *taken = rg_truth_(&c, t);
+    return rg_check_(cx, cond, *taken);
+}
+
+static err_t rg_if_(rg_ctx_t* cx, rg_env_t* env, ast_node_t* ifn)
+{
+    // IF/BRANCH children: cond, stmt, [tail]
+    ast_node_t* cond = ifn->left;
+    ast_node_t* then = cond ? cond->right : NULL;
+    ast_node_t* tail = then ? then->right : NULL;
+    if (!cond || !then) return OK;
+
+    const size_t n = cx->bind_count;
+    rg_env_t out = rg_env_take_(cx);
+    rg_env_t arm = rg_env_take_(cx);
+    err_t rc = OK;
+
+    while (rc == OK)
+    {
+        int taken = -1;
+        rc = rg_cond_(cx, env, cond, &taken);
+
+        if (rc == OK && taken != 0)
+        {
+            rc = rg_env_copy_(&arm, env, n);
+            if (rc == OK) rg_refine_(cx, &arm, cond, 1);
+            if (rc == OK && arm.live) rc = rg_scoped_(cx, &arm, then);
+            if (rc == OK && !out.live) rg_env_swap_(&out, &arm);
+            else if (rc == OK)         rc = rg_env_join_(&out, &arm, n);
+        }
+        if (rc != OK) break;
+
+        // later arms see the conditions before them fail
+        if (taken == 1) { env->live = 0; break; }
+        rg_refine_(cx, env, cond, 0);
+
+        if (!tail || !env->live) break;
+
+        if (tail->kind == ASTK_ELSE)
+        {
+            rc = rg_scoped_(cx, env, tail->left);
+            break;
+        }
+
+        cond = tail->left;
+        then = cond ? cond->right : NULL;
+        tail = then ? then->right : NULL;
+        if (!cond || !then) break;
+    }
+
+    if (rc == OK) rc = rg_env_join_(&out, env, n);
+    if (rc == OK) rg_env_swap_(env, &out);
+
+    rg_env_give_(cx, &out);
+    rg_env_give_(cx, &arm);
+    return rc;
+}
+
+static err_t rg_push_loop_(rg_ctx_t* cx)
+{
+    if (cx->loop_count == cx->loop_cap)
+    {
+        const size_t old = cx->loop_cap;
+        RG_GROW_(cx->loops, cx->loop_cap, cx->loop_count + 1, rg_loop_t);
+        memset(cx->loops + old, 0, (cx->loop_cap - old) * sizeof(rg_loop_t));
+    }
+
+    cx->loops[cx->loop_count].exit.live = 0;
+    cx->loops[cx->loop_count++].binds   = cx->bind_count;
+    return OK;
+}
+
+// header test and one walk of the body from in, gg environments are collected anew
+static err_t rg_loop_pass_(rg_ctx_t* cx, const rg_env_t* in, rg_env_t* iter,
+                           ast_node_t* cond, ast_node_t* body, int* taken)
+{
+    cx->loops[cx->loop_count - 1].exit.live = 0;
+
+    err_t rc = rg_cond_(cx, in, cond, taken);
+
+    iter->live = 0;
+    if (rc != OK || *taken == 0) return rc;
+
+    rc = rg_env_copy_(iter, in, cx->bind_count);
+    if (rc == OK) rg_refine_(cx, iter, cond, 1);
+    if (rc == OK && iter->live) rc = rg_scoped_(cx, iter, body);
+    return rc;
+}
+
+static err_t rg_while_(rg_ctx_t* cx, rg_env_t* env, ast_node_t* w)
+{
+    ast_node_t* cond = w->left;
+    ast_node_t* body = cond ? cond->right : NULL;
+    if (!cond || !body) return OK;
+
+    err_t rc = rg_push_loop_(cx);
+    if (rc != OK) return rc;
+
+    const size_t n       = cx->bind_count;
+    const int    rewrite = cx->rewrite;
+
+    rg_env_t in   = rg_env_take_(cx);
+    rg_env_t iter = rg_env_take_(cx);
+    rg_env_t next = rg_env_take_(cx);
+    int    taken   = -1;
+    int    widened = 0;
+    size_t rounds  = 0;
+
+    rc = rg_env_copy_(&in, env, n);
+
+    // header = entry join back edge, until it stops changing
+    cx->rewrite = 0;
+    while (rc == OK && !cx->exhausted)
+    {
+        rc = rg_loop_pass_(cx, &in, &iter, cond, body, &taken);
+        if (rc == OK) rc = rg_env_copy_(&next, env, n);
+        if (rc == OK) rc = rg_env_join_(&next, &iter, n);
+        if (rc != OK) break;
+
+        if (++rounds > RG_WIDEN_AFTER) widened |= rg_env_widen_(&next, &in, n);
+        if (rg_env_same_(&next, &in, n)) break;
+
+        rg_env_swap_(&in, &next);
+    }
+
+    // the widened header holds every round, one more from it is tighter and still does
+    if (rc == OK && widened && !cx->exhausted)
+    {
+        rc = rg_loop_pass_(cx, &in, &iter, cond, body, &taken);
+        if (rc == OK) rc = rg_env_copy_(&in, env, n);
+        if (rc == OK) rc = rg_env_join_(&in, &iter, n);
+    }
+
+    if (rc == OK && rewrite && !cx->exhausted)
+    {
+        cx->rewrite = 1;
+        rc = rg_loop_pass_(cx, &in, &iter, cond, body, &taken);
+    }
+    cx->rewrite = rewrite;
+
+    // exits: condition false at the header, and every gg
+    if (taken == 1) in.live = 0;
+    if (rc == OK) rg_refine_(cx, &in, cond, 0);
+    if (rc == OK) rc = rg_env_join_(&in, &cx->loops[cx->loop_count - 1].exit, n);
+    if (rc == OK) rg_env_swap_(env, &in);
+
+    cx->loop_count--;
+
+    rg_env_give_(cx, &in);
+    rg_env_give_(cx, &iter);
+    rg_env_give_(cx, &next);
+    return rc;
+}
+
+// a declaration used as an arm without a block stays bound after the
+// statement in the backend, with a value from whichever path ran
+static err_t rg_bare_decl_(rg_ctx_t* cx, rg_env_t* env, ast_node_t* arm)
+{
+    if (!arm || arm->kind != ASTK_VAR_DECL) return OK;
+
+    size_t var = 0;
+    return rg_bind_(cx, env, arm, arm->u.vdecl.name_id, arm->u.vdecl.type, &var);
+}
+
+static err_t rg_stmt_(rg_ctx_t* cx, rg_env_t* env, ast_node_t* st)
+{
+    // unreachable statements are left as they are
+    if (!st || !env->live || cx->exhausted) return OK;
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:
+        {
+            const size_t binds = cx->bind_count;
+            err_t rc = OK;
+            for (ast_node_t* c = st->left; c && rc == OK; c = c->right)
+                rc = rg_stmt_(cx, env, c);
+            cx->bind_count = binds;
+            return rc;
+        }
+
+        case ASTK_IF:
+        {
+            err_t rc = rg_if_(cx, env, st);
+
+            for (ast_node_t* arm = st; arm && rc == OK; )
+            {
+                ast_node_t* then = arm->left ? arm->left->right : NULL;
+                ast_node_t* tail = then ? then->right : NULL;
+
+                if (arm->kind == ASTK_ELSE) then = arm->left, tail = NULL;
+                rc = rg_bare_decl_(cx, env, then);
+                arm = tail;
+            }
+            return rc;
+        }
+
+        case ASTK_WHILE:
+        {
+            err_t rc = rg_while_(cx, env, st);
+            if (rc == OK && st->left) rc = rg_bare_decl_(cx, env, st->left->right);
+            return rc;
+        }
+
+        case ASTK_VAR_DECL:
+        {
+            // the name is in scope in its own init, as in the backend
+            size_t var = 0;
+            err_t rc = rg_bind_(cx, env, st, st->u.vdecl.name_id, st->u.vdecl.type, &var);
+            if (rc != OK) return rc;
+
+            const size_t cand = cx->binds[var].cand;
+            if (cx->rewrite && cand != SIZE_MAX) cx->cands[cand].seen = 1;
+
+            ast_type_t t = AST_TYPE_INT;
+            rg_value_t v = rg_int_(0.0, 0.0);
+            if (st->left) v = rg_expr_(cx, env, st->left, &t);
+
+            rg_store_(cx, env, var, v, t);
+            return OK;
+        }
+
+        case ASTK_ASSIGN:
+        {
+            ast_type_t t = AST_TYPE_UNKNOWN;
+            const rg_value_t v   = rg_expr_(cx, env, st->left, &t);
+            const size_t     var = rg_lookup_(cx, st->u.assign.name_id);
+            if (var != SIZE_MAX) rg_store_(cx, env, var, v, t);
+            return OK;
+        }
+
+        case ASTK_RETURN:
+            rg_expr_(cx, env, st->left, NULL);
+            env->live = 0;
+            return OK;
+
+        case ASTK_BREAK:
+        {
+            err_t rc = OK;
+            if (cx->loop_count > 0)
+            {
+                rg_loop_t* loop = &cx->loops[cx->loop_count - 1];
+                rc = rg_env_join_(&loop->exit, env, loop->binds);
+            }
+            env->live = 0;
+            return rc;
+        }
+
+        default:
+            for (ast_node_t* c = st->left; c; c = c->right)
+                rg_expr_(cx, env, c, NULL);
+            return OK;
+    }
+}
+
+// ================================ type walk =================================
+
+/*
+    Types of every expression with the candidates marked retype declared
+    npc (now) and as written (was), counting the conversions the backend
+    emits for now. A node that turns from float to int must compute the
+    same whole numbers either way, else the candidates it reads are taken
+    out of the set
+*/
+
+typedef struct
+{
+    ast_type_t now;
+    ast_type_t was;
+} rg_ty_t;
+
+static int rg_note_cmp_(const void* a, const void* b)
+{
+    const uintptr_t x = (uintptr_t)((const rg_note_t*)a)->node;
+    const uintptr_t y = (uintptr_t)((const rg_note_t*)b)->node;
+    return (x > y) - (x < y);
+}
+
+static int rg_check_cmp_(const void* a, const void* b)
+{
+    const uintptr_t x = (uintptr_t)((const rg_check_t*)a)->cond;
+    const uintptr_t y = (uintptr_t)((const rg_check_t*)b)->cond;
+    return (x > y) - (x < y);
+}
+
+static const rg_value_t* rg_note_find_(const rg_ctx_t* cx, const ast_node_t* e)
+{
+    if (cx->note_count == 0) return NULL;
+
+    const rg_note_t key = { .node = e };
+    const rg_note_t* n = (const rg_note_t*)bsearch(&key, cx->notes, cx->note_count,
+                                                   sizeof(rg_note_t), rg_note_cmp_);
+    return n ? &n->val : NULL;
+}
+
+static int rg_note_exact_(const rg_ctx_t* cx, const ast_node_t* e)
+{
+    const rg_value_t* v = rg_note_find_(cx, e);
+    return v && rg_exact_(v);
+}
+
+static void rg_lit_int_(ast_node_t* n, i64_t v)
+{
+    n->type           = AST_TYPE_INT;
+    n->u.num.lit_type = LIT_INT;
+    n->u.num.lit.i64  = v;
+}
+
+static void rg_lit_float_(ast_node_t* n, f64_t v)
+{
+    n->type           = AST_TYPE_FLOAT;
+    n->u.num.lit_type = LIT_FLOAT;
+    n->u.num.lit.f64  = v;
+}
+
+// e of type have goes where want is expected: a conversion in the output,
+// or none when e is a literal that can be written in the other type
+static void rg_conv_(rg_ctx_t* cx, ast_node_t* e, ast_type_t have, ast_type_t want)
+{
+    const int to_float = (want == AST_TYPE_FLOAT && have == AST_TYPE_INT);
+    const int to_int   = ((want == AST_TYPE_INT || want == AST_TYPE_PTR) && have == AST_TYPE_FLOAT);
+    if (!e || (!to_float && !to_int)) return;
+
+    if (e->kind == ASTK_NUM_LIT && to_float && e->u.num.lit_type == LIT_INT &&
+        fabs((f64_t)e->u.num.lit.i64) <= RG_EXACT)
+    {
+        if (cx->apply) { rg_lit_float_(e, (f64_t)e->u.num.lit.i64); cx->removed++; }
+        return;
+    }
+
+    if (e->kind == ASTK_NUM_LIT && to_int && e->u.num.lit_type == LIT_FLOAT &&
+        isfinite(e->u.num.lit.f64) && fabs(e->u.num.lit.f64) <= RG_EXACT)
+    {
+        if (cx->apply) { rg_lit_int_(e, (i64_t)e->u.num.lit.f64); cx->removed++; }
+        return;
+    }
+
+    const size_t depth = (cx->depth < RG_DEPTH_MAX) ? cx->depth : RG_DEPTH_MAX;
+    cx->cost += (size_t)1 << (3 * depth);
+}
+
+// candidates read in e leave the set
+static void rg_drop_reads_(rg_ctx_t* cx, const ast_node_t* e)
+{
+    if (e->kind == ASTK_IDENT)
+    {
+        const size_t var = rg_lookup_(cx, e->u.ident.name_id);
+        const size_t c   = (var != SIZE_MAX) ? cx->binds[var].cand : SIZE_MAX;
+        if (c != SIZE_MAX && cx->cands[c].retype)
+        {
+            cx->cands[c].retype = 0;
+            cx->dropped = 1;
+        }
+    }
+
+    for (const ast_node_t* c = e->left; c; c = c->right)
+        rg_drop_reads_(cx, c);
+}
+
+static int rg_flipped_(rg_ty_t t)
+{
+    return t.was == AST_TYPE_FLOAT && t.now == AST_TYPE_INT;
+}
+
+static rg_ty_t rg_ty_(rg_ctx_t* cx, ast_node_t* n);
+
+static void rg_ty_list_(rg_ctx_t* cx, ast_node_t* first)
+{
+    for (ast_node_t* c = first; c; c = c->right)
+        rg_ty_(cx, c);
+}
+
+static rg_ty_t rg_ty_call_(rg_ctx_t* cx, ast_node_t* e)
+{
+    const size_t id   = e->u.call.name_id;
+    const int    kind = (id < cx->names) ? cx->calls[id] : RG_CALL_OTHER;
+
+    const ast_node_t* fn = (id < cx->names && kind == RG_CALL_USER) ? cx->funcs[id] : NULL;
+    const ast_node_t* p  = (fn && fn->left) ? fn->left->left : NULL;
+
+    for (ast_node_t* a = e->left ? e->left->left : NULL; a; a = a->right)
+    {
+        const rg_ty_t t = rg_ty_(cx, a);
+
+        if (kind == RG_CALL_INT_ARGS)  rg_conv_(cx, a, t.now, AST_TYPE_INT);
+        if (kind == RG_CALL_FLOAT_ARG) rg_conv_(cx, a, t.now, AST_TYPE_FLOAT);
+        if (p)
+        {
+            rg_conv_(cx, a, t.now, p->u.param.type);
+            p = p->right;
+        }
+    }
+    return (rg_ty_t){ e->type, e->type };
+}
+
+static rg_ty_t rg_ty_binary_(rg_ctx_t* cx, ast_node_t* e)
+{
+    ast_node_t* a = e->left;
+    ast_node_t* b = a ? a->right : NULL;
+    if (!b) return (rg_ty_t){ AST_TYPE_UNKNOWN, AST_TYPE_UNKNOWN };
+
+    const rg_ty_t ta = rg_ty_(cx, a);
+    const rg_ty_t tb = rg_ty_(cx, b);
+    const token_kind_t op = e->u.binary.op;
+
+    if (op == TOK_OP_AND || op == TOK_OP_OR)
+    {
+        rg_conv_(cx, a, ta.now, AST_TYPE_INT);
+        rg_conv_(cx, b, tb.now, AST_TYPE_INT);
+        return (rg_ty_t){ AST_TYPE_INT, AST_TYPE_INT };
+    }
+
+    // the backend picks one of four instructions by the operand types
+    if (op == TOK_OP_POW)
+    {
+        if (!cx->apply && rg_flipped_(ta)) rg_drop_reads_(cx, a);
+        if (!cx->apply && rg_flipped_(tb)) rg_drop_reads_(cx, b);
+        return (rg_ty_t){
+            (ta.now == AST_TYPE_INT && tb.now == AST_TYPE_INT) ? AST_TYPE_INT : AST_TYPE_FLOAT,
+            (ta.was == AST_TYPE_INT && tb.was == AST_TYPE_INT) ? AST_TYPE_INT : AST_TYPE_FLOAT,
+        };
+    }
+
+    const ast_type_t now = rg_arith_type_(ta.now, tb.now);
+    rg_conv_(cx, a, ta.now, now);
+    rg_conv_(cx, b, tb.now, now);
+
+    if (rg_is_compare_(op)) return (rg_ty_t){ AST_TYPE_INT, AST_TYPE_INT };
+    return (rg_ty_t){ now, rg_arith_type_(ta.was, tb.was) };
+}
+
+// floor(x) of a whole float x is x
+static rg_ty_t rg_ty_builtin_(rg_ctx_t* cx, ast_node_t* e)
+{
+    const rg_ty_t t  = e->left ? rg_ty_(cx, e->left) : (rg_ty_t){ AST_TYPE_UNKNOWN, AST_TYPE_UNKNOWN };
+    const int     id = e->u.builtin_unary.id;
+
+    if (id == AST_BUILTIN_FTOI)
+    {
+        rg_conv_(cx, e->left, t.now, AST_TYPE_INT);
+        return (rg_ty_t){ AST_TYPE_INT, AST_TYPE_INT };
+    }
+
+    rg_conv_(cx, e->left, t.now, AST_TYPE_FLOAT);
+
+    const int rounding = (id == AST_BUILTIN_FLOOR || id == AST_BUILTIN_CEIL || id == AST_BUILTIN_ROUND);
+    if (cx->apply && rounding && t.now == AST_TYPE_FLOAT && rg_note_exact_(cx, e->left))
+    {
+        ast_node_t* x      = e->left;
+        ast_node_t* right  = e->right;
+        ast_node_t* parent = e->parent;
+
+        *e = *x;
+        e->right  = right;
+        e->parent = parent;
+        for (ast_node_t* c = e->left; c; c = c->right) c->parent = e;
+        cx->removed++;
+    }
+    return (rg_ty_t){ AST_TYPE_FLOAT, AST_TYPE_FLOAT };
+}
+
+static rg_ty_t rg_ty_expr_(rg_ctx_t* cx, ast_node_t* e)
+{
+    switch (e->kind)
+    {
+        case ASTK_NUM_LIT:
+        {
+            const ast_type_t t = (e->u.num.lit_type == LIT_FLOAT) ? AST_TYPE_FLOAT : AST_TYPE_INT;
+            return (rg_ty_t){ t, t };
+        }
+
+        case ASTK_STR_LIT:
+            return (rg_ty_t){ AST_TYPE_PTR, AST_TYPE_PTR };
+
+        case ASTK_IDENT:
+        {
+            const size_t var = rg_lookup_(cx, e->u.ident.name_id);
+            if (var == SIZE_MAX) return (rg_ty_t){ AST_TYPE_UNKNOWN, AST_TYPE_UNKNOWN };
+
+            const rg_bind_t* b = &cx->binds[var];
+            const int retype   = (b->cand != SIZE_MAX && cx->cands[b->cand].retype);
+            return (rg_ty_t){ retype ? AST_TYPE_INT : b->type, b->type };
+        }
+
+        case ASTK_CALL:
+            return rg_ty_call_(cx, e);
+
+        case ASTK_BUILTIN_UNARY:
+            return rg_ty_builtin_(cx, e);
+
+        case ASTK_UNARY:
+        {
+            const rg_ty_t t = e->left ? rg_ty_(cx, e->left) : (rg_ty_t){ AST_TYPE_UNKNOWN, AST_TYPE_UNKNOWN };
+            if (e->u.unary.op != TOK_OP_NOT) return t;
+
+            rg_conv_(cx, e->left, t.now, AST_TYPE_INT);
+            return (rg_ty_t){ AST_TYPE_INT, AST_TYPE_INT };
+        }
+
+        case ASTK_BINARY:
+            return rg_ty_binary_(cx, e);
+
+        default:
+            rg_ty_list_(cx, e->left);
+            return (rg_ty_t){ e->type, e->type };
+    }
+}
+
+// only + - * on whole numbers within 2^53 may turn from float to int
+static void rg_ty_legal_(rg_ctx_t* cx, ast_node_t* e, rg_ty_t t)
+{
+    if (!rg_flipped_(t) || e->kind == ASTK_IDENT) return;
+
+    const int arith = (e->kind == ASTK_UNARY) ||
+                      (e->kind == ASTK_BINARY && (e->u.binary.op == TOK_OP_PLUS ||
+                                                  e->u.binary.op == TOK_OP_MINUS ||
+                                                  e->u.binary.op == TOK_OP_MUL));
+    if (!arith || !rg_note_exact_(cx, e)) rg_drop_reads_(cx, e);
+}
+
+static rg_ty_t rg_ty_(rg_ctx_t* cx, ast_node_t* n)
+{
+    const rg_ty_t none = { AST_TYPE_VOID, AST_TYPE_VOID };
+    if (!n || cx->rc != OK) return none;
+
+    if (ast_is_expr_kind(n->kind))
+    {
+        const rg_ty_t t = rg_ty_expr_(cx, n);
+        if (!cx->apply) rg_ty_legal_(cx, n, t);
+        return t;
+    }
+
+    const size_t mark = cx->bind_count;
+
+    switch (n->kind)
+    {
+        case ASTK_PARAM:
+            cx->rc = rg_push_bind_(cx, n->u.param.name_id, n->u.param.type, SIZE_MAX);
+            return none;
+
+        case ASTK_VAR_DECL:
+        {
+            const size_t cand = (n->u.vdecl.type == AST_TYPE_FLOAT) ? rg_cand_find_(cx, n) : SIZE_MAX;
+            const int    ret  = (cand != SIZE_MAX && cx->cands[cand].retype);
+
+            cx->rc = rg_push_bind_(cx, n->u.vdecl.name_id, n->u.vdecl.type, cand);
+            if (n->left)
+            {
+                const rg_ty_t t = rg_ty_(cx, n->left);
+                rg_conv_(cx, n->left, t.now, ret ? AST_TYPE_INT : n->u.vdecl.type);
+            }
+            return none;
+        }
+
+        case ASTK_ASSIGN:
+        {
+            const rg_ty_t t   = rg_ty_(cx, n->left);
+            const size_t  var = rg_lookup_(cx, n->u.assign.name_id);
+            if (var == SIZE_MAX) return none;
+
+            const rg_bind_t* b = &cx->binds[var];
+            const int retype   = (b->cand != SIZE_MAX && cx->cands[b->cand].retype);
+            rg_conv_(cx, n->left, t.now, retype ? AST_TYPE_INT : b->type);
+            return none;
+        }
+
+        case ASTK_RETURN:
+        {
+            const rg_ty_t t = rg_ty_(cx, n->left);
+            if (cx->ret_type != AST_TYPE_VOID) rg_conv_(cx, n->left, t.now, cx->ret_type);
+            return none;
+        }
+
+        case ASTK_COUT:
+        case ASTK_ICOUT:
+        case ASTK_FCOUT:
+        {
+            const rg_ty_t t = rg_ty_(cx, n->left);
+            rg_conv_(cx, n->left, t.now, (n->kind == ASTK_FCOUT) ? AST_TYPE_FLOAT : AST_TYPE_INT);
+            return none;
+        }
+
+        case ASTK_WHILE:
+            cx->depth++;
+            rg_ty_list_(cx, n->left);
+            cx->depth--;
+            return none;
+
+        default:
+            rg_ty_list_(cx, n->left);
+            break;
+    }
+
+    // params live until the end of their function, locals until the end of their block
+    if (n->kind == ASTK_FUNC || n->kind == ASTK_BLOCK) cx->bind_count = mark;
+    return none;
+}
+
+static size_t rg_cost_(rg_ctx_t* cx, ast_node_t* fn)
+{
+    cx->bind_count = 0;
+    cx->depth      = 0;
+    cx->cost       = 0;
+    rg_ty_(cx, fn);
+    return cx->cost;
+}
+
+// the candidates worth retyping, marked retype
+static void rg_pick_(rg_ctx_t* cx, ast_node_t* fn)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < cx->cand_count; ++i)
+    {
+        rg_cand_t* c = &cx->cands[i];
+        c->retype = c->seen && c->whole;
+        count += (size_t)c->retype;
+    }
+    if (count == 0) return;
+
+    // taking a candidate out never turns another node from float to int
+    size_t with = 0;
+    do
+    {
+        cx->dropped = 0;
+        with = rg_cost_(cx, fn);
+    } while (cx->dropped && cx->rc == OK);
+
+    for (size_t i = 0; i < cx->cand_count; ++i)
+    {
+        cx->cands[i].saved  = cx->cands[i].retype;
+        cx->cands[i].retype = 0;
+    }
+    const size_t base = rg_cost_(cx, fn);
+    for (size_t i = 0; i < cx->cand_count; ++i) cx->cands[i].retype = cx->cands[i].saved;
+
+    for (size_t i = 0; i < cx->cand_count && count <= RG_GREEDY_MAX; ++i)
+    {
+        if (!cx->cands[i].retype) continue;
+
+        cx->cands[i].retype = 0;
+        const size_t cost = rg_cost_(cx, fn);
+        if (cost < with) with = cost;
+        else             cx->cands[i].retype = 1;
+    }
+
+    if (with >= base || cx->rc != OK)
+        for (size_t i = 0; i < cx->cand_count; ++i) cx->cands[i].retype = 0;
+}
+
+static int rg_has_call_(const ast_node_t* e)
+{
+    for (; e; e = e->right)
+        if (e->kind == ASTK_CALL || rg_has_call_(e->left)) return 1;
+    return 0;
+}
+
+// conditions settled on every path that reaches them become literals
+static void rg_settle_checks_(rg_ctx_t* cx)
+{
+    if (cx->check_count > 1) qsort(cx->checks, cx->check_count, sizeof(rg_check_t), rg_check_cmp_);
+
+    for (size_t i = 0; i < cx->check_count; )
+    {
+        ast_node_t* cond  = cx->checks[i].cond;
+        int         truth = cx->checks[i].truth;
+
+        size_t j = i + 1;
+        for (; j < cx->check_count && cx->checks[j].cond == cond; ++j)
+            if (cx->checks[j].truth != truth) truth = -1;
+        i = j;
+
+        if (truth < 0 || cond->kind == ASTK_NUM_LIT || rg_has_call_(cond->left)) continue;
+
+        cond->kind = ASTK_NUM_LIT;
+        cond->left = NULL;
+        rg_lit_int_(cond, truth);
+        cx->removed++;
+    }
+}
+
+// ================================= functions ================================
+
+static err_t rg_func_(rg_ctx_t* cx, ast_node_t* fn)
+{
+    ast_node_t* plist = fn->left;
+    ast_node_t* body  = plist ? plist->right : NULL;
+    if (!plist || !body) return OK;
+
+    cx->bind_count  = 0;
+    cx->loop_count  = 0;
+    cx->cand_count  = 0;
+    cx->note_count  = 0;
+    cx->check_count = 0;
+    cx->exhausted   = 0;
+    cx->rewrite     = 1;
+    cx->budget      = 64 * ast_subtree_size(fn) + 1024;
+    cx->ret_type    = fn->u.func.ret_type;
+
+    rg_env_t env = { .live = 1 };
+    err_t rc = OK;
+
+    for (ast_node_t* p = plist->left; p && rc == OK; p = p->right)
+    {
+        size_t var = 0;
+        rc = rg_bind_(cx, &env, NULL, p->u.param.name_id, p->u.param.type, &var);
+    }
+
+    if (rc == OK) rc = rg_stmt_(cx, &env, body);
+    if (rc == OK) rc = cx->rc;
+    mem_free(env.vals);
+
+    // a partial walk proves nothing
+    if (rc != OK || cx->exhausted)
+    {
+        if (cx->exhausted)
+            LOG_DEBUG("Range: budget exhausted in '%s', left as is",
+                      ast_name_cstr(cx->tree, fn->u.func.name_id));
+        return rc;
+    }
+
+    if (cx->note_count > 1) qsort(cx->notes, cx->note_count, sizeof(rg_note_t), rg_note_cmp_);
+
+    // a node walked twice keeps the join of what it saw
+    size_t keep = 0;
+    for (size_t i = 0; i < cx->note_count; ++i)
+    {
+        if (keep && cx->notes[keep - 1].node == cx->notes[i].node)
+            rg_join_(&cx->notes[keep - 1].val, &cx->notes[i].val);
+        else
+            cx->notes[keep++] = cx->notes[i];
+    }
+    cx->note_count = keep;
+
+    rg_settle_checks_(cx);
+    rg_pick_(cx, fn);
+
+    cx->apply = 1;
+    rg_cost_(cx, fn);
+    cx->apply = 0;
+
+    for (size_t i = 0; i < cx->cand_count; ++i)
+    {
+        if (!cx->cands[i].retype) continue;
+        cx->cands[i].decl->u.vdecl.type = AST_TYPE_INT;
+        cx->retyped++;
+    }
+    return cx->rc;
+}
+
+static const struct { const char* name; rg_call_t kind; } rg_builtins[] = {
+    { "out",  RG_CALL_INT_ARGS  }, { "pookie",    RG_CALL_INT_ARGS },
+    { "cout", RG_CALL_INT_ARGS  }, { "menace",    RG_CALL_INT_ARGS },
+    { "fout", RG_CALL_FLOAT_ARG }, { "rizz",      RG_CALL_FLOAT_ARG },
+    { "in",   RG_CALL_OTHER     }, { "cap",       RG_CALL_OTHER },
+    { "fin",  RG_CALL_OTHER     }, { "nocap",     RG_CALL_OTHER },
+    { "cin",  RG_CALL_OTHER     }, { "stinky",    RG_CALL_OTHER },
+    { "draw", RG_CALL_OTHER     }, { "gyat",      RG_CALL_OTHER },
+    { "clean_vm", RG_CALL_OTHER }, { "skibidi",   RG_CALL_OTHER },
+    { "set_pixel", RG_CALL_INT_ARGS },
+};
+
+// callee of every name id, builtins win over a function of the same name
+static err_t rg_callees_(rg_ctx_t* cx, const ast_node_t* program)
+{
+    cx->names = cx->tree->nametable.amount;
+    cx->funcs = (const ast_node_t**)mem_calloc(MEM_TAG_OPT, cx->names + 1, sizeof(ast_node_t*));
+    cx->calls = (unsigned char*)mem_calloc(MEM_TAG_OPT, cx->names + 1, 1);
+    if (!cx->funcs || !cx->calls) return ERR_ALLOC;
+
+    for (const ast_node_t* fn = program->left; fn; fn = fn->right)
+        if (fn->kind == ASTK_FUNC && fn->u.func.name_id < cx->names)
+            cx->funcs[fn->u.func.name_id] = fn;
+
+    for (size_t i = 0; i < sizeof(rg_builtins) / sizeof(rg_builtins[0]); ++i)
+    {
+        const char*  name = rg_builtins[i].name;
+        const size_t id   = nametable_find(&cx->tree->nametable, name, strlen(name));
+        if (id < cx->names) cx->calls[id] = (unsigned char)rg_builtins[i].kind;
+    }
+    return OK;
+}
+
+err_t opt_range(ast_tree_t* tree, size_t* out_retyped, size_t* out_removed)
+{
+    if (!tree || !out_retyped || !out_removed) return ERR_BAD_ARG;
+    *out_retyped = 0;
+    *out_removed = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM) return OK;
+
+    rg_ctx_t cx = { .tree = tree };
+    err_t rc = rg_callees_(&cx, program);
+
+    for (ast_node_t* fn = program->left; fn && rc == OK; fn = fn->right)
+        if (fn->kind == ASTK_FUNC)
+            rc = rg_func_(&cx, fn);
+
+    for (size_t i = 0; i < cx.loop_cap; ++i)
+        mem_free(cx.loops[i].exit.vals);
+    mem_free(cx.loops);
+    for (size_t i = 0; i < cx.spare_count; ++i)
+        mem_free(cx.spare[i].vals);
+    mem_free(cx.spare);
+    mem_free(cx.binds);
+    mem_free(cx.cands);
+    mem_free(cx.notes);
+    mem_free(cx.checks);
+    mem_free(cx.funcs);
+    mem_free(cx.calls);
+
+    *out_retyped = cx.retyped;
+    *out_removed = cx.removed;
+    return rc;
+}
@@ -0,0 +1,187 @@
+#include "middleend.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Profile-guided arm order. An alpha/omega chain whose conditions all
+    compare the same int variable with a literal, on ranges that do not
+    overlap, tests them in any order with the same result:
+
+        alpha (x == 1) A  omega (x > 9) B  omega (x < 0) C  sigma D
+
+    With profile counts in the arms, the most frequently taken one is
+    tested first. sigma stays last, the chain keeps its nodes and the
+    counts travel with the arms
+*/
+
+typedef struct
+{
+    ast_node_t* cond;
+    ast_node_t* then;
+    size_t      hits;
+    i64_t       lo;
+    i64_t       hi;
+} ro_arm_t;
+
+typedef struct
+{
+    ast_node_t** nodes;      // IF, then the BRANCHes
+    ro_arm_t*    arms;
+    size_t       cap;
+    size_t       reordered;
+} ro_ctx_t;
+
+// the range of x that cond accepts, 0 when it is not x <op> literal
+static int ro_range_(const ast_node_t* cond, size_t* var, i64_t* lo, i64_t* hi)
+{
+    if (!cond || cond->kind != ASTK_BINARY || !cond->left || !cond->left->right) return 0;
+
+    const ast_node_t* a = cond->left;
+    const ast_node_t* b = a->right;
+    token_kind_t      op = cond->u.binary.op;
+
+    // literal on the left: mirror the compare
+    if (a->kind == ASTK_NUM_LIT)
+    {
+        const ast_node_t* t = a; a = b; b = t;
+        if      (op == TOK_OP_LT)  op = TOK_OP_GT;
+        else if (op == TOK_OP_GT)  op = TOK_OP_LT;
+        else if (op == TOK_OP_LTE) op = TOK_OP_GTE;
+        else if (op == TOK_OP_GTE) op = TOK_OP_LTE;
+    }
+
+    if (a->kind != ASTK_IDENT || a->type != AST_TYPE_INT) return 0;
+    if (b->kind != ASTK_NUM_LIT || b->u.num.lit_type != LIT_INT) return 0;
+
+    const i64_t k = b->u.num.lit.i64;
+    *var = a->u.ident.name_id;
+    *lo  = INT64_MIN;
+    *hi  = INT64_MAX;
+
+    switch (op)
+    {
+        case TOK_OP_EQ:  *lo = k; *hi = k; return 1;
+        case TOK_OP_LTE: *hi = k;          return 1;
+        case TOK_OP_GTE: *lo = k;          return 1;
+        case TOK_OP_LT:  if (k == INT64_MIN) return 0; *hi = k - 1; return 1;
+        case TOK_OP_GT:  if (k == INT64_MAX) return 0; *lo = k + 1; return 1;
+        default:         return 0;
+    }
+}
+
+static err_t ro_grow_(ro_ctx_t* cx, size_t want)
+{
+    if (want <= cx->cap) return OK;
+
+    size_t cap = cx->cap ? cx->cap * 2 : 16;
+    while (cap < want) cap *= 2;
+
+    ast_node_t** nodes = (ast_node_t**)mem_realloc(MEM_TAG_OPT, cx->nodes, cap * sizeof(ast_node_t*));
+    if (!nodes) return ERR_ALLOC;
+    cx->nodes = nodes;
+
+    ro_arm_t* arms = (ro_arm_t*)mem_realloc(MEM_TAG_OPT, cx->arms, cap * sizeof(ro_arm_t));
+    if (!arms) return ERR_ALLOC;
+    cx->arms = arms;
+
+    cx->cap = cap;
+    return OK;
+}
+
+static err_t ro_chain_(ro_ctx_t* cx, ast_node_t* ifn)
+{
+    size_t count = 0, var = SIZE_MAX;
+    int    hot   = 0;
+    ast_node_t* tail = NULL;
+
+    for (ast_node_t* n = ifn; n; n = tail)
+    {
+        if (n->kind == ASTK_ELSE) break;
+
+        ast_node_t* cond = n->left;
+        ast_node_t* then = cond ? cond->right : NULL;
+        if (!then) return OK;
+        tail = then->right;
+
+        err_t rc = ro_grow_(cx, count + 1);
+        if (rc != OK) return rc;
+
+        ro_arm_t* arm = &cx->arms[count];
+        size_t    v   = SIZE_MAX;
+        if (!ro_range_(cond, &v, &arm->lo, &arm->hi) || (var != SIZE_MAX && v != var)) return OK;
+
+        for (size_t i = 0; i < count; ++i)
+            if (arm->lo <= cx->arms[i].hi && cx->arms[i].lo <= arm->hi) return OK;
+
+        var        = v;
+        arm->cond  = cond;
+        arm->then  = then;
+        arm->hits  = n->u.arm.hits;
+        hot       |= (arm->hits != 0);
+        cx->nodes[count++] = n;
+    }
+
+    if (count < 2 || !hot) return OK;
+
+    // stable: arms counted the same keep their order
+    int moved = 0;
+    for (size_t i = 1; i < count; ++i)
+        for (size_t j = i; j > 0 && cx->arms[j].hits > cx->arms[j - 1].hits; --j)
+        {
+            const ro_arm_t t = cx->arms[j];
+            cx->arms[j]     = cx->arms[j - 1];
+            cx->arms[j - 1] = t;
+            moved = 1;
+        }
+    if (!moved) return OK;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        ast_node_t* n   = cx->nodes[i];
+        ro_arm_t*   arm = &cx->arms[i];
+
+        n->left            = arm->cond;
+        arm->cond->right   = arm->then;
+        arm->then->right   = (i + 1 < count) ? cx->nodes[i + 1] : tail;
+        arm->cond->parent  = n;
+        arm->then->parent  = n;
+        n->u.arm.hits      = arm->hits;
+    }
+
+    cx->reordered++;
+    return OK;
+}
+
+static err_t ro_walk_(ro_ctx_t* cx, ast_node_t* n)
+{
+    for (; n; n = n->right)
+    {
+        if (n->kind == ASTK_IF)
+        {
+            err_t rc = ro_chain_(cx, n);
+            if (rc != OK) return rc;
+        }
+
+        err_t rc = ro_walk_(cx, n->left);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+err_t opt_reorder(ast_tree_t* tree, size_t* out_reordered)
+{
+    if (!tree || !out_reordered) return ERR_BAD_ARG;
+    *out_reordered = 0;
+
+    ro_ctx_t cx = { 0 };
+    err_t rc = ro_walk_(&cx, tree->root);
+
+    mem_free(cx.nodes);
+    mem_free(cx.arms);
+
+    *out_reordered = cx.reordered;
+    return rc;
+}
@@ -0,0 +1,347 @@
+#include "middleend.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Tail-call elimination. A function that calls itself as its last action,
+    by micdrop f(...) or, in a void one, by f(...) as the last statement, is
+    turned into a loop over its body:
+
+        yap
+            lowkey (1)
+            yap
+                lowkey (1)
+                    ...body, each tail call replaced by
+                    yap
+                        <param> t gaslight arg;   (args read by earlier params)
+                        p gaslight arg or t;      (one per param changed)
+                        gg
+                    yapity
+            yapity
+            micdrop 0;                    (non-void only, never reached)
+        yapity
+
+    The language has no continue, so gg leaves the inner loop and the outer
+    one starts the body again. Calls inside a user loop stay, gg would leave
+    that loop instead; so do functions that declare a local named as one of
+    their params
+*/
+
+typedef struct
+{
+    ast_tree_t*       tree;
+    const ast_node_t* fn;
+    size_t            param_count;
+    size_t            fresh;
+    size_t            sites;     // tail calls of the current function
+    size_t            replaced;
+} tc_ctx_t;
+
+static ast_node_t* tc_body_(const ast_node_t* fn)
+{
+    return fn->left ? fn->left->right : NULL;
+}
+
+static const ast_node_t* tc_param_(const tc_ctx_t* cx, size_t idx)
+{
+    return ast_child(cx->fn->left, idx);
+}
+
+static int tc_is_self_call_(const tc_ctx_t* cx, const ast_node_t* e)
+{
+    return e && e->kind == ASTK_CALL && e->u.call.name_id == cx->fn->u.func.name_id &&
+           ast_children_count(e->left) == cx->param_count;
+}
+
+static int tc_has_call_(const ast_node_t* e)
+{
+    for (; e; e = e->right)
+        if (e->kind == ASTK_CALL || tc_has_call_(e->left)) return 1;
+    return 0;
+}
+
+static int tc_reads_(const ast_node_t* e, size_t name_id)
+{
+    for (; e; e = e->right)
+    {
+        if (e->kind == ASTK_IDENT && e->u.ident.name_id == name_id) return 1;
+        if (tc_reads_(e->left, name_id)) return 1;
+    }
+    return 0;
+}
+
+static int tc_shadows_param_(const tc_ctx_t* cx, const ast_node_t* n)
+{
+    for (; n; n = n->right)
+    {
+        if (n->kind == ASTK_VAR_DECL)
+            for (size_t i = 0; i < cx->param_count; ++i)
+                if (tc_param_(cx, i)->u.param.name_id == n->u.vdecl.name_id) return 1;
+
+        if (tc_shadows_param_(cx, n->left)) return 1;
+    }
+    return 0;
+}
+
+// the self call a tail statement makes, NULL if it is not one
+static ast_node_t* tc_site_call_(const tc_ctx_t* cx, const ast_node_t* st, int tail)
+{
+    if (cx->fn->u.func.ret_type != AST_TYPE_VOID)
+        return (st->kind == ASTK_RETURN && tc_is_self_call_(cx, st->left)) ? st->left : NULL;
+
+    // a void micdrop ignores its value, the call has to be a statement
+    if (tail && (st->kind == ASTK_CALL_STMT || st->kind == ASTK_EXPR_STMT) &&
+        tc_is_self_call_(cx, st->left))
+        return st->left;
+    return NULL;
+}
+
+static ast_node_t* tc_ident_(tc_ctx_t* cx, token_pos_t pos, size_t name_id, ast_type_t type)
+{
+    ast_node_t* id = ast_new(cx->tree, ASTK_IDENT, pos);
+    if (!id) return NULL;
+
+    id->u.ident.name_id = name_id;
+    id->type            = type;
+    return id;
+}
+
+static ast_node_t* tc_int_lit_(tc_ctx_t* cx, token_pos_t pos, i64_t v)
+{
+    ast_node_t* lit = ast_new(cx->tree, ASTK_NUM_LIT, pos);
+    if (!lit) return NULL;
+
+    lit->u.num.lit_type = LIT_INT;
+    lit->u.num.lit.i64  = v;
+    lit->type           = AST_TYPE_INT;
+    return lit;
+}
+
+// lowkey (1) body
+static ast_node_t* tc_forever_(tc_ctx_t* cx, token_pos_t pos, ast_node_t* body)
+{
+    ast_node_t* w   = ast_new(cx->tree, ASTK_WHILE, pos);
+    ast_node_t* one = tc_int_lit_(cx, pos, 1);
+    if (!w || !one) return NULL;
+
+    ast_add_child(w, one);
+    ast_add_child(w, body);
+    return w;
+}
+
+// statement st making call becomes the param stores and gg
+static err_t tc_rewrite_site_(tc_ctx_t* cx, ast_node_t* st, ast_node_t* call)
+{
+    const token_pos_t pos = st->pos;
+
+    ast_node_t* block = ast_new(cx->tree, ASTK_BLOCK, pos);
+    if (!block) return ERR_ALLOC;
+
+    // args, then what each param gets (NULL: stays as it is)
+    ast_node_t** args = (ast_node_t**)mem_calloc(MEM_TAG_OPT, 2 * cx->param_count + 1, sizeof(ast_node_t*));
+    if (!args) return ERR_ALLOC;
+    ast_node_t** values = args + cx->param_count;
+
+    size_t i = 0;
+    for (ast_node_t* a = call->left->left; a; a = a->right) args[i++] = a;
+
+    // a call in any arg keeps all of them in order through temps
+    const int calls = tc_has_call_(call->left->left);
+    err_t     rc    = OK;
+
+    for (i = 0; i < cx->param_count && rc == OK; ++i)
+    {
+        const ast_node_t* p = tc_param_(cx, i);
+        ast_node_t*       a = args[i];
+        a->right  = NULL;
+        values[i] = NULL;
+
+        if (a->kind == ASTK_IDENT && a->u.ident.name_id == p->u.param.name_id) continue;
+
+        int temp = calls;
+        for (size_t k = 0; k < i && !temp; ++k)
+            temp = values[k] && tc_reads_(a, tc_param_(cx, k)->u.param.name_id);
+
+        values[i] = a;
+        if (!temp) continue;
+
+        size_t name = 0;
+        rc = opt_fresh_name(cx->tree, ast_name_cstr(cx->tree, p->u.param.name_id), "tc", &cx->fresh, &name);
+        if (rc != OK) break;
+
+        ast_node_t* vd = ast_new(cx->tree, ASTK_VAR_DECL, pos);
+        if (!vd) { rc = ERR_ALLOC; break; }
+        vd->u.vdecl.name_id = name;
+        vd->u.vdecl.type    = p->u.param.type;
+        vd->type            = p->u.param.type;
+        ast_add_child(vd, a);
+        ast_add_child(block, vd);
+
+        values[i] = tc_ident_(cx, pos, name, p->u.param.type);
+        if (!values[i]) rc = ERR_ALLOC;
+    }
+
+    for (i = 0; i < cx->param_count && rc == OK; ++i)
+    {
+        if (!values[i]) continue;
+
+        ast_node_t* asn = ast_new(cx->tree, ASTK_ASSIGN, pos);
+        if (!asn) { rc = ERR_ALLOC; break; }
+        asn->u.assign.name_id = tc_param_(cx, i)->u.param.name_id;
+        asn->type             = tc_param_(cx, i)->u.param.type;
+        ast_add_child(asn, values[i]);
+        ast_add_child(block, asn);
+    }
+
+    mem_free(args);
+    if (rc != OK) return rc;
+
+    ast_node_t* brk = ast_new(cx->tree, ASTK_BREAK, pos);
+    if (!brk) return ERR_ALLOC;
+    ast_add_child(block, brk);
+
+    ast_replace(st, block);
+    cx->replaced++;
+    cx->sites++;
+    return OK;
+}
+
+static err_t tc_stmt_(tc_ctx_t* cx, ast_node_t* st, int tail);
+
+// tail: the list ends the function, its last statement is a tail position
+static err_t tc_list_(tc_ctx_t* cx, ast_node_t* first, int tail)
+{
+    for (ast_node_t* st = first; st; )
+    {
+        ast_node_t* next = st->right;
+
+        // in a void function micdrop right after the call ends it too
+        const int st_tail = (tail && !next) ||
+                            (next && next->kind == ASTK_RETURN && !next->left);
+
+        err_t rc = tc_stmt_(cx, st, st_tail);
+        if (rc != OK) return rc;
+
+        st = next;
+    }
+    return OK;
+}
+
+static err_t tc_stmt_(tc_ctx_t* cx, ast_node_t* st, int tail)
+{
+    ast_node_t* call = tc_site_call_(cx, st, tail);
+    if (call) return tc_rewrite_site_(cx, st, call);
+
+    switch (st->kind)
+    {
+        case ASTK_BLOCK:
+            return tc_list_(cx, st->left, tail);
+
+        case ASTK_IF:
+        case ASTK_BRANCH:
+        {
+            ast_node_t* then = st->left ? st->left->right : NULL;
+            if (!then) return OK;
+
+            // the next arm hangs off this one, all of them end a tail if
+            ast_node_t* arm = then->right;
+            err_t rc = tc_stmt_(cx, then, tail);
+            if (rc == OK && arm) rc = tc_stmt_(cx, arm, tail);
+            return rc;
+        }
+
+        case ASTK_ELSE:
+            return st->left ? tc_stmt_(cx, st->left, tail) : OK;
+
+        // gg in here would leave the user's loop
+        case ASTK_WHILE:
+        default:
+            return OK;
+    }
+}
+
+static err_t tc_func_(tc_ctx_t* cx, ast_node_t* fn)
+{
+    ast_node_t* body = tc_body_(fn);
+    if (!body || body->kind != ASTK_BLOCK) return OK;
+
+    cx->fn          = fn;
+    cx->param_count = ast_children_count(fn->left);
+    cx->sites       = 0;
+
+    if (tc_shadows_param_(cx, body->left)) return OK;
+
+    err_t rc = tc_list_(cx, body->left, 1);
+    if (rc != OK || cx->sites == 0) return rc;
+
+    const token_pos_t pos = body->pos;
+
+    // the loop must not run a void body again when it falls off the end
+    ast_node_t* last = body->left;
+    while (last && last->right) last = last->right;
+
+    const ast_type_t rt = fn->u.func.ret_type;
+    if (rt == AST_TYPE_VOID && (!last || last->kind != ASTK_RETURN))
+    {
+        ast_node_t* ret = ast_new(cx->tree, ASTK_RETURN, pos);
+        if (!ret) return ERR_ALLOC;
+        ast_add_child(body, ret);
+    }
+
+    ast_node_t* head  = ast_new(cx->tree, ASTK_BLOCK, pos);
+    ast_node_t* outer = ast_new(cx->tree, ASTK_BLOCK, pos);
+    if (!head || !outer) return ERR_ALLOC;
+
+    ast_replace(body, head);
+
+    ast_node_t* inner_loop = tc_forever_(cx, pos, body);
+    if (!inner_loop) return ERR_ALLOC;
+    ast_add_child(outer, inner_loop);
+
+    ast_node_t* outer_loop = tc_forever_(cx, pos, outer);
+    if (!outer_loop) return ERR_ALLOC;
+    ast_add_child(head, outer_loop);
+
+    // a non-void body ends in micdrop or a tail call, the loop never falls
+    // out; the function still has to end with one
+    if (rt != AST_TYPE_VOID)
+    {
+        ast_node_t* ret  = ast_new(cx->tree, ASTK_RETURN, pos);
+        ast_node_t* zero = tc_int_lit_(cx, pos, 0);
+        if (!ret || !zero) return ERR_ALLOC;
+        if (rt == AST_TYPE_FLOAT)
+        {
+            zero->u.num.lit_type = LIT_FLOAT;
+            zero->u.num.lit.f64  = 0.0;
+            zero->type           = AST_TYPE_FLOAT;
+        }
+        ast_add_child(ret, zero);
+        ast_add_child(head, ret);
+    }
+
+    return OK;
+}
+
+err_t opt_tailcall(ast_tree_t* tree, size_t* out_replaced)
+{
+    if (!tree || !out_replaced) return ERR_BAD_ARG;
+    *out_replaced = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM) return OK;
+
+    tc_ctx_t cx = { .tree = tree };
+
+    for (ast_node_t* fn = program->left; fn; fn = fn->right)
+    {
+        if (fn->kind != ASTK_FUNC) continue;
+
+        err_t rc = tc_func_(&cx, fn);
+        if (rc != OK) return rc;
+    }
+
+    *out_replaced = cx.replaced;
+    return OK;
+}
@@ -0,0 +1,354 @@
+#include "middleend.h"
+
+#include <string.h>
+
+#include "../libs/memory/memory.h"
+
+/*
+    Unrolling of counted loops, the shape highkey leaves behind:
+
+        npc i gaslight c0;
+        lowkey (i < n)          (also <=, >, >=, !=; n a literal)
+        yap
+            ...body, no store to i and no gg of this loop
+            i gaslight i + s;   (or i - s, s + i)
+        yapity
+
+    The trip count is known, so the loop is replaced by one copy of the
+    body per iteration with i read as a literal, when all of them fit the
+    budget. Otherwise a copy reads i + j*s, k of them share one step of
+    k*s, and the trip count modulo k is peeled in front as literal copies,
+    so the condition still falls exactly on the last iteration. i starts
+    at the value it has after the peeled copies and ends where the loop
+    would leave it
+*/
+
+// bounds keep c0 + trips*s and every offset far from overflow
+#define UNR_MAX_ABS_ 0x7FFFFFFFLL
+#define UNR_MAX_STEP_ 0xFFFFFLL
+
+typedef struct
+{
+    ast_tree_t* tree;
+    size_t      budget;
+    size_t      unrolled;
+} unr_ctx_t;
+
+typedef struct
+{
+    ast_node_t* decl;
+    ast_node_t* loop;
+    ast_node_t* body;
+    ast_node_t* step;       // last statement of body
+    size_t      name_id;
+    i64_t       start;
+    i64_t       inc;
+    i64_t       trips;
+} unr_loop_t;
+
+static int unr_int_lit_(const ast_node_t* n, i64_t* out)
+{
+    if (!n || n->kind != ASTK_NUM_LIT || n->u.num.lit_type != LIT_INT) return 0;
+    *out = n->u.num.lit.i64;
+    return 1;
+}
+
+static int unr_is_var_(const ast_node_t* n, size_t name_id)
+{
+    return n && n->kind == ASTK_IDENT && n->u.ident.name_id == name_id;
+}
+
+static ast_node_t* unr_last_(ast_node_t* list)
+{
+    while (list && list->right) list = list->right;
+    return list;
+}
+
+// i gaslight i + s, i - s or s + i; s as added each time
+static int unr_step_(const ast_node_t* st, size_t name_id, i64_t* out)
+{
+    if (!st || st->kind != ASTK_ASSIGN || st->u.assign.name_id != name_id) return 0;
+
+    const ast_node_t* e = st->left;
+    if (!e || e->kind != ASTK_BINARY || !e->left || !e->left->right) return 0;
+
+    const ast_node_t* a = e->left;
+    const ast_node_t* b = a->right;
+    const token_kind_t op = e->u.binary.op;
+
+    i64_t s = 0;
+    if (op == TOK_OP_PLUS && unr_is_var_(a, name_id) && unr_int_lit_(b, &s)) {}
+    else if (op == TOK_OP_PLUS && unr_is_var_(b, name_id) && unr_int_lit_(a, &s)) {}
+    else if (op == TOK_OP_MINUS && unr_is_var_(a, name_id) && unr_int_lit_(b, &s)) s = -s;
+    else return 0;
+
+    if (s == 0 || s > UNR_MAX_STEP_ || s < -UNR_MAX_STEP_) return 0;
+    *out = s;
+    return 1;
+}
+
+// nothing in the body changes i or leaves the loop with gg
+static int unr_clean_(const ast_node_t* n, size_t name_id, int nested)
+{
+    for (; n; n = n->right)
+    {
+        if (n->kind == ASTK_ASSIGN   && n->u.assign.name_id == name_id) return 0;
+        if (n->kind == ASTK_VAR_DECL && n->u.vdecl.name_id  == name_id) return 0;
+        if (n->kind == ASTK_BREAK    && !nested) return 0;
+
+        if (!unr_clean_(n->left, name_id, nested || n->kind == ASTK_WHILE)) return 0;
+    }
+    return 1;
+}
+
+// iterations of i = c0, c0 + s, ... while i op n holds; -1 if it never stops
+static i64_t unr_trips_(token_kind_t op, i64_t c0, i64_t n, i64_t s)
+{
+    switch (op)
+    {
+        case TOK_OP_LT:  if (s < 0) return c0 <  n ? -1 : 0; return c0 <  n ? (n - c0 + s - 1) / s : 0;
+        case TOK_OP_LTE: if (s < 0) return c0 <= n ? -1 : 0; return c0 <= n ? (n - c0) / s + 1   : 0;
+        case TOK_OP_GT:  if (s > 0) return c0 >  n ? -1 : 0; return c0 >  n ? (c0 - n - s - 1) / -s : 0;
+        case TOK_OP_GTE: if (s > 0) return c0 >= n ? -1 : 0; return c0 >= n ? (c0 - n) / -s + 1  : 0;
+
+        case TOK_OP_NEQ:
+            if ((n - c0) % s != 0 || (n - c0) / s < 0) return -1;
+            return (n - c0) / s;
+
+        default:
+            return -1;
+    }
+}
+
+static int unr_match_(ast_node_t* decl, ast_node_t* loop, unr_loop_t* out)
+{
+    if (!decl || decl->kind != ASTK_VAR_DECL || decl->u.vdecl.type != AST_TYPE_INT) return 0;
+    if (!loop || loop->kind != ASTK_WHILE) return 0;
+
+    const size_t name_id = decl->u.vdecl.name_id;
+
+    i64_t c0 = 0;
+    if (!unr_int_lit_(decl->left, &c0) || decl->left->right) return 0;
+
+    const ast_node_t* cond = loop->left;
+    ast_node_t*       body = cond ? cond->right : NULL;
+    if (!cond || cond->kind != ASTK_BINARY || !body || body->kind != ASTK_BLOCK) return 0;
+
+    i64_t n = 0;
+    if (!unr_is_var_(cond->left, name_id) || !unr_int_lit_(cond->left->right, &n)) return 0;
+
+    ast_node_t* step = unr_last_(body->left);
+    i64_t s = 0;
+    if (!unr_step_(step, name_id, &s)) return 0;
+
+    if (c0 > UNR_MAX_ABS_ || c0 < -UNR_MAX_ABS_ || n > UNR_MAX_ABS_ || n < -UNR_MAX_ABS_) return 0;
+
+    for (const ast_node_t* st = body->left; st != step; st = st->right)
+    {
+        if (st->kind == ASTK_ASSIGN   && st->u.assign.name_id == name_id) return 0;
+        if (st->kind == ASTK_VAR_DECL && st->u.vdecl.name_id  == name_id) return 0;
+        if (st->kind == ASTK_BREAK) return 0;
+        if (!unr_clean_(st->left, name_id, st->kind == ASTK_WHILE)) return 0;
+    }
+
+    const i64_t trips = unr_trips_(cond->u.binary.op, c0, n, s);
+    if (trips < 0) return 0;
+
+    *out = (unr_loop_t){ .decl = decl, .loop = loop, .body = body, .step = step,
+                         .name_id = name_id, .start = c0, .inc = s, .trips = trips };
+    return 1;
+}
+
+static ast_node_t* unr_lit_(unr_ctx_t* cx, token_pos_t pos, i64_t v)
+{
+    ast_node_t* lit = ast_new(cx->tree, ASTK_NUM_LIT, pos);
+    if (!lit) return NULL;
+
+    lit->u.num.lit_type = LIT_INT;
+    lit->u.num.lit.i64  = v;
+    lit->type           = AST_TYPE_INT;
+    return lit;
+}
+
+// reads of i become the literal value (as_lit) or i + value
+static err_t unr_subst_(unr_ctx_t* cx, ast_node_t* n, size_t name_id, i64_t value, int as_lit)
+{
+    while (n)
+    {
+        ast_node_t* next = n->right;
+
+        if (unr_is_var_(n, name_id))
+        {
+            if (as_lit)
+            {
+                ast_node_t* lit = unr_lit_(cx, n->pos, value);
+                if (!lit) return ERR_ALLOC;
+                ast_replace(n, lit);
+            }
+            else if (value != 0)
+            {
+                ast_node_t* add = ast_new(cx->tree, ASTK_BINARY, n->pos);
+                ast_node_t* lit = unr_lit_(cx, n->pos, value);
+                if (!add || !lit) return ERR_ALLOC;
+
+                add->u.binary.op = TOK_OP_PLUS;
+                add->type        = AST_TYPE_INT;
+                ast_replace(n, add);
+                ast_add_child(add, n);
+                ast_add_child(add, lit);
+            }
+        }
+        else
+        {
+            err_t rc = unr_subst_(cx, n->left, name_id, value, as_lit);
+            if (rc != OK) return rc;
+        }
+
+        n = next;
+    }
+    return OK;
+}
+
+// the body without its step, as iteration j of the current loop
+static ast_node_t* unr_copy_(unr_ctx_t* cx, const unr_loop_t* lp, i64_t value, int as_lit)
+{
+    ast_node_t* copy = ast_new(cx->tree, ASTK_BLOCK, lp->body->pos);
+    if (!copy) return NULL;
+
+    for (const ast_node_t* st = lp->body->left; st != lp->step; st = st->right)
+    {
+        ast_node_t* c = ast_clone(cx->tree, st);
+        if (!c) return NULL;
+        ast_add_child(copy, c);
+    }
+
+    return (unr_subst_(cx, copy->left, lp->name_id, value, as_lit) == OK) ? copy : NULL;
+}
+
+static err_t unr_full_(unr_ctx_t* cx, const unr_loop_t* lp)
+{
+    ast_node_t* seq = ast_new(cx->tree, ASTK_BLOCK, lp->loop->pos);
+    if (!seq) return ERR_ALLOC;
+
+    for (i64_t j = 0; j < lp->trips; ++j)
+    {
+        ast_node_t* copy = unr_copy_(cx, lp, lp->start + j * lp->inc, 1);
+        if (!copy) return ERR_ALLOC;
+        ast_add_child(seq, copy);
+    }
+
+    lp->decl->left->u.num.lit.i64 = lp->start + lp->trips * lp->inc;
+    ast_replace(lp->loop, seq);
+    return OK;
+}
+
+static err_t unr_partial_(unr_ctx_t* cx, const unr_loop_t* lp, i64_t factor)
+{
+    const token_pos_t pos  = lp->loop->pos;
+    const i64_t       rest = lp->trips % factor;
+
+    ast_node_t* seq  = ast_new(cx->tree, ASTK_BLOCK, pos);
+    ast_node_t* body = ast_new(cx->tree, ASTK_BLOCK, lp->body->pos);
+    if (!seq || !body) return ERR_ALLOC;
+
+    for (i64_t j = 0; j < rest; ++j)
+    {
+        ast_node_t* copy = unr_copy_(cx, lp, lp->start + j * lp->inc, 1);
+        if (!copy) return ERR_ALLOC;
+        ast_add_child(seq, copy);
+    }
+
+    for (i64_t j = 0; j < factor; ++j)
+    {
+        ast_node_t* copy = unr_copy_(cx, lp, j * lp->inc, 0);
+        if (!copy) return ERR_ALLOC;
+        ast_add_child(body, copy);
+    }
+
+    // one step for all copies, reusing the old one
+    ast_node_t* e   = lp->step->left;
+    ast_node_t* var = ast_new(cx->tree, ASTK_IDENT, e->pos);
+    ast_node_t* inc = unr_lit_(cx, e->pos, factor * lp->inc);
+    if (!var || !inc) return ERR_ALLOC;
+
+    var->u.ident.name_id = lp->name_id;
+    var->type            = AST_TYPE_INT;
+    e->u.binary.op       = TOK_OP_PLUS;
+    e->left              = NULL;
+    ast_add_child(e, var);
+    ast_add_child(e, inc);
+    ast_add_child(body, lp->step);
+
+    lp->decl->left->u.num.lit.i64 = lp->start + rest * lp->inc;
+    ast_replace(lp->body, body);
+    ast_replace(lp->loop, seq);
+    ast_add_child(seq, lp->loop);
+    return OK;
+}
+
+static err_t unr_try_(unr_ctx_t* cx, ast_node_t* decl, ast_node_t* loop)
+{
+    unr_loop_t lp = { 0 };
+    if (!unr_match_(decl, loop, &lp)) return OK;
+
+    const size_t size = ast_subtree_size(lp.body);
+
+    if ((size_t)lp.trips <= cx->budget / size)
+    {
+        cx->unrolled++;
+        return unr_full_(cx, &lp);
+    }
+
+    // pays only if the unrolled loop still goes round a few times
+    for (i64_t factor = 8; factor >= 2; factor /= 2)
+    {
+        if ((size_t)factor > cx->budget / size || lp.trips < 2 * factor) continue;
+
+        cx->unrolled++;
+        return unr_partial_(cx, &lp, factor);
+    }
+    return OK;
+}
+
+static err_t unr_list_(unr_ctx_t* cx, ast_node_t* first)
+{
+    ast_node_t* prev = NULL;
+
+    for (ast_node_t* st = first; st; )
+    {
+        ast_node_t* next = st->right;
+
+        // inner loops first, the outer body is measured as they leave it
+        if (!ast_is_expr_kind(st->kind))
+        {
+            err_t rc = unr_list_(cx, st->left);
+            if (rc != OK) return rc;
+        }
+
+        if (st->kind == ASTK_WHILE && prev)
+        {
+            err_t rc = unr_try_(cx, prev, st);
+            if (rc != OK) return rc;
+        }
+
+        prev = st;
+        st   = next;
+    }
+    return OK;
+}
+
+err_t opt_unroll(ast_tree_t* tree, size_t budget, size_t* out_unrolled)
+{
+    if (!tree || !out_unrolled) return ERR_BAD_ARG;
+    *out_unrolled = 0;
+
+    ast_node_t* program = tree->root;
+    if (!program || program->kind != ASTK_PROGRAM || budget == 0) return OK;
+
+    unr_ctx_t cx = { .tree = tree, .budget = budget };
+
+    err_t rc = unr_list_(&cx, program->left);
+
+    *out_unrolled = cx.unrolled;
+    return rc;
+}
@@ -5,6 +5,8 @@
 #include "libs/types.h"
 #include "libs/logging/logging.h"
 #include "libs/io/io.h"
+#include "libs/stats/stats.h"
+#include "libs/memory/memory.h"
 
 #include "ast/ast.h"
 #include "reverse-frontend/reverse-frontend.h"
@@ -16,7 +18,7 @@ static char* make_rot_filename_(const char* base)
     /* If base already ends with .rot => keep */
     const char* dot = strrchr(base, '.');
     if (dot && strcmp(dot, ".rot") == 0)
-        return strdup(base);
+        return mem_strdup(MEM_TAG_IO, base);
 
     /* Strip extension if present */
     size_t prefix_len = strlen(base);
@@ -25,7 +27,7 @@ static char* make_rot_filename_(const char* base)
     const char* ext = ".rot";
     const size_t ext_len = 4;
 
-    char* out = (char*)calloc(prefix_len + ext_len + 1, 1);
+    char* out = (char*)mem_calloc(MEM_TAG_IO, prefix_len + ext_len + 1, 1);
     if (!out) return NULL;
 
     memcpy(out, base, prefix_len);
@@ -63,9 +65,9 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
         if ((fp) && (fp) != stdout) { fclose((fp)); (fp) = NULL; } \
     block_end
 
-#define SAFE_FREE(p)                    \
-    block_begin                         \
-        if (p) { free(p); (p) = NULL; } \
+#define SAFE_FREE(p)                        \
+    block_begin                             \
+        if (p) { mem_free(p); (p) = NULL; } \
     block_end
 
 #define FAIL_MSG(msg)                                                            \
@@ -74,7 +76,7 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
             snprintf(op_data.error_msg, sizeof(op_data.error_msg), "%s", (msg)); \
         fprintf(stderr, "%s\n", op_data.error_msg);                              \
         print_error_context_(stderr, &op_data);                                  \
-        log_printf(ERROR, "%s", op_data.error_msg);                              \
+        LOG_ERROR("%s", op_data.error_msg);                                      \
         rc = ERR_SYNTAX;                                                         \
         goto cleanup;                                                            \
     block_end
@@ -84,7 +86,7 @@ static void print_error_context_(FILE* out, const operational_data_t* op)
         snprintf(op_data.error_msg, sizeof(op_data.error_msg), (fmt), __VA_ARGS__); \
         fprintf(stderr, "%s\n", op_data.error_msg);                                 \
         print_error_context_(stderr, &op_data);                                     \
-        log_printf(ERROR, "%s", op_data.error_msg);                                 \
+        LOG_ERROR("%s", op_data.error_msg);                                         \
         rc = ERR_SYNTAX;                                                            \
         goto cleanup;                                                               \
     block_end
@@ -103,12 +105,23 @@ int main(int argc, char* const argv[])
 
     char* rot_name = NULL;
 
+    const char* stats_flag = NULL;
+    const char* stats_json = NULL;
+
+    const arg_option_t options[] = {
+        { "--stats",      ARG_FLAG,  &stats_flag },
+        { "--stats-json", ARG_VALUE, &stats_json },
+    };
+
     init_logging("reverse_frontend.log", DEBUG);
-    log_printf(INFO, "Reverse-frontend started (.east -> .rot)");
+    LOG_INFO("Reverse-frontend started (.east -> .rot)");
 
-    size_t parsed = parse_arguments(argc, argv, &in_filename, &out_filename);
+    size_t parsed = parse_arguments_ex(argc, argv, &in_filename, &out_filename,
+                                       options, sizeof(options) / sizeof(options[0]));
     unused parsed;
 
+    stats_init("reverse-frontend", stats_flag || stats_json);
+
     if (!CHECK(ERROR, in_filename != NULL,
                "No input file specified. Use --infile <filename>"))
     {
@@ -116,6 +129,7 @@ int main(int argc, char* const argv[])
     }
 
     /* open input .east */
+    stats_phase_begin(STATS_PHASE_LOAD);
     op_data.in_file = load_file(in_filename, "rb");
     if (!op_data.in_file)
         FAILF("Failed to open input file '%s'", in_filename);
@@ -133,6 +147,15 @@ int main(int argc, char* const argv[])
         FAIL_MSG("Failed to read/parse .east AST.");
 
     SAFE_FCLOSE(op_data.in_file);
+    stats_phase_end(STATS_PHASE_LOAD);
+
+    if (stats_enabled())
+    {
+        stats_set(STATS_INPUT_BYTES,    op_data.buffer_size);
+        stats_set(STATS_AST_NODES,      ast_subtree_size(ast_tree.root));
+        stats_set(STATS_AST_ALLOCS,     ast_tree.alloced_count);
+        stats_set(STATS_NAMETABLE_SIZE, ast_tree.nametable.amount);
+    }
 
     /* output filename */
     rot_name = out_filename ? make_rot_filename_(out_filename)
@@ -145,11 +168,18 @@ int main(int argc, char* const argv[])
         FAILF("Failed to open output file '%s' for writing", rot_name);
 
     /* unparse */
+    stats_phase_begin(STATS_PHASE_EMIT);
     rc = reverse_frontend_write_rot(&op_data, &ast_tree);
+    stats_phase_end(STATS_PHASE_EMIT);
     if (rc != OK)
         FAIL_MSG("Reverse-frontend failed while writing .rot");
 
-    log_printf(INFO, "Wrote .rot: %s", rot_name);
+    stats_phase_begin(STATS_PHASE_WRITE);
+    stats_set(STATS_OUTPUT_BYTES, (size_t)ftell(op_data.out_file));
+    SAFE_FCLOSE(op_data.out_file);
+    stats_phase_end(STATS_PHASE_WRITE);
+
+    LOG_INFO("Wrote .rot: %s", rot_name);
 
 cleanup:
     if (ast_inited) ast_tree_dtor(&ast_tree);
@@ -164,6 +194,11 @@ cleanup:
     SAFE_FREE(op_data.buffer);
     op_data.buffer_size = 0;
 
+    mem_leak_report(stderr);
+
+    if (stats_finish(stats_flag != NULL, stats_json) != OK && rc == OK)
+        rc = ERR_BAD_ARG;
+
     close_log_file();
     return (rc == OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }